@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+
+#include <core/ImagePyramidGenerator.h>
+#include <core/LieGaussNewton.h>
+#include <core/lie_algebra.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+/** \brief point-to-point alignment of a fixed point set, i.e., the simplest objective for the Gauss-Newton step. **/
+class PointToPointObjective : public Objective {
+ public:
+  PointToPointObjective(uint32_t num_points, uint32_t seed) : source_(num_points), target_(num_points) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> coord(-50.0, 50.0);
+    std::normal_distribution<double> noise(0.0, 0.01);
+
+    Eigen::VectorXd x(6);
+    x << 0.5, -0.2, 0.1, 0.01, -0.02, 0.05;
+    const Eigen::Matrix4d T = SE3::exp(x);
+
+    for (uint32_t i = 0; i < num_points; ++i) {
+      source_[i] = Eigen::Vector3d(coord(gen), coord(gen), 0.1 * coord(gen));
+      target_[i] = T.topLeftCorner<3, 3>() * source_[i] + T.topRightCorner<3, 1>();
+      target_[i] += Eigen::Vector3d(noise(gen), noise(gen), noise(gen));
+    }
+  }
+
+  uint32_t num_parameters() const override { return 6; }
+
+  double residual(const Eigen::VectorXd& delta) override {
+    const Eigen::Matrix4d T = SE3::exp(delta) * pose_;
+    const Eigen::Matrix3d R = T.topLeftCorner<3, 3>();
+    const Eigen::Vector3d t = T.topRightCorner<3, 1>();
+
+    double F = 0.0;
+    for (uint32_t i = 0; i < source_.size(); ++i) F += (R * source_[i] + t - target_[i]).squaredNorm();
+
+    return F;
+  }
+
+  double jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf) override {
+    const Eigen::Matrix3d R = pose_.topLeftCorner<3, 3>();
+    const Eigen::Vector3d t = pose_.topRightCorner<3, 1>();
+
+    Eigen::Matrix<double, 6, 6> A = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> b = Eigen::Matrix<double, 6, 1>::Zero();
+    Eigen::Matrix<double, 3, 6> J;
+    J.leftCols<3>().setIdentity();
+
+    double F = 0.0;
+    for (uint32_t i = 0; i < source_.size(); ++i) {
+      const Eigen::Vector3d q = R * source_[i] + t;
+      const Eigen::Vector3d f = q - target_[i];
+
+      // derivative of exp(delta) * q w.r.t. delta = (v, omega) at delta = 0: [I, -[q]x].
+      J.rightCols<3>() << 0, q.z(), -q.y(), -q.z(), 0, q.x(), q.y(), -q.x(), 0;
+
+      A.noalias() += J.transpose() * J;
+      b.noalias() += J.transpose() * f;
+      F += f.squaredNorm();
+    }
+
+    JtJ = A;
+    Jtf = b;
+    inlier_ = source_.size();
+
+    return F;
+  }
+
+ protected:
+  std::vector<Eigen::Vector3d> source_, target_;
+};
+
+void BM_SE3_exp(benchmark::State& state) {
+  Eigen::VectorXd x(6);
+  x << 0.5, -0.2, 0.1, 0.01, -0.02, 0.05;
+
+  for (auto _ : state) {
+    Eigen::Matrix4d T = SE3::exp(x);
+    benchmark::DoNotOptimize(T.data());
+  }
+}
+BENCHMARK(BM_SE3_exp);
+
+void BM_SE3_log(benchmark::State& state) {
+  Eigen::VectorXd x(6);
+  x << 0.5, -0.2, 0.1, 0.01, -0.02, 0.05;
+  const Eigen::Matrix4d T = SE3::exp(x);
+
+  for (auto _ : state) {
+    Eigen::VectorXd y = SE3::log(T);
+    benchmark::DoNotOptimize(y.data());
+  }
+}
+BENCHMARK(BM_SE3_log);
+
+void BM_LieGaussNewton_step(benchmark::State& state) {
+  PointToPointObjective objective(state.range(0), 42);
+  LieGaussNewton gn;
+
+  // always start at the same pose, i.e., every iteration performs the identical first step.
+  for (auto _ : state) {
+    gn.initialize(objective, Eigen::Matrix4d::Identity());
+    benchmark::DoNotOptimize(gn.step());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LieGaussNewton_step)->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+
+void BM_makePyramid(benchmark::State& state) {
+  const uint32_t width = state.range(0), height = state.range(1);
+
+  std::vector<glow::vec2> coords;
+  for (uint32_t x = 0; x < width; ++x) {
+    for (uint32_t y = 0; y < height; ++y) coords.push_back(glow::vec2(x, y));
+  }
+
+  std::vector<glow::vec2> img_coords, sizes;
+  for (auto _ : state) {
+    state.PauseTiming();
+    img_coords = coords;  // makePyramid reorders the coordinates in place.
+    state.ResumeTiming();
+
+    ImagePyramidGenerator::makePyramid(4, width, height, img_coords, sizes);
+    benchmark::DoNotOptimize(img_coords.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * coords.size());
+}
+BENCHMARK(BM_makePyramid)->Args({900, 64})->Args({2048, 64});
+}
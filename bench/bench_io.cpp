@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include <io/KITTIReader.h>
+#include <io/MappedScan.h>
+#include <util/kitti_utils.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// inputs are taken directly from the test data of the source tree.
+std::string data(const std::string& filename) {
+  return std::string(BENCH_DATA_DIR) + "/" + filename;
+}
+
+void BM_KITTIReader_read(benchmark::State& state) {
+  rv::KITTIReader reader(data("scan0.bin"));
+  rv::Laserscan scan;
+
+  for (auto _ : state) {
+    reader.reset();  // clears the scan buffer, i.e., the scan is read again.
+    reader.read(scan);
+    benchmark::DoNotOptimize(scan.points().data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * scan.size());
+}
+BENCHMARK(BM_KITTIReader_read)->Unit(benchmark::kMicrosecond);
+
+void BM_KITTIReader_readMapped(benchmark::State& state) {
+  rv::KITTIReader reader(data("scan0.bin"));
+  rv::MappedScan scan;
+
+  for (auto _ : state) {
+    reader.reset();
+    reader.read(scan);
+    benchmark::DoNotOptimize(scan.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * scan.size());
+}
+BENCHMARK(BM_KITTIReader_readMapped)->Unit(benchmark::kMicrosecond);
+
+void BM_calcSequenceErrors(benchmark::State& state) {
+  std::vector<Eigen::Matrix4f> poses_gt = KITTI::Odometry::loadPoses(data("gt_poses.txt"));
+  std::vector<Eigen::Matrix4f> poses_result = KITTI::Odometry::loadPoses(data("result_poses.txt"));
+
+  for (auto _ : state) {
+    std::vector<KITTI::Odometry::errors> err = KITTI::Odometry::calcSequenceErrors(poses_gt, poses_result);
+    benchmark::DoNotOptimize(err.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * poses_gt.size());
+}
+BENCHMARK(BM_calcSequenceErrors)->Unit(benchmark::kMillisecond);
+}
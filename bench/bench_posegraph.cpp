@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+
+#include <core/Posegraph.h>
+#include <core/lie_algebra.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+/** \brief generate posegraph of a vehicle driving repeatedly the same loop with noisy odometry.
+ *
+ *  Every NODES_PER_LAP nodes, the vehicle revisits the same places and every LOOP_STRIDE-th node gets a loop
+ *  closure to the corresponding node of the previous lap. The initial estimates are the chained odometry.
+ **/
+void generateLoops(uint32_t num_nodes, uint32_t seed, Posegraph& graph) {
+  const uint32_t NODES_PER_LAP = 500;
+  const uint32_t LOOP_STRIDE = 10;
+
+  std::mt19937 gen(seed);
+  std::normal_distribution<double> trans_noise(0.0, 0.05), rot_noise(0.0, 0.002);
+
+  std::vector<Eigen::Matrix4d> gt(num_nodes);
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    double angle = 2.0 * M_PI * (i % NODES_PER_LAP) / NODES_PER_LAP;
+    gt[i] = Eigen::Matrix4d::Identity();
+    gt[i].topLeftCorner<3, 3>() = Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+    gt[i].topRightCorner<3, 1>() = Eigen::Vector3d(100.0 * std::sin(angle), 100.0 * (1.0 - std::cos(angle)), 0.0);
+  }
+
+  const Posegraph::Matrix6d info = 100.0 * Posegraph::Matrix6d::Identity();
+
+  Eigen::Matrix4d estimate = gt[0];
+  graph.setInitial(0, estimate);
+  for (uint32_t i = 1; i < num_nodes; ++i) {
+    Eigen::VectorXd noise(6);
+    noise << trans_noise(gen), trans_noise(gen), trans_noise(gen), rot_noise(gen), rot_noise(gen), rot_noise(gen);
+
+    Eigen::Matrix4d odometry = SE3::exp(noise) * gt[i - 1].inverse() * gt[i];
+    graph.addEdge(i - 1, i, odometry, info);
+
+    estimate = estimate * odometry;
+    graph.setInitial(i, estimate);
+
+    if (i >= NODES_PER_LAP && i % LOOP_STRIDE == 0) {
+      graph.addEdge(i - NODES_PER_LAP, i, gt[i - NODES_PER_LAP].inverse() * gt[i], info);
+    }
+  }
+}
+
+void BM_Posegraph_optimize(benchmark::State& state) {
+  Posegraph graph;
+  generateLoops(state.range(0), 42, graph);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    graph.reinitialize();  // always start from the odometry.
+    state.ResumeTiming();
+
+    graph.optimize(10);
+  }
+
+  state.counters["nodes"] = graph.size();
+  state.counters["error"] = graph.error();
+}
+BENCHMARK(BM_Posegraph_optimize)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,306 @@
+#include "core/CpuFrame2Model.h"
+#include "core/lie_algebra.h"
+#include "core/parallel.h"
+
+#include <rv/Math.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace rv;
+using namespace glow;
+
+namespace {
+
+const float inv_pi = 0.31830988618379067154f;
+const float rad2deg = 57.29577951308232f;
+
+/** \brief texel of image with clamp to border, i.e., outside of the image everything is zero. **/
+inline const vec4& texel(const std::vector<vec4>& img, int32_t width, int32_t height, int32_t x, int32_t y) {
+  static const vec4 border(0.0f, 0.0f, 0.0f, 0.0f);
+  if (x < 0 || x >= width || y < 0 || y >= height) return border;
+  return img[y * width + x];
+}
+}
+
+CpuFrame2Model::CpuFrame2Model(const rv::ParameterList& params) : params_(params) {
+  updateParameters();
+}
+
+void CpuFrame2Model::updateParameters() {
+  angle_thresh_ = std::cos(Math::deg2rad(params_["icp-max-angle"]));
+  distance_thresh_ = params_["icp-max-distance"];
+
+  weight_function_ = 0;
+  factor_ = 1.0f;
+  if (params_.hasParam("weighting")) {
+    std::string weighting_name = params_["weighting"];
+    if (weighting_name == "huber")
+      weight_function_ = 1;
+    else if (weighting_name == "turkey")
+      weight_function_ = 2;
+    else if (weighting_name == "stability")
+      weight_function_ = 3;
+    factor_ = params_["factor"];
+  }
+
+  fov_up_ = std::abs(float(params_["data_fov_up"]));
+  fov_down_ = std::abs(float(params_["data_fov_down"]));
+
+  bilinear_ = params_.hasParam("bilinear_sampling") && (bool)params_["bilinear_sampling"];
+
+  levels_ = 1;
+  if (params_.hasParam("pyramid-levels")) {
+    int32_t levels = params_["pyramid-levels"];
+    levels_ = std::max(1, levels);
+  }
+  stride_ = 1;
+
+  int32_t num_threads = 0;
+  if (params_.hasParam("icp-threads")) num_threads = params_["icp-threads"];
+  numThreads_ = getNumThreads(num_threads);
+}
+
+void CpuFrame2Model::setParameter(const rv::Parameter& param) {
+  params_.insert(param);
+  updateParameters();
+}
+
+void CpuFrame2Model::setData(const std::shared_ptr<Frame>& current, const std::shared_ptr<Frame>& last) {
+  current_ = current;
+  last_ = last;
+
+  iteration_ = 0;
+
+  const uint32_t num_pixels = current->width * current->height;
+  if (current->vertex_data.size() == num_pixels && current->normal_data.size() == num_pixels) {
+    data_vertices_ = &current->vertex_data;
+    data_normals_ = &current->normal_data;
+  } else {
+    downloaded_vertices_.resize(num_pixels);
+    downloaded_normals_.resize(num_pixels);
+    current->vertex_map.download(downloaded_vertices_);
+    current->normal_map.download(downloaded_normals_);
+
+    data_vertices_ = &downloaded_vertices_;
+    data_normals_ = &downloaded_normals_;
+  }
+
+  model_vertices_.resize(last->width * last->height);
+  model_normals_.resize(last->width * last->height);
+  last->vertex_map.download(model_vertices_);
+  last->normal_map.download(model_normals_);
+}
+
+uint32_t CpuFrame2Model::num_parameters() const {
+  return 6;
+}
+
+void CpuFrame2Model::setLevel(uint32_t lvl) {
+  stride_ = 1 << (levels_ - 1 - std::min(lvl, levels_ - 1));
+}
+
+uint32_t CpuFrame2Model::getMaxLevel() const {
+  return levels_ - 1;
+}
+
+double CpuFrame2Model::residual(const Eigen::VectorXd& delta) {
+  return evaluate(SE3::exp(delta) * pose_, nullptr, nullptr);
+}
+
+double CpuFrame2Model::jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf) {
+  assert(JtJ.rows() == 6 && JtJ.cols() == 6);
+  assert(Jtf.rows() == 6 && Jtf.cols() == 1);
+
+  return evaluate(pose_, &JtJ, &Jtf);
+}
+
+void CpuFrame2Model::sampleModel(float x, float y, glow::vec4& vertex, glow::vec4& normal) const {
+  const int32_t width = last_->width, height = last_->height;
+
+  if (!bilinear_) {
+    vertex = texel(model_vertices_, width, height, x, y);
+    normal = texel(model_normals_, width, height, x, y);
+    return;
+  }
+
+  // bilinear interpolation between texel centers like GL_LINEAR.
+  float fx = x - 0.5f, fy = y - 0.5f;
+  int32_t x0 = std::floor(fx), y0 = std::floor(fy);
+  float a = fx - x0, b = fy - y0;
+
+  float weights[4] = {(1.0f - a) * (1.0f - b), a * (1.0f - b), (1.0f - a) * b, a * b};
+  int32_t xs[4] = {x0, x0 + 1, x0, x0 + 1};
+  int32_t ys[4] = {y0, y0, y0 + 1, y0 + 1};
+
+  vertex = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+  normal = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+  for (uint32_t i = 0; i < 4; ++i) {
+    const vec4& v = texel(model_vertices_, width, height, xs[i], ys[i]);
+    const vec4& n = texel(model_normals_, width, height, xs[i], ys[i]);
+    vertex.x += weights[i] * v.x;
+    vertex.y += weights[i] * v.y;
+    vertex.z += weights[i] * v.z;
+    vertex.w += weights[i] * v.w;
+    normal.x += weights[i] * n.x;
+    normal.y += weights[i] * n.y;
+    normal.z += weights[i] * n.z;
+    normal.w += weights[i] * n.w;
+  }
+}
+
+double CpuFrame2Model::evaluate(const Eigen::Matrix4d& pose, Eigen::MatrixXd* JtJ, Eigen::MatrixXd* Jtf) {
+  std::vector<Evaluation> results;
+  evaluate(std::vector<Eigen::Matrix4d>{pose}, (JtJ != nullptr), results);
+
+  const Evaluation& result = results[0];
+  if (JtJ != nullptr) {
+    *JtJ = result.JtJ;
+    *Jtf = result.Jtf;
+  }
+
+  outlier_ = result.outlier;
+  inlier_ = result.inlier;
+  invalid_ = result.invalid;
+  inlier_residual_ = result.inlier_residual;
+
+  return result.F;
+}
+
+void CpuFrame2Model::jacobianProducts(const std::vector<Eigen::Matrix4d>& poses, std::vector<Evaluation>& results) {
+  evaluate(poses, true, results);
+}
+
+void CpuFrame2Model::evaluate(const std::vector<Eigen::Matrix4d>& poses, bool computeJacobian,
+                              std::vector<Evaluation>& results) {
+  const uint32_t width = current_->width, height = current_->height;
+  const float model_width = last_->width, model_height = last_->height;
+  const float fov = fov_up_ + fov_down_;
+  const uint32_t num_poses = poses.size();
+
+  std::vector<Eigen::Matrix3f> R(num_poses);
+  std::vector<Eigen::Vector3f> t(num_poses);
+  for (uint32_t h = 0; h < num_poses; ++h) {
+    R[h] = poses[h].topLeftCorner<3, 3>().cast<float>();
+    t[h] = poses[h].topRightCorner<3, 1>().cast<float>();
+  }
+
+  const std::vector<vec4>& data_vertices = *data_vertices_;
+  const std::vector<vec4>& data_normals = *data_normals_;
+
+  accumulators_.resize(numThreads_ * num_poses);
+
+  // same computations as Frame2Model_jacobians.geom, but each thread accumulates a block of rows. All pose
+  // hypotheses are evaluated in the same pass over the data.
+  uint32_t num_chunks = ThreadPool::shared().parallel_for(height, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+    std::vector<Accumulator, Eigen::aligned_allocator<Accumulator>> accs(num_poses);
+    Vector6d J;
+
+    for (uint32_t y = begin; y < end; ++y) {
+      for (uint32_t x = 0; x < width; x += stride_) {
+        const vec4& vd = data_vertices[y * width + x];
+        const vec4& nd = data_normals[y * width + x];
+
+        float e_d = vd.w + nd.w;
+        if (e_d < 1.5f) {
+          for (Accumulator& acc : accs) acc.invalid += 1;
+          continue;
+        }
+
+        for (uint32_t h = 0; h < num_poses; ++h) {
+          Accumulator& acc = accs[h];
+
+          const Eigen::Vector3f v_d = R[h] * Eigen::Vector3f(vd.x, vd.y, vd.z) + t[h];
+          const Eigen::Vector3f n_d = R[h] * Eigen::Vector3f(nd.x, nd.y, nd.z);
+
+          // projection into model image.
+          float depth = v_d.norm();
+          float yaw = std::atan2(v_d.y(), v_d.x());
+          float pitch = -std::asin(v_d.z() / depth);
+          float u = 0.5f * (-yaw * inv_pi + 1.0f) * model_width;
+          float v = (1.0f - (pitch * rad2deg + fov_up_) / fov) * model_height;
+
+          if (!(u >= 0.0f && u < model_width && v >= 0.0f && v < model_height)) {
+            acc.invalid += 1;
+            continue;
+          }
+
+          vec4 vm, nm;
+          sampleModel(u, v, vm, nm);
+          if (vm.w + nm.w < 1.5f) {
+            acc.invalid += 1;
+            continue;
+          }
+
+          const Eigen::Vector3f v_m(vm.x, vm.y, vm.z);
+          const Eigen::Vector3f n_m(nm.x, nm.y, nm.z);
+
+          bool inlier = true;
+          if ((v_m - v_d).norm() > distance_thresh_) inlier = false;
+          if (n_m.dot(n_d) < angle_thresh_) inlier = false;
+
+          float residual = n_m.dot(v_d - v_m);
+
+          float weight = 1.0f;
+          if (weight_function_ == 1) {
+            // huber weighting.
+            if (std::abs(residual) > factor_) weight = factor_ / std::abs(residual);
+          } else if (weight_function_ == 2 && iteration_ > 0) {
+            // turkey bi-squared weighting:
+            if (std::abs(residual) > factor_) {
+              weight = 0.0f;
+            } else {
+              float alpha = residual / factor_;
+              weight = (1.0f - alpha * alpha) * (1.0f - alpha * alpha);
+            }
+          }
+
+          acc.valid += 1;
+          acc.F += weight * residual * residual;
+
+          if (inlier) {
+            acc.inlier_residual += weight * residual * residual;
+
+            if (computeJacobian) {
+              const Eigen::Vector3f cp = v_d.cross(n_m);
+              J << n_m.cast<double>(), cp.cast<double>();
+
+              acc.JtJ.noalias() += (double(weight) * J) * J.transpose();
+              acc.Jtf.noalias() += double(weight * residual) * J;
+            }
+          } else {
+            acc.outlier += 1;
+          }
+        }
+      }
+    }
+
+    for (uint32_t h = 0; h < num_poses; ++h) accumulators_[chunk * num_poses + h] = accs[h];
+  }, numThreads_);
+
+  results.resize(num_poses);
+  for (uint32_t h = 0; h < num_poses; ++h) {
+    Accumulator total;
+    for (uint32_t i = 0; i < num_chunks; ++i) {
+      const Accumulator& acc = accumulators_[i * num_poses + h];
+      total.JtJ += acc.JtJ;
+      total.Jtf += acc.Jtf;
+      total.F += acc.F;
+      total.inlier_residual += acc.inlier_residual;
+      total.valid += acc.valid;
+      total.outlier += acc.outlier;
+      total.invalid += acc.invalid;
+    }
+
+    Evaluation& result = results[h];
+    if (computeJacobian) {
+      result.JtJ = total.JtJ;
+      result.Jtf = total.Jtf;
+    }
+    result.F = total.F;
+    result.outlier = total.outlier;
+    result.inlier = total.valid - total.outlier;
+    result.invalid = total.invalid;
+    result.inlier_residual = total.inlier_residual;
+  }
+}
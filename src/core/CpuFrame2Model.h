@@ -0,0 +1,99 @@
+#ifndef SRC_CORE_CPUFRAME2MODEL_H_
+#define SRC_CORE_CPUFRAME2MODEL_H_
+
+#include <glow/glutil.h>
+#include <rv/ParameterList.h>
+
+#include "Frame.h"
+#include "core/Objective.h"
+#include "core/parallel.h"
+
+/** \brief CPU implementation of the Frame2Model objective.
+ *
+ *  Performs the same projective data association, Huber/Turkey weighting, and accumulation of JtJ and Jtf as
+ *  the Frame2Model_jacobians shaders, but on host-side copies of the vertex maps and normal maps. Each thread
+ *  accumulates partial sums over a block of rows in double precision, which are afterwards summed up.
+ *
+ *  The vertex map and normal map of the current frame are taken from the host-side images of the frame if
+ *  available (CPU preprocessing); otherwise, the textures are downloaded in setData. The model frame is
+ *  always downloaded, since it is rendered by OpenGL.
+ *
+ *  \see Frame2Model
+ *
+ *  \author behley
+ */
+class CpuFrame2Model : public Objective {
+ public:
+  CpuFrame2Model(const rv::ParameterList& params);
+
+  /** \brief set single parameter to specific value. **/
+  void setParameter(const rv::Parameter& param) override;
+
+  void setData(const std::shared_ptr<Frame>& current, const std::shared_ptr<Frame>& last) override;
+
+  uint32_t num_parameters() const override;
+
+  /** \brief level 0 evaluates only every 2^(pyramid-levels - 1)-th column, getMaxLevel() all columns. **/
+  void setLevel(uint32_t lvl) override;
+
+  uint32_t getMaxLevel() const override;
+
+  /** \brief compute weighted objective F(x) for given increment. **/
+  double residual(const Eigen::VectorXd& delta) override;
+
+  /** \brief compute weighted JtJ and Jtf, return weighted objective F(x). */
+  double jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf) override;
+
+  /** \brief evaluate all pose hypotheses in a single pass over the data. **/
+  void jacobianProducts(const std::vector<Eigen::Matrix4d>& poses, std::vector<Evaluation>& results) override;
+
+ protected:
+  typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+  typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+  /** \brief partial sums of a single thread. **/
+  struct Accumulator {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Matrix6d JtJ{Matrix6d::Zero()};
+    Vector6d Jtf{Vector6d::Zero()};
+    double F{0.0}, inlier_residual{0.0};
+    uint32_t valid{0}, outlier{0}, invalid{0};
+  };
+
+  /** \brief updatable parameters, i.e., params that can be changed at runtime. **/
+  void updateParameters();
+
+  /** \brief evaluate objective at given pose and update counters; JtJ and Jtf only if requested. **/
+  double evaluate(const Eigen::Matrix4d& pose, Eigen::MatrixXd* JtJ, Eigen::MatrixXd* Jtf);
+
+  /** \brief evaluate objective at given poses; JtJ and Jtf of the results only if computeJacobian. **/
+  void evaluate(const std::vector<Eigen::Matrix4d>& poses, bool computeJacobian, std::vector<Evaluation>& results);
+
+  /** \brief vertex & normal of model at continuous image coordinates, like texture() with sampler of Frame2Model. **/
+  void sampleModel(float x, float y, glow::vec4& vertex, glow::vec4& normal) const;
+
+  rv::ParameterList params_;
+
+  std::shared_ptr<Frame> current_;
+  std::shared_ptr<Frame> last_;  // model frame.
+
+  // host-side copies of current and model frame.
+  const std::vector<glow::vec4>* data_vertices_{nullptr};
+  const std::vector<glow::vec4>* data_normals_{nullptr};
+  std::vector<glow::vec4> downloaded_vertices_, downloaded_normals_;
+  std::vector<glow::vec4> model_vertices_, model_normals_;
+
+  float distance_thresh_{0.0f}, angle_thresh_{0.0f};
+  float fov_up_{0.0f}, fov_down_{0.0f};
+  int32_t weight_function_{0};
+  float factor_{1.0f};
+  bool bilinear_{false};
+
+  uint32_t levels_{1};
+  uint32_t stride_{1};  // column stride of current level.
+
+  uint32_t numThreads_{1};  // maximal number of threads of a loop in ThreadPool::shared().
+  std::vector<Accumulator, Eigen::aligned_allocator<Accumulator>> accumulators_;
+};
+
+#endif /* SRC_CORE_CPUFRAME2MODEL_H_ */
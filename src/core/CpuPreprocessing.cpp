@@ -0,0 +1,385 @@
+#include "core/CpuPreprocessing.h"
+#include "core/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_PREPROCESSING_X86
+#endif
+
+using namespace rv;
+using namespace glow;
+
+namespace {
+
+const float inv_pi = 0.31830988618379067154f;
+const float rad2deg = 57.29577951308232f;
+const uint64_t invalid_key = std::numeric_limits<uint64_t>::max();
+
+inline uint32_t wrap(int32_t x, int32_t dim) {
+  int32_t value = x % dim;
+  return (value < 0) ? value + dim : value;
+}
+
+/** \brief parameters of the spherical projection in pixel coordinates. **/
+struct Projection {
+  float width, height;
+  float fov_up, fov;
+  float min_depth, max_depth;
+};
+
+inline void storeProjection(uint32_t i, float depth, float u, float v, bool inside, uint32_t width, uint32_t* pixels,
+                            uint64_t* keys) {
+  uint32_t depth_bits;
+  std::memcpy(&depth_bits, &depth, sizeof(float));  // positive floats are ordered like their bit pattern.
+
+  pixels[i] = inside ? uint32_t(v) * width + uint32_t(u) : 0;
+  keys[i] = inside ? (uint64_t(depth_bits) << 32) | i : invalid_key;
+}
+
+void projectScalar(const Projection& proj, const Point3f* points, uint32_t begin, uint32_t end, uint32_t* pixels,
+                   uint64_t* keys) {
+  // same computations as gen_vertexmap.vert, but directly in pixel coordinates.
+  for (uint32_t i = begin; i < end; ++i) {
+    const float x = points[i].x(), y = points[i].y(), z = points[i].z();
+    const float depth = std::sqrt(x * x + y * y + z * z);
+    const float yaw = std::atan2(y, x);
+    const float pitch = -std::asin(z / depth);
+
+    const float u = std::floor(0.5f * (-yaw * inv_pi + 1.0f) * proj.width);
+    const float v = std::floor(0.5f * (2.0f - 2.0f * (pitch * rad2deg + proj.fov_up) / proj.fov) * proj.height);
+
+    // clipping like the rasterizer; the cleared depth buffer (1.0) rejects points at exactly max_depth.
+    const bool inside = (depth >= proj.min_depth) && (depth < proj.max_depth) && (u >= 0.0f) && (u < proj.width) &&
+                        (v >= 0.0f) && (v < proj.height);
+
+    storeProjection(i, depth, u, v, inside, proj.width, pixels, keys);
+  }
+}
+
+#ifdef CPU_PREPROCESSING_X86
+/** \brief atan2 of eight lanes with an absolute error below 1e-7 (polynomial of Abramowitz and Stegun, 4.4.49). **/
+__attribute__((target("avx2,fma"))) inline __m256 atan2Simd(__m256 y, __m256 x) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  const __m256 ax = _mm256_andnot_ps(sign, x), ay = _mm256_andnot_ps(sign, y);
+
+  // atan(r) with r = min / max in [0, 1]; atan2(0, 0) = 0.
+  const __m256 r = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(1e-30f)));
+  const __m256 r2 = _mm256_mul_ps(r, r);
+  __m256 a = _mm256_set1_ps(0.0028662257f);
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(-0.0161657367f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(0.0429096138f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(-0.0752896400f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(0.1065626393f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(-0.1420889944f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(0.1999355085f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(-0.3333314528f));
+  a = _mm256_fmadd_ps(a, r2, _mm256_set1_ps(1.0f));
+  a = _mm256_mul_ps(a, r);
+
+  // octant: mirror at the diagonal, at the y axis, and finally at the x axis.
+  a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.57079632679f), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+  a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(3.14159265359f), a), x);
+  return _mm256_xor_ps(a, _mm256_and_ps(y, sign));
+}
+
+/** \brief projection of eight points at once; the points are transposed into a structure of arrays before. **/
+__attribute__((target("avx2,fma"))) void projectSimd(const Projection& proj, const Point3f* points, uint32_t begin,
+                                                     uint32_t end, uint32_t* pixels, uint64_t* keys) {
+  const __m256 u_scale = _mm256_set1_ps(-0.5f * inv_pi * proj.width), u_offset = _mm256_set1_ps(0.5f * proj.width);
+  const __m256 v_scale = _mm256_set1_ps(rad2deg * proj.height / proj.fov);
+  const __m256 v_offset = _mm256_set1_ps(proj.height - proj.fov_up * proj.height / proj.fov);
+  const __m256 width = _mm256_set1_ps(proj.width), height = _mm256_set1_ps(proj.height);
+  const __m256 min_depth = _mm256_set1_ps(proj.min_depth), max_depth = _mm256_set1_ps(proj.max_depth);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256i stride = _mm256_set1_epi32(int32_t(proj.width));
+
+  alignas(32) float xs[8], ys[8], zs[8], depths[8];
+  alignas(32) uint32_t pixel[8], mask[8];
+
+  uint32_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    for (uint32_t k = 0; k < 8; ++k) {
+      xs[k] = points[i + k].x();
+      ys[k] = points[i + k].y();
+      zs[k] = points[i + k].z();
+    }
+
+    const __m256 x = _mm256_load_ps(xs), y = _mm256_load_ps(ys), z = _mm256_load_ps(zs);
+    const __m256 planar2 = _mm256_fmadd_ps(y, y, _mm256_mul_ps(x, x));
+    const __m256 depth = _mm256_sqrt_ps(_mm256_fmadd_ps(z, z, planar2));
+
+    // asin(z / depth) = atan2(z, |(x, y)|), i.e., pitch is negated twice.
+    const __m256 yaw = atan2Simd(y, x);
+    const __m256 pitch = atan2Simd(z, _mm256_sqrt_ps(planar2));
+
+    const __m256 u = _mm256_floor_ps(_mm256_fmadd_ps(yaw, u_scale, u_offset));
+    const __m256 v = _mm256_floor_ps(_mm256_fmadd_ps(pitch, v_scale, v_offset));
+
+    __m256 inside = _mm256_cmp_ps(depth, min_depth, _CMP_GE_OQ);
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(depth, max_depth, _CMP_LT_OQ));
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(u, width, _CMP_LT_OQ));
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    inside = _mm256_and_ps(inside, _mm256_cmp_ps(v, height, _CMP_LT_OQ));
+
+    const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(v), stride), _mm256_cvttps_epi32(u));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(pixel), _mm256_and_si256(index, _mm256_castps_si256(inside)));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(mask), _mm256_castps_si256(inside));
+    _mm256_store_ps(depths, depth);
+
+    for (uint32_t k = 0; k < 8; ++k) {
+      uint32_t depth_bits;
+      std::memcpy(&depth_bits, &depths[k], sizeof(float));
+
+      pixels[i + k] = pixel[k];
+      keys[i + k] = mask[k] ? (uint64_t(depth_bits) << 32) | (i + k) : invalid_key;
+    }
+  }
+
+  projectScalar(proj, points, i, end, pixels, keys);
+}
+#endif
+
+inline bool valid(const vec4& v) {
+  return (v.w > 0.5f);
+}
+
+inline vec4 normalize(const vec4& v, const vec4& p) {
+  vec4 d(v.x - p.x, v.y - p.y, v.z - p.z, v.w);
+  float len = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+  if (len > 0.0f) {
+    d.x /= len;
+    d.y /= len;
+    d.z /= len;
+  }
+  return d;
+}
+}
+
+CpuPreprocessing::CpuPreprocessing(const rv::ParameterList& params)
+    : width_(params["data_width"]), height_(params["data_height"]) {
+  zbuffer_.reset(new std::atomic<uint64_t>[width_ * height_]);
+  temp_vertices_.resize(width_ * height_);
+
+  setParameters(params);
+}
+
+void CpuPreprocessing::setParameters(const rv::ParameterList& params) {
+  fov_up_ = std::abs((float)params["data_fov_up"]);
+  fov_down_ = std::abs((float)params["data_fov_down"]);
+  min_depth_ = params["min_depth"];
+  max_depth_ = params["max_depth"];
+
+  useFilteredVertexmap_ = false;
+  filterVertexmap_ = false;
+  avgVertexmap_ = false;
+  if (params.hasParam("filter_vertexmap")) filterVertexmap_ = params["filter_vertexmap"];
+  if (params.hasParam("avg_vertexmap")) avgVertexmap_ = params["avg_vertexmap"];
+  if (filterVertexmap_) {
+    sigma_space_ = params["bilateral_sigma_space"];
+    sigma_range_ = params["bilateral_sigma_range"];
+    useFilteredVertexmap_ = params["use_filtered_vertexmap"];
+  }
+
+  int32_t num_threads = 0;
+  if (params.hasParam("preprocessing_threads")) num_threads = params["preprocessing_threads"];
+  numThreads_ = getNumThreads(num_threads);
+
+  simd_ = true;
+  if (params.hasParam("preprocessing_simd")) simd_ = params["preprocessing_simd"];
+}
+
+void CpuPreprocessing::process(const rv::Point3f* points, uint32_t num_points, std::vector<glow::vec4>& vertex_map,
+                               std::vector<glow::vec4>& normal_map) {
+  vertex_map.resize(width_ * height_);
+  normal_map.resize(width_ * height_);
+
+  project(points, num_points);
+
+  // 1. generate raw vertex map:
+  if (avgVertexmap_)
+    averageVertexmap(points, num_points, vertex_map);
+  else
+    nearestVertexmap(points, num_points, vertex_map);
+
+  // 1.5: bilateral filtering of vertex map.
+  if (filterVertexmap_) {
+    bilateralFilter(vertex_map, temp_vertices_);
+    if (useFilteredVertexmap_) vertex_map = temp_vertices_;
+  }
+
+  // 2. generate normal map:
+  normalmap(filterVertexmap_ ? temp_vertices_ : vertex_map, normal_map);
+}
+
+void CpuPreprocessing::project(const rv::Point3f* points, uint32_t N) {
+  pixels_.resize(N);
+  keys_.resize(N);
+
+  Projection proj;
+  proj.width = width_;
+  proj.height = height_;
+  proj.fov_up = fov_up_;
+  proj.fov = fov_up_ + fov_down_;
+  proj.min_depth = min_depth_;
+  proj.max_depth = max_depth_;
+
+  const bool simd = simd_ && simdSupported();
+  ThreadPool::shared().parallel_for(N, [&](uint32_t, uint32_t begin, uint32_t end) {
+#ifdef CPU_PREPROCESSING_X86
+    if (simd) {
+      projectSimd(proj, points, begin, end, pixels_.data(), keys_.data());
+      return;
+    }
+#endif
+    projectScalar(proj, points, begin, end, pixels_.data(), keys_.data());
+  }, numThreads_);
+}
+
+bool CpuPreprocessing::simdSupported() {
+#ifdef CPU_PREPROCESSING_X86
+  static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void CpuPreprocessing::nearestVertexmap(const rv::Point3f* points, uint32_t N, std::vector<glow::vec4>& vertex_map) {
+  const uint32_t num_pixels = width_ * height_;
+
+  ThreadPool::shared().parallel_for(num_pixels, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) zbuffer_[i].store(invalid_key, std::memory_order_relaxed);
+  }, numThreads_);
+
+  // z-buffer: ties are resolved by the point index, i.e., the first drawn point wins like with GL_LESS.
+  ThreadPool::shared().parallel_for(N, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      if (keys_[i] == invalid_key) continue;
+
+      std::atomic<uint64_t>& entry = zbuffer_[pixels_[i]];
+      uint64_t current = entry.load(std::memory_order_relaxed);
+      while (keys_[i] < current && !entry.compare_exchange_weak(current, keys_[i], std::memory_order_relaxed)) {
+      }
+    }
+  }, numThreads_);
+
+  ThreadPool::shared().parallel_for(num_pixels, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      uint64_t key = zbuffer_[i].load(std::memory_order_relaxed);
+      if (key == invalid_key) {
+        vertex_map[i] = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+      } else {
+        const Point3f& p = points[key & 0xFFFFFFFF];
+        vertex_map[i] = vec4(p.x(), p.y(), p.z(), 1.0f);
+      }
+    }
+  }, numThreads_);
+}
+
+void CpuPreprocessing::averageVertexmap(const rv::Point3f* points, uint32_t N, std::vector<glow::vec4>& vertex_map) {
+  std::fill(vertex_map.begin(), vertex_map.end(), vec4(0.0f, 0.0f, 0.0f, 0.0f));
+
+  // summation like additive blending; sequential to get the same order of floating point additions every time.
+  for (uint32_t i = 0; i < N; ++i) {
+    if (keys_[i] == invalid_key) continue;
+
+    vec4& v = vertex_map[pixels_[i]];
+    v.x += points[i].x();
+    v.y += points[i].y();
+    v.z += points[i].z();
+    v.w += 1.0f;
+  }
+
+  // same as avg_vertexmap.frag:
+  ThreadPool::shared().parallel_for(width_ * height_, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      vec4& v = vertex_map[i];
+      if (v.w > 0.5f) v = vec4(v.x / v.w, v.y / v.w, v.z / v.w, 1.0f);
+    }
+  }, numThreads_);
+}
+
+void CpuPreprocessing::bilateralFilter(const std::vector<glow::vec4>& in, std::vector<glow::vec4>& out) const {
+  const int32_t width = width_, height = height_;
+  const float sigma_space_factor = -0.5 / (sigma_space_ * sigma_space_);
+  const float sigma_range_factor = -0.5 / (sigma_range_ * sigma_range_);
+  const int32_t R = 6;  // see bilateral_filter.frag.
+
+  ThreadPool::shared().parallel_for(height_, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (int32_t y = begin; y < int32_t(end); ++y) {
+      for (int32_t x = 0; x < width; ++x) {
+        const vec4& vertex = in[y * width + x];
+        out[y * width + x] = vertex;
+        if (!valid(vertex)) continue;
+
+        float range = std::sqrt(vertex.x * vertex.x + vertex.y * vertex.y + vertex.z * vertex.z);
+
+        float sum1 = 0.0f;
+        float sum2 = 0.0f;
+
+        for (int32_t cy = std::max(y - R, 0); cy < std::min(y + R + 1, height); ++cy) {
+          for (int32_t cx = x - R; cx < x + R + 1; ++cx) {
+            int32_t xx = wrap(cx, width);
+            const vec4& tmp = in[cy * width + xx];
+            if (tmp.w < 0.5f) continue;
+
+            // the shader uses the length of the homogeneous vector, which we keep for identical results.
+            float tmp_range = std::sqrt(tmp.x * tmp.x + tmp.y * tmp.y + tmp.z * tmp.z + tmp.w * tmp.w);
+
+            float diff_space2 = (x - xx) * (x - xx) + (y - cy) * (y - cy);
+            float diff_range2 = (range - tmp_range) * (range - tmp_range);
+
+            float weight = std::exp(diff_space2 * sigma_space_factor + diff_range2 * sigma_range_factor);
+
+            sum1 += tmp_range * weight;
+            sum2 += weight;
+          }
+        }
+
+        float factor = (sum1 / sum2) / range;
+        out[y * width + x] = vec4(factor * vertex.x, factor * vertex.y, factor * vertex.z, 1.0f);
+      }
+    }
+  }, numThreads_);
+}
+
+void CpuPreprocessing::normalmap(const std::vector<glow::vec4>& vertex_map, std::vector<glow::vec4>& normal_map) const {
+  const int32_t width = width_, height = height_;
+  const vec4 border(0.0f, 0.0f, 0.0f, 0.0f);  // clamp to border.
+
+  ThreadPool::shared().parallel_for(height_, [&](uint32_t, uint32_t begin, uint32_t end) {
+    for (int32_t y = begin; y < int32_t(end); ++y) {
+      for (int32_t x = 0; x < width; ++x) {
+        vec4& normal = normal_map[y * width + x];
+        normal = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+
+        const vec4& p = vertex_map[y * width + x];
+        if (p.w <= 0.0f) continue;
+
+        // same as gen_normalmap.frag:
+        const vec4& u = vertex_map[y * width + wrap(x + 1, width)];
+        const vec4& v = (y + 1 < height) ? vertex_map[(y + 1) * width + x] : border;
+        const vec4& s = vertex_map[y * width + wrap(x - 1, width)];
+        const vec4& t = (y > 0) ? vertex_map[(y - 1) * width + x] : border;
+
+        if (u.w < 1.0f && v.w < 1.0f) continue;
+        if (s.w < 1.0f && t.w < 1.0f) continue;
+        if (!valid(u) || !valid(v)) continue;
+
+        vec4 du = normalize(u, p), dv = normalize(v, p);
+        float nx = du.y * dv.z - du.z * dv.y;
+        float ny = du.z * dv.x - du.x * dv.z;
+        float nz = du.x * dv.y - du.y * dv.x;
+        float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+        if (len > 0.0000001f) normal = vec4(nx / len, ny / len, nz / len, 1.0f);
+      }
+    }
+  }, numThreads_);
+}
@@ -0,0 +1,85 @@
+#ifndef SRC_CORE_CPUPREPROCESSING_H_
+#define SRC_CORE_CPUPREPROCESSING_H_
+
+#include <rv/ParameterList.h>
+#include <rv/geometry.h>
+#include <glow/glutil.h>
+#include "core/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/** \brief CPU implementation of the preprocessing, i.e., generation of vertex map and normal map.
+ *
+ *  Computes the same images as the OpenGL-based Preprocessing (gen_vertexmap, avg_vertexmap, bilateral_filter,
+ *  and gen_normalmap shaders) without any OpenGL context. The images are stored like the textures: row-major
+ *  with origin in the lower left, i.e., pixel (x, y) is located at index y * width + x.
+ *
+ *  The projection is computed in parallel over chunks of the point cloud. Instead of the depth test, we use a
+ *  z-buffer of 64-bit words containing the depth in the upper and the point index in the lower 32 bit, which is
+ *  updated by an atomic minimum. Therefore, the nearest point of a pixel is selected independent of the thread
+ *  scheduling. With AVX2 and FMA, eight points are projected at once, where atan2 and asin are replaced by a
+ *  polynomial approximation (error below 1e-7 rad); the parameter preprocessing_simd = false selects the scalar
+ *  projection with the functions of libm.
+ *
+ *  \see Preprocessing
+ *
+ *  \author behley
+ **/
+class CpuPreprocessing {
+ public:
+  CpuPreprocessing(const rv::ParameterList& params);
+
+  void setParameters(const rv::ParameterList& params);
+
+  /** \brief generate vertex map and normal map of size width x height from the given point cloud. **/
+  void process(const std::vector<rv::Point3f>& points, std::vector<glow::vec4>& vertex_map,
+               std::vector<glow::vec4>& normal_map) {
+    process(points.data(), points.size(), vertex_map, normal_map);
+  }
+
+  /** \brief same as above, but the points are only read, e.g., directly from a memory-mapped scan. **/
+  void process(const rv::Point3f* points, uint32_t num_points, std::vector<glow::vec4>& vertex_map,
+               std::vector<glow::vec4>& normal_map);
+
+  uint32_t numThreads() const { return std::min(numThreads_, ThreadPool::shared().size()); }
+
+  /** \brief AVX2 and FMA available, i.e., the projection processes eight points at once. **/
+  static bool simdSupported();
+
+ protected:
+  /** \brief determine pixel index and depth key for all points; invalid points get key UINT64_MAX. **/
+  void project(const rv::Point3f* points, uint32_t num_points);
+
+  /** \brief nearest point for each pixel. **/
+  void nearestVertexmap(const rv::Point3f* points, uint32_t num_points, std::vector<glow::vec4>& vertex_map);
+
+  /** \brief average of all points falling into a pixel. **/
+  void averageVertexmap(const rv::Point3f* points, uint32_t num_points, std::vector<glow::vec4>& vertex_map);
+
+  void bilateralFilter(const std::vector<glow::vec4>& in, std::vector<glow::vec4>& out) const;
+
+  void normalmap(const std::vector<glow::vec4>& vertex_map, std::vector<glow::vec4>& normal_map) const;
+
+  uint32_t width_, height_;
+  float fov_up_{0.0f}, fov_down_{0.0f};
+  float min_depth_{0.0f}, max_depth_{0.0f};
+  float sigma_space_{0.0f}, sigma_range_{0.0f};
+
+  bool filterVertexmap_{false};
+  bool useFilteredVertexmap_{true};
+  bool avgVertexmap_{false};
+
+  bool simd_{true};
+
+  uint32_t numThreads_{1};  // maximal number of threads of a loop in ThreadPool::shared().
+
+  std::vector<uint32_t> pixels_;  // pixel index for each point.
+  std::vector<uint64_t> keys_;    // depth key for each point.
+  std::unique_ptr<std::atomic<uint64_t>[]> zbuffer_;
+  std::vector<glow::vec4> temp_vertices_;
+};
+
+#endif /* SRC_CORE_CPUPREPROCESSING_H_ */
@@ -6,9 +6,11 @@
 #include <glow/GlBuffer.h>
 #include <glow/GlTexture.h>
 #include <glow/GlTextureRectangle.h>
+#include <glow/glutil.h>
 #include <eigen3/Eigen/Dense>
 #include <rv/geometry.h>
 #include <memory>
+#include <vector>
 
 class SurfelMap;
 
@@ -49,6 +51,8 @@ class Frame {
     normal_map.copy(other.normal_map);
     points.assign(other.points);
     residual_map.copy(other.residual_map);
+    vertex_data = other.vertex_data;
+    normal_data = other.normal_data;
     map = other.map;
 
     pose = other.pose;
@@ -60,6 +64,9 @@ class Frame {
   glow::GlTextureRectangle vertex_map;  // (x,y,z) & w encodes validity
   glow::GlTextureRectangle normal_map;  // (x,y,z) & w encodes validity
 
+  // host-side vertex map & normal map in the layout of the textures; only filled by the CPU preprocessing.
+  std::vector<glow::vec4> vertex_data, normal_data;
+
   glow::GlBuffer<rv::Point3f> points{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_DRAW};
 
   Eigen::Matrix4f pose{Eigen::Matrix4f::Identity()};  // estimated pose of that frame.
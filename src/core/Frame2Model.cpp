@@ -1,4 +1,5 @@
 #include "core/Frame2Model.h"
+#include "core/GpuTimer.h"
 
 #include <rv/Math.h>
 #include <rv/Stopwatch.h>
@@ -6,11 +7,17 @@
 #include <iostream>
 #include "core/lie_algebra.h"
 
+#include <algorithm>
 #include <exception>
 
 using namespace rv;
 using namespace glow;
 
+static const uint32_t NUM_VALUES = 48;  // 16 texels with 3 values, see Frame2Model_jacobians.geom.
+static const uint32_t GROUP_SIZE = 128;  // work group size of Frame2Model_jacobians.comp.
+
+const uint32_t Frame2Model::MAX_HYPOTHESES;
+
 Frame2Model::Frame2Model(const rv::ParameterList& params)
     : JtJJtf_blend_(2, 8, TextureFormat::RGBA_FLOAT),
       fbo_blend_(2, 8)  // blending for matrix comp.
@@ -21,6 +28,20 @@ Frame2Model::Frame2Model(const rv::ParameterList& params)
   if (params.hasParam("entriesPerKernel")) {
     entriesPerKernel_ = params["entriesPerKernel"];
   }
+
+  if (params.hasParam("pyramid-levels")) {
+    int32_t levels = params["pyramid-levels"];
+    levels_ = std::max(1, levels);
+  }
+  // the column stride of the coarsest level must divide the columns per kernel.
+  uint32_t requested_levels = levels_;
+  while (levels_ > 1 && entriesPerKernel_ % (1 << (levels_ - 1)) != 0) levels_ -= 1;
+  if (levels_ != requested_levels) {
+    std::cerr << "Warning: Frame2Model uses " << levels_ << " instead of " << requested_levels
+              << " pyramid-levels, since entriesPerKernel = " << entriesPerKernel_ << " is not divisible by "
+              << (1 << (requested_levels - 1)) << "." << std::endl;
+  }
+
   std::vector<vec2> img_coords;
   img_coords.reserve(width * height);
   for (uint32_t i = 0; i < width; i += entriesPerKernel_) {
@@ -56,10 +77,61 @@ Frame2Model::Frame2Model(const rv::ParameterList& params)
   program_blend_.setUniform(GlUniform<int32_t>("normal_data", 3));
   program_blend_.setUniform(GlUniform<Eigen::Matrix4f>("pose", Eigen::Matrix4f::Identity()));
   program_blend_.setUniform(GlUniform<int32_t>("entries_per_kernel", entriesPerKernel_));
+  program_blend_.setUniform(GlUniform<int32_t>("stride", 1));
+
+  std::string reduction = "compute";
+  if (params.hasParam("icp-reduction")) reduction = std::string(params["icp-reduction"]);
+  if (reduction != "compute" && reduction != "blending")
+    throw std::runtime_error("Frame2Model: unknown icp-reduction '" + reduction + "'.");
+
+#if __GL_VERSION >= 430L
+  computeReduction_ = (reduction == "compute");
+  if (computeReduction_) {
+    program_reduce_.attach(GlShader::fromCache(ShaderType::COMPUTE_SHADER, "shader/Frame2Model_jacobians.comp"));
+    program_reduce_.link();
+
+    program_reduce_.setUniform(GlUniform<int32_t>("vertex_model", 0));
+    program_reduce_.setUniform(GlUniform<int32_t>("normal_model", 1));
+    program_reduce_.setUniform(GlUniform<int32_t>("vertex_data", 2));
+    program_reduce_.setUniform(GlUniform<int32_t>("normal_data", 3));
+
+    program_sum_.attach(GlShader::fromCache(ShaderType::COMPUTE_SHADER, "shader/reduce_sum.comp"));
+    program_sum_.link();
+    program_sum_.setUniform(GlUniform<int32_t>("num_values", NUM_VALUES));
+
+    partial_sums_.resize(NUM_VALUES * ((width * height + GROUP_SIZE - 1) / GROUP_SIZE));
+    poses_.resize(16 * MAX_HYPOTHESES);
+
+    GLsizeiptr result_size = NUM_VALUES * MAX_HYPOTHESES * sizeof(float);
+    glGenBuffers(1, &result_buffer_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result_buffer_);
+#if __GL_VERSION >= 440L
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, result_size, nullptr, flags);
+    result_ptr_ = reinterpret_cast<float*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, result_size, flags));
+#else
+    glBufferData(GL_SHADER_STORAGE_BUFFER, result_size, nullptr, GL_DYNAMIC_READ);
+#endif
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+#endif
 
   updateParameters();
 }
 
+Frame2Model::~Frame2Model() {
+#if __GL_VERSION >= 430L
+  if (result_buffer_ != 0) {
+#if __GL_VERSION >= 440L
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result_buffer_);
+    glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+#endif
+    glDeleteBuffers(1, &result_buffer_);
+  }
+#endif
+}
+
 void Frame2Model::updateParameters() {
   float angle_thresh = std::cos(Math::deg2rad(params_["icp-max-angle"]));
   float distance_thresh = params_["icp-max-distance"];
@@ -84,19 +156,24 @@ void Frame2Model::updateParameters() {
   bool distance_outliers = false;
   if (params_.hasParam("distance_outliers")) distance_outliers = params_["distance_outliers"];
 
-  program_blend_.setUniform(GlUniform<bool>("distance_outliers", (weight_function == 0) || distance_outliers));
-  program_blend_.setUniform(GlUniform<int32_t>("weight_function", weight_function));
-  program_blend_.setUniform(GlUniform<float>("factor", factor));
-
-  program_blend_.setUniform(GlUniform<float>("factor", factor));
-  program_blend_.setUniform(GlUniform<float>("distance_thresh", distance_thresh));
-  program_blend_.setUniform(GlUniform<float>("angle_thresh", angle_thresh));
-  program_blend_.setUniform(GlUniform<float>("fov_up", fov_up));
-  program_blend_.setUniform(GlUniform<float>("fov_down", fov_down));
-  program_blend_.setUniform(GlUniform<float>("fov", fov_up + fov_down));
-  program_blend_.setUniform(GlUniform<float>("min_depth", float(params_["min_depth"])));
-  program_blend_.setUniform(GlUniform<float>("max_depth", float(params_["max_depth"])));
-  program_blend_.setUniform(GlUniform<float>("cutoff_threshold", float(params_["cutoff_threshold"])));
+  std::vector<GlProgram*> programs{&program_blend_};
+#if __GL_VERSION >= 430L
+  if (computeReduction_) programs.push_back(&program_reduce_);
+#endif
+
+  for (GlProgram* program : programs) {
+    program->setUniform(GlUniform<bool>("distance_outliers", (weight_function == 0) || distance_outliers));
+    program->setUniform(GlUniform<int32_t>("weight_function", weight_function));
+    program->setUniform(GlUniform<float>("factor", factor));
+    program->setUniform(GlUniform<float>("distance_thresh", distance_thresh));
+    program->setUniform(GlUniform<float>("angle_thresh", angle_thresh));
+    program->setUniform(GlUniform<float>("fov_up", fov_up));
+    program->setUniform(GlUniform<float>("fov_down", fov_down));
+    program->setUniform(GlUniform<float>("fov", fov_up + fov_down));
+    program->setUniform(GlUniform<float>("min_depth", float(params_["min_depth"])));
+    program->setUniform(GlUniform<float>("max_depth", float(params_["max_depth"])));
+    program->setUniform(GlUniform<float>("cutoff_threshold", float(params_["cutoff_threshold"])));
+  }
 
   sampler_.setWrapOperation(TexWrapOp::CLAMP_TO_BORDER, TexWrapOp::CLAMP_TO_BORDER);
   if (params_.hasParam("bilinear_sampling") && (bool)params_["bilinear_sampling"]) {
@@ -121,10 +198,13 @@ void Frame2Model::setData(const std::shared_ptr<Frame>& current, const std::shar
   iteration_ = 0;
 }
 
-void Frame2Model::setLevel(uint32_t lvl) {}
+void Frame2Model::setLevel(uint32_t lvl) {
+  // level 0 is the coarsest level, getMaxLevel() the complete image.
+  stride_ = 1 << (levels_ - 1 - std::min(lvl, levels_ - 1));
+}
 
 uint32_t Frame2Model::getMaxLevel() const {
-  return 0;
+  return levels_ - 1;
 }
 
 double Frame2Model::residual(const Eigen::VectorXd& delta) {
@@ -136,20 +216,73 @@ double Frame2Model::jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf)
   assert(JtJ.rows() == 6 && JtJ.cols() == 6);
   assert(Jtf.rows() == 6 && Jtf.cols() == 1);
 
-  //  Stopwatch::tic();
+  bindTextures();
 
-  double F = 0.0;
+  std::vector<float> values(NUM_VALUES);
+  if (computeReduction_)
+    reduceCompute(std::vector<Eigen::Matrix4d>{pose_}, values);
+  else
+    reduceBlending(values);
 
-  GLint ov[4];
-  GLfloat cc[4];
+  releaseTextures();
 
-  glGetIntegerv(GL_VIEWPORT, ov);
-  glGetFloatv(GL_COLOR_CLEAR_VALUE, cc);
+  Evaluation result;
+  unpack(&values[0], result);
 
-  glPointSize(1.0f);
-  glClearColor(0, 0, 0, 0);
-  glDisable(GL_DEPTH_TEST);
+  JtJ = result.JtJ;
+  Jtf = result.Jtf;
+  outlier_ = result.outlier;
+  inlier_residual_ = result.inlier_residual;
+  inlier_ = result.inlier;
+  invalid_ = result.invalid;
+
+  return result.F;
+}
+
+void Frame2Model::jacobianProducts(const std::vector<Eigen::Matrix4d>& poses, std::vector<Evaluation>& results) {
+  if (!computeReduction_) {
+    Objective::jacobianProducts(poses, results);  // one pose after another.
+    return;
+  }
+
+  bindTextures();
+
+  results.resize(poses.size());
+  std::vector<float> values;
+  for (uint32_t begin = 0; begin < poses.size(); begin += MAX_HYPOTHESES) {
+    uint32_t end = std::min<uint32_t>(poses.size(), begin + MAX_HYPOTHESES);
+    std::vector<Eigen::Matrix4d> batch(poses.begin() + begin, poses.begin() + end);
 
+    values.resize(NUM_VALUES * batch.size());
+    reduceCompute(batch, values);
+
+    for (uint32_t i = begin; i < end; ++i) unpack(&values[NUM_VALUES * (i - begin)], results[i]);
+  }
+
+  releaseTextures();
+}
+
+void Frame2Model::unpack(const float* values, Evaluation& result) {
+  result.JtJ.resize(6, 6);
+  result.Jtf.resize(6, 1);
+
+  for (uint32_t i = 0; i < 6 * 6; ++i) {
+    result.JtJ.data()[i] = values[i];
+  }
+
+  for (uint32_t i = 0; i < 6; ++i) {
+    result.Jtf.data()[i] = values[36 + i];
+  }
+
+  uint32_t valid = values[42];
+  result.F = values[43];
+  result.outlier = values[44];
+  result.inlier_residual = values[45];
+  result.inlier = valid - result.outlier;
+  result.invalid = values[46];
+}
+
+void Frame2Model::bindTextures() {
   glActiveTexture(GL_TEXTURE0);
   last_->vertex_map.bind();
 
@@ -166,26 +299,59 @@ double Frame2Model::jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf)
   sampler_.bind(1);
   sampler_.bind(2);
   sampler_.bind(3);
+}
 
-  vao_img_coords_.bind();
+void Frame2Model::releaseTextures() {
+  sampler_.release(0);
+  sampler_.release(1);
+  sampler_.release(2);
+  sampler_.release(3);
+
+  glActiveTexture(GL_TEXTURE0);
+  last_->vertex_map.release();
+
+  glActiveTexture(GL_TEXTURE1);
+  last_->normal_map.release();
 
-  //  Stopwatch::tic();
+  glActiveTexture(GL_TEXTURE2);
+  current_->vertex_map.release();
+
+  glActiveTexture(GL_TEXTURE3);
+  current_->normal_map.release();
+}
+
+void Frame2Model::reduceBlending(std::vector<float>& values) {
+  GLint ov[4];
+  GLfloat cc[4];
+
+  glGetIntegerv(GL_VIEWPORT, ov);
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, cc);
+
+  glPointSize(1.0f);
+  glClearColor(0, 0, 0, 0);
+  glDisable(GL_DEPTH_TEST);
+
+  vao_img_coords_.bind();
 
   // second stage: compute jacobian.
   fbo_blend_.bind();
 
   glViewport(0, 0, fbo_blend_.width(), fbo_blend_.height());  // matrix width/height.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);         // set jacobian to zero.
+  {
+    GpuTimer::Scope timer(GpuTimer::JACOBIAN_BLEND);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // set jacobian to zero.
 
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_ONE, GL_ONE);  // computing the sum of values
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);  // computing the sum of values
 
-  program_blend_.bind();
+    program_blend_.bind();
 
-  program_blend_.setUniform(GlUniform<Eigen::Matrix4f>("pose", pose_.cast<float>()));
-  program_blend_.setUniform(GlUniform<int32_t>("iteration", iteration_));
+    program_blend_.setUniform(GlUniform<Eigen::Matrix4f>("pose", pose_.cast<float>()));
+    program_blend_.setUniform(GlUniform<int32_t>("iteration", iteration_));
+    program_blend_.setUniform(GlUniform<int32_t>("stride", stride_));
 
-  glDrawArrays(GL_POINTS, 0, vbo_img_coords_.size());  // size depending on last's size.
+    glDrawArrays(GL_POINTS, 0, vbo_img_coords_.size());  // size depending on last's size.
+  }
   program_blend_.release();
 
   vao_img_coords_.release();
@@ -193,81 +359,87 @@ double Frame2Model::jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf)
 
   glDisable(GL_BLEND);
 
-  glFinish();
-
-  //  double blendTime = Stopwatch::toc();
-
-  //  Stopwatch::tic();
-
   // Note: Quick and dirty fix for RGB_FLOAT not in core profile problem:
   // store everything in RGBA_FLOAT texture and throw away unused data.
   std::vector<float> blending_temp(64);
-  JtJJtf_blend_.download(PixelFormat::RGBA, &blending_temp[0]);
+  JtJJtf_blend_.download(PixelFormat::RGBA, &blending_temp[0]);  // waits for the blending.
 
-  std::vector<float> blending(6 * 8);
   for (uint32_t i = 0; i < 2 * 8; ++i) {
-    blending[3 * i] = blending_temp[4 * i];
-    blending[3 * i + 1] = blending_temp[4 * i + 1];
-    blending[3 * i + 2] = blending_temp[4 * i + 2];
-    blending[3 * i + 3] = blending_temp[4 * i + 3];
-  }
-
-  for (uint32_t i = 0; i < 6 * 6; ++i) {
-    JtJ.data()[i] = blending[i];
-  }
-
-  for (uint32_t i = 0; i < 6; ++i) {
-    Jtf.data()[i] = blending[36 + i];
+    values[3 * i] = blending_temp[4 * i];
+    values[3 * i + 1] = blending_temp[4 * i + 1];
+    values[3 * i + 2] = blending_temp[4 * i + 2];
   }
 
-  uint32_t valid = blending[42];
-  F = blending[43];
-  outlier_ = blending[44];
-  inlier_residual_ = blending[45];
-  inlier_ = valid - outlier_;
-  invalid_ = blending[46];
-
-  //  double downloadTime = Stopwatch::toc();
-
   glEnable(GL_DEPTH_TEST);
-  sampler_.release(0);
-  sampler_.release(1);
-  sampler_.release(2);
-  sampler_.release(3);
-
-  glActiveTexture(GL_TEXTURE0);
-  last_->vertex_map.release();
-
-  glActiveTexture(GL_TEXTURE1);
-  last_->normal_map.release();
-
-  glActiveTexture(GL_TEXTURE2);
-  current_->vertex_map.release();
-
-  glActiveTexture(GL_TEXTURE3);
-  current_->normal_map.release();
-
   glViewport(ov[0], ov[1], ov[2], ov[3]);
   glClearColor(cc[0], cc[1], cc[2], cc[3]);
+}
 
-  glFinish();
-
-  //  double completeTime = Stopwatch::toc();
+void Frame2Model::reduceCompute(const std::vector<Eigen::Matrix4d>& poses, std::vector<float>& values) {
+#if __GL_VERSION >= 430L
+  uint32_t num_columns = (current_->width + stride_ - 1) / stride_;
+  uint32_t num_groups = (num_columns * current_->height + GROUP_SIZE - 1) / GROUP_SIZE;
+  uint32_t num_poses = poses.size();
+  assert(num_poses <= MAX_HYPOTHESES);
 
-  //  std::cout << "jacobianProducts (" << current_lvl_ << "): " << completeTime * 1000 << " ms =>" << std::endl;
-  //  //  std::cout << "  residuals: " << computeResiduals * 1000 << " ms (" << 100 * computeResiduals / completeTime <<
-  //  "),
-  //  //  "
-  //  //            << computeResiduals_query << " ms" << std::endl;
-  //  std::cout << "  blend    : " << blendTime * 1000 << " ms (" << 100 * blendTime / completeTime << "), " <<
-  //  std::endl;
-  //  //            << blendTime_query << " ms" << std::endl;
-  //  std::cout << "  download : " << downloadTime * 1000 << " ms (" << 100 * downloadTime / completeTime << "), "
-  //            << std::endl;
-  //  //            << downloadTime_query << " ms " << std::endl;
-  //  std::cout << "Inlier: " << inlier_ << ", valid: " << (inlier_ + outlier_) << std::endl;
+  if (partial_sums_.size() < NUM_VALUES * num_groups * num_poses) {
+    partial_sums_.resize(NUM_VALUES * num_groups * num_poses);
+  }
 
-  return F;
+  std::vector<float> pose_values(16 * num_poses);
+  for (uint32_t i = 0; i < num_poses; ++i) {
+    Eigen::Matrix4f pose = poses[i].cast<float>();
+    std::copy(pose.data(), pose.data() + 16, pose_values.begin() + 16 * i);  // column-major as GLSL's mat4.
+  }
+  poses_.replace(0, pose_values);
+
+  // 1. pass: per pixel products, summed up per work group.
+  program_reduce_.bind();
+  program_reduce_.setUniform(GlUniform<int32_t>("iteration", iteration_));
+  program_reduce_.setUniform(GlUniform<int32_t>("stride", stride_));
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, partial_sums_.id());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, poses_.id());
+  GpuTimer::begin(GpuTimer::JACOBIAN_COMPUTE);
+  glDispatchCompute(num_groups, num_poses, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  program_reduce_.release();
+
+  // 2. pass: sum of partial sums.
+  program_sum_.bind();
+  program_sum_.setUniform(GlUniform<int32_t>("num_partials", num_groups));
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, result_buffer_);
+  glDispatchCompute(num_poses, 1, 1);
+  GpuTimer::end(GpuTimer::JACOBIAN_COMPUTE);
+  program_sum_.release();
+
+#if __GL_VERSION >= 440L
+  glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+#else
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+#endif
+
+  // only wait for the reduction instead of flushing the complete pipeline.
+  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+  }
+  glDeleteSync(fence);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+#if __GL_VERSION >= 440L
+  std::copy(result_ptr_, result_ptr_ + NUM_VALUES * num_poses, values.begin());
+#else
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, result_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, NUM_VALUES * num_poses * sizeof(float), &values[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+#endif
+#else
+  throw std::runtime_error("Frame2Model: compute shaders require OpenGL 4.3.");
+#endif
 }
 
 uint32_t Frame2Model::num_parameters() const {
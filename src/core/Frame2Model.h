@@ -21,12 +21,27 @@
  *  This variant transforms the point cloud and tries to match this to the model frame rendered
  *  at the last position.
  *
+ *  With OpenGL 4.3, the products are summed up by compute shaders: work groups sum up pairwise in shared
+ *  memory and the partial sums are added with compensated summation. The result is read back after waiting for
+ *  a fence. Otherwise (or with parameter icp-reduction = "blending"), the values are accumulated by additive
+ *  blending into a small texture.
+ *
+ *  With parameter pyramid-levels > 1, coarse levels only evaluate every 2^k-th column of the data, i.e.,
+ *  the same nested subsets as generated by ImagePyramidGenerator. Since every kernel of the blending
+ *  shader then processes its entries with a stride, the number of levels is limited such that the
+ *  stride divides entriesPerKernel.
+ *
+ *  For the loop closure search, multiple pose hypotheses can be evaluated at once: the compute shader then
+ *  evaluates all hypotheses with a single dispatch, which shares the texture fetches of the data and the
+ *  synchronization of a single read back.
+ *
  *  \author behley
  */
 class Frame2Model : public Objective {
  public:
   /** \brief setup objective. **/
   Frame2Model(const rv::ParameterList& params);
+  ~Frame2Model();
 
   /** \brief set single parameter to specific value. **/
   void setParameter(const rv::Parameter& param) override;
@@ -47,10 +62,30 @@ class Frame2Model : public Objective {
   /** \brief compute weighted JtJ and Jtf exploiting intermediate computations, return weighted objective F(x). */
   double jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf);
 
+  /** \brief evaluate multiple poses; with compute shaders up to MAX_HYPOTHESES poses are evaluated by a single
+   *  dispatch, otherwise the poses are evaluated sequentially.
+   **/
+  void jacobianProducts(const std::vector<Eigen::Matrix4d>& poses, std::vector<Evaluation>& results) override;
+
+  /** \brief maximal number of poses evaluated by a single dispatch. **/
+  static const uint32_t MAX_HYPOTHESES = 16;
+
  protected:
   /** \brief updatable parameters, i.e., params that can be changed at runtime. **/
   void updateParameters();
 
+  /** \brief sum up the 48 values for the current pose via blending; layout of values like JtJJtf_blend_. **/
+  void reduceBlending(std::vector<float>& values);
+
+  /** \brief sum up the 48 values for each of the given poses via compute shaders; values of pose i start at 48 * i. **/
+  void reduceCompute(const std::vector<Eigen::Matrix4d>& poses, std::vector<float>& values);
+
+  /** \brief convert the 48 summed up values into an evaluation. **/
+  static void unpack(const float* values, Evaluation& result);
+
+  void bindTextures();
+  void releaseTextures();
+
   rv::ParameterList params_;
 
   std::shared_ptr<Frame> current_;
@@ -68,6 +103,18 @@ class Frame2Model : public Objective {
   glow::GlProgram program_blend_;
 
   uint32_t entriesPerKernel_{64};
+
+  uint32_t levels_{1};
+  uint32_t stride_{1};  // column stride of current level.
+
+  bool computeReduction_{false};
+#if __GL_VERSION >= 430L
+  glow::GlProgram program_reduce_, program_sum_;
+  glow::GlBuffer<float> partial_sums_{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_COPY};
+  glow::GlBuffer<float> poses_{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_DRAW};  // column-major.
+  GLuint result_buffer_{0};
+  float* result_ptr_{nullptr};  // persistently mapped result buffer (OpenGL 4.4).
+#endif
 };
 
 #endif /* INCLUDE_CORE_FRAME2MODEL_H_ */
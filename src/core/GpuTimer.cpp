@@ -0,0 +1,172 @@
+#include "core/GpuTimer.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+const uint32_t GpuTimer::MAX_PENDING;
+
+bool GpuTimer::enabled_ = false;
+GpuTimer::Frame GpuTimer::current_{0, {}};
+std::deque<GpuTimer::Frame> GpuTimer::pending_;
+std::vector<GLuint> GpuTimer::queries_;
+GLuint GpuTimer::open_[GpuTimer::NUM_PASSES] = {0};
+double GpuTimer::times_[GpuTimer::NUM_PASSES] = {0};
+int32_t GpuTimer::frames_ = 0;
+int32_t GpuTimer::harvested_ = -1;
+uint32_t GpuTimer::dropped_ = 0;
+
+void GpuTimer::setEnabled(bool enabled) {
+  if (!enabled && enabled_) reset();
+  enabled_ = enabled;
+}
+
+void GpuTimer::begin(Pass pass) {
+  if (!enabled_) return;
+  if (open_[pass] != 0) throw std::runtime_error(std::string("GpuTimer: pass ") + name(pass) + " already running.");
+
+  open_[pass] = query();
+  glQueryCounter(open_[pass], GL_TIMESTAMP);
+}
+
+void GpuTimer::end(Pass pass) {
+  if (!enabled_) return;
+  if (open_[pass] == 0) throw std::runtime_error(std::string("GpuTimer: pass ") + name(pass) + " not running.");
+
+  Interval interval;
+  interval.pass = pass;
+  interval.begin = open_[pass];
+  interval.end = query();
+  glQueryCounter(interval.end, GL_TIMESTAMP);
+
+  current_.intervals.push_back(interval);
+  open_[pass] = 0;
+}
+
+bool GpuTimer::nextFrame() {
+  if (!enabled_) return false;
+
+  // a pass without end(), e.g., due to an exception, has no valid interval and must not block the next frame.
+  for (uint32_t i = 0; i < NUM_PASSES; ++i) {
+    if (open_[i] != 0) queries_.push_back(open_[i]);
+    open_[i] = 0;
+  }
+
+  pending_.push_back(current_);
+  current_.index = ++frames_;
+  current_.intervals.clear();
+
+  bool updated = false;
+  while (!pending_.empty() && available(pending_.front())) {
+    Frame& frame = pending_.front();
+
+    std::fill(times_, times_ + NUM_PASSES, -1.0);
+    for (const Interval& interval : frame.intervals) {
+      GLuint64 t0 = 0, t1 = 0;
+      glGetQueryObjectui64v(interval.begin, GL_QUERY_RESULT, &t0);
+      glGetQueryObjectui64v(interval.end, GL_QUERY_RESULT, &t1);
+      times_[interval.pass] = std::max(0.0, times_[interval.pass]) + 1e-9 * (t1 - t0);
+    }
+    harvested_ = frame.index;
+    updated = true;
+
+    release(frame);
+    pending_.pop_front();
+  }
+
+  // never stall the pipeline: results of the oldest frames are simply discarded.
+  while (pending_.size() > MAX_PENDING) {
+    release(pending_.front());
+    pending_.pop_front();
+    dropped_ += 1;
+  }
+
+  return updated;
+}
+
+const char* GpuTimer::name(Pass pass) {
+  switch (pass) {
+    case VERTEX_MAP:
+      return "vertex-map";
+    case AVERAGE_VERTEX_MAP:
+      return "average-vertex-map";
+    case BILATERAL_FILTER:
+      return "bilateral-filter";
+    case NORMAL_MAP:
+      return "normal-map";
+    case JACOBIAN_BLEND:
+      return "jacobian-blend";
+    case JACOBIAN_COMPUTE:
+      return "jacobian-compute";
+    case INDEX_MAP:
+      return "index-map";
+    case SURFEL_UPDATE:
+      return "surfel-update";
+    case SURFEL_COPY:
+      return "surfel-copy";
+    case SURFEL_EXTRACT:
+      return "surfel-extract";
+    case RENDER:
+      return "render";
+    case RENDER_ACTIVE:
+      return "render-active";
+    case RENDER_INACTIVE:
+      return "render-inactive";
+    case RENDER_COMPOSED:
+      return "render-composed";
+    default:
+      return "unknown";
+  }
+}
+
+void GpuTimer::reset() {
+  for (Frame& frame : pending_) release(frame);
+  pending_.clear();
+  release(current_);
+  for (uint32_t i = 0; i < NUM_PASSES; ++i) {
+    if (open_[i] != 0) queries_.push_back(open_[i]);
+    open_[i] = 0;
+  }
+
+  if (!queries_.empty()) glDeleteQueries(queries_.size(), queries_.data());
+  queries_.clear();
+
+  std::fill(times_, times_ + NUM_PASSES, 0.0);
+  current_.index = frames_ = 0;
+  harvested_ = -1;
+  dropped_ = 0;
+}
+
+GLuint GpuTimer::query() {
+  if (queries_.empty()) {
+    GLuint id = 0;
+    glGenQueries(1, &id);
+    return id;
+  }
+
+  GLuint id = queries_.back();
+  queries_.pop_back();
+
+  return id;
+}
+
+bool GpuTimer::available(const Frame& frame) {
+  for (const Interval& interval : frame.intervals) {
+    for (GLuint id : {interval.begin, interval.end}) {
+      GLint ready = 0;
+      glGetQueryObjectiv(id, GL_QUERY_RESULT_AVAILABLE, &ready);
+      if (ready == 0) return false;
+    }
+  }
+
+  return true;
+}
+
+void GpuTimer::release(Frame& frame) {
+  for (const Interval& interval : frame.intervals) {
+    queries_.push_back(interval.begin);
+    queries_.push_back(interval.end);
+  }
+  frame.intervals.clear();
+}
@@ -0,0 +1,126 @@
+#ifndef SRC_CORE_GPUTIMER_H_
+#define SRC_CORE_GPUTIMER_H_
+
+#include <glow/glbase.h>
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+/** \brief GPU-side timing of the render and compute passes with timestamp queries.
+ *
+ *  Like Stopwatch, the timer is static, i.e., every pass can be timed without passing a timer around:
+ *
+ *    GpuTimer::begin(GpuTimer::NORMAL_MAP);
+ *    glDrawArrays(...);
+ *    GpuTimer::end(GpuTimer::NORMAL_MAP);
+ *
+ *  Passes, which call functions that might throw, should use a Scope, which ends the pass also during stack
+ *  unwinding:
+ *
+ *    {
+ *      GpuTimer::Scope timer(GpuTimer::RENDER);
+ *      program.setUniform(...);
+ *      glDrawArrays(...);
+ *    }
+ *
+ *  begin() and end() only issue timestamp queries and never wait for the GPU. With nextFrame(), the queries of the
+ *  current frame are queued and all queued frames, whose results are already available, are harvested; usually,
+ *  the results are available one or two frames later. Passes, which are still running at nextFrame(), are
+ *  discarded. If more than MAX_PENDING frames are queued, the oldest frame
+ *  is dropped instead of waiting for it.
+ *
+ *  Without setEnabled(true), all calls are no-ops and no queries are generated.
+ *
+ *  \author behley
+ */
+class GpuTimer {
+ public:
+  enum Pass {
+    VERTEX_MAP,
+    AVERAGE_VERTEX_MAP,
+    BILATERAL_FILTER,
+    NORMAL_MAP,
+    JACOBIAN_BLEND,
+    JACOBIAN_COMPUTE,
+    INDEX_MAP,
+    SURFEL_UPDATE,
+    SURFEL_COPY,
+    SURFEL_EXTRACT,
+    RENDER,
+    RENDER_ACTIVE,
+    RENDER_INACTIVE,
+    RENDER_COMPOSED,
+    NUM_PASSES
+  };
+
+  /** \brief times the pass from construction until destruction. **/
+  class Scope {
+   public:
+    explicit Scope(Pass pass) : pass_(pass) { begin(pass); }
+    ~Scope() {
+      if (running(pass_)) end(pass_);
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Pass pass_;
+  };
+
+  static void setEnabled(bool enabled);
+  static bool enabled() { return enabled_; }
+
+  /** \brief issue timestamp at begin/end of pass; a pass can be executed multiple times per frame. **/
+  static void begin(Pass pass);
+  static void end(Pass pass);
+
+  /** \brief true, if begin() was called without end() in the current frame. **/
+  static bool running(Pass pass) { return open_[pass] != 0; }
+
+  /** \brief finish current frame and harvest available results without waiting; true, if results were updated. **/
+  static bool nextFrame();
+
+  /** \brief GPU time in seconds of the pass in the most recently harvested frame; negative, if not executed. **/
+  static double time(Pass pass) { return times_[pass]; }
+
+  /** \brief index of the most recently harvested frame, i.e., number of nextFrame() calls before; -1 if none. **/
+  static int32_t frame() { return harvested_; }
+
+  /** \brief frames dropped, since their results were not available in time. **/
+  static uint32_t dropped() { return dropped_; }
+
+  static const char* name(Pass pass);
+
+  /** \brief delete all queries, e.g., before the OpenGL context is destroyed. **/
+  static void reset();
+
+  static const uint32_t MAX_PENDING = 4;
+
+ protected:
+  struct Interval {
+    Pass pass;
+    GLuint begin, end;
+  };
+
+  struct Frame {
+    int32_t index;
+    std::vector<Interval> intervals;
+  };
+
+  static GLuint query();
+  static bool available(const Frame& frame);
+  static void release(Frame& frame);
+
+  static bool enabled_;
+  static Frame current_;
+  static std::deque<Frame> pending_;
+  static std::vector<GLuint> queries_;  // unused queries.
+  static GLuint open_[NUM_PASSES];      // begin query of a running pass, 0 if not running.
+  static double times_[NUM_PASSES];
+  static int32_t frames_, harvested_;
+  static uint32_t dropped_;
+};
+
+#endif /* SRC_CORE_GPUTIMER_H_ */
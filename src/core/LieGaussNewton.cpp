@@ -1,6 +1,10 @@
 #include "core/LieGaussNewton.h"
 #include <rv/PrimitiveParameters.h>
 #include <rv/Stopwatch.h>
+#include <rv/Tracer.h>
+
+#include <algorithm>
+#include <limits>
 
 using namespace rv;
 
@@ -8,6 +12,7 @@ LieGaussNewton::LieGaussNewton() {
   params_.insert(IntegerParameter("max iterations", maxIter));
   params_.insert(FloatParameter("stopping threshold", epsilon));
   params_.insert(FloatParameter("delta", delta));
+  params_.insert(FloatParameter("prune factor", pruneFactor));
 }
 
 int32_t LieGaussNewton::minimize(Objective& F, const Eigen::Matrix4d& T0) {
@@ -15,17 +20,23 @@ int32_t LieGaussNewton::minimize(Objective& F, const Eigen::Matrix4d& T0) {
 
   initialize(F, T0);
 
-  std::vector<uint32_t> maxIterations({maxIter, maxIter, maxIter, 3, 3, 3});
+  const uint32_t maxLevel = F.getMaxLevel();
 
-  for (uint32_t i = 0; i <= F.getMaxLevel(); ++i) {
+  for (uint32_t i = 0; i <= maxLevel; ++i) {
     F.setLevel(i);
     k_ = 0;
+    last_error = std::numeric_limits<float>::max();  // objective changes with the level.
+
+    // coarse levels do most of the work; the complete image is only used for refinement.
+    uint32_t maxIterations = maxIter;
+    if (maxLevel > 0 && i == maxLevel) maxIterations = std::min<uint32_t>(maxIter, 3);
 //    std::cout << " ==== LEVEL " << i << " ==== " << std::endl;
     for (;;) {
+      ScopedTrace trace("gn-iteration");
       history_.push_back(Tk_);
       /** check if we can stop here. **/
 
-      if (maxIterations[i] > 0 && k_ >= maxIterations[i]) break;  // max iterations reached. :/
+      if (maxIterations > 0 && k_ >= maxIterations) break;  // max iterations reached. :/
 
       int32_t result = step();
 //      std::cout << "error = " << last_error << std::endl;
@@ -38,6 +49,103 @@ int32_t LieGaussNewton::minimize(Objective& F, const Eigen::Matrix4d& T0) {
   return 0;  // converged, hurray!
 }
 
+void LieGaussNewton::minimize(Objective& F, const std::vector<Eigen::Matrix4d>& T0,
+                              std::vector<Hypothesis>& hypotheses) {
+  hypotheses.assign(T0.size(), Hypothesis());
+  for (uint32_t i = 0; i < T0.size(); ++i) hypotheses[i].pose = T0[i];
+
+  std::vector<uint32_t> active;
+  std::vector<Eigen::Matrix4d> poses;
+  std::vector<Objective::Evaluation> evaluations;
+  std::vector<uint32_t> increases(T0.size(), 0);
+
+  const uint32_t maxLevel = F.getMaxLevel();
+  uint32_t iteration = 0;
+
+  for (uint32_t i = 0; i <= maxLevel; ++i) {
+    F.setLevel(i);
+
+    // objective changes with the level.
+    for (uint32_t j = 0; j < hypotheses.size(); ++j) {
+      hypotheses[j].converged = false;
+      hypotheses[j].error = std::numeric_limits<float>::max();
+      increases[j] = 0;
+    }
+
+    uint32_t maxIterations = maxIter;
+    if (maxLevel > 0 && i == maxLevel) maxIterations = std::min<uint32_t>(maxIter, 3);
+
+    for (uint32_t k = 0; maxIterations == 0 || k < maxIterations; ++k) {
+      ScopedTrace trace("gn-iteration");
+      active.clear();
+      poses.clear();
+      for (uint32_t j = 0; j < hypotheses.size(); ++j) {
+        if (hypotheses[j].pruned || hypotheses[j].converged) continue;
+        active.push_back(j);
+        poses.push_back(hypotheses[j].pose);
+      }
+      if (active.empty()) break;
+
+      F.setIteration(iteration++);
+      F.jacobianProducts(poses, evaluations);
+
+      double best_residual = std::numeric_limits<double>::max();
+
+      for (uint32_t a = 0; a < active.size(); ++a) {
+        Hypothesis& h = hypotheses[active[a]];
+        const Objective::Evaluation& eval = evaluations[a];
+
+        if (eval.valid() == 0) {
+          h.pruned = true;  // lost track of the model completely.
+          continue;
+        }
+
+        double current_error = eval.F;
+        increases[active[a]] = (current_error > h.error) ? increases[active[a]] + 1 : 0;
+        if (increases[active[a]] > 1) {
+          h.pruned = true;  // diverging.
+          continue;
+        }
+
+        Eigen::VectorXd deltax = eval.JtJ.ldlt().solve(-eval.Jtf);
+
+        if (deltax.lpNorm<Eigen::Infinity>() < delta) h.converged = true;
+        if (std::abs(eval.Jtf.maxCoeff()) < epsilon) h.converged = true;
+        if (current_error < h.error && std::abs(current_error - h.error) < epsilon) h.converged = true;
+
+        h.pose = SE3::exp(deltax) * h.pose;
+        h.error = current_error;
+        h.iterations += 1;
+
+        best_residual = std::min(best_residual, current_error / eval.valid());
+      }
+
+      if (pruneFactor <= 0.0 || k == 0) continue;  // first step might be far off for all hypotheses.
+
+      for (uint32_t a = 0; a < active.size(); ++a) {
+        Hypothesis& h = hypotheses[active[a]];
+        if (h.pruned) continue;
+        if (evaluations[a].F / evaluations[a].valid() > pruneFactor * best_residual) h.pruned = true;
+      }
+    }
+  }
+
+  // evaluate remaining hypotheses at their final poses.
+  active.clear();
+  poses.clear();
+  for (uint32_t j = 0; j < hypotheses.size(); ++j) {
+    if (hypotheses[j].pruned) continue;
+    active.push_back(j);
+    poses.push_back(hypotheses[j].pose);
+  }
+
+  if (active.empty()) return;
+
+  F.setIteration(iteration);
+  F.jacobianProducts(poses, evaluations);
+  for (uint32_t a = 0; a < active.size(); ++a) hypotheses[active[a]].evaluation = evaluations[a];
+}
+
 void LieGaussNewton::initialize(Objective& F, const Eigen::Matrix4d& T0) {
   const uint32_t N = F.num_parameters();
 
@@ -90,6 +198,7 @@ void LieGaussNewton::setParameters(const ParameterList& params) {
   maxIter = params_["max iterations"];
   epsilon = params_["stopping threshold"];
   delta = params_["delta"];
+  pruneFactor = params_["prune factor"];
 }
 
 const Eigen::MatrixXd& LieGaussNewton::covariance() {
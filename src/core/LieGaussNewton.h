@@ -4,7 +4,9 @@
 #include <rv/ParameterList.h>
 #include "Objective.h"
 
+#include <limits>
 #include <memory>
+#include <vector>
 
 /** \brief Gauss-Newton method on Lie Groups, which performs the update using matrix exponentials.
  *
@@ -24,6 +26,16 @@ class OptimizerCallback {
 
 class LieGaussNewton {
  public:
+  /** \brief state of a single pose hypothesis of the batched optimization. **/
+  struct Hypothesis {
+    Eigen::Matrix4d pose{Eigen::Matrix4d::Identity()};
+    Objective::Evaluation evaluation;  // evaluation at the final pose (if not pruned).
+    double error{std::numeric_limits<double>::max()};
+    uint32_t iterations{0};
+    bool converged{false};
+    bool pruned{false};  // diverged or clearly worse than the best hypothesis.
+  };
+
   LieGaussNewton();
 
   void setParameters(const rv::ParameterList& params);
@@ -31,6 +43,16 @@ class LieGaussNewton {
   /** \brief optimize F starting with given pose T0. **/
   int32_t minimize(Objective& F, const Eigen::Matrix4d& T0);
 
+  /** \brief optimize F starting with all given poses together.
+   *
+   *  All hypotheses are advanced in lockstep, where every iteration evaluates the remaining hypotheses
+   *  with a single call of the objective. A hypothesis is pruned if it has no valid correspondences, if its error
+   *  increased twice in a row, or if its mean residual exceeds "prune factor" times the best mean residual.
+   *
+   *  The current pose and history of the optimizer are not changed.
+   **/
+  void minimize(Objective& F, const std::vector<Eigen::Matrix4d>& T0, std::vector<Hypothesis>& hypotheses);
+
   /** \brief initialize given objective and pose... **/
   void initialize(Objective& F, const Eigen::Matrix4d& T0);
 
@@ -70,6 +92,7 @@ class LieGaussNewton {
 
   uint32_t maxIter{200};
   double epsilon{1e-10}, delta{1e-10};
+  double pruneFactor{3.0};
 
   std::vector<Eigen::Matrix4d> history_;
   std::shared_ptr<OptimizerCallback> callback_;
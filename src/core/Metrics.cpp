@@ -0,0 +1,226 @@
+#include "core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+const uint32_t Metrics::NUM_BUCKETS;
+constexpr double Metrics::BUCKET_GROWTH;
+constexpr double Metrics::BUCKET_MIN;
+
+Metrics::~Metrics() {
+  close();
+}
+
+Metrics::Handle Metrics::counter(const std::string& name) {
+  return registerMetric(name, Type::COUNTER);
+}
+
+Metrics::Handle Metrics::gauge(const std::string& name) {
+  return registerMetric(name, Type::GAUGE);
+}
+
+Metrics::Handle Metrics::histogram(const std::string& name) {
+  return registerMetric(name, Type::HISTOGRAM);
+}
+
+Metrics::Handle Metrics::registerMetric(const std::string& name, Type type) {
+  auto it = handles_.find(name);
+  if (it != handles_.end()) {
+    if (metrics_[it->second].type != type)
+      throw std::runtime_error("Metrics: metric '" + name + "' already registered with different type.");
+    return it->second;
+  }
+
+  Metric metric;
+  metric.name = name;
+  metric.type = type;
+  if (type == Type::HISTOGRAM) metric.buckets.assign(NUM_BUCKETS, 0);
+
+  metrics_.push_back(metric);
+  handles_[name] = metrics_.size() - 1;
+
+  return metrics_.size() - 1;
+}
+
+void Metrics::add(Handle h, double delta) {
+  Metric& metric = metrics_[h];
+  metric.value += delta;
+  metric.valid = metric.updated = true;
+}
+
+void Metrics::set(Handle h, double value) {
+  Metric& metric = metrics_[h];
+  metric.value = value;
+  metric.valid = metric.updated = true;
+}
+
+void Metrics::record(Handle h, double value) {
+  Metric& metric = metrics_[h];
+  if (metric.type != Type::HISTOGRAM) throw std::runtime_error("Metrics: '" + metric.name + "' is no histogram.");
+
+  metric.value = value;
+  metric.valid = metric.updated = true;
+
+  metric.buckets[bucket(value)] += 1;
+  metric.min = (metric.count == 0) ? value : std::min(metric.min, value);
+  metric.max = (metric.count == 0) ? value : std::max(metric.max, value);
+  metric.sum += value;
+  metric.count += 1;
+}
+
+Metrics::Summary Metrics::summary(Handle h) const {
+  const Metric& metric = metrics_[h];
+
+  Summary summary;
+  if (metric.count == 0) return summary;
+
+  summary.count = metric.count;
+  summary.mean = metric.sum / metric.count;
+  summary.min = metric.min;
+  summary.max = metric.max;
+
+  // nearest rank, but with the representative value of the bucket clamped to the observed range.
+  const double ps[3] = {0.50, 0.95, 0.99};
+  double* results[3] = {&summary.p50, &summary.p95, &summary.p99};
+  uint64_t cumulative = 0;
+  uint32_t k = 0;
+  for (uint32_t b = 0; b < NUM_BUCKETS && k < 3; ++b) {
+    cumulative += metric.buckets[b];
+    while (k < 3 && cumulative >= std::max<uint64_t>(std::ceil(ps[k] * metric.count), 1)) {
+      *results[k] = std::max(metric.min, std::min(metric.max, bucketValue(b)));
+      k += 1;
+    }
+  }
+
+  return summary;
+}
+
+void Metrics::values(std::unordered_map<std::string, float>& values) const {
+  for (const Metric& metric : metrics_) {
+    if (metric.valid) values[metric.name] = metric.value;
+  }
+}
+
+void Metrics::clear() {
+  for (Metric& metric : metrics_) {
+    metric.value = 0.0;
+    metric.valid = metric.updated = false;
+    std::fill(metric.buckets.begin(), metric.buckets.end(), 0);
+    metric.count = 0;
+    metric.sum = metric.min = metric.max = 0.0;
+  }
+}
+
+uint32_t Metrics::bucket(double value) {
+  if (!(value > BUCKET_MIN)) return 0;  // also NaN.
+
+  double b = 1.0 + std::floor(std::log(value / BUCKET_MIN) / std::log(BUCKET_GROWTH));
+  return std::min<double>(b, NUM_BUCKETS - 1);
+}
+
+double Metrics::bucketValue(uint32_t bucket) {
+  // upper bound of the bucket.
+  return BUCKET_MIN * std::pow(BUCKET_GROWTH, bucket);
+}
+
+void Metrics::open(const std::string& filename) {
+  close();
+
+  out_.open(filename.c_str());
+  if (!out_.is_open()) throw std::runtime_error("Metrics: unable to open log file " + filename + ".");
+
+  csv_ = (filename.size() >= 4 && filename.substr(filename.size() - 4) == ".csv");
+  logged_ = 0;
+  closing_ = false;
+  writer_ = std::thread(&Metrics::write, this);
+}
+
+void Metrics::commit(uint32_t frame) {
+  if (!writer_.joinable()) {
+    for (Metric& metric : metrics_) metric.updated = false;
+    return;
+  }
+
+  Row row;
+  row.frame = frame;
+  for (; logged_ < metrics_.size(); ++logged_) row.names.push_back(metrics_[logged_].name);
+  for (Handle h = 0; h < metrics_.size(); ++h) {
+    if (metrics_[h].updated) row.values.push_back(std::make_pair(h, metrics_[h].value));
+    metrics_[h].updated = false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  rows_.push_back(std::move(row));
+  cond_.notify_one();
+}
+
+void Metrics::close() {
+  if (!writer_.joinable()) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+    cond_.notify_one();
+  }
+  writer_.join();
+  out_.close();
+}
+
+void Metrics::write() {
+  std::vector<std::string> names;  // names of all metrics passed to the writer.
+  int32_t columns = -1;            // CSV only; -1 until the header is written.
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_.wait(lock, [this] { return closing_ || !rows_.empty(); });
+    if (rows_.empty()) break;  // closing and everything written.
+
+    Row row = std::move(rows_.front());
+    rows_.pop_front();
+
+    lock.unlock();
+    writeRow(row, names, columns);
+    lock.lock();
+  }
+
+  out_.flush();
+}
+
+void Metrics::writeRow(const Row& row, std::vector<std::string>& names, int32_t& columns) {
+  names.insert(names.end(), row.names.begin(), row.names.end());
+
+  out_ << std::setprecision(9);
+  if (csv_) {
+    if (columns < 0) {
+      columns = names.size();
+      out_ << "frame";
+      for (const std::string& name : names) out_ << "," << name;
+      out_ << "\n";
+    }
+
+    std::vector<std::string> fields(columns);
+    for (const auto& value : row.values) {
+      if (int32_t(value.first) >= columns) continue;  // registered after the header was written.
+      std::ostringstream field;
+      field << std::setprecision(9) << value.second;
+      fields[value.first] = field.str();
+    }
+
+    out_ << row.frame;
+    for (const std::string& field : fields) out_ << "," << field;
+    out_ << "\n";
+  } else {
+    out_ << "{\"frame\": " << row.frame;
+    for (const auto& value : row.values) {
+      out_ << ", \"" << names[value.first] << "\": ";
+      if (std::isfinite(value.second))
+        out_ << value.second;
+      else
+        out_ << "null";
+    }
+    out_ << "}\n";
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef SRC_CORE_METRICS_H_
+#define SRC_CORE_METRICS_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** \brief registry of named metrics, which are updated through pre-registered handles.
+ *
+ *  A counter accumulates increments, a gauge holds the last value, and a histogram additionally keeps the
+ *  distribution of all recorded samples in logarithmic buckets, i.e., percentiles have a relative error below
+ *  BUCKET_GROWTH - 1 independent of the number of samples.
+ *
+ *  With open(), every commit() appends the metrics updated since the previous commit as row of a per-frame log,
+ *  which is either CSV (filename ending with .csv) or JSON lines. The rows are formatted and written by a
+ *  background thread. In CSV, the columns are the metrics registered before the first commit.
+ *
+ *  Updating metrics is not thread-safe; only the log writing happens concurrently.
+ *
+ *  \author behley
+ */
+class Metrics {
+ public:
+  typedef uint32_t Handle;
+
+  enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+  struct Summary {
+    uint64_t count{0};
+    double mean{0.0}, min{0.0}, max{0.0};
+    double p50{0.0}, p95{0.0}, p99{0.0};
+  };
+
+  Metrics() = default;
+  ~Metrics();
+
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  /** \brief register metric with given name; registering an existing name returns its handle. **/
+  Handle counter(const std::string& name);
+  Handle gauge(const std::string& name);
+  Handle histogram(const std::string& name);
+
+  /** \brief increment counter. **/
+  void add(Handle h, double delta = 1.0);
+
+  /** \brief set current value of a metric without recording a sample. **/
+  void set(Handle h, double value);
+
+  /** \brief record sample of a histogram, which also becomes the current value. **/
+  void record(Handle h, double value);
+
+  /** \brief current value of the metric, or 0 if it was never updated. **/
+  double value(Handle h) const { return metrics_[h].value; }
+
+  /** \brief distribution of the recorded samples of a histogram. **/
+  Summary summary(Handle h) const;
+
+  const std::string& name(Handle h) const { return metrics_[h].name; }
+  Type type(Handle h) const { return metrics_[h].type; }
+  uint32_t size() const { return metrics_.size(); }
+
+  /** \brief current values of all metrics that were updated at least once. **/
+  void values(std::unordered_map<std::string, float>& values) const;
+
+  /** \brief remove all values and samples, but keep registered metrics. **/
+  void clear();
+
+  /** \brief start writing the per-frame log to given file. **/
+  void open(const std::string& filename);
+
+  /** \brief append a row with the metrics updated since the last commit to the log, if opened. **/
+  void commit(uint32_t frame);
+
+  /** \brief write all pending rows and close the log. **/
+  void close();
+
+  static const uint32_t NUM_BUCKETS = 2100;
+  static constexpr double BUCKET_GROWTH = 1.02;
+  static constexpr double BUCKET_MIN = 1e-9;  // all values below are counted in the first bucket.
+
+ protected:
+  struct Metric {
+    std::string name;
+    Type type;
+    double value{0.0};
+    bool valid{false};    // updated at least once.
+    bool updated{false};  // updated since last commit.
+
+    // histogram only.
+    std::vector<uint64_t> buckets;
+    uint64_t count{0};
+    double sum{0.0}, min{0.0}, max{0.0};
+  };
+
+  struct Row {
+    uint32_t frame;
+    std::vector<std::string> names;  // metrics registered since the last row.
+    std::vector<std::pair<Handle, double>> values;
+  };
+
+  Handle registerMetric(const std::string& name, Type type);
+  static uint32_t bucket(double value);
+  static double bucketValue(uint32_t bucket);
+
+  void write();
+  void writeRow(const Row& row, std::vector<std::string>& names, int32_t& columns);
+
+  std::vector<Metric> metrics_;
+  std::unordered_map<std::string, Handle> handles_;
+
+  // per-frame log.
+  std::ofstream out_;
+  bool csv_{false};
+  uint32_t logged_{0};  // number of metrics, which were already passed to the writer.
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Row> rows_;
+  bool closing_{false};
+};
+
+#endif /* SRC_CORE_METRICS_H_ */
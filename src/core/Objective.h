@@ -7,9 +7,20 @@
 #include <rv/Parameter.h>
 
 #include <memory>
+#include <vector>
 
 class Objective {
  public:
+  /** \brief JtJ, Jtf, F(x), and counters of the evaluation of a single pose. **/
+  struct Evaluation {
+    Eigen::MatrixXd JtJ, Jtf;
+    double F{0.0};
+    uint32_t inlier{0}, outlier{0}, invalid{0};
+    float inlier_residual{0.0f};
+
+    uint32_t valid() const { return inlier + outlier; }
+  };
+
   virtual ~Objective() {}
 
   virtual uint32_t num_parameters() const = 0;
@@ -38,6 +49,37 @@ class Objective {
   /** \brief compute JtJ and Jtf exploiting intermediate computations at current pose, return F(x).  */
   virtual double jacobianProducts(Eigen::MatrixXd& JtJ, Eigen::MatrixXd& Jtf) = 0;
 
+  /** \brief compute JtJ, Jtf, and F(x) for multiple pose hypotheses.
+   *
+   *  The default implementation evaluates one pose after another; derived classes should evaluate all poses
+   *  in a single pass over the data. The current pose and counters of the objective are not changed.
+   **/
+  virtual void jacobianProducts(const std::vector<Eigen::Matrix4d>& poses, std::vector<Evaluation>& results) {
+    const Eigen::Matrix4d pose = pose_;
+    const uint32_t inlier = inlier_, outlier = outlier_, invalid = invalid_;
+    const float inlier_residual = inlier_residual_;
+
+    results.resize(poses.size());
+    for (uint32_t i = 0; i < poses.size(); ++i) {
+      Evaluation& result = results[i];
+      result.JtJ.resize(num_parameters(), num_parameters());
+      result.Jtf.resize(num_parameters(), 1);
+
+      pose_ = poses[i];
+      result.F = jacobianProducts(result.JtJ, result.Jtf);
+      result.inlier = inlier_;
+      result.outlier = outlier_;
+      result.invalid = invalid_;
+      result.inlier_residual = inlier_residual_;
+    }
+
+    pose_ = pose;
+    inlier_ = inlier;
+    outlier_ = outlier;
+    invalid_ = invalid;
+    inlier_residual_ = inlier_residual;
+  }
+
   /** \brief increment by given delta. **/
   void increment(const Eigen::VectorXd& delta) {
     pose_ = SE3::exp(delta) * pose_;
@@ -56,6 +98,9 @@ class Objective {
 
   const Eigen::Matrix4d& pose() const { return pose_; }
 
+  /** \brief set number of performed iterations, which influences the weighting. **/
+  void setIteration(uint32_t iteration) { iteration_ = iteration; }
+
   /** \brief specify at which level the redisual/jacobian is computed. **/
   virtual void setLevel(uint32_t lvl) {  // noop
   }
@@ -0,0 +1,134 @@
+#include "core/PoseIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+PoseIndex::PoseIndex(float cellSize) : cellSize_(cellSize) {
+  if (cellSize_ <= 0.0f) throw std::runtime_error("PoseIndex: cell size must be positive.");
+}
+
+void PoseIndex::setCellSize(float cellSize) {
+  if (cellSize <= 0.0f) throw std::runtime_error("PoseIndex: cell size must be positive.");
+  if (cellSize == cellSize_) return;
+
+  cellSize_ = cellSize;
+
+  cells_.clear();
+  for (uint32_t i = 0; i < positions_.size(); ++i) {
+    if (valid_[i]) insertIntoCell(i);
+  }
+}
+
+void PoseIndex::clear() {
+  positions_.clear();
+  valid_.clear();
+  cells_.clear();
+}
+
+void PoseIndex::set(int32_t id, const Eigen::Vector3d& position) {
+  if (id < 0) throw std::runtime_error("PoseIndex: negative node id.");
+
+  if (id >= int32_t(positions_.size())) {
+    positions_.resize(id + 1, Eigen::Vector3d::Zero());
+    valid_.resize(id + 1, false);
+  }
+
+  if (valid_[id]) {
+    // only rehash if the cell changes.
+    if (cell(positions_[id]) == cell(position)) {
+      positions_[id] = position;
+      return;
+    }
+    removeFromCell(id);
+  }
+
+  positions_[id] = position;
+  valid_[id] = true;
+  insertIntoCell(id);
+}
+
+void PoseIndex::rebuild(const std::vector<Eigen::Matrix4d>& poses) {
+  clear();
+
+  positions_.resize(poses.size());
+  valid_.assign(poses.size(), true);
+
+  for (uint32_t i = 0; i < poses.size(); ++i) {
+    positions_[i] = poses[i].block<3, 1>(0, 3);
+    insertIntoCell(i);
+  }
+}
+
+void PoseIndex::radiusSearch(const Eigen::Vector3d& query, float radius, std::vector<int32_t>& indexes,
+                             const Filter& filter) const {
+  indexes.clear();
+  const double sqr_radius = double(radius) * double(radius);
+
+  visit(query, radius, [&](int32_t id) {
+    if ((positions_[id] - query).squaredNorm() > sqr_radius) return;
+    if (filter && !filter(id)) return;
+
+    indexes.push_back(id);
+  });
+
+  std::sort(indexes.begin(), indexes.end());
+}
+
+int32_t PoseIndex::closest(const Eigen::Vector3d& query, float radius, const Filter& filter) const {
+  int32_t closest_idx = -1;
+  double min_distance = radius;
+
+  visit(query, radius, [&](int32_t id) {
+    double distance = (positions_[id] - query).norm();
+    if (distance > min_distance || (distance == min_distance && (closest_idx == -1 || id < closest_idx))) return;
+    if (filter && !filter(id)) return;
+
+    closest_idx = id;
+    min_distance = distance;
+  });
+
+  return closest_idx;
+}
+
+Eigen::Vector3i PoseIndex::cell(const Eigen::Vector3d& position) const {
+  return Eigen::Vector3i(std::floor(position.x() / cellSize_), std::floor(position.y() / cellSize_),
+                         std::floor(position.z() / cellSize_));
+}
+
+PoseIndex::Key PoseIndex::key(const Eigen::Vector3i& cell) {
+  // 21 bits per dimension, i.e., more than enough cells for any reasonable cell size.
+  const Key mask = (Key(1) << 21) - 1;
+  return ((Key(cell.x()) & mask) << 42) | ((Key(cell.y()) & mask) << 21) | (Key(cell.z()) & mask);
+}
+
+void PoseIndex::insertIntoCell(int32_t id) {
+  cells_[key(cell(positions_[id]))].push_back(id);
+}
+
+void PoseIndex::removeFromCell(int32_t id) {
+  auto it = cells_.find(key(cell(positions_[id])));
+  if (it == cells_.end()) return;
+
+  std::vector<int32_t>& ids = it->second;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+  if (ids.empty()) cells_.erase(it);
+}
+
+template <class Visitor>
+void PoseIndex::visit(const Eigen::Vector3d& query, float radius, Visitor visitor) const {
+  const Eigen::Vector3d extent = Eigen::Vector3d::Constant(radius);
+  const Eigen::Vector3i min_cell = cell(query - extent);
+  const Eigen::Vector3i max_cell = cell(query + extent);
+
+  for (int32_t x = min_cell.x(); x <= max_cell.x(); ++x) {
+    for (int32_t y = min_cell.y(); y <= max_cell.y(); ++y) {
+      for (int32_t z = min_cell.z(); z <= max_cell.z(); ++z) {
+        auto it = cells_.find(key(Eigen::Vector3i(x, y, z)));
+        if (it == cells_.end()) continue;
+
+        for (int32_t id : it->second) visitor(id);
+      }
+    }
+  }
+}
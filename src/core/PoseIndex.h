@@ -0,0 +1,80 @@
+#ifndef SRC_CORE_POSEINDEX_H_
+#define SRC_CORE_POSEINDEX_H_
+
+#include <eigen3/Eigen/Dense>
+
+#include <functional>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/** \brief spatial index over the positions of pose graph nodes for nearest neighbor and radius queries.
+ *
+ *  The positions are hashed into a regular grid with given cell size, i.e., a radius query only visits
+ *  the cells overlapping with the bounding box of the query ball. If the cell size corresponds to the
+ *  query radius, only 27 cells must be visited regardless of the number of nodes.
+ *
+ *  Nodes can be moved individually and after an optimization of the pose graph, the index can be rebuilt
+ *  in linear time from the optimized poses.
+ *
+ *  Queries can be restricted by a filter, e.g., to only consider nodes that are far enough away along the
+ *  trajectory.
+ *
+ *  \author behley
+ */
+class PoseIndex {
+ public:
+  typedef std::function<bool(int32_t)> Filter;
+
+  PoseIndex(float cellSize = 20.0f);
+
+  /** \brief change cell size and rehash all nodes. **/
+  void setCellSize(float cellSize);
+  float cellSize() const { return cellSize_; }
+
+  /** \brief remove all nodes. **/
+  void clear();
+
+  /** \brief insert node or move already inserted node to given position. **/
+  void set(int32_t id, const Eigen::Vector3d& position);
+
+  /** \brief replace all nodes with the translations of the given poses, where pose i corresponds to node i. **/
+  void rebuild(const std::vector<Eigen::Matrix4d>& poses);
+
+  /** \brief number of nodes. **/
+  uint32_t size() const { return positions_.size(); }
+
+  bool contains(int32_t id) const { return id >= 0 && id < int32_t(valid_.size()) && valid_[id]; }
+
+  const Eigen::Vector3d& position(int32_t id) const { return positions_[id]; }
+
+  /** \brief get all nodes within the given radius accepted by the filter sorted by id. **/
+  void radiusSearch(const Eigen::Vector3d& query, float radius, std::vector<int32_t>& indexes,
+                    const Filter& filter = Filter()) const;
+
+  /** \brief get closest node within the given radius accepted by the filter, or -1 if there is no such node.
+   *
+   *  If there are multiple nodes with the same distance, the node with the largest id is returned.
+   **/
+  int32_t closest(const Eigen::Vector3d& query, float radius, const Filter& filter = Filter()) const;
+
+ protected:
+  typedef int64_t Key;
+
+  Eigen::Vector3i cell(const Eigen::Vector3d& position) const;
+  static Key key(const Eigen::Vector3i& cell);
+
+  void insertIntoCell(int32_t id);
+  void removeFromCell(int32_t id);
+
+  /** \brief visit all nodes inside cells overlapping with the bounding box of the ball. **/
+  template <class Visitor>
+  void visit(const Eigen::Vector3d& query, float radius, Visitor visitor) const;
+
+  float cellSize_;
+  std::vector<Eigen::Vector3d> positions_;
+  std::vector<bool> valid_;
+  std::unordered_map<Key, std::vector<int32_t>> cells_;
+};
+
+#endif /* SRC_CORE_POSEINDEX_H_ */
@@ -0,0 +1,78 @@
+#include "core/PoseTable.h"
+
+#include <algorithm>
+
+const uint32_t PoseTable::MERGE_GAP;
+
+PoseTable::PoseTable(uint32_t capacity) {
+  reset(capacity);
+}
+
+void PoseTable::reset(uint32_t capacity) {
+  poses_.assign(std::max<uint32_t>(capacity, 1), Eigen::Matrix4f::Identity());
+  dirty_.clear();
+  resized_ = true;
+}
+
+void PoseTable::set(uint32_t idx, const Eigen::Matrix4f& pose) {
+  reserve(idx + 1);
+  poses_[idx] = pose;
+  markDirty(idx, idx + 1);
+}
+
+void PoseTable::update(const std::vector<Eigen::Matrix4f>& poses) {
+  reserve(poses.size());
+
+  uint32_t first = 0;
+  bool changed = false;
+  for (uint32_t i = 0; i < poses.size(); ++i) {
+    if (poses_[i] == poses[i]) {
+      if (changed) markDirty(first, i);
+      changed = false;
+      continue;
+    }
+
+    if (!changed) first = i;
+    changed = true;
+    poses_[i] = poses[i];
+  }
+  if (changed) markDirty(first, poses.size());
+}
+
+void PoseTable::reserve(uint32_t count) {
+  if (count <= poses_.size()) return;
+
+  poses_.resize(std::max<uint32_t>(count, 2 * poses_.size()), Eigen::Matrix4f::Identity());
+  resized_ = true;
+}
+
+std::vector<PoseTable::Range> PoseTable::dirtyRanges() const {
+  std::vector<Range> ranges = dirty_;
+  std::sort(ranges.begin(), ranges.end());
+
+  std::vector<Range> result;
+  for (const Range& range : ranges) {
+    if (!result.empty() && range.first <= result.back().second + MERGE_GAP) {
+      result.back().second = std::max(result.back().second, range.second);
+    } else {
+      result.push_back(range);
+    }
+  }
+
+  return result;
+}
+
+void PoseTable::clean() {
+  dirty_.clear();
+  resized_ = false;
+}
+
+void PoseTable::markDirty(uint32_t first, uint32_t last) {
+  // consecutive modifications, like set() of the next scan, simply extend the last range.
+  if (!dirty_.empty() && first >= dirty_.back().first && first <= dirty_.back().second + MERGE_GAP) {
+    dirty_.back().second = std::max(dirty_.back().second, last);
+    return;
+  }
+
+  dirty_.push_back(Range(first, last));
+}
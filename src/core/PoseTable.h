@@ -0,0 +1,63 @@
+#ifndef SRC_CORE_POSETABLE_H_
+#define SRC_CORE_POSETABLE_H_
+
+#include <eigen3/Eigen/Dense>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/** \brief host-side copy of the scan poses, which keeps track of the poses that must be uploaded to the GPU.
+ *
+ *  The table grows on demand by doubling its capacity; unused entries are identities. Every change marks the
+ *  modified poses dirty, and dirtyRanges() combines them into few contiguous ranges, i.e., only these ranges
+ *  must be uploaded. After growing, the complete table must be uploaded (see resized()).
+ *
+ *  \author behley
+ */
+class PoseTable {
+ public:
+  typedef std::pair<uint32_t, uint32_t> Range;  // first index and one past the last index.
+
+  PoseTable(uint32_t capacity = 10000);
+
+  /** \brief replace all poses by identities with given capacity. **/
+  void reset(uint32_t capacity);
+
+  /** \brief set pose with given index and grow if needed. **/
+  void set(uint32_t idx, const Eigen::Matrix4f& pose);
+
+  /** \brief replace the first poses.size() poses; only poses that actually change are marked dirty. **/
+  void update(const std::vector<Eigen::Matrix4f>& poses);
+
+  /** \brief ensure that poses with index smaller than count can be stored. **/
+  void reserve(uint32_t count);
+
+  uint32_t capacity() const { return poses_.size(); }
+
+  const Eigen::Matrix4f& operator[](uint32_t idx) const { return poses_[idx]; }
+
+  /** \brief all poses including unused entries. **/
+  const std::vector<Eigen::Matrix4f>& poses() const { return poses_; }
+
+  /** \brief true, if the capacity changed since the last call of clean(). **/
+  bool resized() const { return resized_; }
+
+  /** \brief sorted and disjoint ranges of dirty poses; ranges separated by less than MERGE_GAP poses are merged,
+   *  since a single larger upload is cheaper than many small uploads. **/
+  std::vector<Range> dirtyRanges() const;
+
+  /** \brief mark everything as uploaded. **/
+  void clean();
+
+  static const uint32_t MERGE_GAP = 16;
+
+ protected:
+  void markDirty(uint32_t first, uint32_t last);
+
+  std::vector<Eigen::Matrix4f> poses_;
+  std::vector<Range> dirty_;  // in order of modification.
+  bool resized_{true};
+};
+
+#endif /* SRC_CORE_POSETABLE_H_ */
@@ -8,6 +8,13 @@
 #include <gtsam/slam/BetweenFactor.h>
 #include <gtsam/slam/PriorFactor.h>
 
+#include "util/BinaryBuffer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
 using namespace gtsam;
 
 Posegraph::Posegraph() {}
@@ -17,10 +24,59 @@ void Posegraph::clear() {
   initial_.clear();
   edges_.clear();
   result_.clear();
+  priorId_ = -1;
+
+  newFactors_ = NonlinearFactorGraph();
+  newValues_.clear();
+  if (isam_ != nullptr) isam_ = createSolver();
 }
 
 Posegraph::Ptr Posegraph::clone() const {
-  return Posegraph::Ptr(new Posegraph(*this));
+  Posegraph::Ptr copy(new Posegraph(*this));
+  if (isam_ != nullptr) copy->isam_ = std::make_shared<ISAM2>(*isam_);
+
+  return copy;
+}
+
+void Posegraph::setIncremental(bool incremental) {
+  if (incremental == isIncremental()) return;
+
+  if (incremental) {
+    // everything is new for the solver.
+    isam_ = createSolver();
+    newFactors_ = graph_;
+    newValues_ = result_;
+  } else {
+    isam_ = nullptr;
+    newFactors_ = NonlinearFactorGraph();
+    newValues_.clear();
+  }
+}
+
+Posegraph::Ptr Posegraph::extractChanges() {
+  if (isam_ == nullptr) throw std::runtime_error("Posegraph: changes can only be extracted in incremental mode.");
+
+  Posegraph::Ptr changes(new Posegraph());
+  changes->isam_ = isam_;
+  changes->graph_ = newFactors_;
+  changes->initial_ = newValues_;
+  changes->newFactors_ = newFactors_;
+  changes->newValues_ = newValues_;
+  changes->robustify_ = robustify_;
+  changes->robustifier_ = robustifier_;
+
+  newFactors_ = NonlinearFactorGraph();
+  newValues_.clear();
+
+  return changes;
+}
+
+std::shared_ptr<ISAM2> Posegraph::createSolver() {
+  ISAM2Params params;
+  params.relinearizeThreshold = 0.01;
+  params.relinearizeSkip = 1;
+
+  return std::make_shared<ISAM2>(params);
 }
 
 void Posegraph::setInitial(int32_t id, const Eigen::Matrix4d& initial_estimate) {
@@ -28,10 +84,14 @@ void Posegraph::setInitial(int32_t id, const Eigen::Matrix4d& initial_estimate)
 
   //  std::cout << "Initializing " << id << std::endl;
 
-  if (!initial_.exists(id))
+  if (!initial_.exists(id)) {
     initial_.insert(id, Pose3(initial_estimate));
-  else
+    if (isam_ != nullptr) newValues_.insert(id, Pose3(initial_estimate));
+  } else {
     initial_.update(id, Pose3(initial_estimate));
+    // the solver keeps its own linearization point for already integrated nodes.
+    if (newValues_.exists(id)) newValues_.update(id, Pose3(initial_estimate));
+  }
 
   // also update intermediate result.
   if (result_.exists(id))
@@ -40,10 +100,12 @@ void Posegraph::setInitial(int32_t id, const Eigen::Matrix4d& initial_estimate)
     result_.insert(id, Pose3(initial_estimate));
 
   if (addPrior) {
+    priorId_ = id;
     Vector6 diagonal;
     diagonal << 1e-6, 1e-6, 1e-6, 1e-6, 1e-6, 1e-6;
     noiseModel::Diagonal::shared_ptr priorModel = noiseModel::Diagonal::Variances(diagonal);
     graph_.add(PriorFactor<Pose3>(id, Pose3(), priorModel));
+    if (isam_ != nullptr) newFactors_.add(PriorFactor<Pose3>(id, Pose3(), priorModel));
   }
 }
 
@@ -56,8 +118,9 @@ void Posegraph::addEdge(int32_t from, int32_t to, const Eigen::Matrix4d& measure
 
   NonlinearFactor::shared_ptr factor(new BetweenFactor<Pose3>(from, to, Pose3(measurement), model));
   graph_.add(factor);
+  if (isam_ != nullptr) newFactors_.add(factor);
 
-  edges_.push_back({from, to, measurement});
+  edges_.push_back({from, to, measurement, information});
 }
 
 Eigen::Matrix4d Posegraph::pose(int32_t id) const {
@@ -91,6 +154,19 @@ double Posegraph::error() const {
 bool Posegraph::optimize(uint32_t num_iters) {
   // todo: check if every value has been initialized.
 
+  if (isam_ != nullptr) {
+    ISAM2Result update = isam_->update(newFactors_, newValues_);
+    newFactors_ = NonlinearFactorGraph();
+    newValues_.clear();
+
+    // further updates only relinearize variables with large enough changes.
+    for (uint32_t i = 1; i < num_iters && update.variablesRelinearized > 0; ++i) update = isam_->update();
+
+    result_ = isam_->calculateEstimate();
+
+    return true;
+  }
+
   LevenbergMarquardtParams params;
   params.maxIterations = num_iters;
   params.setVerbosity("TERMINATION");  // this will show info about stopping conditions
@@ -116,8 +192,320 @@ const gtsam::Values& Posegraph::result() const {
   return result_;
 }
 
-void Posegraph::save(const std::string& filename) const {}
-void Posegraph::load(const std::string& filename) {}
+namespace {
+
+const uint32_t BINARY_MAGIC = 0x47504D53;  // "SMPG" in little endian.
+const uint32_t BINARY_VERSION = 1;
+
+bool endsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** \brief upper 3x4 part of the pose in row-major order. **/
+void writePose(BinaryWriter& writer, const Eigen::Matrix4d& pose) {
+  for (uint32_t i = 0; i < 3; ++i)
+    for (uint32_t j = 0; j < 4; ++j) writer.write<double>(pose(i, j));
+}
+
+/** \brief upper triangle of the symmetric information matrix in row-major order. **/
+void writeInformation(BinaryWriter& writer, const Posegraph::Matrix6d& information) {
+  for (uint32_t i = 0; i < 6; ++i)
+    for (uint32_t j = i; j < 6; ++j) writer.write<double>(information(i, j));
+}
+
+Eigen::Matrix4d readPose(BinaryReader& reader) {
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  for (uint32_t i = 0; i < 3; ++i)
+    for (uint32_t j = 0; j < 4; ++j) pose(i, j) = reader.read<double>();
+
+  return pose;
+}
+
+Posegraph::Matrix6d readInformation(BinaryReader& reader) {
+  Posegraph::Matrix6d information;
+  for (uint32_t i = 0; i < 6; ++i) {
+    for (uint32_t j = i; j < 6; ++j) {
+      information(i, j) = information(j, i) = reader.read<double>();
+    }
+  }
+
+  return information;
+}
+
+/** \brief swap rotation and translation blocks, i.e., convert between gtsam's and g2o's tangent space order. **/
+Posegraph::Matrix6d swapBlocks(const Posegraph::Matrix6d& information) {
+  Posegraph::Matrix6d swapped;
+  swapped.block<3, 3>(0, 0) = information.block<3, 3>(3, 3);
+  swapped.block<3, 3>(0, 3) = information.block<3, 3>(3, 0);
+  swapped.block<3, 3>(3, 0) = information.block<3, 3>(0, 3);
+  swapped.block<3, 3>(3, 3) = information.block<3, 3>(0, 0);
+
+  return swapped;
+}
+
+void writeQuat(std::ostream& out, const Eigen::Matrix4d& pose) {
+  Eigen::Quaterniond q(Eigen::Matrix3d(pose.block<3, 3>(0, 0)));
+  out << pose(0, 3) << " " << pose(1, 3) << " " << pose(2, 3) << " ";
+  out << q.x() << " " << q.y() << " " << q.z() << " " << q.w();
+}
+
+Eigen::Matrix4d readQuat(std::istream& in) {
+  double x, y, z, qx, qy, qz, qw;
+  in >> x >> y >> z >> qx >> qy >> qz >> qw;
+
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  pose.block<3, 3>(0, 0) = Eigen::Quaterniond(qw, qx, qy, qz).normalized().toRotationMatrix();
+  pose.block<3, 1>(0, 3) = Eigen::Vector3d(x, y, z);
+
+  return pose;
+}
+}
+
+void Posegraph::save(const std::string& filename) const {
+  if (endsWith(filename, ".g2o"))
+    saveG2o(filename);
+  else if (endsWith(filename, ".graph"))
+    saveToro(filename);
+  else
+    saveBinary(filename);
+}
+
+void Posegraph::load(const std::string& filename) {
+  if (endsWith(filename, ".g2o"))
+    loadG2o(filename);
+  else
+    loadBinary(filename);
+}
+
+void Posegraph::serialize(std::vector<char>& buffer) const {
+  BinaryWriter writer;
+  writer.buffer.reserve(5 * sizeof(uint32_t) + result_.size() * (sizeof(int32_t) + 24 * sizeof(double)) +
+                        edges_.size() * (2 * sizeof(int32_t) + 33 * sizeof(double)));
+  serialize(writer, nullptr);
+
+  buffer.swap(writer.buffer);
+}
+
+void Posegraph::serialize(std::ostream& out) const {
+  BinaryWriter writer;
+  serialize(writer, &out);
+}
+
+void Posegraph::serialize(BinaryWriter& writer, std::ostream* out) const {
+  // moves the written bytes to the stream, if any; otherwise, the complete graph is collected in the writer.
+  auto flush = [&writer, out]() {
+    if (out == nullptr) return;
+    out->write(writer.buffer.data(), writer.buffer.size());
+    writer.buffer.clear();
+  };
+
+  // header: magic, version, prior id, number of nodes and edges; afterwards nodes and edges.
+  writer.write<uint32_t>(BINARY_MAGIC);
+  writer.write<uint32_t>(BINARY_VERSION);
+  writer.write<int32_t>(priorId_);
+  writer.write<uint32_t>(result_.size());
+  writer.write<uint32_t>(edges_.size());
+  flush();
+
+  for (const auto& pair : result_) {
+    writer.write<int32_t>(pair.key);
+    const Pose3& initial = initial_.exists(pair.key) ? initial_.at<Pose3>(pair.key) : pair.value.cast<Pose3>();
+    writePose(writer, initial.matrix());
+    writePose(writer, pair.value.cast<Pose3>().matrix());
+    flush();
+  }
+
+  for (const Edge& edge : edges_) {
+    writer.write<int32_t>(edge.from);
+    writer.write<int32_t>(edge.to);
+    writePose(writer, edge.measurement);
+    writeInformation(writer, edge.information);
+    flush();
+  }
+}
+
+void Posegraph::deserialize(const std::vector<char>& buffer) {
+  BinaryReader reader(buffer);
+  if (reader.read<uint32_t>() != BINARY_MAGIC) throw std::runtime_error("Posegraph: data is no posegraph.");
+  uint32_t version = reader.read<uint32_t>();
+  if (version != BINARY_VERSION) {
+    throw std::runtime_error("Posegraph: unsupported version " + std::to_string(version) + ".");
+  }
+
+  int32_t priorId = reader.read<int32_t>();
+  uint32_t num_nodes = reader.read<uint32_t>();
+  uint32_t num_edges = reader.read<uint32_t>();
+  const uint64_t node_size = sizeof(int32_t) + 24 * sizeof(double);
+  const uint64_t edge_size = 2 * sizeof(int32_t) + 33 * sizeof(double);
+  if (num_nodes * node_size + num_edges * edge_size > reader.remaining()) {
+    throw std::runtime_error("Posegraph: data is truncated.");
+  }
+
+  std::vector<int32_t> ids(num_nodes);
+  std::vector<Eigen::Matrix4d> initial(num_nodes), result(num_nodes);
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    ids[i] = reader.read<int32_t>();
+    initial[i] = readPose(reader);
+    result[i] = readPose(reader);
+  }
+
+  std::vector<Edge> edges;
+  edges.reserve(num_edges);
+  for (uint32_t i = 0; i < num_edges; ++i) {
+    int32_t from = reader.read<int32_t>();
+    int32_t to = reader.read<int32_t>();
+    Eigen::Matrix4d measurement = readPose(reader);
+    Matrix6d information = readInformation(reader);
+
+    edges.push_back(Edge(from, to, measurement, information));
+  }
+
+  clear();
+
+  // the prior is added to the first initialized node.
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    if (ids[i] == priorId) setInitial(ids[i], initial[i]);
+  }
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    if (ids[i] != priorId) setInitial(ids[i], initial[i]);
+  }
+
+  for (const Edge& edge : edges) addEdge(edge.from, edge.to, edge.measurement, edge.information);
+
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    result_.update(ids[i], Pose3(result[i]));
+    if (isam_ != nullptr) newValues_.update(ids[i], Pose3(result[i]));  // continue from the stored result.
+  }
+}
+
+void Posegraph::saveBinary(const std::string& filename) const {
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out.is_open()) throw std::runtime_error("Posegraph: unable to open " + filename + " for writing.");
+
+  serialize(out);
+  if (!out.good()) throw std::runtime_error("Posegraph: unable to write " + filename + ".");
+}
+
+void Posegraph::loadBinary(const std::string& filename) {
+  std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (!in.is_open()) throw std::runtime_error("Posegraph: unable to open " + filename + ".");
+
+  std::vector<char> buffer(in.tellg());
+  in.seekg(0);
+  in.read(buffer.data(), buffer.size());
+  if (!in.good()) throw std::runtime_error("Posegraph: unable to read " + filename + ".");
+
+  deserialize(buffer);
+}
+
+void Posegraph::saveG2o(const std::string& filename) const {
+  std::ofstream out(filename.c_str());
+  if (!out.is_open()) throw std::runtime_error("Posegraph: unable to open " + filename + " for writing.");
+
+  out.precision(17);
+
+  for (const auto& pair : result_) {
+    out << "VERTEX_SE3:QUAT " << pair.key << " ";
+    writeQuat(out, pair.value.cast<Pose3>().matrix());
+    out << "\n";
+  }
+
+  if (priorId_ > -1) out << "FIX " << priorId_ << "\n";
+
+  for (const Edge& edge : edges_) {
+    out << "EDGE_SE3:QUAT " << edge.from << " " << edge.to << " ";
+    writeQuat(out, edge.measurement);
+
+    Matrix6d information = swapBlocks(edge.information);  // g2o: translation before rotation.
+    for (uint32_t i = 0; i < 6; ++i)
+      for (uint32_t j = i; j < 6; ++j) out << " " << information(i, j);
+    out << "\n";
+  }
+
+  if (!out.good()) throw std::runtime_error("Posegraph: unable to write " + filename + ".");
+}
+
+void Posegraph::loadG2o(const std::string& filename) {
+  std::ifstream in(filename.c_str());
+  if (!in.is_open()) throw std::runtime_error("Posegraph: unable to open " + filename + ".");
+
+  std::vector<int32_t> ids;
+  std::vector<Eigen::Matrix4d> poses;
+  std::vector<Edge> edges;
+  int32_t priorId = -1;
+
+  std::string line, tag;
+  while (std::getline(in, line)) {
+    std::istringstream str(line);
+    if (!(str >> tag)) continue;
+
+    if (tag == "VERTEX_SE3:QUAT") {
+      int32_t id;
+      str >> id;
+      ids.push_back(id);
+      poses.push_back(readQuat(str));
+    } else if (tag == "EDGE_SE3:QUAT") {
+      int32_t from, to;
+      str >> from >> to;
+      Eigen::Matrix4d measurement = readQuat(str);
+
+      Matrix6d information;
+      for (uint32_t i = 0; i < 6; ++i)
+        for (uint32_t j = i; j < 6; ++j) str >> information(i, j);
+      information.triangularView<Eigen::StrictlyLower>() = information.transpose();
+
+      edges.push_back(Edge(from, to, measurement, swapBlocks(information)));
+    } else if (tag == "FIX") {
+      str >> priorId;
+    }
+
+    if (str.fail()) throw std::runtime_error("Posegraph: invalid line '" + line + "' in " + filename + ".");
+  }
+
+  if (priorId == -1 && !ids.empty()) priorId = *std::min_element(ids.begin(), ids.end());
+
+  clear();
+
+  for (uint32_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] == priorId) setInitial(ids[i], poses[i]);
+  }
+  for (uint32_t i = 0; i < ids.size(); ++i) {
+    if (ids[i] != priorId) setInitial(ids[i], poses[i]);
+  }
+
+  for (const Edge& edge : edges) addEdge(edge.from, edge.to, edge.measurement, edge.information);
+}
+
+void Posegraph::saveToro(const std::string& filename) const {
+  std::ofstream out(filename.c_str());
+  if (!out.is_open()) throw std::runtime_error("Posegraph: unable to open " + filename + " for writing.");
+
+  out.precision(17);
+
+  auto writePose = [&out](const Pose3& pose) {
+    gtsam::Vector3 rpy = pose.rotation().rpy();
+    out << pose.x() << " " << pose.y() << " " << pose.z() << " " << rpy(0) << " " << rpy(1) << " " << rpy(2);
+  };
+
+  for (const auto& pair : result_) {
+    out << "VERTEX3 " << pair.key << " ";
+    writePose(pair.value.cast<Pose3>());
+    out << "\n";
+  }
+
+  for (const Edge& edge : edges_) {
+    out << "EDGE3 " << edge.from << " " << edge.to << " ";
+    writePose(Pose3(edge.measurement));
+
+    // TORO: x, y, z, roll, pitch, yaw.
+    Matrix6d information = swapBlocks(edge.information);
+    for (uint32_t i = 0; i < 6; ++i)
+      for (uint32_t j = i; j < 6; ++j) out << " " << information(i, j);
+    out << "\n";
+  }
+
+  if (!out.good()) throw std::runtime_error("Posegraph: unable to write " + filename + ".");
+}
 
 void Posegraph::setMEstimator(const gtsam::noiseModel::mEstimator::Base::shared_ptr& m_estimator) {
   robustify_ = (m_estimator != nullptr);
@@ -2,8 +2,13 @@
 #define SRC_CORE_POSEGRAPH_H_
 
 #include <gtsam/linear/NoiseModel.h>
+#include <gtsam/nonlinear/ISAM2.h>
 #include <gtsam/nonlinear/NonlinearFactorGraph.h>
 
+#include <iosfwd>
+
+class BinaryWriter;
+
 class Posegraph {
  public:
   typedef std::shared_ptr<Posegraph> Ptr;
@@ -13,16 +18,36 @@ class Posegraph {
 
   class Edge {
    public:
-    Edge(int32_t from_, int32_t to_, const Eigen::Matrix4d& measurement_)
-        : from(from_), to(to_), measurement(measurement_) {}
+    Edge(int32_t from_, int32_t to_, const Eigen::Matrix4d& measurement_,
+         const Matrix6d& information_ = Matrix6d::Identity())
+        : from(from_), to(to_), measurement(measurement_), information(information_) {}
     int32_t from, to;
     Eigen::Matrix4d measurement;
+    Matrix6d information;  // tangent space order of gtsam, i.e., rotation before translation.
   };
 
   Posegraph();
 
+  /** \brief deep copy of the graph including the state of the incremental solver. **/
   Posegraph::Ptr clone() const;
 
+  /** \brief enable or disable incremental optimization with iSAM2.
+   *
+   *  In incremental mode, all factors and initial estimates added since the last optimization are passed to a
+   *  persistent iSAM2 solver, which only relinearizes the affected parts of the Bayes tree. Thus, the cost
+   *  of an optimization is mostly independent of the size of the graph.
+   **/
+  void setIncremental(bool incremental);
+  bool isIncremental() const { return isam_ != nullptr; }
+
+  /** \brief move all changes since the last call into a new posegraph sharing the incremental solver.
+   *
+   *  Optimizing the returned posegraph integrates these changes into the shared solver and afterwards
+   *  provides the estimates of all nodes, i.e., it replaces the expensive clone of the complete graph.
+   *  The solver must not be used concurrently by multiple posegraphs.
+   **/
+  Posegraph::Ptr extractChanges();
+
   double error() const;
 
   void clear();
@@ -48,12 +73,35 @@ class Posegraph {
   /** \brief reinitialize model with initial estimates. **/
   void reinitialize();
 
-  /** \brief start optimization for given number of iterations. **/
+  /** \brief start optimization for given number of iterations.
+   *
+   *  In incremental mode, the pending changes are integrated with a single update followed by at most
+   *  num_iters - 1 updates as long as some variables still need relinearization.
+   **/
   bool optimize(uint32_t num_iters);
 
+  /** \brief save graph with initial estimates and (optimized) result.
+   *
+   *  The format is determined by the extension: ".g2o" for g2o (VERTEX_SE3:QUAT, EDGE_SE3:QUAT), ".graph" for
+   *  TORO (VERTEX3, EDGE3), and a compact versioned binary format otherwise. Throws on failure.
+   **/
   void save(const std::string& filename) const;
+
+  /** \brief replace graph by the graph stored in given file (binary or g2o format).
+   *
+   *  The graph is rebuilt from the stored nodes and edges; in g2o files, the initial estimate is also the result.
+   **/
   void load(const std::string& filename);
 
+  /** \brief write graph in the binary format of save() into the given buffer. **/
+  void serialize(std::vector<char>& buffer) const;
+
+  /** \brief write graph in the binary format of save() to the given stream, one node or edge at a time. **/
+  void serialize(std::ostream& out) const;
+
+  /** \brief replace graph by the graph serialized in the given buffer; throws on invalid data. **/
+  void deserialize(const std::vector<char>& buffer);
+
   /** \brief set m estimator. **/
   void setMEstimator(const gtsam::noiseModel::mEstimator::Base::shared_ptr& m_estimator);
 
@@ -64,11 +112,27 @@ class Posegraph {
   const std::vector<Edge>& getEdges() const { return edges_; }
 
  protected:
+  static std::shared_ptr<gtsam::ISAM2> createSolver();
+
+  /** \brief write the binary format with writer; the bytes are moved to out after each record, if out is given. **/
+  void serialize(BinaryWriter& writer, std::ostream* out) const;
+
+  void saveBinary(const std::string& filename) const;
+  void loadBinary(const std::string& filename);
+  void saveG2o(const std::string& filename) const;
+  void loadG2o(const std::string& filename);
+  void saveToro(const std::string& filename) const;
+
   std::vector<Edge> edges_;
+  int32_t priorId_{-1};  // node with prior, i.e., the first initialized node.
   gtsam::Values initial_;
   gtsam::Values result_;
   gtsam::NonlinearFactorGraph graph_;
 
+  std::shared_ptr<gtsam::ISAM2> isam_;  // only in incremental mode.
+  gtsam::NonlinearFactorGraph newFactors_;  // factors not yet passed to isam_.
+  gtsam::Values newValues_;                 // initial estimates not yet passed to isam_.
+
   bool robustify_{false};
   gtsam::noiseModel::mEstimator::Base::shared_ptr robustifier_;
 };
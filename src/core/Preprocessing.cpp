@@ -6,10 +6,14 @@
  */
 
 #include "core/Preprocessing.h"
+#include "core/GpuTimer.h"
 
 #include <glow/GlState.h>
 #include <glow/glutil.h>
 
+#include <stdexcept>
+#include <string>
+
 using namespace rv;
 using namespace glow;
 
@@ -23,7 +27,8 @@ Preprocessing::Preprocessing(const rv::ParameterList& params)
     : width_(params["data_width"]),
       height_(params["data_height"]),
       framebuffer_(width_, height_, FramebufferTarget::BOTH),
-      temp_vertices_(width_, height_, TextureFormat::RGBA_FLOAT) {
+      temp_vertices_(width_, height_, TextureFormat::RGBA_FLOAT),
+      cpu_(params) {
 
   depth_program_.attach(GlShader::fromCache(ShaderType::VERTEX_SHADER, "shader/gen_vertexmap.vert"));
   depth_program_.attach(GlShader::fromCache(ShaderType::FRAGMENT_SHADER, "shader/gen_vertexmap.frag"));
@@ -72,6 +77,16 @@ void Preprocessing::setParameters(const rv::ParameterList& params) {
     useFilteredVertexmap_ = params["use_filtered_vertexmap"];
   }
 
+  backend_ = Backend::OPENGL;
+  if (params.hasParam("preprocessing_backend")) {
+    std::string backend = std::string(params["preprocessing_backend"]);
+    if (backend == "cpu")
+      backend_ = Backend::CPU;
+    else if (backend != "opengl")
+      throw std::runtime_error("Preprocessing: unknown preprocessing_backend '" + backend + "'.");
+  }
+  cpu_.setParameters(params);
+
   fov_up = std::abs(fov_up);
   fov_down = std::abs(fov_down);
 
@@ -89,10 +104,12 @@ void Preprocessing::setParameters(const rv::ParameterList& params) {
 }
 
 /** \brief pre-process the point cloud (validity map, vertex map, normal map, ... etc.) and store results in frame. **/
-void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
+void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame, bool finish) {
   CheckGlError();
 
   frame.points.assign(points);
+  frame.vertex_data.clear();  // host-side images are only provided by the CPU backend.
+  frame.normal_data.clear();
 
   GLboolean depthTest;
   GLint ov[4], depthFunc, old_fbo;
@@ -137,17 +154,19 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
   glClearColor(0, 0, 0, 0);
   glViewport(0, 0, width_, height_);
 
+  GpuTimer::begin(GpuTimer::VERTEX_MAP);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // reset depth/vertexmap
 
   vao_points_.bind();
   depth_program_.bind();
 
   glDrawArrays(GL_POINTS, 0, points.size());
+  GpuTimer::end(GpuTimer::VERTEX_MAP);
 
   depth_program_.release();
   vao_points_.release();
   framebuffer_.release();
-  glFinish();
+  if (finish) glFinish();
 
   if (avgVertexmap_) {
     glDisable(GL_BLEND);
@@ -160,8 +179,10 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
     glActiveTexture(GL_TEXTURE0);
     temp_vertices_.bind();
 
+    GpuTimer::begin(GpuTimer::AVERAGE_VERTEX_MAP);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glDrawArrays(GL_POINTS, 0, 1);
+    GpuTimer::end(GpuTimer::AVERAGE_VERTEX_MAP);
 
     temp_vertices_.release();
 
@@ -184,8 +205,10 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
 
     bilateral_program_.bind();
 
+    GpuTimer::begin(GpuTimer::BILATERAL_FILTER);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glDrawArrays(GL_POINTS, 0, 1);
+    GpuTimer::end(GpuTimer::BILATERAL_FILTER);
 
     vao_no_points_.release();
     bilateral_program_.release();
@@ -211,8 +234,10 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
   vao_no_points_.bind();
   normal_program_.bind();
 
+  GpuTimer::begin(GpuTimer::NORMAL_MAP);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // reset depth/normalmap
   glDrawArrays(GL_POINTS, 0, 1);
+  GpuTimer::end(GpuTimer::NORMAL_MAP);
 
   normal_program_.release();
   vao_no_points_.release();
@@ -226,7 +251,7 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
 
   framebuffer_.release();
 
-  glFinish();
+  if (finish) glFinish();
 
   frame.valid = true;
 
@@ -243,3 +268,25 @@ void Preprocessing::process(glow::GlBuffer<rv::Point3f>& points, Frame& frame) {
 
   CheckGlError();
 }
+
+// -- CPU-based preprocessing:
+
+void Preprocessing::process(const rv::Point3f* points, uint32_t num_points, Frame& frame) {
+  processHost(points, num_points, frame);
+  upload(points, num_points, frame);
+}
+
+void Preprocessing::processHost(const rv::Point3f* points, uint32_t num_points, Frame& frame) {
+  cpu_.process(points, num_points, frame.vertex_data, frame.normal_data);
+}
+
+void Preprocessing::upload(const rv::Point3f* points, uint32_t num_points, Frame& frame) {
+  frame.points.resize(num_points);
+  if (num_points > 0) frame.points.replace(0, points, num_points);
+  frame.vertex_map.assign(PixelFormat::RGBA, PixelType::FLOAT, &frame.vertex_data[0]);
+  frame.normal_map.assign(PixelFormat::RGBA, PixelType::FLOAT, &frame.normal_data[0]);
+
+  frame.valid = true;
+
+  CheckGlError();
+}
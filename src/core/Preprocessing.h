@@ -11,6 +11,7 @@
 #include <vector>
 #include <rv/geometry.h>
 
+#include "core/CpuPreprocessing.h"
 #include "core/Frame.h"
 
 /** \brief Preprocessing of the data.
@@ -36,17 +37,36 @@
  *  The vertex map and normal map store in the fourth coordinate if the point is valid. If the vertex or
  *  normal is valid, the fourth coordinate is 1; otherwise 0.
  *
+ *  With parameter preprocessing_backend = "cpu", the vertex map and normal map are computed by the CpuPreprocessing
+ *  and afterwards uploaded to the textures of the frame. The host-side images are then also available in the frame.
+ *
  *  \author behley
  **/
 
 class Preprocessing {
  public:
+  enum class Backend { OPENGL, CPU };
+
   Preprocessing(const rv::ParameterList& params);
 
   void setParameters(const rv::ParameterList& params);
 
-  /** \brief pre-process the point cloud (vertex map, normal map, ... etc.) and store results in frame. **/
-  void process(glow::GlBuffer<rv::Point3f>& points, Frame& frame);
+  /** \brief pre-process the point cloud (vertex map, normal map, ... etc.) and store results in frame.
+   *  Without finish, the commands are only issued and the caller has to synchronize, e.g., with a fence. **/
+  void process(glow::GlBuffer<rv::Point3f>& points, Frame& frame, bool finish = true);
+
+  /** \brief pre-process the point cloud on the CPU; also fills the host-side vertex map and normal map. The points
+   *  are only read, i.e., they can directly point into a memory-mapped scan. **/
+  void process(const rv::Point3f* points, uint32_t num_points, Frame& frame);
+
+  /** \brief only compute the host-side vertex map and normal map on the CPU without any OpenGL call, i.e., this
+   *  can run in another thread. Afterwards, upload() must be called from the thread owning the context. **/
+  void processHost(const rv::Point3f* points, uint32_t num_points, Frame& frame);
+
+  /** \brief upload points and host-side vertex map and normal map computed by processHost() to the frame. **/
+  void upload(const rv::Point3f* points, uint32_t num_points, Frame& frame);
+
+  Backend backend() const { return backend_; }
 
  protected:
   uint32_t width_, height_;
@@ -61,6 +81,9 @@ class Preprocessing {
   bool filterVertexmap_{false};
   bool useFilteredVertexmap_{true};
   bool avgVertexmap_{false};
+
+  Backend backend_{Backend::OPENGL};
+  CpuPreprocessing cpu_;
 };
 
 #endif /* SRC_CORE_PREPROCESSING_H_ */
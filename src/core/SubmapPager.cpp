@@ -0,0 +1,398 @@
+#include "core/SubmapPager.h"
+#include "core/SurfelPacking.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t WORDS_PER_SURFEL = sizeof(Surfel) / 4;
+static_assert(sizeof(Surfel) % 4 == 0, "Surfel must consist of 32-bit fields.");
+
+std::vector<char> deflate(const void* data, uint64_t size) {
+  uLongf compressed_size = compressBound(size);
+  std::vector<char> compressed(compressed_size);
+  if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size, reinterpret_cast<const Bytef*>(data),
+                size, 1) != Z_OK) {
+    throw std::runtime_error("SubmapPager: compression failed.");
+  }
+  compressed.resize(compressed_size);
+
+  return compressed;
+}
+
+void inflate(const std::vector<char>& compressed, void* data, uint64_t size) {
+  uLongf uncompressed_size = size;
+  if (uncompress(reinterpret_cast<Bytef*>(data), &uncompressed_size,
+                 reinterpret_cast<const Bytef*>(compressed.data()), compressed.size()) != Z_OK ||
+      uncompressed_size != size) {
+    throw std::runtime_error("SubmapPager: decompression failed.");
+  }
+}
+
+/** \brief reorder bytes of all 32-bit words into 4 byte planes and compress them. **/
+std::vector<char> compress(const std::vector<Surfel>& surfels) {
+  const uint64_t num_words = surfels.size() * WORDS_PER_SURFEL;
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(surfels.data());
+
+  std::vector<unsigned char> planes(4 * num_words);
+  for (uint64_t w = 0; w < num_words; ++w) {
+    for (uint32_t b = 0; b < 4; ++b) planes[b * num_words + w] = bytes[4 * w + b];
+  }
+
+  return deflate(planes.data(), planes.size());
+}
+
+void decompress(const std::vector<char>& compressed, std::vector<Surfel>& surfels) {
+  const uint64_t num_words = surfels.size() * WORDS_PER_SURFEL;
+
+  std::vector<unsigned char> planes(4 * num_words);
+  inflate(compressed, planes.data(), planes.size());
+
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(surfels.data());
+  for (uint64_t w = 0; w < num_words; ++w) {
+    for (uint32_t b = 0; b < 4; ++b) bytes[4 * w + b] = planes[b * num_words + w];
+  }
+}
+}
+
+SubmapPager::~SubmapPager() {
+  for (auto& prefetch : prefetches_) {
+    if (prefetch.second.valid()) prefetch.second.wait();
+  }
+  if (fd_ >= 0) ::close(fd_);
+}
+
+void SubmapPager::setBudget(uint64_t bytes) {
+  budget_ = bytes;
+  evict();
+}
+
+void SubmapPager::setDirectory(const std::string& directory) {
+  directory_ = directory;
+}
+
+void SubmapPager::put(const Index& idx, std::vector<Surfel>& surfels) {
+  uint64_t k = key(idx);
+  prefetches_.erase(k);  // outdated content.
+
+  auto it = entries_.find(k);
+  if (it == entries_.end()) {
+    it = entries_.insert(std::make_pair(k, Entry())).first;
+    lru_.push_front(k);
+    it->second.lru = lru_.begin();
+  } else if (it->second.resident) {
+    stats_.residentBytes -= it->second.content.bytes();
+    touch(it->second);
+  } else {
+    lru_.push_front(k);
+    it->second.lru = lru_.begin();
+  }
+
+  Entry& entry = it->second;
+  if (!entry.dirty) liveBytes_ -= entry.size;  // the spilled content is outdated.
+  entry.content = Content();
+  entry.compact = compact_;
+  if (compact_) {
+    SurfelPacking::pack(surfels.data(), surfels.size(), entry.content.packed);
+    surfels.clear();
+  } else {
+    entry.content.surfels.swap(surfels);
+  }
+  entry.resident = true;
+  entry.dirty = true;
+  stats_.residentBytes += entry.content.bytes();
+
+  evict();
+}
+
+bool SubmapPager::get(const Index& idx, std::vector<Surfel>& surfels) {
+  uint64_t k = key(idx);
+  auto it = entries_.find(k);
+  if (it == entries_.end()) return false;
+
+  Entry& entry = it->second;
+  if (entry.resident) {
+    stats_.hits += 1;
+    touch(entry);
+  } else {
+    if (prefetches_.find(k) != prefetches_.end())
+      stats_.prefetchHits += 1;
+    else
+      stats_.misses += 1;
+    load(k, entry);
+  }
+
+  append(entry.content, surfels);
+  evict();
+
+  return true;
+}
+
+bool SubmapPager::peek(const Index& idx, std::vector<Surfel>& surfels) const {
+  auto it = entries_.find(key(idx));
+  if (it == entries_.end()) return false;
+
+  const Entry& entry = it->second;
+  if (entry.resident)
+    append(entry.content, surfels);
+  else
+    append(read(fd_, entry.offset, entry.size, entry.rawSize, entry.compact), surfels);
+
+  return true;
+}
+
+bool SubmapPager::snapshot(const Index& idx, Snapshot& snapshot) const {
+  auto it = entries_.find(key(idx));
+  if (it == entries_.end()) return false;
+
+  const Entry& entry = it->second;
+  snapshot.index = idx;
+  snapshot.compact = entry.compact;
+  snapshot.spilled = !entry.resident;
+  if (entry.resident) {
+    snapshot.surfels = entry.content.surfels;
+    snapshot.bytes = entry.content.packed;
+    snapshot.rawSize = 0;
+  } else {
+    snapshot.surfels.clear();
+    snapshot.bytes = readBytes(fd_, entry.offset, entry.size);
+    snapshot.rawSize = entry.rawSize;
+  }
+
+  return true;
+}
+
+void SubmapPager::restore(const Snapshot& snapshot) {
+  if (!snapshot.spilled) {
+    std::vector<Surfel> surfels = snapshot.surfels;
+    if (!snapshot.bytes.empty()) SurfelPacking::unpack(snapshot.bytes.data(), snapshot.bytes.size(), surfels);
+    put(snapshot.index, surfels);
+    return;
+  }
+
+  uint64_t k = key(snapshot.index);
+  prefetches_.erase(k);
+
+  auto it = entries_.find(k);
+  if (it != entries_.end()) {
+    if (it->second.resident) {
+      stats_.residentBytes -= it->second.content.bytes();
+      lru_.erase(it->second.lru);
+    }
+    if (!it->second.dirty) liveBytes_ -= it->second.size;
+    entries_.erase(it);
+  }
+
+  uint64_t offset = write(snapshot.bytes);
+
+  Entry& entry = entries_[k];
+  entry.compact = snapshot.compact;
+  entry.resident = false;
+  entry.dirty = false;
+  entry.offset = offset;
+  entry.size = snapshot.bytes.size();
+  entry.rawSize = snapshot.rawSize;
+  entry.lru = lru_.end();
+  liveBytes_ += entry.size;
+}
+
+void SubmapPager::decode(const Snapshot& snapshot, std::vector<Surfel>& surfels) {
+  if (snapshot.spilled) {
+    append(inflateContent(snapshot.bytes, snapshot.rawSize, snapshot.compact), surfels);
+  } else {
+    surfels.insert(surfels.end(), snapshot.surfels.begin(), snapshot.surfels.end());
+    if (!snapshot.bytes.empty()) SurfelPacking::unpack(snapshot.bytes.data(), snapshot.bytes.size(), surfels);
+  }
+}
+
+void SubmapPager::prefetch(const Index& idx) {
+  uint64_t k = key(idx);
+  auto it = entries_.find(k);
+  if (it == entries_.end() || it->second.resident || prefetches_.find(k) != prefetches_.end()) return;
+
+  // spilled content is never overwritten, i.e., reading concurrently to further spilling is safe.
+  const Entry& entry = it->second;
+  prefetches_[k] =
+      std::async(std::launch::async, &SubmapPager::read, fd_, entry.offset, entry.size, entry.rawSize, entry.compact);
+}
+
+bool SubmapPager::contains(const Index& idx) const {
+  return entries_.find(key(idx)) != entries_.end();
+}
+
+std::vector<SubmapPager::Index> SubmapPager::indexes() const {
+  std::vector<Index> result;
+  result.reserve(entries_.size());
+  for (const auto& entry : entries_) result.push_back(index(entry.first));
+
+  return result;
+}
+
+void SubmapPager::clear() {
+  for (auto& prefetch : prefetches_) {
+    if (prefetch.second.valid()) prefetch.second.wait();
+  }
+  prefetches_.clear();
+
+  entries_.clear();
+  lru_.clear();
+  stats_.residentBytes = 0;
+  liveBytes_ = 0;
+
+  if (fd_ >= 0 && ftruncate(fd_, 0) != 0) throw std::runtime_error("SubmapPager: unable to truncate spill file.");
+  fileSize_ = 0;
+}
+
+SubmapPager::Content SubmapPager::read(int fd, uint64_t offset, uint64_t size, uint64_t rawSize, bool compact) {
+  return inflateContent(readBytes(fd, offset, size), rawSize, compact);
+}
+
+std::vector<char> SubmapPager::readBytes(int fd, uint64_t offset, uint64_t size) {
+  std::vector<char> bytes(size);
+  uint64_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, bytes.data() + done, size - done, offset + done);
+    if (n <= 0) throw std::runtime_error("SubmapPager: unable to read spill file.");
+    done += n;
+  }
+
+  return bytes;
+}
+
+SubmapPager::Content SubmapPager::inflateContent(const std::vector<char>& compressed, uint64_t rawSize,
+                                                 bool compact) {
+  Content content;
+  if (compact) {
+    content.packed.resize(rawSize);
+    if (rawSize > 0) inflate(compressed, content.packed.data(), rawSize);
+  } else {
+    content.surfels.resize(rawSize / sizeof(Surfel));
+    if (rawSize > 0) decompress(compressed, content.surfels);
+  }
+
+  return content;
+}
+
+void SubmapPager::append(const Content& content, std::vector<Surfel>& surfels) {
+  surfels.insert(surfels.end(), content.surfels.begin(), content.surfels.end());
+  if (!content.packed.empty()) SurfelPacking::unpack(content.packed.data(), content.packed.size(), surfels);
+}
+
+void SubmapPager::load(uint64_t k, Entry& entry) {
+  auto prefetch = prefetches_.find(k);
+  if (prefetch != prefetches_.end()) {
+    entry.content = prefetch->second.get();
+    prefetches_.erase(prefetch);
+  } else {
+    entry.content = read(fd_, entry.offset, entry.size, entry.rawSize, entry.compact);
+  }
+
+  entry.resident = true;
+  entry.dirty = false;  // still valid on disk.
+  stats_.residentBytes += entry.content.bytes();
+
+  lru_.push_front(k);
+  entry.lru = lru_.begin();
+}
+
+void SubmapPager::evict() {
+  if (budget_ == 0) return;
+
+  // the most recently used submap always stays in memory.
+  while (stats_.residentBytes > budget_ && lru_.size() > 1) {
+    spill(entries_[lru_.back()]);
+  }
+}
+
+void SubmapPager::spill(Entry& entry) {
+  if (entry.dirty) {
+    const Content& content = entry.content;
+    std::vector<char> compressed =
+        entry.compact ? deflate(content.packed.data(), content.packed.size()) : compress(content.surfels);
+
+    // append only: a running prefetch might still read the previous content.
+    entry.offset = write(compressed);
+    entry.size = compressed.size();
+    entry.rawSize = content.bytes();
+    liveBytes_ += entry.size;
+
+    stats_.spilledSubmaps += 1;
+    stats_.spilledBytes += compressed.size();
+  }
+
+  stats_.residentBytes -= entry.content.bytes();
+  entry.content = Content();  // release memory.
+  entry.resident = false;
+  entry.dirty = false;
+
+  lru_.erase(entry.lru);
+  entry.lru = lru_.end();
+}
+
+uint64_t SubmapPager::write(const std::vector<char>& bytes) {
+  if (fd_ < 0) openFile();
+  compactFile();
+
+  uint64_t done = 0;
+  while (done < bytes.size()) {
+    ssize_t n = pwrite(fd_, bytes.data() + done, bytes.size() - done, fileSize_ + done);
+    if (n <= 0) throw std::runtime_error("SubmapPager: unable to write spill file.");
+    done += n;
+  }
+
+  uint64_t offset = fileSize_;
+  fileSize_ += bytes.size();
+
+  return offset;
+}
+
+void SubmapPager::compactFile() {
+  if (fileSize_ < minCompactionSize_ || fileSize_ < 2 * liveBytes_) return;
+
+  // running prefetches still read from the old file.
+  for (auto& prefetch : prefetches_) {
+    if (prefetch.second.valid()) prefetch.second.wait();
+  }
+
+  int old_fd = fd_;
+  openFile();
+
+  for (auto& it : entries_) {
+    Entry& entry = it.second;
+    if (entry.dirty) continue;  // no valid content on disk.
+
+    std::vector<char> bytes = readBytes(old_fd, entry.offset, entry.size);
+    uint64_t done = 0;
+    while (done < bytes.size()) {
+      ssize_t n = pwrite(fd_, bytes.data() + done, bytes.size() - done, fileSize_ + done);
+      if (n <= 0) throw std::runtime_error("SubmapPager: unable to write spill file.");
+      done += n;
+    }
+    entry.offset = fileSize_;
+    fileSize_ += bytes.size();
+  }
+
+  ::close(old_fd);
+  stats_.compactions += 1;
+}
+
+void SubmapPager::touch(Entry& entry) {
+  lru_.splice(lru_.begin(), lru_, entry.lru);
+}
+
+void SubmapPager::openFile() {
+  std::string filename = directory_ + "/suma_submaps_XXXXXX";
+  std::vector<char> name(filename.begin(), filename.end());
+  name.push_back('\0');
+
+  fd_ = mkstemp(name.data());
+  if (fd_ < 0) throw std::runtime_error("SubmapPager: unable to create spill file in " + directory_ + ".");
+
+  unlink(name.data());  // removed as soon as the file is closed.
+  fileSize_ = 0;
+}
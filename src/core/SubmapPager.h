@@ -0,0 +1,177 @@
+#ifndef SRC_CORE_SUBMAPPAGER_H_
+#define SRC_CORE_SUBMAPPAGER_H_
+
+#include <stdint.h>
+#include <future>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Surfel.h"
+
+/** \brief storage of the inactive submaps with bounded host memory.
+ *
+ *  Submaps are kept in memory until the budget is exceeded. Then, the least recently used submaps are compressed
+ *  and spilled to a temporary file, which is removed when the pager is destroyed. A spilled submap is read again
+ *  when it is requested; with prefetch(), the reading and decompression happens asynchronously in advance.
+ *
+ *  The spill file is append-only, i.e., the previous content of a submap, which is spilled again after a change,
+ *  stays in the file. If such dead bytes make up more than half of the file, the valid content is rewritten into a
+ *  new file.
+ *
+ *  Before compression, the bytes of the 32-bit fields are reordered into byte planes, since neighboring surfels
+ *  mostly differ in the lower bytes. In compact mode, the submaps are stored with the lossy SurfelPacking in
+ *  memory and on disk.
+ *
+ *  \author behley
+ */
+class SubmapPager {
+ public:
+  typedef std::pair<int32_t, int32_t> Index;
+
+  struct Statistics {
+    uint64_t hits{0};           // requested submaps found in memory.
+    uint64_t prefetchHits{0};   // requested submaps found in a prefetch.
+    uint64_t misses{0};         // requested submaps read synchronously from disk.
+    uint64_t spilledSubmaps{0};
+    uint64_t spilledBytes{0};   // compressed bytes written to disk.
+    uint64_t compactions{0};    // rewrites of the spill file.
+    uint64_t residentBytes{0};  // bytes held in memory.
+
+    /** \brief fraction of requests without synchronous disk access. **/
+    float hitRate() const {
+      uint64_t total = hits + prefetchHits + misses;
+      return (total == 0) ? 1.0f : float(hits + prefetchHits) / float(total);
+    }
+  };
+
+  /** \brief stored form of a submap; spilled submaps stay compressed, i.e., they are copied without decoding. **/
+  struct Snapshot {
+    Index index;
+    bool compact{false};
+    bool spilled{false};
+    std::vector<Surfel> surfels;  // resident submap.
+    std::vector<char> bytes;      // resident compact submap (SurfelPacking) or compressed content of spilled submap.
+    uint64_t rawSize{0};          // uncompressed size of spilled content.
+  };
+
+  SubmapPager() = default;
+  ~SubmapPager();
+
+  SubmapPager(const SubmapPager&) = delete;
+  SubmapPager& operator=(const SubmapPager&) = delete;
+
+  /** \brief memory budget in bytes; 0 means no limit, i.e., nothing is spilled. **/
+  void setBudget(uint64_t bytes);
+
+  /** \brief store submaps added afterwards with SurfelPacking. **/
+  void setCompact(bool compact) { compact_ = compact; }
+
+  /** \brief spill files below this size are not compacted. **/
+  void setMinCompactionSize(uint64_t bytes) { minCompactionSize_ = bytes; }
+
+  /** \brief directory of the spill file; only used for files created afterwards. **/
+  void setDirectory(const std::string& directory);
+
+  /** \brief store surfels of given submap, which replaces any previous content; surfels are moved into the pager. **/
+  void put(const Index& idx, std::vector<Surfel>& surfels);
+
+  /** \brief append surfels of given submap and mark it as recently used; returns false for unknown submaps. **/
+  bool get(const Index& idx, std::vector<Surfel>& surfels);
+
+  /** \brief append surfels of given submap without changing the memory usage or statistics. **/
+  bool peek(const Index& idx, std::vector<Surfel>& surfels) const;
+
+  /** \brief copy stored form of given submap without decompression and without changing the statistics. **/
+  bool snapshot(const Index& idx, Snapshot& snapshot) const;
+
+  /** \brief store submap of a snapshot; compressed content is directly written to the spill file. **/
+  void restore(const Snapshot& snapshot);
+
+  /** \brief append surfels of the snapshot. **/
+  static void decode(const Snapshot& snapshot, std::vector<Surfel>& surfels);
+
+  /** \brief start asynchronous reading of a spilled submap; no effect for submaps in memory or unknown submaps. **/
+  void prefetch(const Index& idx);
+
+  /** \brief true, if submap is stored (either in memory or on disk). **/
+  bool contains(const Index& idx) const;
+
+  /** \brief indexes of all stored submaps. **/
+  std::vector<Index> indexes() const;
+
+  uint32_t size() const { return entries_.size(); }
+
+  /** \brief remove all submaps and truncate the spill file. **/
+  void clear();
+
+  const Statistics& statistics() const { return stats_; }
+
+ protected:
+  struct Content {
+    std::vector<Surfel> surfels;
+    std::vector<char> packed;  // used instead of surfels in compact mode.
+
+    uint64_t bytes() const { return surfels.size() * sizeof(Surfel) + packed.size(); }
+  };
+
+  struct Entry {
+    Content content;
+    bool compact{false};
+    bool resident{true};
+    bool dirty{true};  // content in memory differs from content on disk, i.e., the bytes on disk are dead.
+
+    uint64_t offset{0}, size{0}, rawSize{0};  // location and uncompressed size of the last spilled content.
+
+    std::list<uint64_t>::iterator lru;
+  };
+
+  static uint64_t key(const Index& idx) { return (uint64_t(uint32_t(idx.first)) << 32) | uint32_t(idx.second); }
+  static Index index(uint64_t key) { return Index(int32_t(key >> 32), int32_t(key & 0xFFFFFFFF)); }
+
+  /** \brief read and decompress spilled content. **/
+  static Content read(int fd, uint64_t offset, uint64_t size, uint64_t rawSize, bool compact);
+  static std::vector<char> readBytes(int fd, uint64_t offset, uint64_t size);
+  static Content inflateContent(const std::vector<char>& compressed, uint64_t rawSize, bool compact);
+
+  /** \brief append the surfels of the given content. **/
+  static void append(const Content& content, std::vector<Surfel>& surfels);
+
+  /** \brief make entry resident by reading it or by waiting for its prefetch. **/
+  void load(uint64_t k, Entry& entry);
+
+  /** \brief spill least recently used submaps until the budget is met. **/
+  void evict();
+  void spill(Entry& entry);
+
+  /** \brief append bytes to spill file and return their offset. **/
+  uint64_t write(const std::vector<char>& bytes);
+
+  /** \brief rewrite spill file with valid content only, if dead bytes dominate. **/
+  void compactFile();
+
+  /** \brief mark resident entry as most recently used. **/
+  void touch(Entry& entry);
+
+  void openFile();
+
+  uint64_t budget_{0};
+  bool compact_{false};
+  std::string directory_{"/tmp"};
+
+  std::unordered_map<uint64_t, Entry> entries_;
+  std::list<uint64_t> lru_;  // resident submaps; most recently used first.
+
+  std::unordered_map<uint64_t, std::future<Content>> prefetches_;
+
+  int fd_{-1};
+  uint64_t fileSize_{0};
+  uint64_t liveBytes_{0};  // bytes of the spill file, which are the current content of a submap.
+  uint64_t minCompactionSize_{64 * 1024 * 1024};
+
+  Statistics stats_;
+};
+
+#endif /* SRC_CORE_SUBMAPPAGER_H_ */
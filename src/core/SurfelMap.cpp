@@ -1,8 +1,12 @@
 #include "core/SurfelMap.h"
+#include "core/GpuTimer.h"
 #include <glow/GlState.h>
 #include <glow/ScopedBinder.h>
 #include <rv/Math.h>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace rv;
 using namespace glow;
 
@@ -40,7 +44,10 @@ SurfelMap::SurfelMap(const ParameterList& params)
       "sfl_position_radius", "sfl_normal_confidence", "sfl_timestamp", "sfl_color_weight_count",
   };
 
-  surfels_.reserve(maxNumSurfels_);
+  // initial capacity; all surfel buffers grow geometrically if needed.
+  if (params.hasParam("surfel-capacity")) surfelCapacity_ = params["surfel-capacity"];
+
+  surfels_.reserve(surfelCapacity_);
   copy_feedback_.attach(surfel_varyings, surfels_);
 
   // now we can set the vertex attributes. (the "shallow copy" of surfels now contains the correct id.
@@ -65,7 +72,7 @@ SurfelMap::SurfelMap(const ParameterList& params)
   vao_data_surfels_.setVertexAttribute(3, data_surfels_, 3, AttributeType::FLOAT, false, sizeof(Surfel),
                                        reinterpret_cast<GLvoid*>(offsetof(Surfel, color)));
 
-  updated_surfels_.reserve(maxNumSurfels_);
+  updated_surfels_.reserve(surfelCapacity_);
   update_feedback_.attach(surfel_varyings, updated_surfels_);
 
   vao_updated_surfels_.setVertexAttribute(0, updated_surfels_, 4, AttributeType::FLOAT, false, sizeof(Surfel),
@@ -258,6 +265,21 @@ SurfelMap::SurfelMap(const ParameterList& params)
   submap_dim_ = int32_t(params["submap-dimension"]);
   submap_size_ = 2 * submap_dim_ + 1;
 
+  // memory budget of the inactive submaps in MB; 0 = unlimited.
+  if (params.hasParam("submap-memory-budget")) {
+    submapCache_.setBudget(uint64_t(float(params["submap-memory-budget"]) * 1024 * 1024));
+  }
+  if (params.hasParam("submap-spill-directory")) {
+    submapCache_.setDirectory(std::string(params["submap-spill-directory"]));
+  }
+  // lossy, but less than half of the memory and disk space.
+  if (params.hasParam("submap-compact")) compact_ = params["submap-compact"];
+
+  if (params.hasParam("surfel-compaction-interval")) compactionInterval_ = params["surfel-compaction-interval"];
+  if (params.hasParam("surfel-compaction-confidence")) compactionConfidence_ = params["surfel-compaction-confidence"];
+  if (params.hasParam("surfel-compaction-age")) compactionAge_ = params["surfel-compaction-age"];
+  submapCache_.setCompact(compact_);
+
   partial_extraction_ = false;
   if (params.hasParam("partial-extraction")) {
     std::cout << "Extracting surfel maps partially." << std::endl;
@@ -267,8 +289,8 @@ SurfelMap::SurfelMap(const ParameterList& params)
   initializeSubmaps();
 
   // BEWARE: If too large, then the performance of the copy operation is really, really bad!
-  // I suppose this has something to do with the location of that buffer.
-  extractBuffer_.reserve(500000);
+  // I suppose this has something to do with the location of that buffer. Hence, it only grows if needed.
+  reserveSurfels(extractBuffer_, std::min<uint32_t>(500000, surfelCapacity_), false);
   extractFeedback_.attach(surfel_varyings, extractBuffer_);
   old_surfel_cache_.reserve(submap_size_ * extractBuffer_.capacity());
 
@@ -291,9 +313,7 @@ SurfelMap::SurfelMap(const ParameterList& params)
 
   drawSubmaps_.setUniform(GlUniform<float>("submap_extent", submap_extent_));
 
-  poses_.resize(maxPoses_);
-  std::fill(poses_.begin(), poses_.end(), Eigen::Matrix4f::Identity());
-  poseBuffer_.assign(poses_);
+  uploadPoses();
 
   glow::_CheckGlError(__FILE__, __LINE__);
 
@@ -303,6 +323,7 @@ SurfelMap::SurfelMap(const ParameterList& params)
 }
 
 void SurfelMap::setParameters(const rv::ParameterList& params) {
+  version_ += 1;  // uniforms of the rendering might change.
   // pixel size corresponds to the size of a surfel scaled by a distance, i.e., size of surfel at 1 meter in world
   // coordinates, ...
   float vfov = (std::abs(float(params["data_fov_up"])) + std::abs(float(params["data_fov_down"])));
@@ -416,6 +437,12 @@ void SurfelMap::setParameters(const rv::ParameterList& params) {
   //  }
 }
 
+SurfelMap::~SurfelMap() {
+  for (uint32_t slot = 0; slot < 2; ++slot) {
+    if (stagingFence_[slot] != 0) glDeleteSync(stagingFence_[slot]);
+  }
+}
+
 void SurfelMap::initializeSubmaps() {
   extraction_buffer_.clear();
   submap_origin_ = SubmapIndex();
@@ -431,30 +458,132 @@ void SurfelMap::initializeSubmaps() {
 }
 
 void SurfelMap::reset() {
+  version_ += 1;
   surfels_.resize(0);
+  mapFile_ = nullptr;
+  localization_ = false;
+  peakBytes_.clear();
 
   initializeSubmaps();  // re-initialize submaps.
 
   timestamp_ = 0;
-  poses_.resize(maxPoses_);
-  std::fill(poses_.begin(), poses_.end(), Eigen::Matrix4f::Identity());
-  poseBuffer_.assign(poses_);
+  poses_.reset(poses_.capacity());
+  uploadPoses();
 }
 
 /** \brief update the poses of the integrated scans (maybe, due to loop closure) **/
 void SurfelMap::updatePoses(const std::vector<Eigen::Matrix4f>& poses) {
-  for (uint32_t i = 0; i < poses.size(); ++i) {
-    poses_[i] = poses[i];  // replacing poses => memcpy?
+  version_ += 1;
+  poses_.update(poses);
+  uploadPoses();
+}
+
+void SurfelMap::reserveSurfels(GlBuffer<Surfel>& buffer, uint32_t count, bool preserve) {
+  if (count <= buffer.capacity()) return;
+
+  uint32_t capacity = std::max(count, 2 * buffer.capacity());
+  uint32_t size = buffer.size();
+
+  // reallocation discards the content; hence, a copy is kept in a temporary buffer.
+  GlBuffer<Surfel> copy(BufferTarget::ARRAY_BUFFER, BufferUsage::DYNAMIC_COPY);
+  if (preserve && size > 0) {
+    copy.resize(size);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, copy.id());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size * sizeof(Surfel));
+  }
+
+  buffer.reserve(capacity);
+  buffer.resize(size);
+
+  if (preserve && size > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, copy.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size * sizeof(Surfel));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+
+  CheckGlError();
+}
+
+std::vector<SurfelMap::MemoryUsage> SurfelMap::memoryUsage() const {
+  std::vector<MemoryUsage> usage(6);
+  usage[0].name = "surfels";
+  usage[0].allocatedBytes = uint64_t(surfels_.capacity()) * sizeof(Surfel);
+  usage[0].usedBytes = uint64_t(surfels_.size()) * sizeof(Surfel);
+  usage[1].name = "updated-surfels";
+  usage[1].allocatedBytes = uint64_t(updated_surfels_.capacity()) * sizeof(Surfel);
+  usage[1].usedBytes = uint64_t(updated_surfels_.size()) * sizeof(Surfel);
+  usage[2].name = "data-surfels";
+  usage[2].allocatedBytes = uint64_t(data_surfels_.capacity()) * sizeof(Surfel);
+  usage[2].usedBytes = uint64_t(data_surfels_.size()) * sizeof(Surfel);
+  usage[3].name = "extracted-surfels";
+  usage[3].allocatedBytes = uint64_t(extractBuffer_.capacity()) * sizeof(Surfel);
+  usage[3].usedBytes = uint64_t(extractBuffer_.size()) * sizeof(Surfel);
+  usage[4].name = "poses";
+  usage[4].allocatedBytes = uint64_t(poses_.capacity()) * sizeof(Eigen::Matrix4f);
+  usage[4].usedBytes = uint64_t(timestamp_) * sizeof(Eigen::Matrix4f);
+  usage[5].name = "checkpoint-staging";
+  for (uint32_t i = 0; i < 2; ++i) {
+    usage[5].allocatedBytes += uint64_t(staging_[i].capacity()) * sizeof(Surfel);
+    usage[5].usedBytes += uint64_t(staging_[i].size()) * sizeof(Surfel);
+  }
+
+  for (MemoryUsage& u : usage) {
+    auto it = peakBytes_.find(u.name);
+    u.peakBytes = std::max(u.usedBytes, (it == peakBytes_.end()) ? uint64_t(0) : it->second);
+  }
+
+  return usage;
+}
+
+void SurfelMap::updatePeakUsage() {
+  for (const MemoryUsage& u : memoryUsage()) peakBytes_[u.name] = u.peakBytes;
+}
+
+SurfelMap::RenderKey SurfelMap::renderKey(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& pose_new,
+                                          float confidence_threshold, RenderMode mode) const {
+  RenderKey key;
+  key.valid = true;
+  key.version = version_;
+  key.pose_old = pose_old;
+  key.pose_new = pose_new;
+  key.confidence_threshold = confidence_threshold;
+  key.mode = mode;
+
+  return key;
+}
+
+bool SurfelMap::cached(bool hit) {
+  if (hit)
+    renderStats_.hits += 1;
+  else
+    renderStats_.misses += 1;
+
+  return hit;
+}
+
+void SurfelMap::uploadPoses() {
+  if (poses_.resized()) {
+    poseBuffer_.assign(poses_.poses());
+  } else {
+    for (const PoseTable::Range& range : poses_.dirtyRanges()) {
+      poseBuffer_.replace(range.first, &poses_[range.first], range.second - range.first);
+    }
   }
-  poseBuffer_.assign(poses_);
+  poses_.clean();
 }
 
 void SurfelMap::update(const Eigen::Matrix4f& pose, Frame& frame) {
+  if (localization_) throw std::runtime_error("SurfelMap: map cannot be updated in localization mode.");
+  version_ += 1;
+
   //  std::cout << "entry: " << GlState::queryAll() << std::endl;
 
   // update pose buffer.
-  poses_[timestamp_] = pose;
-  poseBuffer_.insert(timestamp_, pose);
+  poses_.set(timestamp_, pose);
+  uploadPoses();
 
   Eigen::Matrix4f inv_pose = pose.inverse();
 
@@ -525,6 +654,7 @@ void SurfelMap::update(const Eigen::Matrix4f& pose, Frame& frame) {
   sampler_.release(5);
 
   timestamp_ += 1;
+  updatePeakUsage();
 
   // restore settings.
   glClearColor(cc[0], cc[1], cc[2], cc[3]);
@@ -546,8 +676,10 @@ void SurfelMap::renderIndexmap(const Eigen::Matrix4f& pose, Eigen::Matrix4f& inv
   indexMap_program_.setUniform(GlUniform<int32_t>("timestamp", timestamp_));
 
   vao_surfels_.bind();
+  GpuTimer::begin(GpuTimer::INDEX_MAP);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glDrawArrays(GL_POINTS, 0, surfels_.size());
+  GpuTimer::end(GpuTimer::INDEX_MAP);
   vao_surfels_.release();
 
   indexMap_program_.release();
@@ -561,8 +693,10 @@ void SurfelMap::generateDataSurfels(Frame& frame) {
   radiusConfidenceFramebuffer_.bind();
 
   vao_img_coords_.bind();
+  GpuTimer::begin(GpuTimer::SURFEL_UPDATE);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glDrawArrays(GL_POINTS, 0, vbo_img_coords_.size());
+  GpuTimer::end(GpuTimer::SURFEL_UPDATE);
   vao_img_coords_.release();
 
   radiusConfidenceFramebuffer_.release();
@@ -595,8 +729,13 @@ void SurfelMap::updateSurfels(const Eigen::Matrix4f& pose, Eigen::Matrix4f& inv_
   updateFramebuffer_.bind();
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  // every surfel is updated at most once; previous content is not needed.
+  reserveSurfels(updated_surfels_, surfels_.size(), false);
+
+  GpuTimer::begin(GpuTimer::SURFEL_UPDATE);
   update_feedback_.begin(TransformFeedbackMode::POINTS);
   glDrawArrays(GL_POINTS, 0, surfels_.size());
+  GpuTimer::end(GpuTimer::SURFEL_UPDATE);
   updated_surfels_.resize(update_feedback_.end());
 
   update_feedback_.release();
@@ -620,8 +759,10 @@ void SurfelMap::updateSurfels(const Eigen::Matrix4f& pose, Eigen::Matrix4f& inv_
 
   glEnable(GL_RASTERIZER_DISCARD);
 
+  GpuTimer::begin(GpuTimer::SURFEL_UPDATE);
   initialize_feedback_.begin(TransformFeedbackMode::POINTS);
   glDrawArrays(GL_POINTS, 0, vbo_img_coords_.size());
+  GpuTimer::end(GpuTimer::SURFEL_UPDATE);
   data_surfels_.resize(initialize_feedback_.end());
 
   vao_img_coords_.release();
@@ -641,6 +782,9 @@ void SurfelMap::updateSurfels(const Eigen::Matrix4f& pose, Eigen::Matrix4f& inv_
 }
 
 void SurfelMap::copySurfels() {
+  // surfels_ was already consumed by the update, i.e., only the capacity is needed.
+  reserveSurfels(surfels_, updated_surfels_.size() + data_surfels_.size(), false);
+
   // (4.) finally add old & new surfels.
   copy_feedback_.bind();
   copy_program_.bind();
@@ -654,6 +798,13 @@ void SurfelMap::copySurfels() {
 
   copy_program_.setUniform(GlUniform<float>("submap_extent", extent));
 
+  // periodic compaction removes unstable surfels, which were not confirmed for a long time.
+  bool compact = (compactionInterval_ > 0 && timestamp_ > 0 && timestamp_ % compactionInterval_ == 0);
+  copy_program_.setUniform(GlUniform<bool>("compact", compact));
+  copy_program_.setUniform(GlUniform<float>("compaction_confidence", compactionConfidence_));
+  copy_program_.setUniform(GlUniform<int32_t>("compaction_timestamp", int32_t(timestamp_) - int32_t(compactionAge_)));
+
+  GpuTimer::begin(GpuTimer::SURFEL_COPY);
   copy_feedback_.begin(TransformFeedbackMode::POINTS);
 
   // first, copy old updated and active map surfels...
@@ -665,6 +816,7 @@ void SurfelMap::copySurfels() {
   vao_data_surfels_.bind();
   glDrawArrays(GL_POINTS, 0, data_surfels_.size());
   vao_data_surfels_.release();
+  GpuTimer::end(GpuTimer::SURFEL_COPY);
 
   surfels_.resize(copy_feedback_.end());
   copy_program_.release();
@@ -696,19 +848,24 @@ void SurfelMap::extractSurfels(bool partially) {
     extractProgram_.setUniform(GlUniform<vec2>("submap_center", ctr));
     extractProgram_.setUniform(GlUniform<float>("submap_extent", submap_extent_));
 
-    extractFeedback_.begin(TransformFeedbackMode::POINTS);
-    glDrawArrays(GL_POINTS, 0, surfels_.size());
-    uint32_t extractedSize = extractFeedback_.end();
-
-    //    if (extractedSize == 0) continue;
-
-    if (extractedSize >= extractBuffer_.capacity())
-      std::cout << "Warning: potential lost of information!!!" << std::endl;
+    uint32_t extractedSize = 0;
+    while (true) {
+      GpuTimer::begin(GpuTimer::SURFEL_EXTRACT);
+      extractFeedback_.begin(TransformFeedbackMode::POINTS);
+      glDrawArrays(GL_POINTS, 0, surfels_.size());
+      GpuTimer::end(GpuTimer::SURFEL_EXTRACT);
+      extractedSize = extractFeedback_.end();
+
+      // the feedback stops at the capacity; thus, surfels might be lost and the submap is extracted again.
+      if (extractedSize < extractBuffer_.capacity()) break;
+      reserveSurfels(extractBuffer_, 2 * extractBuffer_.capacity(), false);
+    }
 
     extractBuffer_.resize(extractedSize);
 
-    SubmapCache& cachedSubmap = submapCache_[idx];
-    extractBuffer_.get(cachedSubmap.surfels);
+    std::vector<Surfel> surfels;
+    extractBuffer_.get(surfels);
+    submapCache_.put(pagerIndex(idx), surfels);
 
     if (partially) break;
   }
@@ -746,17 +903,11 @@ void SurfelMap::updateActiveSubmaps(const Eigen::Matrix4f& pose) {
       submap_origin_.i += dir;
 
       // (3) upload data in single chunk.
-      old_surfel_cache_.clear();
+      std::vector<SubmapIndex> indexes;
       for (int32_t c = -submap_dim_; c <= submap_dim_; ++c) {
-        SubmapIndex idx(submap_origin_.i + dir * submap_dim_, submap_origin_.j + c);
-        SubmapCache& cachedSubmap = submapCache_[idx];
-
-        old_surfel_cache_.insert(old_surfel_cache_.end(), cachedSubmap.surfels.begin(), cachedSubmap.surfels.end());
+        indexes.push_back(SubmapIndex(submap_origin_.i + dir * submap_dim_, submap_origin_.j + c));
       }
-
-      uint32_t old_size = surfels_.size();
-      surfels_.resize(surfels_.size() + old_surfel_cache_.size());
-      surfels_.replace(old_size, old_surfel_cache_);
+      appendActiveSubmaps(indexes);
     }
 
     if (std::abs(changey) > factor * submap_extent_) {
@@ -772,34 +923,328 @@ void SurfelMap::updateActiveSubmaps(const Eigen::Matrix4f& pose) {
       submap_origin_.j += dir;
 
       // (3) upload data in single chunk.
-      old_surfel_cache_.clear();
+      std::vector<SubmapIndex> indexes;
       for (int32_t r = -submap_dim_; r <= submap_dim_; ++r) {
-        SubmapIndex idx(submap_origin_.i + r, submap_origin_.j + dir * submap_dim_);
-        SubmapCache& cachedSubmap = submapCache_[idx];
-
-        old_surfel_cache_.insert(old_surfel_cache_.end(), cachedSubmap.surfels.begin(), cachedSubmap.surfels.end());
+        indexes.push_back(SubmapIndex(submap_origin_.i + r, submap_origin_.j + dir * submap_dim_));
       }
+      appendActiveSubmaps(indexes);
+    }
+
+    updateSubmapCenters();
+
+    if (!GpuTimer::enabled()) glFinish();  // the GPU timer measures without synchronization.
+  }
+
+  prefetchSubmaps(pose);
+
+  if (!extraction_buffer_.empty()) extractSurfels(partial_extraction_);
+}
+
+void SurfelMap::prefetchSubmaps(const Eigen::Matrix4f& pose) {
+  // submaps become active if the vehicle continues towards the border of the active area.
+  vec2 submap_center = submapIndex2center(submap_origin_);
+  float changex = pose(0, 3) - submap_center.x;
+  float changey = pose(1, 3) - submap_center.y;
+  float factor = 0.5;
+
+  std::vector<SubmapIndex> indexes;
+  if (std::abs(changex) > factor * submap_extent_) {
+    int32_t dir = direction(changex);
+    for (int32_t c = -submap_dim_; c <= submap_dim_; ++c) {
+      indexes.push_back(SubmapIndex(submap_origin_.i + dir * (submap_dim_ + 1), submap_origin_.j + c));
+    }
+  }
+
+  if (std::abs(changey) > factor * submap_extent_) {
+    int32_t dir = direction(changey);
+    for (int32_t r = -submap_dim_; r <= submap_dim_; ++r) {
+      indexes.push_back(SubmapIndex(submap_origin_.i + r, submap_origin_.j + dir * (submap_dim_ + 1)));
+    }
+  }
+
+  for (const SubmapIndex& idx : indexes) {
+    if (submapCache_.contains(pagerIndex(idx)))
+      submapCache_.prefetch(pagerIndex(idx));
+    else if (mapFile_ != nullptr)
+      mapFile_->prefetch(idx.i, idx.j);
+  }
+}
+
+void SurfelMap::updateSubmapCenters() {
+  std::vector<vec2> centers(submap_size_ * submap_size_);
+  for (int32_t i = -submap_dim_; i <= submap_dim_; ++i) {
+    for (int32_t j = -submap_dim_; j <= submap_dim_; ++j) {
+      SubmapIndex idx = submap_origin_;
+      idx += SubmapIndex(i, j);
+      centers[offset2index(i, j)] = submapIndex2center(idx);
+    }
+  }
+
+  vbo_submap_centers_.replace(0, centers);
+}
+
+uint32_t SurfelMap::beginDownload(State& state) {
+  state.timestamp = timestamp_;
+  state.poses.assign(poses_.poses().begin(), poses_.poses().begin() + timestamp_);
+  state.origin_i = submap_origin_.i;
+  state.origin_j = submap_origin_.j;
+
+  state.extraction.clear();
+  for (const SubmapIndex& idx : extraction_buffer_) state.extraction.push_back(std::make_pair(idx.i, idx.j));
+
+  // spilled submaps are copied without decompression.
+  state.submaps.resize(submapCache_.size());
+  std::vector<SubmapPager::Index> indexes = submapCache_.indexes();
+  for (uint32_t i = 0; i < indexes.size(); ++i) submapCache_.snapshot(indexes[i], state.submaps[i]);
+
+  uint32_t slot = nextSlot_;
+  nextSlot_ = 1 - nextSlot_;
+  if (stagingFence_[slot] != 0) throw std::runtime_error("SurfelMap: download of staging buffer not finished.");
+
+  // copy on the GPU, such that the surfels can be updated while the download is in flight.
+  staging_[slot].resize(surfels_.size());
+  if (surfels_.size() > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, surfels_.id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, staging_[slot].id());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, surfels_.size() * sizeof(Surfel));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+
+  stagingFence_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+
+  return slot;
+}
+
+bool SurfelMap::downloadReady(uint32_t slot) const {
+  if (stagingFence_[slot] == 0) return true;
+
+  GLenum status = glClientWaitSync(stagingFence_[slot], 0, 0);
+  return (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED);
+}
+
+void SurfelMap::finishDownload(uint32_t slot, State& state) {
+  if (stagingFence_[slot] == 0) throw std::runtime_error("SurfelMap: no download started.");
+
+  while (glClientWaitSync(stagingFence_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+  }
+  glDeleteSync(stagingFence_[slot]);
+  stagingFence_[slot] = 0;
+
+  state.surfels.clear();
+  if (staging_[slot].size() > 0) staging_[slot].get(state.surfels);
+}
+
+void SurfelMap::restore(const State& state) {
+  version_ += 1;
+  reserveSurfels(surfels_, state.surfels.size(), false);
+  surfels_.resize(state.surfels.size());
+  if (!state.surfels.empty()) surfels_.replace(0, state.surfels);
+
+  timestamp_ = state.timestamp;
+  poses_.reset(poses_.capacity());
+  poses_.update(state.poses);
+  uploadPoses();
+  localization_ = false;
+
+  submapCache_.clear();
+  for (const SubmapPager::Snapshot& submap : state.submaps) submapCache_.restore(submap);
+
+  extraction_buffer_.clear();
+  for (const auto& idx : state.extraction) extraction_buffer_.push_back(SubmapIndex(idx.first, idx.second));
+
+  submap_origin_ = SubmapIndex(state.origin_i, state.origin_j);
+  updateSubmapCenters();
+}
 
-      uint32_t old_size = surfels_.size();
-      surfels_.resize(surfels_.size() + old_surfel_cache_.size());
-      surfels_.replace(old_size, old_surfel_cache_);
+void SurfelMap::appendSubmap(const SubmapIndex& idx, std::vector<Surfel>& surfels) {
+  // extracted surfels are always more recent than the surfels of the map file.
+  if (submapCache_.get(pagerIndex(idx), surfels)) return;
+
+  if (mapFile_ == nullptr) return;
+
+  mapFile_->read(idx.i, idx.j, surfels);
+}
+
+void SurfelMap::save(const std::string& filename) {
+  std::unordered_map<SubmapIndex, std::vector<Surfel>, SubmapIndex> tiles;
+
+  // active surfels (including submaps, which are not yet extracted) are assigned by their position.
+  std::vector<Surfel> active;
+  if (surfels_.size() > 0) surfels_.get(active);
+  for (const Surfel& s : active) {
+    Eigen::Vector4f position = poses_[int32_t(s.count)] * Eigen::Vector4f(s.x, s.y, s.z, 1.0f);
+    SubmapIndex idx(int32_t(std::round(0.5f * position.x() / submap_extent_)),
+                    int32_t(std::round(0.5f * position.y() / submap_extent_)));
+    tiles[idx].push_back(s);
+  }
+
+  // cached surfels of active submaps are outdated.
+  auto isActive = [this](const SubmapIndex& idx) {
+    if (std::abs(idx.i - submap_origin_.i) <= submap_dim_ && std::abs(idx.j - submap_origin_.j) <= submap_dim_) {
+      return true;
     }
+    return std::find(extraction_buffer_.begin(), extraction_buffer_.end(), idx) != extraction_buffer_.end();
+  };
 
-    std::vector<vec2> centers(submap_size_ * submap_size_);
-    for (int32_t i = -submap_dim_; i <= submap_dim_; ++i) {
-      for (int32_t j = -submap_dim_; j <= submap_dim_; ++j) {
-        SubmapIndex idx = submap_origin_;
-        idx += SubmapIndex(i, j);
-        centers[offset2index(i, j)] = submapIndex2center(idx);
+  std::vector<SurfelMapFile::TileIndex> indexes;
+  for (const auto& tile : tiles) indexes.push_back(SurfelMapFile::TileIndex(tile.first.i, tile.first.j));
+
+  // inactive submaps are only decoded here if active surfels fall into them; otherwise, they are decoded or read
+  // one after another while the file is written. Submaps of a loaded map, which never became active, are copied.
+  // The loaded file stays open, since it is only replaced after the new file was written.
+  auto addInactive = [&](const SurfelMapFile::TileIndex& index) {
+    SubmapIndex idx(index.first, index.second);
+    auto tile = tiles.find(idx);
+    if (tile == tiles.end())
+      indexes.push_back(index);
+    else if (!submapCache_.peek(index, tile->second))
+      mapFile_->read(idx.i, idx.j, tile->second);
+  };
+
+  for (const auto& index : submapCache_.indexes()) {
+    if (!isActive(SubmapIndex(index.first, index.second))) addInactive(index);
+  }
+
+  if (mapFile_ != nullptr) {
+    for (const auto& tile : mapFile_->tiles()) {
+      if (!isActive(SubmapIndex(tile.first, tile.second)) && !submapCache_.contains(tile)) addInactive(tile);
+    }
+  }
+  std::sort(indexes.begin(), indexes.end());
+
+  auto source = [&](uint32_t t, std::vector<Surfel>& buffer) -> const std::vector<Surfel>& {
+    SubmapIndex idx(indexes[t].first, indexes[t].second);
+    auto tile = tiles.find(idx);
+    if (tile != tiles.end()) return tile->second;
+
+    if (!submapCache_.peek(indexes[t], buffer)) mapFile_->read(idx.i, idx.j, buffer);
+    return buffer;
+  };
+
+  std::vector<Eigen::Matrix4f> poses(poses_.poses().begin(), poses_.poses().begin() + timestamp_);
+  SurfelMapFile::write(filename, submap_extent_, poses, indexes, source, compact_);
+}
+
+void SurfelMap::load(const std::string& filename) {
+  std::shared_ptr<SurfelMapFile> file = std::make_shared<SurfelMapFile>();
+  file->open(filename);
+
+  if (file->submapExtent() != submap_extent_) {
+    throw std::runtime_error("SurfelMap: submap extent of " + filename + " does not match parameter submap-extent.");
+  }
+
+  reset();
+  mapFile_ = file;
+
+  timestamp_ = mapFile_->poses().size();
+  poses_.update(mapFile_->poses());
+  uploadPoses();
+
+  // only the active area is uploaded.
+  uploadActiveSubmaps();
+}
+
+void SurfelMap::localize(const Eigen::Matrix4f& pose) {
+  vec2 submap_center = submapIndex2center(submap_origin_);
+  float changex = pose(0, 3) - submap_center.x;
+  float changey = pose(1, 3) - submap_center.y;
+  float factor = 1.1;
+
+  // same hysteresis as updateActiveSubmaps, but the active area might jump, e.g., to an initial pose.
+  if (std::abs(changex) > factor * submap_extent_ || std::abs(changey) > factor * submap_extent_) {
+    int32_t di = (std::abs(changex) > factor * submap_extent_) ? direction(changex) : 0;
+    int32_t dj = (std::abs(changey) > factor * submap_extent_) ? direction(changey) : 0;
+
+    if (std::abs(changex) > 3.0f * submap_extent_ || std::abs(changey) > 3.0f * submap_extent_) {
+      submap_origin_ = SubmapIndex(int32_t(std::round(0.5f * pose(0, 3) / submap_extent_)),
+                                   int32_t(std::round(0.5f * pose(1, 3) / submap_extent_)));
+      uploadActiveSubmaps();
+    } else {
+      // the surfels are unchanged copies of the map file; thus, the leaving submaps are only discarded.
+      version_ += 1;
+      submap_origin_ += SubmapIndex(di, dj);
+      discardInactiveSurfels();
+
+      std::vector<SubmapIndex> indexes;
+      for (int32_t c = -submap_dim_; c <= submap_dim_; ++c) {
+        if (di != 0) indexes.push_back(SubmapIndex(submap_origin_.i + di * submap_dim_, submap_origin_.j + c));
+        // the corner submap is already part of the row.
+        if (dj != 0 && (di == 0 || c != di * submap_dim_)) {
+          indexes.push_back(SubmapIndex(submap_origin_.i + c, submap_origin_.j + dj * submap_dim_));
+        }
       }
+      appendActiveSubmaps(indexes);
     }
 
-    vbo_submap_centers_.replace(0, centers);
+    updateSubmapCenters();
+  }
+
+  prefetchSubmaps(pose);
+}
 
-    glFinish();
+void SurfelMap::uploadActiveSubmaps() {
+  version_ += 1;
+  std::vector<Surfel> surfels;
+  for (int32_t i = -submap_dim_; i <= submap_dim_; ++i) {
+    for (int32_t j = -submap_dim_; j <= submap_dim_; ++j) {
+      SubmapIndex idx = submap_origin_;
+      idx += SubmapIndex(i, j);
+      appendSubmap(idx, surfels);
+    }
   }
 
-  if (!extraction_buffer_.empty()) extractSurfels(partial_extraction_);
+  reserveSurfels(surfels_, surfels.size(), false);
+  surfels_.resize(surfels.size());
+  if (!surfels.empty()) surfels_.replace(0, surfels);
+}
+
+void SurfelMap::appendActiveSubmaps(const std::vector<SubmapIndex>& indexes) {
+  old_surfel_cache_.clear();
+  for (const SubmapIndex& idx : indexes) appendSubmap(idx, old_surfel_cache_);
+
+  uint32_t old_size = surfels_.size();
+  reserveSurfels(surfels_, surfels_.size() + old_surfel_cache_.size(), true);
+  surfels_.resize(surfels_.size() + old_surfel_cache_.size());
+  surfels_.replace(old_size, old_surfel_cache_);
+}
+
+void SurfelMap::discardInactiveSurfels() {
+  if (surfels_.size() == 0) return;
+
+  // the copy program filters by the active area; updated_surfels_ is only needed during update().
+  reserveSurfels(updated_surfels_, surfels_.size(), false);
+  updated_surfels_.resize(surfels_.size());
+  glBindBuffer(GL_COPY_READ_BUFFER, surfels_.id());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, updated_surfels_.id());
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, surfels_.size() * sizeof(Surfel));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  copy_feedback_.bind();
+  copy_program_.bind();
+  copy_program_.setUniform(GlUniform<vec2>("submap_center", submapIndex2center(submap_origin_)));
+  copy_program_.setUniform(GlUniform<float>("submap_extent", 2.0f * submap_dim_ * submap_extent_ + submap_extent_));
+  copy_program_.setUniform(GlUniform<bool>("compact", false));
+
+  glActiveTexture(GL_TEXTURE5);
+  poseTexture_.bind();
+
+  copy_feedback_.begin(TransformFeedbackMode::POINTS);
+  vao_updated_surfels_.bind();
+  glDrawArrays(GL_POINTS, 0, updated_surfels_.size());
+  vao_updated_surfels_.release();
+  surfels_.resize(copy_feedback_.end());
+
+  poseTexture_.release();
+  glActiveTexture(GL_TEXTURE0);
+  copy_program_.release();
+  copy_feedback_.release();
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  CheckGlError();
 }
 
 int32_t SurfelMap::direction(float a) {
@@ -842,70 +1287,84 @@ void SurfelMap::render(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& p
     poseTexture_.bind();
 
     renderFramebuffer_.bind();
-    render_program_.bind();
-    vao_surfels_.bind();
-
-    // FIXME: can we avoid rendering of all surfels by just keeping track of currently old surfels?
-
-    // -- render old map parts.
-    render_program_.setUniform(GlUniform<float>("conf_threshold", confidence_threshold));
-    render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestamp_ - composeSurfelAge_));
-
-    render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_old.inverse()));
-    render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
-
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR0, oldMapFrame_->vertex_map);
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR1, oldMapFrame_->normal_map);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDrawArrays(GL_POINTS, 0, surfels_.size());
-
-    render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
-    render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
-
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR0, newMapFrame_->vertex_map);
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR1, newMapFrame_->normal_map);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDrawArrays(GL_POINTS, 0, surfels_.size());
-
-    render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_old.inverse()));
-    render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
-
-    // compose both views, take just nearest surfels (FIXME: avoid rendering two times!)
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR0, composedFrame_->vertex_map);
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR1, composedFrame_->normal_map);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDrawArrays(GL_POINTS, 0, surfels_.size());
-
-    render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
-    render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
-    // Note: not clearing!
-    glDrawArrays(GL_POINTS, 0, surfels_.size());
-
-    vao_surfels_.release();
-    render_program_.release();
+    {
+      GpuTimer::Scope timer(GpuTimer::RENDER);
+
+      // the renderings of the old, new, and composed map are reused if nothing changed.
+      RenderKey old_key = renderKey(pose_old, pose_old, confidence_threshold, RenderMode::INACTIVE);
+      RenderKey new_key = renderKey(pose_new, pose_new, confidence_threshold, RenderMode::ACTIVE);
+      RenderKey composed_key = renderKey(pose_old, pose_new, confidence_threshold, RenderMode::RENDER_COMPOSED);
+      if (!cached(oldKey_ == old_key && newKey_ == new_key && composedKey_ == composed_key)) {
+        render_program_.bind();
+        vao_surfels_.bind();
+
+        // FIXME: can we avoid rendering of all surfels by just keeping track of currently old surfels?
+
+        // -- render old map parts.
+        render_program_.setUniform(GlUniform<float>("conf_threshold", confidence_threshold));
+        render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestampThreshold()));
+
+        render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_old.inverse()));
+        render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
+
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR0, oldMapFrame_->vertex_map);
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR1, oldMapFrame_->normal_map);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDrawArrays(GL_POINTS, 0, surfels_.size());
+
+        render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
+        render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
+
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR0, newMapFrame_->vertex_map);
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR1, newMapFrame_->normal_map);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDrawArrays(GL_POINTS, 0, surfels_.size());
+
+        render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_old.inverse()));
+        render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
+
+        // compose both views, take just nearest surfels (FIXME: avoid rendering two times!)
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR0, composedFrame_->vertex_map);
+        renderFramebuffer_.attach(FramebufferAttachment::COLOR1, composedFrame_->normal_map);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDrawArrays(GL_POINTS, 0, surfels_.size());
+
+        render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
+        render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
+        // Note: not clearing!
+        glDrawArrays(GL_POINTS, 0, surfels_.size());
+
+        vao_surfels_.release();
+        render_program_.release();
+
+        oldKey_ = old_key;
+        newKey_ = new_key;
+        composedKey_ = composed_key;
+      }
 
-    compose_program_.bind();
-    vao_no_points_.bind();
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR0, frame.vertex_map);
-    renderFramebuffer_.attach(FramebufferAttachment::COLOR1, frame.normal_map);
+      compose_program_.bind();
+      vao_no_points_.bind();
+      renderFramebuffer_.attach(FramebufferAttachment::COLOR0, frame.vertex_map);
+      renderFramebuffer_.attach(FramebufferAttachment::COLOR1, frame.normal_map);
 
-    glActiveTexture(GL_TEXTURE0);
-    oldMapFrame_->vertex_map.bind();
-    glActiveTexture(GL_TEXTURE1);
-    oldMapFrame_->normal_map.bind();
+      glActiveTexture(GL_TEXTURE0);
+      oldMapFrame_->vertex_map.bind();
+      glActiveTexture(GL_TEXTURE1);
+      oldMapFrame_->normal_map.bind();
 
-    glActiveTexture(GL_TEXTURE2);
-    newMapFrame_->vertex_map.bind();
-    glActiveTexture(GL_TEXTURE3);
-    newMapFrame_->normal_map.bind();
+      glActiveTexture(GL_TEXTURE2);
+      newMapFrame_->vertex_map.bind();
+      glActiveTexture(GL_TEXTURE3);
+      newMapFrame_->normal_map.bind();
 
-    sampler_.bind(0);
-    sampler_.bind(1);
-    sampler_.bind(2);
-    sampler_.bind(3);
+      sampler_.bind(0);
+      sampler_.bind(1);
+      sampler_.bind(2);
+      sampler_.bind(3);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDrawArrays(GL_POINTS, 0, 1);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glDrawArrays(GL_POINTS, 0, 1);
+    }
 
     glActiveTexture(GL_TEXTURE0);
     oldMapFrame_->vertex_map.release();
@@ -935,6 +1394,12 @@ void SurfelMap::render(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& p
     oldMapFrame_->valid = true;
     newMapFrame_->valid = true;
   } else {
+    RenderKey key = renderKey(pose_old, pose_old, confidence_threshold, RenderMode::PLAIN);
+    if (cached(newKey_ == key && oldKey_ == key)) {
+      frame.copy(*newMapFrame_);
+      return;
+    }
+
     glGetIntegerv(GL_VIEWPORT, vp);
     glGetFloatv(GL_COLOR_CLEAR_VALUE, cc);
 
@@ -958,8 +1423,10 @@ void SurfelMap::render(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& p
     glActiveTexture(GL_TEXTURE5);
     poseTexture_.bind();
 
+    GpuTimer::begin(GpuTimer::RENDER);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glDrawArrays(GL_POINTS, 0, surfels_.size());
+    GpuTimer::end(GpuTimer::RENDER);
 
     glActiveTexture(GL_TEXTURE5);
     poseTexture_.release();
@@ -975,12 +1442,17 @@ void SurfelMap::render(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& p
     // copy new, oldmap frame.
     newMapFrame_->copy(frame);
     oldMapFrame_->copy(frame);
+    newKey_ = oldKey_ = key;
   }
 
   CheckGlError();
 }
 
 void SurfelMap::render_active(const Eigen::Matrix4f& pose, float confidence_threshold) {
+  RenderKey key = renderKey(pose, pose, confidence_threshold, RenderMode::ACTIVE);
+  if (cached(newKey_ == key)) return;
+  newKey_ = key;
+
   GLfloat cc[4];
   GLint vp[4];
 
@@ -999,15 +1471,17 @@ void SurfelMap::render_active(const Eigen::Matrix4f& pose, float confidence_thre
   render_program_.bind();
   vao_surfels_.bind();
 
-  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestamp_ - composeSurfelAge_));
+  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestampThreshold()));
   render_program_.setUniform(GlUniform<float>("conf_threshold", confidence_threshold));
   render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose.inverse()));
   render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
 
   renderFramebuffer_.attach(FramebufferAttachment::COLOR0, newMapFrame_->vertex_map);
   renderFramebuffer_.attach(FramebufferAttachment::COLOR1, newMapFrame_->normal_map);
+  GpuTimer::begin(GpuTimer::RENDER_ACTIVE);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glDrawArrays(GL_POINTS, 0, surfels_.size());
+  GpuTimer::end(GpuTimer::RENDER_ACTIVE);
 
   vao_surfels_.release();
   render_program_.release();
@@ -1028,6 +1502,10 @@ void SurfelMap::render_active(const Eigen::Matrix4f& pose, float confidence_thre
 }
 
 void SurfelMap::render_inactive(const Eigen::Matrix4f& pose, float confidence_threshold) {
+  RenderKey key = renderKey(pose, pose, confidence_threshold, RenderMode::INACTIVE);
+  if (cached(oldKey_ == key)) return;
+  oldKey_ = key;
+
   GLfloat cc[4];
   GLint vp[4];
 
@@ -1048,15 +1526,17 @@ void SurfelMap::render_inactive(const Eigen::Matrix4f& pose, float confidence_th
 
   // -- render old map parts.
   render_program_.setUniform(GlUniform<float>("conf_threshold", confidence_threshold));
-  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestamp_ - composeSurfelAge_));
+  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestampThreshold()));
 
   render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose.inverse()));
   render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
 
   renderFramebuffer_.attach(FramebufferAttachment::COLOR0, oldMapFrame_->vertex_map);
   renderFramebuffer_.attach(FramebufferAttachment::COLOR1, oldMapFrame_->normal_map);
+  GpuTimer::begin(GpuTimer::RENDER_INACTIVE);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glDrawArrays(GL_POINTS, 0, surfels_.size());
+  GpuTimer::end(GpuTimer::RENDER_INACTIVE);
 
   vao_surfels_.release();
   render_program_.release();
@@ -1074,6 +1554,10 @@ void SurfelMap::render_inactive(const Eigen::Matrix4f& pose, float confidence_th
 
 void SurfelMap::render_composed(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& pose_new,
                                 float confidence_threshold) {
+  RenderKey key = renderKey(pose_old, pose_new, confidence_threshold, RenderMode::COMPOSED);
+  if (cached(composedKey_ == key)) return;
+  composedKey_ = key;
+
   GLfloat cc[4];
   GLint vp[4];
 
@@ -1093,7 +1577,7 @@ void SurfelMap::render_composed(const Eigen::Matrix4f& pose_old, const Eigen::Ma
   vao_surfels_.bind();
 
   render_program_.setUniform(GlUniform<float>("conf_threshold", confidence_threshold));
-  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestamp_ - composeSurfelAge_));
+  render_program_.setUniform(GlUniform<int>("timestamp_threshold", timestampThreshold()));
 
   // compose both views, take just nearest surfels (FIXME: avoid rendering two times!)
   renderFramebuffer_.attach(FramebufferAttachment::COLOR0, composedFrame_->vertex_map);
@@ -1102,13 +1586,16 @@ void SurfelMap::render_composed(const Eigen::Matrix4f& pose_old, const Eigen::Ma
   render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_old.inverse()));
   render_program_.setUniform(GlUniform<bool>("render_old_surfels", true));
 
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDrawArrays(GL_POINTS, 0, surfels_.size());
+  {
+    GpuTimer::Scope timer(GpuTimer::RENDER_COMPOSED);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawArrays(GL_POINTS, 0, surfels_.size());
 
-  render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
-  render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
-  // Note: not clearing!
-  glDrawArrays(GL_POINTS, 0, surfels_.size());
+    render_program_.setUniform(GlUniform<Eigen::Matrix4f>("inv_pose", pose_new.inverse()));
+    render_program_.setUniform(GlUniform<bool>("render_old_surfels", false));
+    // Note: not clearing!
+    glDrawArrays(GL_POINTS, 0, surfels_.size());
+  }
 
   vao_surfels_.release();
   render_program_.release();
@@ -12,6 +12,9 @@
 #include <unordered_map>
 #include "Frame.h"
 #include "Surfel.h"
+#include "SubmapPager.h"
+#include "PoseTable.h"
+#include "SurfelMapFile.h"
 
 /** \brief Parameters for rendering the map. **/
 struct SurfelMapVisualOptions {
@@ -29,7 +32,18 @@ struct SurfelMapVisualOptions {
 /** \brief surfel-based map representation. **/
 class SurfelMap {
  public:
+  /** \brief host-side copy of the complete map, i.e., active surfels, cached submaps, and poses of the scans. **/
+  struct State {
+    uint32_t timestamp{0};
+    std::vector<Surfel> surfels;  // surfels of the active submaps.
+    std::vector<Eigen::Matrix4f> poses;
+    int32_t origin_i{0}, origin_j{0};  // submap origin.
+    std::vector<std::pair<int32_t, int32_t>> extraction;  // submaps not yet extracted.
+    std::vector<SubmapPager::Snapshot> submaps;  // inactive submaps; spilled submaps stay compressed.
+  };
+
   SurfelMap(const rv::ParameterList& params);
+  ~SurfelMap();
 
   void setParameters(const rv::ParameterList& params);
 
@@ -65,14 +79,133 @@ class SurfelMap {
   /** \brief update the poses of the integrated scans (maybe, due to loop closure) **/
   void updatePoses(const std::vector<Eigen::Matrix4f>& poses);
 
+  /** \brief copy host-side state and start the download of the surfels, which is finished by finishDownload.
+   *
+   *  The surfels are copied on the GPU into one of two staging buffers, i.e., the map can be updated
+   *  while the download is in flight and a second download can be started before the first is finished.
+   *
+   *  \return slot, which must be passed to downloadReady and finishDownload.
+   **/
+  uint32_t beginDownload(State& state);
+
+  /** \brief true, if the download of the given slot can be finished without waiting. **/
+  bool downloadReady(uint32_t slot) const;
+
+  /** \brief wait for the download of the given slot and read the surfels into the state. **/
+  void finishDownload(uint32_t slot, State& state);
+
+  /** \brief replace the map by the given state. **/
+  void restore(const State& state);
+
+  /** \brief write the complete map, i.e., all active and inactive submaps, as tiled map file (see SurfelMapFile). **/
+  void save(const std::string& filename);
+
+  /** \brief counters of the render cache, i.e., renderings that were reused or actually rendered. **/
+  struct RenderStatistics {
+    uint64_t hits{0};
+    uint64_t misses{0};
+  };
+
+  const RenderStatistics& renderStatistics() const { return renderStats_; }
+
+  /** \brief version of the map, which changes with every modification of surfels, poses, or parameters. **/
+  uint64_t version() const { return version_; }
+
+  /** \brief memory of a GPU buffer. **/
+  struct MemoryUsage {
+    std::string name;
+    uint64_t allocatedBytes{0};
+    uint64_t usedBytes{0};
+    uint64_t peakBytes{0};  // maximal used bytes since the last reset.
+  };
+
+  /** \brief allocated and used memory of the surfel and pose buffers. **/
+  std::vector<MemoryUsage> memoryUsage() const;
+
+  /** \brief statistics of the storage of the inactive submaps. **/
+  const SubmapPager::Statistics& submapStatistics() const { return submapCache_.statistics(); }
+
+  /** \brief replace the map by the given map file.
+   *
+   *  Only the submaps of the active area are read and uploaded. The remaining submaps are read from the
+   *  memory-mapped file when they become active.
+   **/
+  void load(const std::string& filename);
+
+  /** \brief keep the map fixed, i.e., all surfels are rendered as active and update() must not be called.
+   *  The map is reset to normal operation by reset(). **/
+  void setLocalization(bool localization) {
+    localization_ = localization;
+    version_ += 1;
+  }
+
+  bool isLocalization() const { return localization_; }
+
+  /** \brief move the active area with the given pose and prefetch the submaps ahead; replaces update() in
+   *  localization mode. Like in update(), only the row or column of submaps entering the active area is uploaded,
+   *  but the leaving submaps are discarded instead of extracted. After a jump, all active submaps are uploaded. **/
+  void localize(const Eigen::Matrix4f& pose);
+
  protected:
   void initializeSubmaps();
+  void updateSubmapCenters();
+
+  /** \brief start reading of inactive submaps, which will probably become active soon. **/
+  void prefetchSubmaps(const Eigen::Matrix4f& pose);
+
+  enum class RenderMode { ACTIVE, INACTIVE, COMPOSED, RENDER_COMPOSED, PLAIN };
+
+  /** \brief parameters of a rendering into one of the map frames; equal keys result in equal renderings. **/
+  struct RenderKey {
+    bool valid{false};
+    uint64_t version{0};
+    Eigen::Matrix4f pose_old, pose_new;
+    float confidence_threshold{0.0f};
+    RenderMode mode{RenderMode::PLAIN};
+
+    bool operator==(const RenderKey& other) const {
+      return valid && other.valid && version == other.version && mode == other.mode &&
+             confidence_threshold == other.confidence_threshold && pose_old == other.pose_old &&
+             pose_new == other.pose_new;
+    }
+  };
+
+  RenderKey renderKey(const Eigen::Matrix4f& pose_old, const Eigen::Matrix4f& pose_new, float confidence_threshold,
+                      RenderMode mode) const;
+
+  /** \brief count hit or miss of the render cache and return hit. **/
+  bool cached(bool hit);
+
+  /** \brief grow buffer geometrically if it cannot store count surfels; with preserve, the surfels are kept. **/
+  void reserveSurfels(glow::GlBuffer<Surfel>& buffer, uint32_t count, bool preserve);
+
+  /** \brief remember maximal used memory of all buffers. **/
+  void updatePeakUsage();
+
+  /** \brief upload modified poses; after growing, the complete pose buffer is uploaded. **/
+  void uploadPoses();
+
+  /** \brief replace the surfels by the submaps of the active area. **/
+  void uploadActiveSubmaps();
+
+  /** \brief remove surfels outside of the active area on the GPU. **/
+  void discardInactiveSurfels();
+
+  /** \brief surfels created before this timestamp are rendered as old surfels. **/
+  int32_t timestampThreshold() const { return localization_ ? 0 : int32_t(timestamp_ - composeSurfelAge_); }
 
   uint32_t timestamp_{0};
 
   uint32_t dataWidth_, dataHeight_;
   uint32_t modelWidth_, modelHeight_;
-  uint32_t maxNumSurfels_{2048 * 2048};  //{4096 * 4096};  // 16.777.216 surfels.
+  uint32_t surfelCapacity_{1 << 20};  // initial capacity of the surfel buffers, which grow on demand.
+
+  // periodic compaction: drop surfels below the confidence, which were not updated for the given number of scans.
+  uint32_t compactionInterval_{0};
+  float compactionConfidence_{0.0f};
+  uint32_t compactionAge_{100};
+
+  std::unordered_map<std::string, uint64_t> peakBytes_;
   float timeDelta_{20};
   Eigen::Matrix4f currentPose_;
 
@@ -127,6 +260,9 @@ class SurfelMap {
   std::shared_ptr<Frame> oldMapFrame_;
   std::shared_ptr<Frame> newMapFrame_;
   std::shared_ptr<Frame> composedFrame_;
+  RenderKey oldKey_, newKey_, composedKey_;  // content of the map frames.
+  uint64_t version_{0};
+  RenderStatistics renderStats_;
 
   bool composeRendering_{false};
   uint32_t composeSurfelAge_{100};
@@ -164,14 +300,20 @@ class SurfelMap {
     int32_t i, j;
   };
 
-  struct SubmapCache {
-    std::vector<Surfel> surfels;
-  };
-
   glow::vec2 submapIndex2center(const SubmapIndex& idx);
   uint32_t offset2index(int32_t i, int32_t j);
 
-  std::unordered_map<SubmapIndex, SubmapCache, SubmapIndex> submapCache_;
+  static SubmapPager::Index pagerIndex(const SubmapIndex& idx) { return SubmapPager::Index(idx.i, idx.j); }
+
+  /** \brief append surfels of an inactive submap, either from the cache or from the loaded map file. **/
+  void appendSubmap(const SubmapIndex& idx, std::vector<Surfel>& surfels);
+
+  /** \brief append the surfels of the given inactive submaps to the active surfels. **/
+  void appendActiveSubmaps(const std::vector<SubmapIndex>& indexes);
+
+  SubmapPager submapCache_;  // extracted inactive submaps; spilled to disk if the memory budget is exceeded.
+  bool compact_{false};      // store inactive submaps and map files with SurfelPacking.
+  bool localization_{false};  // fixed map; submaps are only streamed from the map file.
 
   SubmapIndex submap_origin_;
   int32_t submap_dim_;
@@ -190,10 +332,17 @@ class SurfelMap {
   std::vector<Surfel> old_surfel_cache_;
   std::vector<SubmapIndex> extraction_buffer_;
 
-  uint32_t maxPoses_{10000};
-  std::vector<Eigen::Matrix4f> poses_;
+  PoseTable poses_;  // grows on demand; only modified poses are uploaded to poseBuffer_.
   glow::GlBuffer<Eigen::Matrix4f> poseBuffer_{glow::BufferTarget::TEXTURE_BUFFER, glow::BufferUsage::DYNAMIC_DRAW};
   glow::GlTextureBuffer poseTexture_;
+
+  // double-buffered download of the surfels.
+  glow::GlBuffer<Surfel> staging_[2]{{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ},
+                                     {glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ}};
+  GLsync stagingFence_[2]{0, 0};
+  uint32_t nextSlot_{0};
+
+  std::shared_ptr<SurfelMapFile> mapFile_;  // submaps, which were never active, are read from this file.
 };
 
 #endif /* INCLUDE_CORE_SURFELMAP_H_ */
@@ -0,0 +1,247 @@
+#include "core/SurfelMapFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "core/SurfelPacking.h"
+#include "util/BinaryBuffer.h"
+
+namespace {
+
+const uint64_t TILE_ALIGNMENT = 4096;  // page size.
+
+uint64_t alignToPage(uint64_t offset) {
+  return (offset + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+}
+}
+
+const uint32_t SurfelMapFile::MAGIC;
+const uint32_t SurfelMapFile::VERSION;
+
+SurfelMapFile::~SurfelMapFile() {
+  close();
+}
+
+void SurfelMapFile::write(const std::string& filename, float submap_extent,
+                          const std::vector<Eigen::Matrix4f>& poses, const std::vector<Tile>& tiles, bool compact) {
+  std::vector<TileIndex> indexes;
+  for (const Tile& tile : tiles) indexes.push_back(tile.index);
+
+  write(filename, submap_extent, poses, indexes,
+        [&tiles](uint32_t t, std::vector<Surfel>&) -> const std::vector<Surfel>& { return tiles[t].surfels; },
+        compact);
+}
+
+void SurfelMapFile::write(const std::string& filename, float submap_extent,
+                          const std::vector<Eigen::Matrix4f>& poses, const std::vector<TileIndex>& indexes,
+                          const TileSource& source, bool compact) {
+  // header: magic, version, encoding, submap extent, number of poses and tiles; afterwards poses and index.
+  BinaryWriter header;
+  header.write<uint32_t>(MAGIC);
+  header.write<uint32_t>(VERSION);
+  header.write<uint32_t>(compact ? PACKED : RAW);
+  header.write<float>(submap_extent);
+  header.write<uint32_t>(poses.size());
+  header.write<uint32_t>(indexes.size());
+  for (const Eigen::Matrix4f& pose : poses) header.write(pose.data(), 16);
+
+  // the new file replaces the old file only after it was completely written; thus, a mapping of the old file stays
+  // valid, even if it has the same filename.
+  std::string tmp_filename = filename + ".tmp";
+  std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+  if (!out.is_open()) throw std::runtime_error("SurfelMapFile: unable to open " + tmp_filename + " for writing.");
+
+  // the sizes of the tiles are only known after encoding; thus, the index is written after all tiles.
+  uint64_t index_size = indexes.size() * (2 * sizeof(int32_t) + 3 * sizeof(uint64_t));
+  uint64_t written = 0;
+  std::vector<char> padding(TILE_ALIGNMENT, 0);
+  std::vector<Surfel> buffer;
+  std::vector<char> packed;
+  BinaryWriter index;
+  for (uint32_t t = 0; t < indexes.size(); ++t) {
+    uint64_t offset = alignToPage(std::max<uint64_t>(written, header.buffer.size() + index_size));
+    while (written < offset) {
+      uint64_t n = std::min<uint64_t>(offset - written, padding.size());
+      out.write(padding.data(), n);
+      written += n;
+    }
+
+    buffer.clear();
+    const std::vector<Surfel>& surfels = source(t, buffer);
+    const char* data = reinterpret_cast<const char*>(surfels.data());
+    uint64_t size = surfels.size() * sizeof(Surfel);
+    if (compact) {
+      packed.clear();
+      SurfelPacking::pack(surfels.data(), surfels.size(), packed);
+      data = packed.data();
+      size = packed.size();
+    }
+    out.write(data, size);
+    written += size;
+
+    index.write<int32_t>(indexes[t].first);
+    index.write<int32_t>(indexes[t].second);
+    index.write<uint64_t>(offset);
+    index.write<uint64_t>(surfels.size());
+    index.write<uint64_t>(size);
+  }
+
+  out.seekp(0);
+  out.write(header.buffer.data(), header.buffer.size());
+  out.write(index.buffer.data(), index.buffer.size());
+  out.close();
+  if (!out.good()) throw std::runtime_error("SurfelMapFile: unable to write " + tmp_filename + ".");
+
+  if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    throw std::runtime_error("SurfelMapFile: unable to rename " + tmp_filename + ".");
+  }
+}
+
+void SurfelMapFile::open(const std::string& filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("SurfelMapFile: unable to open " + filename + ".");
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("SurfelMapFile: unable to read " + filename + ".");
+  }
+
+  void* address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // mapping stays valid.
+  if (address == MAP_FAILED) throw std::runtime_error("SurfelMapFile: unable to map " + filename + ".");
+
+  address_ = address;
+  length_ = st.st_size;
+
+  // tiles are requested in arbitrary order.
+  madvise(address_, length_, MADV_RANDOM);
+
+  try {
+    const char* bytes = reinterpret_cast<const char*>(address_);
+    uint64_t fixed_size = 2 * sizeof(uint32_t);
+    if (length_ < fixed_size) throw std::runtime_error("SurfelMapFile: " + filename + " is no surfel map.");
+
+    // only the header is copied, since the reader needs a buffer.
+    std::vector<char> buffer(bytes, bytes + fixed_size);
+    BinaryReader magic(buffer);
+    if (magic.read<uint32_t>() != MAGIC) throw std::runtime_error("SurfelMapFile: " + filename + " is no surfel map.");
+    uint32_t version = magic.read<uint32_t>();
+    if (version != 1 && version != VERSION) {
+      throw std::runtime_error("SurfelMapFile: unsupported version " + std::to_string(version) + ".");
+    }
+
+    // version 1 has neither encoding nor tile sizes.
+    fixed_size += (version == 1 ? 3 : 4) * sizeof(uint32_t);
+    if (length_ < fixed_size) throw std::runtime_error("SurfelMapFile: " + filename + " is truncated.");
+    buffer.assign(bytes + 2 * sizeof(uint32_t), bytes + fixed_size);
+    BinaryReader fixed(buffer);
+    encoding_ = RAW;
+    if (version > 1) encoding_ = fixed.read<uint32_t>();
+    if (encoding_ != RAW && encoding_ != PACKED) {
+      throw std::runtime_error("SurfelMapFile: unknown encoding " + std::to_string(encoding_) + ".");
+    }
+    submap_extent_ = fixed.read<float>();
+    uint32_t num_poses = fixed.read<uint32_t>();
+    uint32_t num_tiles = fixed.read<uint32_t>();
+
+    const uint32_t entry_size = 2 * sizeof(int32_t) + (version == 1 ? 2 : 3) * sizeof(uint64_t);
+    uint64_t header_size = fixed_size + uint64_t(num_poses) * 16 * sizeof(float) + uint64_t(num_tiles) * entry_size;
+    if (header_size > length_) throw std::runtime_error("SurfelMapFile: " + filename + " is truncated.");
+
+    buffer.assign(bytes + fixed_size, bytes + header_size);
+    BinaryReader reader(buffer);
+
+    poses_.resize(num_poses);
+    for (Eigen::Matrix4f& pose : poses_) reader.read(pose.data(), 16);
+
+    for (uint32_t t = 0; t < num_tiles; ++t) {
+      int32_t i = reader.read<int32_t>();
+      int32_t j = reader.read<int32_t>();
+      Entry entry;
+      entry.offset = reader.read<uint64_t>();
+      entry.count = reader.read<uint64_t>();
+      if (version == 1) {
+        if (entry.count > length_ / sizeof(Surfel)) throw std::runtime_error("SurfelMapFile: invalid tile size.");
+        entry.size = entry.count * sizeof(Surfel);
+      } else {
+        entry.size = reader.read<uint64_t>();
+      }
+      if (encoding_ == RAW && entry.size != entry.count * sizeof(Surfel)) {
+        throw std::runtime_error("SurfelMapFile: invalid tile size.");
+      }
+      if (entry.offset > length_ || entry.size > length_ - entry.offset) {
+        throw std::runtime_error("SurfelMapFile: " + filename + " is truncated.");
+      }
+
+      index_[key(i, j)] = entry;
+    }
+  } catch (...) {
+    close();
+    throw;
+  }
+}
+
+void SurfelMapFile::close() {
+  if (address_ != nullptr) munmap(address_, length_);
+
+  address_ = nullptr;
+  length_ = 0;
+  encoding_ = RAW;
+  submap_extent_ = 0.0f;
+  poses_.clear();
+  index_.clear();
+}
+
+std::vector<SurfelMapFile::TileIndex> SurfelMapFile::tiles() const {
+  std::vector<TileIndex> result;
+  result.reserve(index_.size());
+  for (const auto& entry : index_) {
+    result.push_back(TileIndex(int32_t(entry.first >> 32), int32_t(entry.first & 0xFFFFFFFF)));
+  }
+
+  return result;
+}
+
+bool SurfelMapFile::contains(int32_t i, int32_t j) const {
+  return index_.find(key(i, j)) != index_.end();
+}
+
+void SurfelMapFile::prefetch(int32_t i, int32_t j) const {
+  auto it = index_.find(key(i, j));
+  if (it == index_.end() || it->second.size == 0) return;
+
+  char* bytes = reinterpret_cast<char*>(address_) + it->second.offset;  // page aligned.
+  madvise(bytes, it->second.size, MADV_WILLNEED);
+}
+
+uint64_t SurfelMapFile::count(int32_t i, int32_t j) const {
+  auto it = index_.find(key(i, j));
+  return (it == index_.end()) ? 0 : it->second.count;
+}
+
+bool SurfelMapFile::read(int32_t i, int32_t j, std::vector<Surfel>& surfels) const {
+  auto it = index_.find(key(i, j));
+  if (it == index_.end()) return false;
+
+  const Entry& entry = it->second;
+  const char* bytes = reinterpret_cast<const char*>(address_) + entry.offset;
+  if (encoding_ == PACKED) {
+    SurfelPacking::unpack(bytes, entry.size, surfels);
+  } else {
+    const Surfel* stored = reinterpret_cast<const Surfel*>(bytes);
+    surfels.insert(surfels.end(), stored, stored + entry.count);
+  }
+
+  return true;
+}
@@ -0,0 +1,111 @@
+#ifndef SRC_CORE_SURFELMAPFILE_H_
+#define SRC_CORE_SURFELMAPFILE_H_
+
+#include <eigen3/Eigen/Dense>
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Surfel.h"
+
+/** \brief tiled on-disk surfel map, where each tile corresponds to a submap of the SurfelMap.
+ *
+ *  The file starts with a header containing the submap extent, the poses of the scans (surfels are stored relative
+ *  to the pose referenced by the surfel), and an index of the tiles with offset, number of surfels, and size. The
+ *  surfels of every tile start at a page boundary, such that the complete file can be memory-mapped and only the
+ *  pages of actually requested tiles are read from disk. Tiles are either stored as raw surfels or, in compact
+ *  files, encoded with SurfelPacking.
+ *
+ *  \author behley
+ */
+class SurfelMapFile {
+ public:
+  typedef std::pair<int32_t, int32_t> TileIndex;
+
+  struct Tile {
+    TileIndex index;
+    std::vector<Surfel> surfels;
+  };
+
+  SurfelMapFile() = default;
+  ~SurfelMapFile();
+
+  SurfelMapFile(const SurfelMapFile&) = delete;
+  SurfelMapFile& operator=(const SurfelMapFile&) = delete;
+
+  /** \brief write tiles and poses into given file; throws std::runtime_error on failure.
+   *
+   *  The file is written under a temporary name and renamed afterwards, i.e., an open SurfelMapFile with the same
+   *  filename still reads the old file.
+   *
+   *  \param compact  encode tiles with SurfelPacking (lossy, but less than half of the size).
+   **/
+  static void write(const std::string& filename, float submap_extent, const std::vector<Eigen::Matrix4f>& poses,
+                    const std::vector<Tile>& tiles, bool compact = false);
+
+  /** \brief surfels of the t-th tile, either stored in buffer or referencing existing surfels. **/
+  typedef std::function<const std::vector<Surfel>&(uint32_t t, std::vector<Surfel>& buffer)> TileSource;
+
+  /** \brief write tiles, which are requested from source one after another; thus, only a single tile must be
+   *  in memory. **/
+  static void write(const std::string& filename, float submap_extent, const std::vector<Eigen::Matrix4f>& poses,
+                    const std::vector<TileIndex>& indexes, const TileSource& source, bool compact = false);
+
+  /** \brief memory-map given file and read header; throws std::runtime_error on invalid files. **/
+  void open(const std::string& filename);
+
+  /** \brief release mapping. **/
+  void close();
+
+  bool isOpen() const { return address_ != nullptr; }
+
+  /** \brief true, if tiles are encoded with SurfelPacking. **/
+  bool isCompact() const { return encoding_ == PACKED; }
+
+  float submapExtent() const { return submap_extent_; }
+
+  const std::vector<Eigen::Matrix4f>& poses() const { return poses_; }
+
+  /** \brief indexes of all stored tiles. **/
+  std::vector<TileIndex> tiles() const;
+
+  /** \brief true, if tile (i, j) is stored in the file. **/
+  bool contains(int32_t i, int32_t j) const;
+
+  /** \brief advise the kernel to read tile (i, j) ahead. **/
+  void prefetch(int32_t i, int32_t j) const;
+
+  /** \brief number of surfels of tile (i, j); 0 if tile is not stored. **/
+  uint64_t count(int32_t i, int32_t j) const;
+
+  /** \brief append surfels of tile (i, j), which are read from the mapping; returns false if tile is not stored. **/
+  bool read(int32_t i, int32_t j, std::vector<Surfel>& surfels) const;
+
+  static const uint32_t MAGIC = 0x464D5553;  // "SUMF"
+  static const uint32_t VERSION = 2;
+
+ protected:
+  enum Encoding { RAW = 0, PACKED = 1 };
+
+  struct Entry {
+    uint64_t offset;
+    uint64_t count;
+    uint64_t size;  // bytes.
+  };
+
+  static uint64_t key(int32_t i, int32_t j) { return (uint64_t(uint32_t(i)) << 32) | uint32_t(j); }
+
+  void* address_{nullptr};
+  size_t length_{0};
+
+  uint32_t encoding_{RAW};
+  float submap_extent_{0.0f};
+  std::vector<Eigen::Matrix4f> poses_;
+  std::unordered_map<uint64_t, Entry> index_;
+};
+
+#endif /* SRC_CORE_SURFELMAPFILE_H_ */
@@ -1,4 +1,5 @@
 #include <core/SurfelMapping.h>
+#include "core/CpuFrame2Model.h"
 #include "core/Frame2Model.h"
 
 #include <rv/PrimitiveParameters.h>
@@ -9,8 +10,12 @@
 #include <glow/GlState.h>
 
 #include <rv/Stopwatch.h>
+#include <rv/Tracer.h>
+#include <cstdio>
 #include <memory>
 
+#include "util/BinaryBuffer.h"
+
 #include <gtsam/linear/NoiseModel.h>
 
 using namespace rv;
@@ -30,16 +35,22 @@ SurfelMapping::SurfelMapping(const rv::ParameterList& params)
       confidence_threshold_(10.0f) {
   currentPose_ = Eigen::Matrix4d::Identity();
   lastPose_ = Eigen::Matrix4d::Identity();
+  nextFrame_ = std::make_shared<Frame>(width_, height_);
 
   lastFrame_->map = map_;
   currentModelFrame_->map = map_;
   lastModelFrame_->map = map_;
   currentFrame_->map = map_;
+  nextFrame_->map = map_;
+
+  registerMetrics();
 
   setParameters(params);
 
   posegraph_ = std::shared_ptr<Posegraph>(new Posegraph());
+  posegraph_->setIncremental(incrementalPosegraph_);
   posegraph_->setInitial(0, Eigen::Matrix4d::Identity());  // dummy key for first frame.
+  poseIndex_.set(0, Eigen::Vector3d::Zero());
   trajectory_distances_.push_back(0);
   currentlyLoopClosing_ = false;
   currentPose_new_ = currentPose_old_ = Eigen::Matrix4d::Identity();
@@ -56,12 +67,66 @@ SurfelMapping::SurfelMapping(const rv::ParameterList& params)
   diag[3] = (rotNoise * rotNoise);
   diag[4] = (rotNoise * rotNoise);
   diag[5] = (rotNoise * rotNoise);
+}
+
+void SurfelMapping::registerMetrics() {
+  metric_.scans = metrics_.counter("scans");
+
+  metric_.initializeTime = metrics_.histogram("initialize-time");
+  metric_.preprocessingTime = metrics_.histogram("preprocessing-time");
+  metric_.icpTime = metrics_.histogram("icp-time");
+  metric_.loopTime = metrics_.histogram("loop-time");
+  metric_.prepareNextTime = metrics_.histogram("prepare-next-time");
+  metric_.mappingTime = metrics_.histogram("mapping-time");
+  metric_.completeTime = metrics_.histogram("complete-time");
+  metric_.mapRendering = metrics_.histogram("map rendering");
+  metric_.optTime = metrics_.histogram("opt-time");
+  metric_.residualTime = metrics_.histogram("time_residual_new");
+  metric_.icpOverall = metrics_.histogram("icp-overall");
+  metric_.additionalIcpTime = metrics_.histogram("additional-icp-time");
+  metric_.loopDetectionTime = metrics_.histogram("time_loopdetection");
+  metric_.mapUpdate = metrics_.histogram("map-update");
+
+  metric_.loopOutlierThres = metrics_.gauge("loopOutlierThres");
+  metric_.loopResidualThres = metrics_.gauge("loopResidualThres");
+  metric_.validThres = metrics_.gauge("validThres");
+  metric_.loopValidThres = metrics_.gauge("loopValidThres");
+  metric_.loopValidRatio = metrics_.gauge("loop_valid_ratio");
+  metric_.loopOutlierRatio = metrics_.gauge("loop_outlier_ratio");
+  metric_.loopRelativeError = metrics_.gauge("loop_relative_error_all");
+  metric_.residualOld = metrics_.gauge("residual_old");
+  metric_.posegraphError = metrics_.gauge("posegraph_error");
+
+  metric_.icpPercentage = metrics_.gauge("icp_percentage");
+  metric_.numIterations = metrics_.gauge("num_iterations");
+  metric_.incrementDifference = metrics_.gauge("increment_difference");
+
+  metric_.renderCacheHits = metrics_.gauge("render-cache-hits");
+  metric_.renderCacheMisses = metrics_.gauge("render-cache-misses");
+  metric_.submapHitRate = metrics_.gauge("submap-hit-rate");
+  metric_.submapSpillBytes = metrics_.gauge("submap-spill-bytes");
+  metric_.submapResidentBytes = metrics_.gauge("submap-resident-bytes");
+  metric_.gpuAllocatedBytes = metrics_.gauge("gpu-allocated-bytes");
+  metric_.gpuUsedBytes = metrics_.gauge("gpu-used-bytes");
+
+  for (uint32_t i = 0; i < GpuTimer::NUM_PASSES; ++i) {
+    metric_.gpuTime[i] = metrics_.histogram(std::string("gpu-") + GpuTimer::name(GpuTimer::Pass(i)));
+  }
+  metric_.gpuFrame = metrics_.gauge("gpu-frame");
+}
+
+/** \brief create projective ICP objective of the given backend (opengl, cpu); nullptr if unknown. **/
+static std::shared_ptr<Objective> createObjective(const std::string& backend, const rv::ParameterList& params) {
+  if (backend == "opengl") return std::make_shared<Frame2Model>(params);
+  if (backend == "cpu") return std::make_shared<CpuFrame2Model>(params);
 
-  statistics_["additional-icp-time"] = 0.0;
+  return nullptr;
 }
 
 SurfelMapping::~SurfelMapping() {
   if (optimizeFuture_.valid()) optimizeFuture_.wait();  // wait for finishing.
+  discardNext();
+  waitCheckpoints();
 }
 
 void SurfelMapping::setParameters(const rv::ParameterList& const_params) {
@@ -74,7 +139,10 @@ void SurfelMapping::setParameters(const rv::ParameterList& const_params) {
 
   preprocessor_.setParameters(params);
 
-  objective_.reset(new Frame2Model(params));
+  std::string icp_backend = "opengl";
+  if (params.hasParam("icp-backend")) icp_backend = std::string(params["icp-backend"]);
+
+  objective_ = createObjective(icp_backend, params);
 
   if (approach == "frame-to-frame") {
     std::cout << "Performing frame-to-frame matching." << std::endl;
@@ -91,7 +159,7 @@ void SurfelMapping::setParameters(const rv::ParameterList& const_params) {
     fallback_params.insert(FloatParameter("icp-max-distance", float(params["fallback-max-distance"])));
     fallback_params.insert(FloatParameter("icp-max-angle", float(params["fallback-max-angle"])));
 
-    recovery_.reset(new Frame2Model(fallback_params));
+    recovery_ = createObjective(icp_backend, fallback_params);
   }
 
   if (objective_ == nullptr) throw std::runtime_error("unknown projective ICP implementation.");
@@ -116,22 +184,31 @@ void SurfelMapping::setParameters(const rv::ParameterList& const_params) {
   if (params.hasParam("loop-valid-threshold")) loopValidThres_ = params["loop-valid-threshold"];
   if (params.hasParam("close-loops")) makeLoopClosures_ = params["close-loops"];
   if (params.hasParam("loop-search-distance")) loopClosureSearchDist_ = params["loop-search-distance"];
+  poseIndex_.setCellSize(loopClosureSearchDist_);  // radius queries only visit neighboring cells.
   if (params.hasParam("perform-mapping")) performMapping_ = params["perform-mapping"];
   if (params.hasParam("loop-min-verifications")) loopMinNumberVerifications_ = params["loop-min-verifications"];
   if (params.hasParam("loop-min-trajectory-distance")) loopClosureMinTrajDist_ = params["loop-min-trajectory-distance"];
+  if (params.hasParam("pipelined")) pipelined_ = params["pipelined"];
+  if (params.hasParam("gpu-timing")) GpuTimer::setEnabled(params["gpu-timing"]);
+  if (params.hasParam("posegraph-incremental")) incrementalPosegraph_ = params["posegraph-incremental"];
+  if (posegraph_ != nullptr && !currentlyOptimizing_) posegraph_->setIncremental(incrementalPosegraph_);
 
-  statistics_["loopOutlierThres"] = loopOutlierThres_;
-  statistics_["loopResidualThres"] = loopResidualThres_;
-  statistics_["validThres"] = loopValidThres_;
+  metrics_.set(metric_.loopOutlierThres, loopOutlierThres_);
+  metrics_.set(metric_.loopResidualThres, loopResidualThres_);
+  metrics_.set(metric_.validThres, loopValidThres_);
 
   params_ = params;
 }
 
 void SurfelMapping::reset() {
+  discardNext();
+  deferredCheckpoint_.clear();
+
   timestamp_ = 0;
   lastFrame_ = std::make_shared<Frame>(width_, height_);
   currentFrame_ = std::make_shared<Frame>(width_, height_);
   intermediateFrame_ = std::make_shared<Frame>(width_, height_);
+  nextFrame_ = std::make_shared<Frame>(width_, height_);
 
   uint32_t mwidth = currentModelFrame_->width;
   uint32_t mheight = currentModelFrame_->height;
@@ -143,12 +220,14 @@ void SurfelMapping::reset() {
   currentPose_ = Eigen::Matrix4d::Identity();
 
   map_->reset();
+  localizationOnly_ = false;
   T0 = Eigen::Matrix4d::Identity();
 
   lastFrame_->map = map_;
   currentFrame_->map = map_;
   currentModelFrame_->map = map_;
   lastModelFrame_->map = map_;
+  nextFrame_->map = map_;
 
   trackLoss_ = 0;
   firstTime_ = true;
@@ -156,14 +235,14 @@ void SurfelMapping::reset() {
 
   posegraph_->clear();
   posegraph_->setInitial(0, Eigen::Matrix4d::Identity());
+  poseIndex_.clear();
+  poseIndex_.set(0, Eigen::Vector3d::Zero());
   trajectory_distances_.clear();
   trajectory_distances_.push_back(0);
   currentlyLoopClosing_ = false;
   currentPose_new_ = currentPose_old_ = Eigen::Matrix4d::Identity();
   loopCount_ = 0;
 
-  statistics_["additional-icp-time"] = 0.0;
-
   objective_->reset();  // FIXME: not needed.
 }
 
@@ -172,43 +251,91 @@ uint32_t SurfelMapping::timestamp() const {
 }
 
 void SurfelMapping::processScan(const rv::Laserscan& scan) {
+  processScan(scan.points().data(), scan.points().size());
+}
+
+void SurfelMapping::processScan(const rv::Point3f* points, uint32_t num_points) {
+  processScan(points, num_points, nullptr, 0);
+}
+
+void SurfelMapping::processScan(const rv::Laserscan& scan, const rv::Laserscan& next) {
+  processScan(scan.points().data(), scan.points().size(), next.points().data(), next.points().size());
+}
+
+void SurfelMapping::processScan(const rv::Point3f* points, uint32_t num_points, const rv::Point3f* next_points,
+                                uint32_t num_next_points) {
+  ScopedTrace trace("processScan");
   Stopwatch::tic();
 
+  if (!pendingCheckpoints_.empty()) pollCheckpoints(false);
+
+  const bool closeLoops = makeLoopClosures_ && performMapping_ && !localizationOnly_;
+
   // check if optimization ready, copy poses, reinitialize loop closure count.
-  if (makeLoopClosures_ && performMapping_) integrateLoopClosures();
+  if (closeLoops) integrateLoopClosures();
+
+  if (!deferredCheckpoint_.empty() && !optimizationRunning()) {
+    writeCheckpoint(deferredCheckpoint_);
+    deferredCheckpoint_.clear();
+  }
 
   Stopwatch::tic();
-  initialize(scan);
-  statistics_["initialize-time"] = Stopwatch::toc();
+  if (nextPrepared_)
+    initializeNext();  // points were already uploaded and pre-processed with the previous scan.
+  else
+    initialize(points, num_points);
+  metrics_.record(metric_.initializeTime, Stopwatch::toc());
 
   Stopwatch::tic();
   preprocess();
-  statistics_["preprocessing-time"] = Stopwatch::toc();
+  metrics_.record(metric_.preprocessingTime, Stopwatch::toc());
 
-  //  double icpTime = 0.0;
   if (timestamp_ > 0) {
     Stopwatch::tic();
     updatePose();
-    statistics_["icp-time"] = Stopwatch::toc();
+    metrics_.record(metric_.icpTime, Stopwatch::toc());
+
+    Stopwatch::tic();
+    if (closeLoops) checkLoopClosure();
+    metrics_.record(metric_.loopTime, Stopwatch::toc());
+  }
 
+  // pre-processing of the next scan does not depend on the pose or the map; hence it can overlap with the map update.
+  if (pipelined_ && next_points != nullptr) {
     Stopwatch::tic();
-    if (makeLoopClosures_ && performMapping_) checkLoopClosure();
-    statistics_["loop-time"] = Stopwatch::toc();
+    prepareNext(next_points, num_next_points);
+    metrics_.record(metric_.prepareNextTime, Stopwatch::toc());
   }
 
   Stopwatch::tic();
-  if (performMapping_) updateMap();
-  statistics_["mapping-time"] = Stopwatch::toc();
+  if (localizationOnly_)
+    updateLocalization();
+  else if (performMapping_)
+    updateMap();
+  metrics_.record(metric_.mappingTime, Stopwatch::toc());
+  metrics_.set(metric_.renderCacheHits, map_->renderStatistics().hits);
+  metrics_.set(metric_.renderCacheMisses, map_->renderStatistics().misses);
 
   double completeTime = Stopwatch::toc();
 
-  statistics_["complete-time"] = completeTime;
-  statistics_["icp_percentage"] = statistics_["opt-time"] / completeTime;
+  metrics_.record(metric_.completeTime, completeTime);
+  metrics_.set(metric_.icpPercentage, metrics_.value(metric_.optTime) / completeTime);
+  metrics_.add(metric_.scans);
+
+  // GPU times are only available one or two scans later.
+  if (GpuTimer::nextFrame()) {
+    for (uint32_t i = 0; i < GpuTimer::NUM_PASSES; ++i) {
+      double time = GpuTimer::time(GpuTimer::Pass(i));
+      if (time >= 0.0) metrics_.record(metric_.gpuTime[i], time);
+    }
+    metrics_.set(metric_.gpuFrame, GpuTimer::frame());
+  }
 
   timestamp_ += 1;
 }
 
 void SurfelMapping::integrateLoopClosures() {
+  ScopedTrace trace("integrateLoopClosures");
   if (currentlyOptimizing_) {
     if (optimizeFuture_.wait_for(std::chrono::milliseconds(5)) == std::future_status::ready) {
       //      std::cout << "<<< optimization finished! at t = " << timestamp_ << std::endl;
@@ -220,6 +347,7 @@ void SurfelMapping::integrateLoopClosures() {
       for (uint32_t i = 0; i < poses_opt.size(); ++i) {
         casted_poses.push_back(poses_opt[i].cast<float>());
         posegraph_->setInitial(i, poses_opt[i]);
+        poses_before[i] = poses_opt[i];
       }
 
       loopCount_ -= beforeLoopCount_;
@@ -232,6 +360,7 @@ void SurfelMapping::integrateLoopClosures() {
       }
 
       map_->updatePoses(casted_poses);
+      poseIndex_.rebuild(poses_before);  // now contains the updated poses of all nodes.
 
       currentlyOptimizing_ = false;
       currentPose_ = difference * currentPose_;
@@ -322,10 +451,25 @@ void SurfelMapping::genResidualPlot() {
 }
 
 void SurfelMapping::initialize(const Laserscan& scan) {
+  initialize(scan.points().data(), scan.points().size());
+}
+
+void SurfelMapping::initialize(const rv::Point3f* points, uint32_t num_points) {
+  ScopedTrace trace("initialize");
+  discardNext();
+  currentPreprocessed_ = false;
+
   lastFrame_.swap(currentFrame_);  // current frame is the last frame.
   lastModelFrame_.swap(currentModelFrame_);
 
-  current_pts_.assign(scan.points());
+  if (preprocessor_.backend() == Preprocessing::Backend::CPU) {
+    // no copy: the points are only read by preprocess() of this scan.
+    current_host_pts_ = points;
+    num_current_host_pts_ = num_points;
+  } else {
+    current_pts_.resize(num_points);
+    current_pts_.replace(0, points, num_points);
+  }
 }
 
 float SurfelMapping::getConfidenceThreshold() {
@@ -337,10 +481,74 @@ float SurfelMapping::getConfidenceThreshold() {
   return ct;
 }
 
+void SurfelMapping::prepareNext(const rv::Point3f* points, uint32_t num_points) {
+  ScopedTrace trace("prepareNext");
+  discardNext();
+
+  if (preprocessor_.backend() == Preprocessing::Backend::CPU) {
+    // only the host-side images are computed in the background; the upload happens in initializeNext.
+    // no copy: the points must stay valid until the next scan is processed, see processScan().
+    next_host_pts_ = points;
+    num_next_host_pts_ = num_points;
+    nextFuture_ = std::async(std::launch::async, [this]() {
+      preprocessor_.processHost(next_host_pts_, num_next_host_pts_, *nextFrame_);
+    });
+  } else {
+    // no implicit synchronization on upload: the last pre-processing reading next_pts_ was already waited for.
+    next_pts_.resize(num_points);
+    next_pts_.replace(0, points, num_points);
+    preprocessor_.process(next_pts_, *nextFrame_, false);
+
+    nextFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();  // ensure that the commands are submitted before the map update is issued.
+  }
+
+  nextPrepared_ = true;
+}
+
+void SurfelMapping::initializeNext() {
+  ScopedTrace trace("initializeNext");
+  waitNext();
+
+  lastFrame_.swap(currentFrame_);  // current frame is the last frame.
+  currentFrame_.swap(nextFrame_);  // last frame is reused for the next scan.
+  lastModelFrame_.swap(currentModelFrame_);
+
+  if (preprocessor_.backend() == Preprocessing::Backend::CPU) {
+    current_host_pts_ = next_host_pts_;
+    num_current_host_pts_ = num_next_host_pts_;
+    preprocessor_.upload(current_host_pts_, num_current_host_pts_, *currentFrame_);
+  }
+
+  nextPrepared_ = false;
+  currentPreprocessed_ = true;
+}
+
+void SurfelMapping::waitNext() {
+  if (nextFuture_.valid()) nextFuture_.get();  // rethrows exceptions of the pre-processing.
+
+  if (nextFence_ != nullptr) {
+    while (glClientWaitSync(nextFence_, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(nextFence_);
+    nextFence_ = nullptr;
+  }
+}
+
+void SurfelMapping::discardNext() {
+  waitNext();
+  nextPrepared_ = false;
+}
+
 void SurfelMapping::preprocess() {
-  Stopwatch::tic();
+  ScopedTrace trace("preprocess");
 
-  preprocessor_.process(current_pts_, *currentFrame_);
+  if (currentPreprocessed_)
+    currentPreprocessed_ = false;  // already done by prepareNext.
+  else if (preprocessor_.backend() == Preprocessing::Backend::CPU)
+    preprocessor_.process(current_host_pts_, num_current_host_pts_, *currentFrame_);
+  else
+    preprocessor_.process(current_pts_, *currentFrame_, !GpuTimer::enabled());
   //  intermediateFrame_->copy(*currentFrame_);
 
   if (performMapping_) {
@@ -349,12 +557,10 @@ void SurfelMapping::preprocess() {
 
     Stopwatch::tic();
     map_->render(currentPose_old_.cast<float>(), currentPose_new_.cast<float>(), *lastModelFrame_, ct);
-    statistics_["map rendering"] = 1000. * Stopwatch::toc();
+    metrics_.record(metric_.mapRendering, 1000. * Stopwatch::toc());
 
     lastModelFrame_->pose = currentPose_new_.cast<float>();
   }
-
-  statistics_["preprocessing-time"] = Stopwatch::toc();
 }
 
 bool SurfelMapping::foundLoopClosureCandidate() {
@@ -370,6 +576,7 @@ const std::vector<Eigen::Matrix4f>& SurfelMapping::getLoopClosurePoses() const {
 }
 
 void SurfelMapping::updatePose() {
+  ScopedTrace trace("updatePose");
   if (!initialize_identity_) {
     T0 = lastIncrement_;  // take last pose increment for initialization.
   } else
@@ -379,7 +586,6 @@ void SurfelMapping::updatePose() {
 
   // determine ego-motion of vehicle. (Assuming the map only contains static stuff.)
 
-  Stopwatch::tic();
   if (performMapping_)
     objective_->setData(currentFrame_, map_->newMapFrame());
   else
@@ -398,8 +604,8 @@ void SurfelMapping::updatePose() {
 
   odom_poses_ = gn_->history();
 
-  statistics_["opt-time"] = Stopwatch::toc();
-  statistics_["num_iterations"] = gn_->iterationCount();
+  metrics_.record(metric_.optTime, Stopwatch::toc());
+  metrics_.set(metric_.numIterations, gn_->iterationCount());
 
   Eigen::Matrix4d increment = gn_->pose();
 
@@ -420,7 +626,7 @@ void SurfelMapping::updatePose() {
 
   double residual = objective_->jacobianProducts(JtJ_new, Jtr);
 
-  statistics_["time_residual_new"] = Stopwatch::toc();
+  metrics_.record(metric_.residualTime, Stopwatch::toc());
 
   result_new_.error = residual;  // gn_->residual();
   result_new_.inlier = objective_->inlier();
@@ -430,8 +636,6 @@ void SurfelMapping::updatePose() {
   result_new_.invalid = objective_->invalid();
   result_new_.valid = objective_->valid();
 
-  statistics_["icp-time"] = Stopwatch::toc();
-
   if (success < -1) {
     std::cerr << "minimization not successful. reason => " << gn_->reason(success) << std::endl;
   }
@@ -469,7 +673,9 @@ void SurfelMapping::updatePose() {
   float distance = 0;
 
   if (timestamp_ > 0) {
-    posegraph_->setInitial(timestamp_, posegraph_->pose(timestamp_ - 1) * increment);
+    Eigen::Matrix4d pose = posegraph_->pose(timestamp_ - 1) * increment;
+    posegraph_->setInitial(timestamp_, pose);
+    poseIndex_.set(timestamp_, pose.block<3, 1>(0, 3));
 
     posegraph_->addEdge(timestamp_ - 1, timestamp_, increment, info_);
     //    posegraph_->addEdge(timestamp_ - 1, timestamp_, increment, JtJ_new);
@@ -481,24 +687,13 @@ void SurfelMapping::updatePose() {
 
   lastIncrement_ = increment;  // take last pose increment for initialization.
 
-  statistics_["icp-overall"] = Stopwatch::toc();
+  metrics_.record(metric_.icpOverall, Stopwatch::toc());
 }
 
 std::vector<int32_t> SurfelMapping::getCandidateIndexes(float radius) {
   std::vector<int32_t> candidates;
 
-  int32_t closest_idx = -1;
-  float min_distance = radius;
-  for (int32_t j = int32_t(timestamp_) - loopDetlaTimestamp_; j >= 0; --j) {
-    float distance = pose_distance(currentPose_, posegraph_->pose(j));
-    float tdistance = trajectory_distances_[timestamp_] - trajectory_distances_[j];
-
-    if (distance < min_distance && tdistance > loopClosureMinTrajDist_) {
-      closest_idx = j;
-      min_distance = distance;
-    }
-  }
-
+  int32_t closest_idx = poseIndex_.closest(currentPose_.block<3, 1>(0, 3), radius, candidateFilter());
   if (closest_idx > -1) {
     candidates.push_back(closest_idx);
   }
@@ -510,20 +705,18 @@ double SurfelMapping::pose_distance(const Eigen::Matrix4d& a, const Eigen::Matri
 }
 
 int32_t SurfelMapping::getClosestIndex(const Eigen::Matrix4d& query) {
-  int32_t closest_idx = -1;
+  // Note: the search uses the current pose, since the loop closure pose is only slightly different.
+  return poseIndex_.closest(currentPose_.block<3, 1>(0, 3), loopClosureSearchDist_, candidateFilter());
+}
 
-  float min_distance = loopClosureSearchDist_;
-  for (int32_t j = int32_t(timestamp_) - loopDetlaTimestamp_; j >= 0; --j) {
-    float distance = pose_distance(currentPose_, posegraph_->pose(j));
-    float tdistance = trajectory_distances_[timestamp_] - trajectory_distances_[j];
+PoseIndex::Filter SurfelMapping::candidateFilter() const {
+  // only nodes that are old enough and far enough away along the trajectory.
+  const int32_t max_id = int32_t(timestamp_) - loopDetlaTimestamp_;
+  const float max_trajectory_distance = trajectory_distances_[timestamp_] - loopClosureMinTrajDist_;
 
-    if (distance < min_distance && tdistance > loopClosureMinTrajDist_) {
-      closest_idx = j;
-      min_distance = distance;
-    }
-  }
-
-  return closest_idx;
+  return [this, max_id, max_trajectory_distance](int32_t j) {
+    return j <= max_id && trajectory_distances_[j] < max_trajectory_distance;
+  };
 }
 
 Eigen::Matrix4d R(const Eigen::Matrix4d& M) {
@@ -534,6 +727,7 @@ Eigen::Matrix4d R(const Eigen::Matrix4d& M) {
 }
 
 void SurfelMapping::checkLoopClosure() {
+  ScopedTrace trace("checkLoopClosure");
   // Check nearby poses to search a loop closure.
 
   Stopwatch::tic();
@@ -573,7 +767,7 @@ void SurfelMapping::checkLoopClosure() {
 
     increment_old = gn_->pose();
     float increment_difference = (SE3::log(lastIncrement_) - SE3::log(increment_old)).norm();
-    statistics_["increment_difference"] = increment_difference;
+    metrics_.set(metric_.incrementDifference, increment_difference);
     //    std::cout << increment_difference << std::endl;
 
     if (valid_ratio > 0.2 && outlier_ratio < 0.85 && increment_difference < 0.1) {
@@ -671,7 +865,16 @@ void SurfelMapping::checkLoopClosure() {
   if ((loopCount_ > 6 && !currentlyOptimizing_) ||
       (loopCount_ > 0 && !currentlyOptimizing_ && (timeWithoutLoopClosure_ > 3))) {
     //    std::cout << "[info] Trigger optimization at " << timestamp_ << std::endl;
-    optimizedPosegraph_ = posegraph_->clone();
+    currentlyOptimizing_ = true;
+    beforeID_ = timestamp_;
+    beforeLoopCount_ = loopCount_;
+    beforeOptimizationPose_ = posegraph_->pose(timestamp_);
+
+    // the incremental solver only needs the changes since the last optimization.
+    if (posegraph_->isIncremental())
+      optimizedPosegraph_ = posegraph_->extractChanges();
+    else
+      optimizedPosegraph_ = posegraph_->clone();
     optimizeFuture_ = std::async(std::launch::async, std::bind(&SurfelMapping::optimizeAsync, this));
     //    optimizeFuture_.wait();  // calling this synchronously to directly see the error.
   }
@@ -687,6 +890,7 @@ void SurfelMapping::checkLoopClosure() {
 
     std::vector<int32_t> candidateTimestamps = getCandidateIndexes(loopClosureSearchDist_);
     int32_t loopClosureTimestamp = -1;
+    std::vector<LieGaussNewton::Hypothesis> hypotheses;
 
     for (uint32_t c = 0; c < candidateTimestamps.size(); ++c) {
       int32_t to = candidateTimestamps[c];
@@ -729,22 +933,24 @@ void SurfelMapping::checkLoopClosure() {
       double optimizationTime = 0.0f;
       double renderingTime = 0.0f;
 
-      for (uint32_t i = 0; i < initializations.size(); ++i) {
-        Stopwatch::tic();
-        gn_->minimize(*objective_, initializations[i]);
-        optimizationTime += 1000 * Stopwatch::toc();
-
-        //        float error =
-        objective_->jacobianProducts(JtJ, Jtr);
+      // all initializations are optimized together, where diverging hypotheses are dropped early.
+      Stopwatch::tic();
+      gn_->minimize(*objective_, initializations, hypotheses);
+      optimizationTime += 1000 * Stopwatch::toc();
 
-        float valid_ratio = float(objective_->valid()) / float(objective_->valid() + objective_->invalid());
-        float outlier_ratio = float(objective_->outlier()) / float(objective_->outlier() + objective_->inlier());
-        //        float residual = error / float(objective_->inlier() + objective_->outlier());
+      for (uint32_t i = 0; i < hypotheses.size(); ++i) {
+        const LieGaussNewton::Hypothesis& hypothesis = hypotheses[i];
         foundLoopClosureCandidate_ = true;
 
-        loopClosurePoses_.push_back((pose_prior * gn_->pose()).cast<float>());
+        loopClosurePoses_.push_back((pose_prior * hypothesis.pose).cast<float>());
+        if (hypothesis.pruned) continue;
+
+        const Objective::Evaluation& evaluation = hypothesis.evaluation;
+        float valid_ratio = float(evaluation.valid()) / float(evaluation.valid() + evaluation.invalid);
+        float outlier_ratio = float(evaluation.outlier) / float(evaluation.outlier + evaluation.inlier);
+
         if (valid_ratio > 0.2 && outlier_ratio < 0.85) {
-          Eigen::Matrix4f pose = (pose_prior * gn_->pose()).cast<float>();
+          Eigen::Matrix4f pose = (pose_prior * hypothesis.pose).cast<float>();
 
           Stopwatch::tic();
           map_->render_composed(pose, currentPose_new_.cast<float>(), getConfidenceThreshold());
@@ -769,7 +975,7 @@ void SurfelMapping::checkLoopClosure() {
               loopClosureTimestamp = to;
               minCandidate = loopClosurePoses_.size() - 1;
 
-              result_old_.pose = pose_prior * gn_->pose();
+              result_old_.pose = pose_prior * hypothesis.pose;
               result_old_.error = error;
               result_old_.information = JtJ;
               result_old_.inlier = objective_->inlier();
@@ -782,7 +988,7 @@ void SurfelMapping::checkLoopClosure() {
 
               bool loop_closure = (rel_error_all < loopResidualThres_) || (residual - result_new_.residual) < 0.1;
               if (loop_closure) {
-                currentPose_old_ = pose_prior * gn_->pose();
+                currentPose_old_ = pose_prior * hypothesis.pose;
               }
             }
           }
@@ -794,7 +1000,7 @@ void SurfelMapping::checkLoopClosure() {
         //                  << 100 * renderingTime / (optimizationTime + renderingTime) << "%)" << std::endl;
       }
 
-      statistics_["additional-icp-time"] = Stopwatch::toc();
+      metrics_.record(metric_.additionalIcpTime, Stopwatch::toc());
     }
 
     if (minCandidate > -1) {
@@ -829,26 +1035,53 @@ void SurfelMapping::checkLoopClosure() {
   float valid_ratio_old = float(result_old_.valid) / float(result_old_.valid + result_old_.invalid);
   float outlier_ratio_old = float(result_old_.outlier) / float(result_old_.outlier + result_old_.inlier);
 
-  statistics_["loop_valid_ratio"] = valid_ratio_old / valid_ratio_new;
-  statistics_["loop_outlier_ratio"] = outlier_ratio_old / outlier_ratio_new;
-  statistics_["loop_relative_error_all"] = result_old_.residual / result_new_.residual;
+  metrics_.set(metric_.loopValidRatio, valid_ratio_old / valid_ratio_new);
+  metrics_.set(metric_.loopOutlierRatio, outlier_ratio_old / outlier_ratio_new);
+  metrics_.set(metric_.loopRelativeError, result_old_.residual / result_new_.residual);
 
-  statistics_["residual_old"] = result_old_.residual;
-  statistics_["loopOutlierThres"] = loopOutlierThres_;
-  statistics_["loopValidThres"] = loopValidThres_;
-  statistics_["loopResidualThres"] = loopResidualThres_;
+  metrics_.set(metric_.residualOld, result_old_.residual);
+  metrics_.set(metric_.loopOutlierThres, loopOutlierThres_);
+  metrics_.set(metric_.loopValidThres, loopValidThres_);
+  metrics_.set(metric_.loopResidualThres, loopResidualThres_);
 
-  statistics_["posegraph_error"] = posegraph_->error();
-  statistics_["time_loopdetection"] = Stopwatch::toc();
+  metrics_.set(metric_.posegraphError, posegraph_->error());
+  metrics_.record(metric_.loopDetectionTime, Stopwatch::toc());
 }
 
 void SurfelMapping::updateMap() {
+  ScopedTrace trace("updateMap");
   Stopwatch::tic();
   map_->update(currentPose_.cast<float>(), *currentFrame_);
-  statistics_["map-update"] = Stopwatch::toc();
+  metrics_.record(metric_.mapUpdate, Stopwatch::toc());
 
   float ct = getConfidenceThreshold();
   map_->render(currentPose_.cast<float>(), *currentModelFrame_, ct);
+
+  const SubmapPager::Statistics& submaps = map_->submapStatistics();
+  metrics_.set(metric_.submapHitRate, submaps.hitRate());
+  metrics_.set(metric_.submapSpillBytes, submaps.spilledBytes);
+  metrics_.set(metric_.submapResidentBytes, submaps.residentBytes);
+
+  uint64_t allocated = 0, used = 0;
+  for (const SurfelMap::MemoryUsage& usage : map_->memoryUsage()) {
+    allocated += usage.allocatedBytes;
+    used += usage.usedBytes;
+  }
+  metrics_.set(metric_.gpuAllocatedBytes, allocated);
+  metrics_.set(metric_.gpuUsedBytes, used);
+}
+
+void SurfelMapping::updateLocalization() {
+  ScopedTrace trace("updateLocalization");
+  Stopwatch::tic();
+  map_->localize(currentPose_.cast<float>());
+  metrics_.record(metric_.mapUpdate, Stopwatch::toc());
+
+  float ct = getConfidenceThreshold();
+  map_->render(currentPose_.cast<float>(), *currentModelFrame_, ct);
+
+  const SubmapPager::Statistics& submaps = map_->submapStatistics();
+  metrics_.set(metric_.submapHitRate, submaps.hitRate());
 }
 
 void SurfelMapping::globallyOptimize() {
@@ -865,13 +1098,9 @@ void SurfelMapping::globallyOptimize() {
 }
 
 bool SurfelMapping::optimizeAsync() {
-  //  std::cout << ">>> Called optimized asynchronously at t = " << timestamp_ << "..." << std::endl;
-  currentlyOptimizing_ = true;
-
-  beforeID_ = timestamp_;
-  beforeLoopCount_ = loopCount_;
-  beforeOptimizationPose_ = optimizedPosegraph_->pose(timestamp_);
-
+  //  std::cout << ">>> Called optimized asynchronously at t = " << beforeID_ << "..." << std::endl;
+  Tracer::setThreadName("posegraph-optimization");
+  ScopedTrace trace("optimizePosegraph");
   return optimizedPosegraph_->optimize(100);
 }
 
@@ -887,6 +1116,342 @@ void SurfelMapping::storePoseGraph(const std::string& filename) const {
   posegraph_->save(filename);
 }
 
+namespace {
+
+const uint32_t CHECKPOINT_MAGIC = 0x504B4353;  // "SCKP"
+const uint32_t CHECKPOINT_VERSION = 2;
+
+template <class Derived>
+void writeMatrix(BinaryWriter& writer, const Eigen::MatrixBase<Derived>& m) {
+  typename Derived::PlainObject copy = m;  // column-major.
+  writer.write(copy.data(), copy.size());
+}
+
+template <class Matrix>
+Matrix readMatrix(BinaryReader& reader) {
+  Matrix m;
+  reader.read(m.data(), m.size());
+  return m;
+}
+
+template <class Candidate>
+void writeCandidates(BinaryWriter& writer, const std::vector<Candidate>& candidates) {
+  writer.write<uint64_t>(candidates.size());
+  for (const Candidate& c : candidates) {
+    writer.write<int32_t>(c.from);
+    writer.write<int32_t>(c.to);
+    writeMatrix(writer, c.rel_pose);
+  }
+}
+
+template <class Candidate>
+void readCandidates(BinaryReader& reader, std::vector<Candidate>& candidates) {
+  candidates.resize(reader.readCount(2 * sizeof(int32_t) + 16 * sizeof(double)));
+  for (Candidate& c : candidates) {
+    c.from = reader.read<int32_t>();
+    c.to = reader.read<int32_t>();
+    c.rel_pose = readMatrix<Eigen::Matrix4d>(reader);
+  }
+}
+
+void writeMapState(BinaryWriter& writer, const SurfelMap::State& map) {
+  writer.write<uint32_t>(map.timestamp);
+  writer.write<int32_t>(map.origin_i);
+  writer.write<int32_t>(map.origin_j);
+  writer.write(map.surfels);
+
+  writer.write<uint64_t>(map.poses.size());
+  for (const Eigen::Matrix4f& pose : map.poses) writeMatrix(writer, pose);
+
+  writer.write<uint64_t>(map.extraction.size());
+  for (const auto& idx : map.extraction) {
+    writer.write<int32_t>(idx.first);
+    writer.write<int32_t>(idx.second);
+  }
+
+  writer.write<uint64_t>(map.submaps.size());
+  for (const SubmapPager::Snapshot& submap : map.submaps) {
+    writer.write<int32_t>(submap.index.first);
+    writer.write<int32_t>(submap.index.second);
+    writer.write<uint8_t>(submap.compact);
+    writer.write<uint8_t>(submap.spilled);
+    writer.write(submap.surfels);
+    writer.write(submap.bytes);
+    writer.write<uint64_t>(submap.rawSize);
+  }
+}
+
+void readMapState(BinaryReader& reader, SurfelMap::State& map) {
+  map.timestamp = reader.read<uint32_t>();
+  map.origin_i = reader.read<int32_t>();
+  map.origin_j = reader.read<int32_t>();
+  reader.read(map.surfels);
+
+  map.poses.resize(reader.readCount(16 * sizeof(float)));
+  for (Eigen::Matrix4f& pose : map.poses) pose = readMatrix<Eigen::Matrix4f>(reader);
+
+  map.extraction.resize(reader.readCount(2 * sizeof(int32_t)));
+  for (auto& idx : map.extraction) {
+    idx.first = reader.read<int32_t>();
+    idx.second = reader.read<int32_t>();
+  }
+
+  // a submap has at least index, flags, both sizes of the (empty) content, and the raw size.
+  map.submaps.resize(reader.readCount(2 * sizeof(int32_t) + 2 * sizeof(uint8_t) + 3 * sizeof(uint64_t)));
+  for (SubmapPager::Snapshot& submap : map.submaps) {
+    submap.index.first = reader.read<int32_t>();
+    submap.index.second = reader.read<int32_t>();
+    submap.compact = reader.read<uint8_t>();
+    submap.spilled = reader.read<uint8_t>();
+    reader.read(submap.surfels);
+    reader.read(submap.bytes);
+    submap.rawSize = reader.read<uint64_t>();
+  }
+}
+}
+
+void SurfelMapping::checkpoint(const std::string& filename) {
+  // waiting for the result of the optimization would stall the mapping; processScan writes it later.
+  if (optimizationRunning()) {
+    deferredCheckpoint_ = filename;
+    return;
+  }
+
+  writeCheckpoint(filename);
+}
+
+bool SurfelMapping::optimizationRunning() {
+  return currentlyOptimizing_ && optimizeFuture_.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+void SurfelMapping::writeCheckpoint(const std::string& filename) {
+  // at most two downloads are in flight, since the map only has two staging buffers.
+  if (pendingCheckpoints_.size() > 1) {
+    Checkpoint& oldest = *pendingCheckpoints_.front();
+    map_->finishDownload(oldest.slot, oldest.map);
+    oldest.downloaded = true;
+    pollCheckpoints(false);
+  }
+
+  std::shared_ptr<Checkpoint> cp = std::make_shared<Checkpoint>();
+  cp->filename = filename;
+
+  BinaryWriter writer;
+  writer.write<uint32_t>(timestamp_);
+  writeMatrix(writer, currentPose_);
+  writeMatrix(writer, lastPose_);
+  writeMatrix(writer, currentPose_old_);
+  writeMatrix(writer, lastPose_old_);
+  writeMatrix(writer, currentPose_new_);
+  writeMatrix(writer, lastIncrement_);
+  writer.write<float>(lastError);
+  writer.write<uint32_t>(trackLoss_);
+  writer.write<uint8_t>(firstTime_);
+  writer.write(trajectory_distances_);
+
+  writer.write<uint8_t>(currentlyLoopClosing_);
+  writer.write<uint32_t>(loopCount_);
+  writer.write<uint32_t>(timeWithoutLoopClosure_);
+  writer.write<uint8_t>(alreadyVerifiedLoopClosure_);
+  writer.write<int32_t>(lastAddedLoopClosureCandidate_);
+  writeCandidates(writer, unverifiedLoopClosures_);
+  writeCandidates(writer, verifiedLoopClosures_);
+  writeCandidates(writer, nearbyLoopClosures_);
+
+  std::vector<char> graph;
+  posegraph_->serialize(graph);
+  writer.write(graph);
+
+  writer.write<uint8_t>(currentlyOptimizing_);
+  if (currentlyOptimizing_) {
+    writer.write<int32_t>(beforeID_);
+    writer.write<uint32_t>(beforeLoopCount_);
+    writeMatrix(writer, beforeOptimizationPose_);
+
+    const std::vector<Eigen::Matrix4d>& optimized = optimizedPosegraph_->poses();
+    writer.write<uint64_t>(optimized.size());
+    for (const Eigen::Matrix4d& pose : optimized) writeMatrix(writer, pose);
+  }
+
+  cp->state.swap(writer.buffer);
+  cp->slot = map_->beginDownload(cp->map);
+
+  pendingCheckpoints_.push_back(cp);
+}
+
+void SurfelMapping::pollCheckpoints(bool wait) {
+  while (!pendingCheckpoints_.empty()) {
+    std::shared_ptr<Checkpoint> cp = pendingCheckpoints_.front();
+    if (!cp->downloaded) {
+      if (!wait && !map_->downloadReady(cp->slot)) break;
+      map_->finishDownload(cp->slot, cp->map);
+      cp->downloaded = true;
+    }
+    pendingCheckpoints_.pop_front();
+
+    // files are written one after another by a single background thread.
+    if (checkpointWriter_.valid()) checkpointWriter_.get();
+    checkpointWriter_ = std::async(std::launch::async, [cp]() {
+      Tracer::setThreadName("checkpoint-writer");
+      ScopedTrace trace("writeCheckpoint");
+      BinaryWriter writer;
+      writer.write<uint32_t>(CHECKPOINT_MAGIC);
+      writer.write<uint32_t>(CHECKPOINT_VERSION);
+      writer.write(cp->state);
+      writeMapState(writer, cp->map);
+
+      // write to temporary file first, such that an interrupted write does not destroy the last checkpoint.
+      std::string tmp_filename = cp->filename + ".tmp";
+      std::ofstream out(tmp_filename.c_str(), std::ios::binary);
+      if (!out.is_open()) throw std::runtime_error("SurfelMapping: unable to open " + tmp_filename + " for writing.");
+      out.write(writer.buffer.data(), writer.buffer.size());
+      out.close();
+      if (!out.good()) throw std::runtime_error("SurfelMapping: unable to write " + tmp_filename + ".");
+
+      if (std::rename(tmp_filename.c_str(), cp->filename.c_str()) != 0) {
+        throw std::runtime_error("SurfelMapping: unable to rename " + tmp_filename + ".");
+      }
+    });
+  }
+}
+
+void SurfelMapping::waitCheckpoints() {
+  if (!deferredCheckpoint_.empty()) {
+    optimizeFuture_.wait();  // the finished optimization is stored in the checkpoint.
+    writeCheckpoint(deferredCheckpoint_);
+    deferredCheckpoint_.clear();
+  }
+
+  pollCheckpoints(true);
+  if (checkpointWriter_.valid()) checkpointWriter_.get();  // rethrows write errors.
+}
+
+void SurfelMapping::restore(const std::string& filename) {
+  discardNext();
+  waitCheckpoints();
+  if (optimizeFuture_.valid()) optimizeFuture_.wait();
+
+  std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+  if (!in.is_open()) throw std::runtime_error("SurfelMapping: unable to open checkpoint " + filename + ".");
+
+  std::vector<char> buffer(in.tellg());
+  in.seekg(0);
+  in.read(buffer.data(), buffer.size());
+  if (!in.good()) throw std::runtime_error("SurfelMapping: unable to read checkpoint " + filename + ".");
+
+  BinaryReader file(buffer);
+  if (file.read<uint32_t>() != CHECKPOINT_MAGIC) throw std::runtime_error("SurfelMapping: no checkpoint.");
+  uint32_t version = file.read<uint32_t>();
+  if (version != CHECKPOINT_VERSION) {
+    throw std::runtime_error("SurfelMapping: unsupported checkpoint version " + std::to_string(version) + ".");
+  }
+
+  std::vector<char> state;
+  file.read(state);
+  SurfelMap::State map;
+  readMapState(file, map);
+
+  // parse everything before anything is modified.
+  BinaryReader reader(state);
+  uint32_t timestamp = reader.read<uint32_t>();
+  Eigen::Matrix4d currentPose = readMatrix<Eigen::Matrix4d>(reader);
+  Eigen::Matrix4d lastPose = readMatrix<Eigen::Matrix4d>(reader);
+  Eigen::Matrix4d currentPose_old = readMatrix<Eigen::Matrix4d>(reader);
+  Eigen::Matrix4d lastPose_old = readMatrix<Eigen::Matrix4d>(reader);
+  Eigen::Matrix4d currentPose_new = readMatrix<Eigen::Matrix4d>(reader);
+  Eigen::Matrix4d lastIncrement = readMatrix<Eigen::Matrix4d>(reader);
+  float error = reader.read<float>();
+  uint32_t trackLoss = reader.read<uint32_t>();
+  bool firstTime = reader.read<uint8_t>();
+  std::vector<float> trajectory_distances;
+  reader.read(trajectory_distances);
+
+  bool loopClosing = reader.read<uint8_t>();
+  uint32_t loopCount = reader.read<uint32_t>();
+  uint32_t timeWithoutLoopClosure = reader.read<uint32_t>();
+  bool alreadyVerified = reader.read<uint8_t>();
+  int32_t lastAddedCandidate = reader.read<int32_t>();
+  std::vector<LoopClosureCandidate> unverified, verified, nearby;
+  readCandidates(reader, unverified);
+  readCandidates(reader, verified);
+  readCandidates(reader, nearby);
+
+  std::vector<char> graph;
+  reader.read(graph);
+
+  bool optimizing = reader.read<uint8_t>();
+  int32_t beforeID = 0;
+  uint32_t beforeLoopCount = 0;
+  Eigen::Matrix4d beforeOptimizationPose = Eigen::Matrix4d::Identity();
+  std::vector<Eigen::Matrix4d> optimized;
+  if (optimizing) {
+    beforeID = reader.read<int32_t>();
+    beforeLoopCount = reader.read<uint32_t>();
+    beforeOptimizationPose = readMatrix<Eigen::Matrix4d>(reader);
+    optimized.resize(reader.readCount(16 * sizeof(double)));
+    for (Eigen::Matrix4d& pose : optimized) pose = readMatrix<Eigen::Matrix4d>(reader);
+  }
+
+  if (!reader.atEnd() || !file.atEnd()) throw std::runtime_error("SurfelMapping: invalid checkpoint.");
+
+  posegraph_->deserialize(graph);
+  poseIndex_.rebuild(posegraph_->poses());
+  map_->restore(map);
+  localizationOnly_ = false;
+
+  timestamp_ = timestamp;
+  currentPose_ = currentPose;
+  lastPose_ = lastPose;
+  currentPose_old_ = currentPose_old;
+  lastPose_old_ = lastPose_old;
+  currentPose_new_ = currentPose_new;
+  lastIncrement_ = lastIncrement;
+  lastError = error;
+  trackLoss_ = trackLoss;
+  firstTime_ = firstTime;
+  trajectory_distances_ = trajectory_distances;
+
+  currentlyLoopClosing_ = loopClosing;
+  loopCount_ = loopCount;
+  timeWithoutLoopClosure_ = timeWithoutLoopClosure;
+  alreadyVerifiedLoopClosure_ = alreadyVerified;
+  lastAddedLoopClosureCandidate_ = lastAddedCandidate;
+  unverifiedLoopClosures_ = unverified;
+  verifiedLoopClosures_ = verified;
+  nearbyLoopClosures_ = nearby;
+
+  // the stored result of the optimization is integrated with the next scan.
+  currentlyOptimizing_ = optimizing;
+  if (optimizing) {
+    beforeID_ = beforeID;
+    beforeLoopCount_ = beforeLoopCount;
+    beforeOptimizationPose_ = beforeOptimizationPose;
+
+    optimizedPosegraph_ = std::make_shared<Posegraph>();
+    for (uint32_t i = 0; i < optimized.size(); ++i) optimizedPosegraph_->setInitial(i, optimized[i]);
+
+    std::promise<bool> finished;
+    finished.set_value(true);
+    optimizeFuture_ = finished.get_future();
+  }
+
+  // the model frame is rendered from the restored map; the last data frame is only needed by frame-to-frame.
+  map_->render(currentPose_.cast<float>(), *currentModelFrame_, getConfidenceThreshold());
+}
+
+void SurfelMapping::localize(const std::string& filename) {
+  if (!performMapping_) throw std::runtime_error("SurfelMapping: localization needs frame-to-model matching.");
+
+  waitCheckpoints();
+  if (optimizeFuture_.valid()) optimizeFuture_.wait();
+  currentlyOptimizing_ = false;
+
+  reset();
+  map_->load(filename);
+  map_->setLocalization(true);
+  localizationOnly_ = true;
+}
+
 std::shared_ptr<SurfelMap> SurfelMapping::getMap() {
   return map_;
 }
@@ -929,6 +1494,13 @@ uint32_t SurfelMapping::height() const {
 
 void SurfelMapping::setCurrentPose(const Eigen::Matrix4f& pose) {
   currentPose_ = pose.cast<double>();
+  currentPose_new_ = currentPose_old_ = currentPose_;
+
+  // the initial pose is the first node of the trajectory.
+  if (timestamp_ == 0) {
+    posegraph_->setInitial(0, currentPose_);
+    poseIndex_.set(0, currentPose_.block<3, 1>(0, 3));
+  }
 }
 
 Posegraph::ConstPtr SurfelMapping::getPosegraph() const {
@@ -936,6 +1508,7 @@ Posegraph::ConstPtr SurfelMapping::getPosegraph() const {
 }
 
 const SurfelMapping::Stats& SurfelMapping::getStatistics() const {
+  metrics_.values(statistics_);
   return statistics_;
 }
 
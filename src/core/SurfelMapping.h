@@ -7,7 +7,6 @@
 #include <rv/ParameterList.h>
 
 #include <glow/GlBuffer.h>
-#include <glow/GlQuery.h>
 
 #include "LieGaussNewton.h"
 
@@ -15,9 +14,13 @@
 #include "Objective.h"
 #include "Preprocessing.h"
 
+#include "GpuTimer.h"
+#include "Metrics.h"
 #include "SurfelMap.h"
 
+#include <deque>
 #include <future>
+#include "PoseIndex.h"
 #include "Posegraph.h"
 
 /** \brief Building model of the static and the dynamic environment from laser point clouds. **/
@@ -37,6 +40,18 @@ class SurfelMapping {
   /** \brief process a scan and update model, i.e., set data, pre-process it, updatePose, updateMap. **/
   void processScan(const rv::Laserscan& scan);
 
+  /** \brief process scan given by points (x, y, z, and arbitrary fourth coordinate), e.g., from a mapped file. **/
+  void processScan(const rv::Point3f* points, uint32_t num_points);
+
+  /** \brief process scan and, with parameter "pipelined", already upload and pre-process the next scan while the
+   *  map is updated. The following call of processScan must then process exactly this next scan; the results are
+   *  the same as processing both scans one after another. With the CPU backend, the next points are read in the
+   *  background without copy, i.e., they must stay valid until the following call of processScan returns. **/
+  void processScan(const rv::Laserscan& scan, const rv::Laserscan& next);
+
+  void processScan(const rv::Point3f* points, uint32_t num_points, const rv::Point3f* next_points,
+                   uint32_t num_next_points);
+
   uint32_t timestamp() const;
 
   /** \brief get frame of current timestep. **/
@@ -68,11 +83,19 @@ class SurfelMapping {
   /** \brief initialize point buffer, etc. **/
   void initialize(const rv::Laserscan& scan);
 
+  /** \brief initialize point buffer directly from given points without intermediate copy; with the CPU backend,
+   *  the points are read by preprocess(), i.e., they must stay valid until then. **/
+  void initialize(const rv::Point3f* points, uint32_t num_points);
+
   /** \brief pre-process data, i.e., perform projection, etc. **/
   void preprocess();
 
+  /** \brief current values of all metrics; compatibility view of metrics(). **/
   const Stats& getStatistics() const;
 
+  /** \brief metrics of all processing steps, e.g., latency histograms and the per-frame log. **/
+  Metrics& metrics() { return metrics_; }
+
   void globallyOptimize();
 
   void storePoseGraph(const std::string& filename) const;
@@ -94,6 +117,33 @@ class SurfelMapping {
 
   const std::vector<Eigen::Matrix4d>& getIntermediateOdometryPoses() const { return odom_poses_; }
 
+  /** \brief write the complete mapping state, i.e., map, pose graph, and tracking state, into the given file.
+   *
+   *  The host-side state is copied immediately, but the surfels are downloaded asynchronously and the file is
+   *  written by a background thread. Thus, the mapping can continue directly after this call; use
+   *  waitCheckpoints() to ensure that all checkpoints are written.
+   *
+   *  During a running pose graph optimization, the checkpoint is deferred to the first scan after the
+   *  optimization finished, i.e., it then contains the state before this scan.
+   **/
+  void checkpoint(const std::string& filename);
+
+  /** \brief wait until all pending checkpoints, including a deferred one, are written. **/
+  void waitCheckpoints();
+
+  /** \brief restore the mapping state from a checkpoint; processing continues with scan timestamp(). **/
+  void restore(const std::string& filename);
+
+  /** \brief reset and only localize against the given map file (see SurfelMap::save).
+   *
+   *  The map is neither updated nor are loops closed; submaps are streamed from the file with the current pose.
+   *  Use setCurrentPose() to specify the initial pose in the coordinate frame of the map. Localization ends with
+   *  reset().
+   **/
+  void localize(const std::string& filename);
+
+  bool isLocalizing() const { return localizationOnly_; }
+
  protected:
   struct OptResult {
    public:
@@ -116,6 +166,9 @@ class SurfelMapping {
   /** \brief update the pose estimate using a certain number of Gauss-Newton steps. **/
   void updatePose();
 
+  /** \brief register all metrics, i.e., the handles of metric_. **/
+  void registerMetrics();
+
   /** \brief if pose graph optimization finished: update poses, etc. **/
   void integrateLoopClosures();
 
@@ -125,8 +178,33 @@ class SurfelMapping {
   /** \brief use current pose and data to update map. **/
   void updateMap();
 
+  /** \brief stream submaps of the fixed map with the current pose and render the model frame. **/
+  void updateLocalization();
+
+  /** \brief upload and pre-process next scan into next frame without waiting for the results. **/
+  void prepareNext(const rv::Point3f* points, uint32_t num_points);
+
+  /** \brief make the prepared next frame the current frame. **/
+  void initializeNext();
+
+  /** \brief wait until pre-processing of the next frame is finished. **/
+  void waitNext();
+
+  /** \brief wait for and discard the prepared next frame, if any. **/
+  void discardNext();
+
   float getConfidenceThreshold();
 
+  /** \brief finish downloads of pending checkpoints and hand them over to the writer; with wait = true, all
+   *  downloads are finished. **/
+  void pollCheckpoints(bool wait);
+
+  /** \brief copy host-side state and start the map download of a checkpoint. **/
+  void writeCheckpoint(const std::string& filename);
+
+  /** \brief optimization started, but result not available yet. **/
+  bool optimizationRunning();
+
   /** \brief asynchronously optimize a copy of the posegraph. **/
   bool optimizeAsync();
 
@@ -135,9 +213,25 @@ class SurfelMapping {
   int32_t getClosestIndex(const Eigen::Matrix4d& query);
   std::vector<int32_t> getCandidateIndexes(float radius);
 
+  /** \brief filter for loop closure candidates, i.e., nodes far enough away in time and along the trajectory. **/
+  PoseIndex::Filter candidateFilter() const;
+
   double pose_distance(const Eigen::Matrix4d& a, const Eigen::Matrix4d& b) const;
 
   glow::GlBuffer<rv::Point3f> current_pts_{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+  const rv::Point3f* current_host_pts_{nullptr};  // only used by CPU preprocessing; not owned.
+  uint32_t num_current_host_pts_{0};
+
+  // pipelined processing: next scan is pre-processed into nextFrame_ while the map of the current scan is updated.
+  bool pipelined_{false};
+  glow::GlBuffer<rv::Point3f> next_pts_{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+  const rv::Point3f* next_host_pts_{nullptr};
+  uint32_t num_next_host_pts_{0};
+  Frame::Ptr nextFrame_;
+  bool nextPrepared_{false};         // nextFrame_ contains (or will contain) the pre-processed next scan.
+  bool currentPreprocessed_{false};  // currentFrame_ was already pre-processed by prepareNext.
+  GLsync nextFence_{nullptr};        // signaled when the OpenGL pre-processing of the next scan is finished.
+  std::future<void> nextFuture_;     // CPU pre-processing of the next scan.
 
   Preprocessing preprocessor_;
 
@@ -155,6 +249,7 @@ class SurfelMapping {
   rv::ParameterList params_;
 
   bool performMapping_{false};
+  bool localizationOnly_{false};  // fixed map loaded by localize().
   std::shared_ptr<SurfelMap> map_;
   Frame::Ptr currentModelFrame_, lastModelFrame_;
   Frame::Ptr lastLoopClosureFrame_;
@@ -175,9 +270,28 @@ class SurfelMapping {
 
   bool firstTime_{true};
 
-  Stats statistics_;
+  mutable Stats statistics_;
+  Metrics metrics_;
+  struct {
+    Metrics::Handle scans;
+    // latencies.
+    Metrics::Handle initializeTime, preprocessingTime, icpTime, loopTime, prepareNextTime, mappingTime, completeTime;
+    Metrics::Handle mapRendering, optTime, residualTime, icpOverall, additionalIcpTime, loopDetectionTime, mapUpdate;
+    // loop closure.
+    Metrics::Handle loopOutlierThres, loopResidualThres, validThres, loopValidThres;
+    Metrics::Handle loopValidRatio, loopOutlierRatio, loopRelativeError, residualOld, posegraphError;
+    // odometry.
+    Metrics::Handle icpPercentage, numIterations, incrementDifference;
+    // map.
+    Metrics::Handle renderCacheHits, renderCacheMisses, submapHitRate, submapSpillBytes, submapResidentBytes;
+    Metrics::Handle gpuAllocatedBytes, gpuUsedBytes;
+    // GPU time of the passes (see GpuTimer) and the frame they belong to.
+    Metrics::Handle gpuTime[GpuTimer::NUM_PASSES];
+    Metrics::Handle gpuFrame;
+  } metric_;
 
   Posegraph::Ptr posegraph_;
+  PoseIndex poseIndex_;  // positions of the pose graph nodes for the loop closure search.
   std::vector<float> trajectory_distances_;
 
   Eigen::Matrix4d currentPose_old_{Eigen::Matrix4d::Identity()};
@@ -190,6 +304,7 @@ class SurfelMapping {
   Eigen::DiagonalMatrix<double, 6> info_;
 
   bool currentlyOptimizing_{false};
+  bool incrementalPosegraph_{false};  // optimize pose graph with iSAM2 instead of a copy of the complete graph.
   std::future<bool> optimizeFuture_;
   Posegraph::Ptr optimizedPosegraph_;
   int32_t beforeID_;
@@ -220,10 +335,20 @@ class SurfelMapping {
   std::vector<LoopClosureCandidate> nearbyLoopClosures_;
   int32_t lastAddedLoopClosureCandidate_{-1};
 
-  glow::GlQuery time_query_{glow::QueryTarget::TIME_ELAPSED};
-
   std::vector<Eigen::Matrix4d> odom_poses_;
   float init_factor_;
+
+  struct Checkpoint {
+    std::string filename;
+    std::vector<char> state;  // serialized tracking and loop closure state.
+    uint32_t slot;            // staging buffer of the map download.
+    bool downloaded{false};
+    SurfelMap::State map;
+  };
+
+  std::deque<std::shared_ptr<Checkpoint>> pendingCheckpoints_;  // map download still in flight.
+  std::future<void> checkpointWriter_;
+  std::string deferredCheckpoint_;  // requested during optimization; empty = none.
 };
 
 #endif /* INCLUDE_CORE_LASERFUSION_H_ */
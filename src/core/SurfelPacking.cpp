@@ -0,0 +1,353 @@
+#include "core/SurfelPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SURFEL_PACKING_X86
+#endif
+
+const uint32_t SurfelPacking::CHUNK_SIZE;
+const uint32_t SurfelPacking::PACKED_SIZE;
+const float SurfelPacking::MAX_NORMAL_ERROR = 1e-4f;
+const float SurfelPacking::COLOR = float((77 << 16) + (77 << 8) + 77);  // pack(vec3(0.3)) of color.glsl.
+
+namespace {
+
+struct ChunkHeader {
+  float origin[3];
+  float step[3];  // quantization step per coordinate.
+  int32_t timestamp;
+  int32_t count;
+  uint32_t size;  // number of surfels.
+};
+
+struct PackedSurfel {
+  uint16_t position[3];
+  int16_t normal[2];
+  uint16_t radius, confidence, weight;
+  uint16_t timestamp, count;
+};
+
+static_assert(sizeof(PackedSurfel) == SurfelPacking::PACKED_SIZE, "Unexpected padding of PackedSurfel.");
+static_assert(sizeof(ChunkHeader) == 36, "Unexpected padding of ChunkHeader.");
+
+uint16_t floatToHalf(float value) {
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(float));
+
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t exponent = (x >> 23) & 0xFF;
+  uint32_t mantissa = x & 0x7FFFFF;
+
+  if (exponent == 0xFF) return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);  // inf or nan.
+
+  int32_t e = int32_t(exponent) - 127 + 15;
+  if (e >= 0x1F) return sign | 0x7C00;  // overflow.
+
+  if (e <= 0) {
+    // subnormal half; round to nearest even.
+    if (e < -10) return sign;
+    mantissa |= 0x800000;
+    uint32_t shift = 14 - e;
+    uint32_t half = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+
+    return sign | half;
+  }
+
+  // round to nearest even; a carry correctly increments the exponent.
+  uint32_t half = sign | (uint32_t(e) << 10) | (mantissa >> 13);
+  uint32_t remainder = mantissa & 0x1FFF;
+  if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;
+
+  return half;
+}
+
+float halfToFloat(uint16_t half) {
+  uint32_t sign = uint32_t(half & 0x8000) << 16;
+  uint32_t exponent = (half >> 10) & 0x1F;
+  uint32_t mantissa = half & 0x3FF;
+
+  uint32_t x;
+  if (exponent == 0) {
+    float value = std::ldexp(float(mantissa), -24);
+    return sign ? -value : value;
+  } else if (exponent == 0x1F) {
+    x = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  std::memcpy(&value, &x, sizeof(float));
+
+  return value;
+}
+
+float sign(float v) {
+  return (v < 0.0f) ? -1.0f : 1.0f;
+}
+
+int16_t quantizeSnorm(float v) {
+  return int16_t(std::nearbyint(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f));
+}
+
+void encodeNormal(const Surfel& s, PackedSurfel& p) {
+  float l1 = std::abs(s.nx) + std::abs(s.ny) + std::abs(s.nz);
+  if (l1 == 0.0f) {
+    p.normal[0] = p.normal[1] = 0;
+    return;
+  }
+
+  float x = s.nx / l1, y = s.ny / l1;
+  if (s.nz < 0.0f) {
+    float ox = (1.0f - std::abs(y)) * sign(x);
+    float oy = (1.0f - std::abs(x)) * sign(y);
+    x = ox;
+    y = oy;
+  }
+
+  p.normal[0] = quantizeSnorm(x);
+  p.normal[1] = quantizeSnorm(y);
+}
+
+void decodeNormal(const PackedSurfel& p, Surfel& s) {
+  float x = p.normal[0] / 32767.0f, y = p.normal[1] / 32767.0f;
+  float z = 1.0f - std::abs(x) - std::abs(y);
+  if (z < 0.0f) {
+    float ox = (1.0f - std::abs(y)) * sign(x);
+    float oy = (1.0f - std::abs(x)) * sign(y);
+    x = ox;
+    y = oy;
+  }
+
+  float length = std::sqrt(x * x + y * y + z * z);
+  s.nx = x / length;
+  s.ny = y / length;
+  s.nz = z / length;
+}
+
+/** \brief number of surfels of next chunk, such that timestamps and counts fit into 16 bit. **/
+uint32_t chunkSize(const Surfel* surfels, uint32_t count, ChunkHeader& header) {
+  int32_t min_t = surfels[0].timestamp, max_t = min_t;
+  int32_t min_c = int32_t(surfels[0].count), max_c = min_c;
+  float min_p[3] = {surfels[0].x, surfels[0].y, surfels[0].z};
+  float max_p[3] = {surfels[0].x, surfels[0].y, surfels[0].z};
+
+  uint32_t n = 1;
+  for (; n < std::min(count, SurfelPacking::CHUNK_SIZE); ++n) {
+    const Surfel& s = surfels[n];
+    int32_t c = int32_t(s.count);
+    if (std::max(max_t, s.timestamp) - std::min(min_t, s.timestamp) > 0xFFFF) break;
+    if (std::max(max_c, c) - std::min(min_c, c) > 0xFFFF) break;
+
+    min_t = std::min(min_t, s.timestamp);
+    max_t = std::max(max_t, s.timestamp);
+    min_c = std::min(min_c, c);
+    max_c = std::max(max_c, c);
+
+    const float p[3] = {s.x, s.y, s.z};
+    for (uint32_t d = 0; d < 3; ++d) {
+      min_p[d] = std::min(min_p[d], p[d]);
+      max_p[d] = std::max(max_p[d], p[d]);
+    }
+  }
+
+  for (uint32_t d = 0; d < 3; ++d) {
+    header.origin[d] = min_p[d];
+    header.step[d] = std::max((max_p[d] - min_p[d]) / 65535.0f, std::numeric_limits<float>::min());
+  }
+  header.timestamp = min_t;
+  header.count = min_c;
+  header.size = n;
+
+  return n;
+}
+
+void packScalar(const Surfel* surfels, const ChunkHeader& header, PackedSurfel* packed) {
+  for (uint32_t k = 0; k < header.size; ++k) {
+    const Surfel& s = surfels[k];
+    PackedSurfel& p = packed[k];
+
+    const float position[3] = {s.x, s.y, s.z};
+    for (uint32_t d = 0; d < 3; ++d) {
+      float q = (position[d] - header.origin[d]) * (1.0f / header.step[d]);
+      p.position[d] = uint16_t(std::nearbyint(std::max(0.0f, std::min(65535.0f, q))));
+    }
+
+    encodeNormal(s, p);
+    p.radius = floatToHalf(s.radius);
+    p.confidence = floatToHalf(s.confidence);
+    p.weight = floatToHalf(s.weight);
+    p.timestamp = uint16_t(s.timestamp - header.timestamp);
+    p.count = uint16_t(int32_t(s.count) - header.count);
+  }
+}
+
+void unpackScalar(const PackedSurfel* packed, const ChunkHeader& header, Surfel* surfels) {
+  for (uint32_t k = 0; k < header.size; ++k) {
+    const PackedSurfel& p = packed[k];
+    Surfel& s = surfels[k];
+
+    s.x = header.origin[0] + float(p.position[0]) * header.step[0];
+    s.y = header.origin[1] + float(p.position[1]) * header.step[1];
+    s.z = header.origin[2] + float(p.position[2]) * header.step[2];
+
+    decodeNormal(p, s);
+    s.radius = halfToFloat(p.radius);
+    s.confidence = halfToFloat(p.confidence);
+    s.weight = halfToFloat(p.weight);
+    s.timestamp = header.timestamp + p.timestamp;
+    s.count = float(header.count + p.count);
+    s.color = SurfelPacking::COLOR;
+  }
+}
+
+#ifdef SURFEL_PACKING_X86
+__attribute__((target("sse4.1,f16c"))) void packSimd(const Surfel* surfels, const ChunkHeader& header,
+                                                       PackedSurfel* packed) {
+  const __m128 origin = _mm_setr_ps(header.origin[0], header.origin[1], header.origin[2], 0.0f);
+  const __m128 inv_step =
+      _mm_setr_ps(1.0f / header.step[0], 1.0f / header.step[1], 1.0f / header.step[2], 0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 max = _mm_set1_ps(65535.0f);
+
+  for (uint32_t k = 0; k < header.size; ++k) {
+    const Surfel& s = surfels[k];
+    PackedSurfel& p = packed[k];
+
+    // x, y, z, radius; the radius lane is multiplied by zero.
+    __m128 q = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&s.x), origin), inv_step);
+    q = _mm_min_ps(_mm_max_ps(q, zero), max);
+    __m128i position = _mm_packus_epi32(_mm_cvtps_epi32(q), _mm_setzero_si128());
+    p.position[0] = _mm_extract_epi16(position, 0);
+    p.position[1] = _mm_extract_epi16(position, 1);
+    p.position[2] = _mm_extract_epi16(position, 2);
+
+    __m128i halfs = _mm_cvtps_ph(_mm_setr_ps(s.radius, s.confidence, s.weight, 0.0f), _MM_FROUND_TO_NEAREST_INT);
+    p.radius = _mm_extract_epi16(halfs, 0);
+    p.confidence = _mm_extract_epi16(halfs, 1);
+    p.weight = _mm_extract_epi16(halfs, 2);
+
+    encodeNormal(s, p);
+    p.timestamp = uint16_t(s.timestamp - header.timestamp);
+    p.count = uint16_t(int32_t(s.count) - header.count);
+  }
+}
+
+__attribute__((target("sse4.1,f16c"))) void unpackSimd(const PackedSurfel* packed, const ChunkHeader& header,
+                                                         Surfel* surfels) {
+  const __m128 origin = _mm_setr_ps(header.origin[0], header.origin[1], header.origin[2], 0.0f);
+  const __m128 step = _mm_setr_ps(header.step[0], header.step[1], header.step[2], 0.0f);
+
+  for (uint32_t k = 0; k < header.size; ++k) {
+    const PackedSurfel& p = packed[k];
+    Surfel& s = surfels[k];
+
+    // position and radius are loaded together, i.e., the radius is decoded in the fourth lane.
+    __m128i position = _mm_setr_epi16(p.position[0], p.position[1], p.position[2], 0, 0, 0, 0, 0);
+    __m128 xyz = _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(position)), step));
+
+    __m128i halfs = _mm_setr_epi16(p.radius, p.confidence, p.weight, 0, 0, 0, 0, 0);
+    __m128 values = _mm_cvtph_ps(halfs);
+
+    __m128 xyzr = _mm_blend_ps(xyz, _mm_shuffle_ps(values, values, _MM_SHUFFLE(0, 0, 0, 0)), 0x8);
+    _mm_storeu_ps(&s.x, xyzr);
+
+    float v[4];
+    _mm_storeu_ps(v, values);
+    s.confidence = v[1];
+    s.weight = v[2];
+
+    decodeNormal(p, s);
+    s.timestamp = header.timestamp + p.timestamp;
+    s.count = float(header.count + p.count);
+    s.color = SurfelPacking::COLOR;
+  }
+}
+#endif
+}
+
+bool SurfelPacking::simdSupported() {
+#ifdef SURFEL_PACKING_X86
+  static const bool supported = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("f16c");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void SurfelPacking::pack(const Surfel* surfels, uint32_t count, std::vector<char>& packed, bool simd) {
+  simd = simd && simdSupported();
+
+  uint32_t offset = 0;
+  while (offset < count) {
+    ChunkHeader header;
+    uint32_t n = chunkSize(surfels + offset, count - offset, header);
+
+    uint64_t start = packed.size();
+    packed.resize(start + sizeof(ChunkHeader) + n * sizeof(PackedSurfel));
+    std::memcpy(&packed[start], &header, sizeof(ChunkHeader));
+
+    // the chunk data is copied to ensure the alignment.
+    std::vector<PackedSurfel> chunk(n);
+#ifdef SURFEL_PACKING_X86
+    if (simd)
+      packSimd(surfels + offset, header, chunk.data());
+    else
+#endif
+      packScalar(surfels + offset, header, chunk.data());
+
+    std::memcpy(&packed[start + sizeof(ChunkHeader)], chunk.data(), n * sizeof(PackedSurfel));
+    offset += n;
+  }
+}
+
+void SurfelPacking::unpack(const char* packed, uint64_t size, std::vector<Surfel>& surfels, bool simd) {
+  simd = simd && simdSupported();
+
+  uint64_t offset = 0;
+  std::vector<PackedSurfel> chunk;
+  while (offset < size) {
+    ChunkHeader header;
+    if (size - offset < sizeof(ChunkHeader)) throw std::runtime_error("SurfelPacking: truncated chunk header.");
+    std::memcpy(&header, packed + offset, sizeof(ChunkHeader));
+    offset += sizeof(ChunkHeader);
+
+    if (header.size > CHUNK_SIZE || (size - offset) / sizeof(PackedSurfel) < header.size) {
+      throw std::runtime_error("SurfelPacking: truncated chunk.");
+    }
+
+    chunk.resize(header.size);
+    std::memcpy(chunk.data(), packed + offset, header.size * sizeof(PackedSurfel));
+    offset += header.size * sizeof(PackedSurfel);
+
+    uint64_t start = surfels.size();
+    surfels.resize(start + header.size);
+#ifdef SURFEL_PACKING_X86
+    if (simd)
+      unpackSimd(chunk.data(), header, &surfels[start]);
+    else
+#endif
+      unpackScalar(chunk.data(), header, &surfels[start]);
+  }
+}
+
+uint64_t SurfelPacking::count(const char* packed, uint64_t size) {
+  uint64_t offset = 0, num_surfels = 0;
+  while (offset + sizeof(ChunkHeader) <= size) {
+    ChunkHeader header;
+    std::memcpy(&header, packed + offset, sizeof(ChunkHeader));
+    num_surfels += header.size;
+    offset += sizeof(ChunkHeader) + uint64_t(header.size) * sizeof(PackedSurfel);
+  }
+
+  return num_surfels;
+}
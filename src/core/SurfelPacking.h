@@ -0,0 +1,54 @@
+#ifndef SRC_CORE_SURFELPACKING_H_
+#define SRC_CORE_SURFELPACKING_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Surfel.h"
+
+/** \brief compact encoding of surfels with 20 bytes instead of 48 bytes per surfel.
+ *
+ *  Surfels are encoded in chunks of at most CHUNK_SIZE consecutive surfels. Every chunk starts with a header
+ *  containing the bounding box of the positions and the minimal timestamp and creation timestamp (count). Per
+ *  surfel, the encoding stores
+ *    - the position quantized with 16 bit per coordinate relative to the bounding box,
+ *    - the octahedral encoding of the normal with 16 bit per component,
+ *    - radius, confidence, and weight as half precision floats,
+ *    - timestamp and count as 16 bit offsets to the minimum of the chunk.
+ *  A chunk ends early if the timestamps of its surfels span more than 16 bit.
+ *
+ *  The round-trip error is bounded by:
+ *    - position: half of the quantization step, i.e., extent of the chunk's bounding box / 131070 per coordinate,
+ *    - normal: MAX_NORMAL_ERROR (angle in radians); zero normals are decoded as (0, 0, 1),
+ *    - radius, confidence, weight: relative error of 2^-11 (in the normal range of half precision floats),
+ *    - timestamp and count are exact.
+ *  The color is not stored, since the update of the surfels overwrites it anyway; it is decoded as gray.
+ *
+ *  With SSE4.1 and F16C, the quantization and the conversion to half precision floats use SIMD instructions,
+ *  which produce the same results as the scalar code.
+ *
+ *  \author behley
+ **/
+class SurfelPacking {
+ public:
+  SurfelPacking() = delete;
+
+  /** \brief append encoding of the given surfels to packed. **/
+  static void pack(const Surfel* surfels, uint32_t count, std::vector<char>& packed, bool simd = true);
+
+  /** \brief decode size bytes generated by pack() and append the surfels; throws std::runtime_error if invalid. **/
+  static void unpack(const char* packed, uint64_t size, std::vector<Surfel>& surfels, bool simd = true);
+
+  /** \brief number of surfels encoded in the given bytes. **/
+  static uint64_t count(const char* packed, uint64_t size);
+
+  /** \brief true, if the CPU supports the SIMD path. **/
+  static bool simdSupported();
+
+  static const uint32_t CHUNK_SIZE = 4096;
+  static const uint32_t PACKED_SIZE = 20;  // bytes per surfel.
+  static const float MAX_NORMAL_ERROR;
+  static const float COLOR;  // color of decoded surfels.
+};
+
+#endif /* SRC_CORE_SURFELPACKING_H_ */
@@ -0,0 +1,158 @@
+#ifndef SRC_CORE_PARALLEL_H_
+#define SRC_CORE_PARALLEL_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** \brief persistent worker threads for data-parallel loops.
+ *
+ *  parallel_for(n, func) splits [0, n) into at most size() equally sized chunks and calls func(chunk, begin, end)
+ *  for every chunk, where chunk in [0, number of chunks) can be used to access per-thread data, e.g., partial sums.
+ *  The calling thread processes the last chunk; the other chunks are processed by workers, which are started once
+ *  and wait for the next loop afterwards. Thus, no threads are started per call.
+ *
+ *  An exception thrown by func is rethrown in the calling thread. Concurrent calls of parallel_for are executed one
+ *  after another. Thus, a single pool, e.g., shared(), can be used by all components without oversubscribing the
+ *  cores; max_chunks limits the number of threads of a single loop.
+ *
+ *  \author behley
+ **/
+class ThreadPool {
+ public:
+  using Function = std::function<void(uint32_t, uint32_t, uint32_t)>;
+
+  explicit ThreadPool(uint32_t num_threads = 1) { resize(num_threads); }
+  ~ThreadPool() { stop(); }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /** \brief number of threads including the calling thread. **/
+  uint32_t size() const { return workers_.size() + 1; }
+
+  void resize(uint32_t num_threads) {
+    num_threads = std::max<uint32_t>(1, num_threads);
+    if (num_threads == size()) return;
+
+    stop();
+    stop_ = false;
+    // workers must not miss a loop started before they are running.
+    for (uint32_t i = 0; i + 1 < num_threads; ++i) workers_.emplace_back(&ThreadPool::run, this, i, generation_);
+  }
+
+  /** \brief pool with one thread per core, which is shared by all components of the process. **/
+  static ThreadPool& shared();
+
+  /** \return number of chunks, which is at most max_chunks, if max_chunks > 0. **/
+  uint32_t parallel_for(uint32_t n, const Function& func, uint32_t max_chunks = 0) {
+    uint32_t num_chunks = std::max<uint32_t>(1, std::min(size(), n));
+    if (max_chunks > 0) num_chunks = std::min(num_chunks, max_chunks);
+    if (num_chunks == 1) {
+      func(0, 0, n);
+      return 1;
+    }
+
+    std::lock_guard<std::mutex> call_lock(call_mutex_);
+
+    uint32_t chunk_size = (n + num_chunks - 1) / num_chunks;
+    num_chunks = (n + chunk_size - 1) / chunk_size;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      func_ = &func;
+      n_ = n;
+      chunk_size_ = chunk_size;
+      num_chunks_ = num_chunks;
+      pending_ = workers_.size();
+      error_ = nullptr;
+      generation_ += 1;
+    }
+    start_.notify_all();
+
+    std::exception_ptr error;
+    try {
+      func(num_chunks - 1, (num_chunks - 1) * chunk_size, n);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+    func_ = nullptr;
+    if (error == nullptr) error = error_;
+    lock.unlock();
+
+    if (error != nullptr) std::rethrow_exception(error);
+
+    return num_chunks;
+  }
+
+ protected:
+  void run(uint32_t chunk, uint64_t generation) {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+      if (stop_) return;
+      generation = generation_;
+
+      // workers without chunk only report that they are done.
+      if (chunk + 1 < num_chunks_) {
+        const Function& func = *func_;
+        uint32_t begin = chunk * chunk_size_, end = std::min(n_, (chunk + 1) * chunk_size_);
+        lock.unlock();
+
+        try {
+          func(chunk, begin, end);
+        } catch (...) {
+          std::lock_guard<std::mutex> error_lock(mutex_);
+          error_ = std::current_exception();
+        }
+
+        lock.lock();
+      }
+
+      if (--pending_ == 0) done_.notify_one();
+    }
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+    workers_.clear();
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex call_mutex_;  // serializes calls of parallel_for.
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+
+  const Function* func_{nullptr};
+  uint32_t n_{0}, chunk_size_{0}, num_chunks_{0};
+  uint32_t pending_{0};  // workers, which have not finished the current loop.
+  uint64_t generation_{0};
+  std::exception_ptr error_;
+  bool stop_{false};
+};
+
+/** \brief number of worker threads: given number, or all cores if num_threads <= 0. **/
+inline uint32_t getNumThreads(int32_t num_threads) {
+  if (num_threads > 0) return num_threads;
+  return std::max<uint32_t>(1, std::thread::hardware_concurrency());
+}
+
+inline ThreadPool& ThreadPool::shared() {
+  static ThreadPool pool(getNumThreads(0));
+  return pool;
+}
+
+#endif /* SRC_CORE_PARALLEL_H_ */
@@ -0,0 +1,177 @@
+// headless batch processing of a KITTI sequence without any window system.
+#include <core/SurfelMapping.h>
+#include <rv/FileUtil.h>
+#include <rv/Stopwatch.h>
+#include <rv/Tracer.h>
+#include <rv/string_utils.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "io/KITTIReader.h"
+#include "io/MappedScan.h"
+#include "opengl/EGLOffscreenContext.h"
+
+using namespace rv;
+
+int main(int argc, char** argv) {
+  setlocale(LC_NUMERIC, "C");
+
+  if (argc < 4) {
+    std::cerr << "Missing parameters: ./headless [parameter] [scan file] [pose output file] [<max number of scans>]"
+              << std::endl;
+    return 1;
+  }
+
+  if (!rv::FileUtil::exists(argv[2])) {
+    std::cerr << "Error: scan file '" << argv[2] << "' not found." << std::endl;
+    return 1;
+  }
+
+  EGLOffscreenContext ctx;  // needs to be generated before any OpenGL object is created.
+
+  ParameterList params;
+  parseXmlFile(argv[1], params);
+
+  uint32_t maxScans = std::numeric_limits<uint32_t>::max();
+  if (argc > 4) maxScans = std::stoi(argv[4]);
+
+  // checkpoints of the complete mapping state every checkpoint-interval scans; resume continues from checkpoint-file.
+  int32_t checkpointInterval = 0;
+  std::string checkpointFile = "checkpoint.bin";
+  bool resume = false;
+  if (params.hasParam("checkpoint-interval")) checkpointInterval = params["checkpoint-interval"];
+  if (params.hasParam("checkpoint-file")) checkpointFile = std::string(params["checkpoint-file"]);
+  if (params.hasParam("resume")) resume = params["resume"];
+
+  std::string mapFile;  // tiled surfel map written after processing; empty = off.
+  if (params.hasParam("map-output")) mapFile = std::string(params["map-output"]);
+
+  std::string localizationMap;  // prebuilt map, which is only used for localization; empty = mapping.
+  if (params.hasParam("localization-map")) localizationMap = std::string(params["localization-map"]);
+  if (resume && !localizationMap.empty()) {
+    std::cerr << "Error: resume and localization-map cannot be combined." << std::endl;
+    return 1;
+  }
+
+  // scans are memory-mapped and directly uploaded without copy; the kernel reads the next file ahead.
+  KITTIReader reader(argv[2]);
+  SurfelMapping fusion(params);
+
+  if (resume) {
+    fusion.restore(checkpointFile);
+    reader.seek(fusion.timestamp());
+    std::cout << "Resuming from " << checkpointFile << " at scan " << fusion.timestamp() << "." << std::endl;
+  }
+
+  if (!localizationMap.empty()) {
+    fusion.localize(localizationMap);
+    std::cout << "Localizing against " << localizationMap << "." << std::endl;
+
+    // pose of the first scan in the map as 12 values of a KITTI pose, i.e., row-major 3x4 matrix.
+    if (params.hasParam("initial-pose")) {
+      std::vector<std::string> entries = rv::split(rv::trim(std::string(params["initial-pose"])), " ", true);
+      if (entries.size() != 12) {
+        std::cerr << "Error: initial-pose needs 12 values, but got " << entries.size() << "." << std::endl;
+        return 1;
+      }
+
+      Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+      for (uint32_t i = 0; i < 12; ++i) pose(i / 4, i % 4) = std::stof(entries[i]);
+      fusion.setCurrentPose(pose);
+    }
+  }
+
+  // per-frame log of all metrics, either CSV (.csv) or JSON lines.
+  Metrics& metrics = fusion.metrics();
+  Metrics::Handle frameTime = metrics.histogram("frame-time");
+  if (params.hasParam("metrics-log")) metrics.open(std::string(params["metrics-log"]));
+
+  // spans of all threads as Chrome trace, see chrome://tracing or https://ui.perfetto.dev.
+  std::string traceFile;
+  if (params.hasParam("trace-file")) traceFile = std::string(params["trace-file"]);
+  Tracer::setEnabled(!traceFile.empty());
+  Tracer::setThreadName("mapping");
+
+  MappedScan scan, next;
+  uint32_t N = std::min(reader.count(), maxScans);
+
+  Stopwatch::tic();
+  bool hasScan = (fusion.timestamp() < N) && reader.read(scan);
+  while (hasScan) {
+    // with parameter pipelined, the next scan is already pre-processed while the map is updated.
+    bool hasNext = (fusion.timestamp() + 1 < N) && reader.read(next);
+
+    Stopwatch::tic();
+    if (hasNext)
+      fusion.processScan(scan.points(), scan.size(), next.points(), next.size());
+    else
+      fusion.processScan(scan.points(), scan.size());
+    metrics.record(frameTime, Stopwatch::toc());
+    metrics.commit(fusion.timestamp() - 1);
+
+    if (fusion.timestamp() % 100 == 0) std::cout << "Processed " << fusion.timestamp() << "/" << N << std::endl;
+    if (checkpointInterval > 0 && fusion.timestamp() % checkpointInterval == 0) fusion.checkpoint(checkpointFile);
+
+    std::swap(scan, next);
+    hasScan = hasNext;
+  }
+  fusion.waitCheckpoints();
+  double completeTime = Stopwatch::toc();
+
+  // write poses in KITTI format.
+  std::ofstream out(argv[3]);
+  std::vector<Eigen::Matrix4d> poses = fusion.getOptimizedPoses();
+  for (uint32_t i = 0; i < poses.size(); ++i) {
+    Eigen::Matrix4f pose = poses[i].cast<float>();
+    for (uint32_t r = 0; r < 3; ++r) {
+      for (uint32_t c = 0; c < 4; ++c) {
+        out << ((r == 0 && c == 0) ? "" : " ") << pose(r, c);
+      }
+    }
+    out << std::endl;
+  }
+  out.close();
+
+  std::cout << "Wrote " << poses.size() << " poses to " << argv[3] << "." << std::endl;
+
+  if (!mapFile.empty()) {
+    fusion.getMap()->save(mapFile);
+    std::cout << "Wrote map to " << mapFile << "." << std::endl;
+  }
+
+  metrics.close();
+  if (!traceFile.empty()) {
+    Tracer::write(traceFile);
+    std::cout << "Wrote " << Tracer::size() << " spans to " << traceFile << "." << std::endl;
+  }
+
+  // throughput report.
+  uint64_t numFrames = metrics.summary(frameTime).count;
+  std::cout << "Processed " << numFrames << " scans in " << completeTime << " s (" << numFrames / completeTime
+            << " frames/s)." << std::endl;
+  std::cout << std::setw(30) << std::left << "latency" << std::right << std::setw(14) << "p50" << std::setw(14)
+            << "p95" << std::setw(14) << "p99" << std::setw(14) << "max" << std::endl;
+  for (Metrics::Handle h = 0; h < metrics.size(); ++h) {
+    Metrics::Summary summary = metrics.summary(h);
+    if (metrics.type(h) != Metrics::Type::HISTOGRAM || summary.count == 0) continue;
+    std::cout << std::setw(30) << std::left << metrics.name(h) << std::right << std::setw(14) << summary.p50
+              << std::setw(14) << summary.p95 << std::setw(14) << summary.p99 << std::setw(14) << summary.max
+              << std::endl;
+  }
+
+  // memory report, e.g., to choose surfel-capacity for a sensor.
+  std::cout << std::setw(30) << std::left << "buffer [MB]" << std::right << std::setw(14) << "allocated"
+            << std::setw(14) << "used" << std::setw(14) << "peak" << std::endl;
+  for (const SurfelMap::MemoryUsage& usage : fusion.getMap()->memoryUsage()) {
+    const double MB = 1024.0 * 1024.0;
+    std::cout << std::setw(30) << std::left << usage.name << std::right << std::setw(14)
+              << usage.allocatedBytes / MB << std::setw(14) << usage.usedBytes / MB << std::setw(14)
+              << usage.peakBytes / MB << std::endl;
+  }
+
+  return 0;
+}
@@ -5,7 +5,11 @@
 #include <cmath>
 #include <fstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <glow/glutil.h>
+#include <rv/Tracer.h>
 #include <rv/XmlDocument.h>
 #include <rv/string_utils.h>
 #include <boost/lexical_cast.hpp>
@@ -125,21 +129,17 @@ uint32_t KITTIReader::count() const {
 }
 
 bool KITTIReader::read(uint32_t scan_idx, Laserscan& scan) {
-  if (scan_idx > scan_filenames.size()) return false;
+  ScopedTrace trace("readScan");
+  if (scan_idx >= scan_filenames.size()) return false;
 
-  std::ifstream in(scan_filenames[scan_idx].c_str(), std::ios::binary);
-  if (!in.is_open()) return false;
+  MappedScan mapped;
+  if (!mapped.map(scan_filenames[scan_idx], readAhead_)) return false;
 
   scan.clear();
 
-  in.seekg(0, std::ios::end);
-  uint32_t num_points = in.tellg() / (4 * sizeof(float));
-  in.seekg(0, std::ios::beg);
-
-  std::vector<float> values(4 * num_points);
-  in.read((char*)&values[0], 4 * num_points * sizeof(float));
+  const uint32_t num_points = mapped.size();
+  const float* values = mapped.data();
 
-  in.close();
   std::vector<Point3f>& points = scan.points_;
   std::vector<float>& remissions = scan.remissions_;
 
@@ -147,19 +147,42 @@ bool KITTIReader::read(uint32_t scan_idx, Laserscan& scan) {
   remissions.resize(num_points);
 
   float max_remission = 0;
+  for (uint32_t i = 0; i < num_points; ++i) max_remission = std::max(values[4 * i + 3], max_remission);
 
   for (uint32_t i = 0; i < num_points; ++i) {
     points[i].x() = values[4 * i];
     points[i].y() = values[4 * i + 1];
     points[i].z() = values[4 * i + 2];
-    remissions[i] = values[4 * i + 3];
-    max_remission = std::max(remissions[i], max_remission);
+    remissions[i] = values[4 * i + 3] / max_remission;
   }
 
-  for (uint32_t i = 0; i < num_points; ++i) {
-    remissions[i] /= max_remission;
+  return true;
+}
+
+bool KITTIReader::read(MappedScan& scan) {
+  ScopedTrace trace("mapScan");
+  if (currentScan >= (int32_t)scan_filenames.size()) return false;
+
+  bool result = scan.map(scan_filenames[currentScan], readAhead_);
+  ++currentScan;
+
+  // mapped scans are not buffered; keep buffer consistent for seek.
+  bufferedScans.clear();
+  firstBufferedScan = currentScan;
+
+  // let the kernel already load the next file into the page cache.
+  if (readAhead_ && currentScan < (int32_t)scan_filenames.size()) {
+    int fd = open(scan_filenames[currentScan].c_str(), O_RDONLY);
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+      close(fd);
+    }
   }
 
-  return true;
+  return result;
+}
+
+void KITTIReader::setReadAhead(bool readAhead) {
+  readAhead_ = readAhead;
 }
 }
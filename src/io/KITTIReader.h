@@ -3,6 +3,7 @@
 #define KITTILASERSCANREADER_H_
 
 #include "LaserscanReader.h"
+#include "MappedScan.h"
 
 #include <rv/ParameterList.h>
 #include <rv/RingBuffer.h>
@@ -24,6 +25,16 @@ class KITTIReader : public LaserscanReader {
   bool isSeekable() const override;
   uint32_t count() const override;
 
+  /** \brief map next scan without any copy; bypasses the scan buffer.
+   *
+   *  The view is valid until the next call with the same MappedScan or its destruction. In contrast to
+   *  read(Laserscan&), the remissions are not normalized.
+   **/
+  bool read(MappedScan& scan);
+
+  /** \brief advise the kernel to read ahead the mapped scan and the following scan file. **/
+  void setReadAhead(bool readAhead);
+
  protected:
   void initScanFilenames(const std::string& scan_filename);
 
@@ -33,6 +44,7 @@ class KITTIReader : public LaserscanReader {
   std::vector<std::string> scan_filenames;
   RingBuffer<Laserscan> bufferedScans;
   uint32_t firstBufferedScan;
+  bool readAhead_{true};
 
 };
 }
@@ -0,0 +1,80 @@
+#include "MappedScan.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace rv {
+
+static_assert(sizeof(Point3f) == 4 * sizeof(float), "Point3f must consist of exactly 4 floats.");
+
+MappedScan::~MappedScan() {
+  unmap();
+}
+
+MappedScan::MappedScan(MappedScan&& other) {
+  *this = std::move(other);
+}
+
+MappedScan& MappedScan::operator=(MappedScan&& other) {
+  if (this != &other) {
+    unmap();
+    std::swap(address_, other.address_);
+    std::swap(length_, other.length_);
+    std::swap(data_, other.data_);
+    std::swap(num_points_, other.num_points_);
+  }
+
+  return *this;
+}
+
+bool MappedScan::map(const std::string& filename, bool sequential) {
+  unmap();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  length_ = st.st_size;
+  if (length_ == 0) {
+    close(fd);
+    return true;  // empty scan.
+  }
+
+  void* address = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // mapping stays valid.
+
+  if (address == MAP_FAILED) {
+    length_ = 0;
+    return false;
+  }
+
+  if (sequential) {
+    madvise(address, length_, MADV_SEQUENTIAL);
+    madvise(address, length_, MADV_WILLNEED);
+  }
+
+  address_ = address;
+  data_ = reinterpret_cast<const float*>(address);  // page aligned, i.e., also aligned for Eigen::Vector4f.
+  num_points_ = length_ / (4 * sizeof(float));
+
+  return true;
+}
+
+void MappedScan::unmap() {
+  if (address_ != nullptr) munmap(address_, length_);
+
+  address_ = nullptr;
+  length_ = 0;
+  data_ = nullptr;
+  num_points_ = 0;
+}
+}
@@ -0,0 +1,57 @@
+#ifndef SRC_IO_MAPPEDSCAN_H_
+#define SRC_IO_MAPPEDSCAN_H_
+
+#include <rv/geometry.h>
+
+#include <stdint.h>
+#include <string>
+
+namespace rv {
+
+/** \brief read-only, memory-mapped laser scan in KITTI format, i.e., interleaved x, y, z, remission as floats.
+ *
+ *  The data is directly accessed from the page cache without any copy. Since rv::Point3f consists of
+ *  four consecutive floats, the points can be directly used (and uploaded) as Point3f, where the fourth
+ *  coordinate contains the (not normalized) remission instead of 1.
+ *
+ *  With sequential access, the kernel is advised to read the complete file ahead (madvise).
+ *
+ *  \author behley
+ */
+class MappedScan {
+ public:
+  MappedScan() = default;
+  ~MappedScan();
+
+  MappedScan(const MappedScan&) = delete;
+  MappedScan& operator=(const MappedScan&) = delete;
+
+  MappedScan(MappedScan&& other);
+  MappedScan& operator=(MappedScan&& other);
+
+  /** \brief map given file and release previously mapped file; returns false if file cannot be mapped. **/
+  bool map(const std::string& filename, bool sequential = true);
+
+  /** \brief release mapping. **/
+  void unmap();
+
+  /** \brief interleaved x, y, z, remission values. **/
+  const float* data() const { return data_; }
+
+  /** \brief points with remission in the fourth coordinate. **/
+  const Point3f* points() const { return reinterpret_cast<const Point3f*>(data_); }
+
+  /** \brief number of points. **/
+  uint32_t size() const { return num_points_; }
+
+  bool empty() const { return num_points_ == 0; }
+
+ protected:
+  void* address_{nullptr};
+  size_t length_{0};
+  const float* data_{nullptr};
+  uint32_t num_points_{0};
+};
+}
+
+#endif /* SRC_IO_MAPPEDSCAN_H_ */
@@ -0,0 +1,128 @@
+#include "PrefetchingReader.h"
+
+#include <rv/Tracer.h>
+
+#include <stdexcept>
+
+namespace rv {
+
+PrefetchingReader::PrefetchingReader(const std::shared_ptr<LaserscanReader>& reader, uint32_t num_prefetched)
+    : reader_(reader), buffer_(num_prefetched) {
+  if (reader_ == nullptr) throw std::runtime_error("PrefetchingReader: no reader given.");
+  if (num_prefetched == 0) throw std::runtime_error("PrefetchingReader: at least one scan must be prefetched.");
+
+  start();
+}
+
+PrefetchingReader::~PrefetchingReader() {
+  stop();
+}
+
+void PrefetchingReader::start() {
+  head_ = 0;
+  tail_ = 0;
+  finished_ = false;
+  error_ = nullptr;
+  stop_ = false;
+  producer_waiting_ = false;
+  consumer_waiting_ = false;
+
+  worker_ = std::thread(&PrefetchingReader::run, this);
+}
+
+void PrefetchingReader::stop() {
+  stop_ = true;
+  notify();
+
+  if (worker_.joinable()) worker_.join();
+}
+
+void PrefetchingReader::run() {
+  Tracer::setThreadName("prefetching-reader");
+
+  const uint64_t capacity = buffer_.size();
+
+  while (!stop_) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load() == capacity) {
+      // buffer full: wait until the consumer takes a scan.
+      std::unique_lock<std::mutex> lock(mutex_);
+      producer_waiting_ = true;
+      cv_.wait(lock, [&] { return stop_ || head - tail_.load() < capacity; });
+      producer_waiting_ = false;
+      continue;
+    }
+
+    bool success = false;
+    try {
+      success = reader_->read(buffer_[head % capacity]);
+    } catch (...) {
+      error_ = std::current_exception();  // rethrown by read().
+    }
+
+    if (success)
+      head_.store(head + 1);
+    else
+      finished_ = true;
+    if (consumer_waiting_) notify();
+
+    if (!success) break;
+  }
+}
+
+void PrefetchingReader::notify() {
+  // taking the lock ensures that the waiting thread either sees the change or already waits.
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  cv_.notify_all();
+}
+
+bool PrefetchingReader::read(Laserscan& scan) {
+  const uint64_t capacity = buffer_.size();
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+
+  if (head_.load() == tail) {
+    // buffer empty: wait for the worker.
+    ScopedTrace trace("waitForScan");
+    std::unique_lock<std::mutex> lock(mutex_);
+    consumer_waiting_ = true;
+    cv_.wait(lock, [&] { return finished_ || head_.load() != tail; });
+    consumer_waiting_ = false;
+    if (head_.load() == tail) {
+      // no more scans.
+      if (error_ != nullptr) std::rethrow_exception(error_);
+      return false;
+    }
+  }
+
+  std::swap(scan, buffer_[tail % capacity]);
+
+  tail_.store(tail + 1);
+  if (producer_waiting_) notify();
+
+  return true;
+}
+
+void PrefetchingReader::reset() {
+  stop();
+  reader_->reset();
+  start();
+}
+
+bool PrefetchingReader::isSeekable() const {
+  return reader_->isSeekable();
+}
+
+void PrefetchingReader::seek(uint32_t scan) {
+  stop();
+  reader_->seek(scan);
+  start();
+}
+
+uint32_t PrefetchingReader::count() const {
+  return reader_->count();
+}
+
+uint32_t PrefetchingReader::available() const {
+  return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+}
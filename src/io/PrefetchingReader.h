@@ -0,0 +1,75 @@
+#ifndef SRC_IO_PREFETCHINGREADER_H_
+#define SRC_IO_PREFETCHINGREADER_H_
+
+#include "LaserscanReader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rv {
+
+/** \brief decorator reading the next scans of another reader in the background.
+ *
+ *  A worker thread reads ahead up to num_prefetched scans of the wrapped reader into a bounded
+ *  single-producer/single-consumer ring buffer. Thus, the decoding and file access overlap with
+ *  the processing of the current scan. Since readers are sequential, there is exactly one worker.
+ *
+ *  Pushing and popping is lock-free; the mutex and condition variable are only used if the
+ *  worker has to sleep because the buffer is full or the reading thread because the buffer is empty.
+ *
+ *  An exception of the wrapped reader ends the prefetching and is rethrown by read() after all scans read before
+ *  were returned.
+ *
+ *  seek() and reset() stop the worker, discard all prefetched scans, forward the call to the
+ *  wrapped reader, and restart prefetching from the new position.
+ *
+ *  \author behley
+ */
+class PrefetchingReader : public LaserscanReader {
+ public:
+  PrefetchingReader(const std::shared_ptr<LaserscanReader>& reader, uint32_t num_prefetched = 10);
+  ~PrefetchingReader();
+
+  PrefetchingReader(const PrefetchingReader&) = delete;
+  PrefetchingReader& operator=(const PrefetchingReader&) = delete;
+
+  void reset() override;
+  bool read(Laserscan& scan) override;
+  bool isSeekable() const override;
+  void seek(uint32_t scan) override;
+  uint32_t count() const override;
+
+  /** \brief number of scans that are ready to be read. **/
+  uint32_t available() const;
+
+ protected:
+  void start();
+  void stop();
+
+  void run();
+
+  /** \brief wake up waiting thread. **/
+  void notify();
+
+  std::shared_ptr<LaserscanReader> reader_;
+
+  std::vector<Laserscan> buffer_;
+  std::atomic<uint64_t> head_{0};  // next slot written by the worker.
+  std::atomic<uint64_t> tail_{0};  // next slot read by the consumer.
+  std::atomic<bool> finished_{false};
+  std::exception_ptr error_;  // written by the worker before finished_ is set.
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> producer_waiting_{false}, consumer_waiting_{false};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread worker_;
+};
+}
+
+#endif /* SRC_IO_PREFETCHINGREADER_H_ */
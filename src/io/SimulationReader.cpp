@@ -2,6 +2,7 @@
 
 #include <glow/glutil.h>
 #include <cmath>
+#include <stdexcept>
 
 using namespace rv;
 using namespace glow;
@@ -97,27 +98,58 @@ SimulationReader::SimulationReader(const std::string& filename) : rng_(1337) {
 
   addCube(glTranslate(-20, -54, 0.65) * glRotateZ(Radians(15.0f)) * glRotateX(Radians(2.0f)), 4.5f);
 
-  // Version 2 of HDL-64 E has this beam pattern (see specification)
-  float beam_angles[64];
-  for (int32_t i = 0; i < 32; ++i) beam_angles[i] = Radians(90.0f - 2.0f + i / 3.0f);
-  for (int32_t i = 0; i < 32; ++i) beam_angles[32 + i] = Radians(90.0f + 8.83f + i / 2.0f);
+  initBeams(64, 4 * 360);
+  initTrajectory(0);
+}
+
+void SimulationReader::initBeams(uint32_t num_beams, uint32_t num_columns) {
+  // elevation of the beams in degrees from top to bottom.
+  std::vector<float> elevations(num_beams);
+  if (num_beams == 64) {
+    // Version 2 of HDL-64 E has this beam pattern (see specification)
+    for (int32_t i = 0; i < 32; ++i) elevations[i] = 2.0f - i / 3.0f;
+    for (int32_t i = 0; i < 32; ++i) elevations[32 + i] = -8.83f - i / 2.0f;
+  } else {
+    // equally spaced beams of VLP-16, HDL-32E, and OS1-128.
+    float up = 0.0f, down = 0.0f;
+    if (num_beams == 16) {
+      up = 15.0f;
+      down = -15.0f;
+    } else if (num_beams == 32) {
+      up = 10.67f;
+      down = -30.67f;
+    } else if (num_beams == 128) {
+      up = 22.5f;
+      down = -22.5f;
+    } else {
+      throw std::runtime_error("SimulationReader: unsupported number of beams; use 16, 32, 64, or 128.");
+    }
+
+    for (uint32_t i = 0; i < num_beams; ++i) elevations[i] = up - i * (up - down) / (num_beams - 1);
+  }
+
+  fov_up_ = elevations.front();
+  fov_down_ = elevations.back();
 
   // precompute all beams.
-  beams_.reserve(4 * 360 * 64);
-  for (uint32_t i = 0; i < 4 * 360; ++i) {
-    float theta = Radians(float(i) / 4.0);
-    for (uint32_t j = 0; j < 64; ++j) {
+  beams_.clear();
+  beams_.reserve(num_columns * num_beams);
+  for (uint32_t i = 0; i < num_columns; ++i) {
+    float theta = Radians(360.0f * i / num_columns);
+    for (uint32_t j = 0; j < num_beams; ++j) {
+      float beam_angle = Radians(90.0f - elevations[j]);
+
       Eigen::Vector4f beam;
-      beam[0] = std::cos(theta) * std::sin(beam_angles[j]);
-      beam[1] = std::sin(theta) * std::sin(beam_angles[j]);
-      beam[2] = std::cos(beam_angles[j]);
+      beam[0] = std::cos(theta) * std::sin(beam_angle);
+      beam[1] = std::sin(theta) * std::sin(beam_angle);
+      beam[2] = std::cos(beam_angle);
       beam[3] = j;
 
       beams_.push_back(beam);
     }
   }
 
-  for (uint32_t i = 0; i < 64; ++i) calibration_.push_back(1.0f);
+  calibration_.assign(num_beams, 1.0f);
 
   //  calibration_[30] = 0.94f;
   //  calibration_[34] = 1.03f;
@@ -125,8 +157,13 @@ SimulationReader::SimulationReader(const std::string& filename) : rng_(1337) {
   //  calibration_[57] = 1.02f;
   //  calibration_[61] = 0.94f;
   //  calibration_[63] = 1.05f;
+}
+
+void SimulationReader::initTrajectory(uint32_t num_scans) {
+  rng_ = Random(1337);  // same trajectory for the same parameters.
 
   extrinsicPose_ = Eigen::Matrix4f::Identity();
+  trajectory_.clear();
 
   Eigen::Matrix4f T = glTranslate(0, 0, 2);
   trajectory_.push_back(T * extrinsicPose_);
@@ -174,11 +211,24 @@ SimulationReader::SimulationReader(const std::string& filename) : rng_(1337) {
     T = T * glTranslate(0.75 + sigma_speed_ * rng_.getGaussianFloat(), 0, 0);
     trajectory_.push_back(T * extrinsicPose_);
   }
+
+  // only a prefix of the complete trajectory.
+  if (num_scans > 0 && num_scans < trajectory_.size()) trajectory_.resize(num_scans);
 }
 
 void SimulationReader::setParameters(const ParameterList& params) {
-  sigma_noise_ = params["sigma_noise"];
-  sigma_speed_ = params["sigma_speed"];
+  if (params.hasParam("sigma_noise")) sigma_noise_ = params["sigma_noise"];
+  if (params.hasParam("sigma_speed")) sigma_speed_ = params["sigma_speed"];
+
+  uint32_t num_beams = calibration_.size(), num_columns = beams_.size() / calibration_.size(), num_scans = 0;
+  if (params.hasParam("simulation_beams")) num_beams = params["simulation_beams"];
+  if (params.hasParam("simulation_columns")) num_columns = params["simulation_columns"];
+  if (params.hasParam("simulation_scans")) num_scans = params["simulation_scans"];
+
+  // the trajectory depends on sigma_speed.
+  initBeams(num_beams, num_columns);
+  initTrajectory(num_scans);
+  timestamp_ = 0;
 }
 
 void SimulationReader::reset() {
@@ -189,7 +239,7 @@ bool SimulationReader::read(rv::Laserscan& scan) {
   scan.clear();
   if (timestamp_ >= trajectory_.size()) return false;
   if (buffer_.size() > timestamp_) {
-    scan = buffer_[timestamp_];
+    scan = buffer_[timestamp_++];
     return true;
   }
 
@@ -224,6 +274,7 @@ bool SimulationReader::read(rv::Laserscan& scan) {
       scan.points().push_back(Point3f(p[0], p[1], p[2]));
     }
   }
+  timestamp_ += 1;  // like other readers, read() advances to the next scan.
 
   return true;
 }
@@ -5,7 +5,12 @@
 #include <rv/Random.h>
 #include <rv/ParameterList.h>
 
-/** \brief simple generator of simulated laser scan data. **/
+/** \brief simple generator of simulated laser scan data.
+ *
+ *  Scans are generated by ray casting against a world of planes and cubes along a fixed trajectory, where the
+ *  number of beams, i.e., the sensor, the number of columns, and the number of scans can be set with the parameters
+ *  simulation_beams (16, 32, 64, or 128), simulation_columns, and simulation_scans (0 = complete trajectory).
+ **/
 class SimulationReader : public rv::LaserscanReader {
  public:
   SimulationReader(const std::string& filename);
@@ -22,8 +27,15 @@ class SimulationReader : public rv::LaserscanReader {
 
   const std::vector<Eigen::Matrix4f>& getTrajectory() const;
 
+  /** \brief set noise and sensor parameters; regenerates beams and trajectory. **/
   void setParameters(const rv::ParameterList& params);
 
+  /** \brief vertical field of view of the simulated sensor in degrees, i.e., data_fov_up and data_fov_down. **/
+  float fovUp() const { return fov_up_; }
+  float fovDown() const { return fov_down_; }
+
+  uint32_t numBeams() const { return calibration_.size(); }
+
  protected:
   class Ray {
    public:
@@ -45,6 +57,9 @@ class SimulationReader : public rv::LaserscanReader {
    * ray. **/
   bool intersect(const Ray& ray, const Triangle& triangle, float& t);
 
+  void initBeams(uint32_t num_beams, uint32_t num_columns);
+  void initTrajectory(uint32_t num_scans);
+
   void addCube(const Eigen::Matrix4f& pose, float size);
   void addPlane(const Eigen::Matrix4f& pose, float size);
 
@@ -56,6 +71,7 @@ class SimulationReader : public rv::LaserscanReader {
   std::vector<Eigen::Vector4f> beams_;
   std::vector<float> calibration_;
   Eigen::Matrix4f extrinsicPose_;
+  float fov_up_{0.0f}, fov_down_{0.0f};
 
   rv::Random rng_;
   float sigma_noise_{0.0f};
@@ -0,0 +1,78 @@
+#include "EGLOffscreenContext.h"
+
+#include <glow/glbase.h>
+
+#include <EGL/eglext.h>
+#include <stdexcept>
+#include <string>
+
+EGLOffscreenContext::EGLOffscreenContext(int32_t major_version, int32_t minor_version) {
+  // 1. get display: prefer the surfaceless platform, which needs no X server at all.
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay != nullptr) {
+    display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (display_ == EGL_NO_DISPLAY) display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display_ == EGL_NO_DISPLAY) throw std::runtime_error("EGLOffscreenContext: no EGL display available.");
+
+  EGLint egl_major, egl_minor;
+  if (!eglInitialize(display_, &egl_major, &egl_minor)) {
+    throw std::runtime_error("EGLOffscreenContext: unable to initialize EGL.");
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) throw std::runtime_error("EGLOffscreenContext: OpenGL API not supported.");
+
+  // 2. choose config & create core profile context.
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                  EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) || num_configs == 0) {
+    throw std::runtime_error("EGLOffscreenContext: no suitable EGL config.");
+  }
+
+  const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                    major_version,
+                                    EGL_CONTEXT_MINOR_VERSION,
+                                    minor_version,
+                                    EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                    EGL_NONE};
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs);
+  if (context_ == EGL_NO_CONTEXT) {
+    throw std::runtime_error("EGLOffscreenContext: unable to create OpenGL " + std::to_string(major_version) + "." +
+                             std::to_string(minor_version) + " core profile context.");
+  }
+
+  // 3. we render only into framebuffer objects, but some implementations need a surface anyway.
+  if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface_ = eglCreatePbufferSurface(display_, config, pbuffer_attribs);
+    if (surface_ == EGL_NO_SURFACE || !eglMakeCurrent(display_, surface_, surface_, context_)) {
+      throw std::runtime_error("EGLOffscreenContext: unable to make context current.");
+    }
+  }
+
+  // Note: glewInit also tries to initialize GLX, which fails without X server after the GL functions are loaded.
+  glewExperimental = GL_TRUE;
+  GLenum err = glewInit();
+  if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) {
+    throw std::runtime_error(std::string("EGLOffscreenContext: unable to initialize GLEW: ") +
+                             reinterpret_cast<const char*>(glewGetErrorString(err)));
+  }
+  glGetError();  // glew might produce an GL_INVALID_ENUM in core profile contexts.
+}
+
+EGLOffscreenContext::~EGLOffscreenContext() {
+  if (display_ == EGL_NO_DISPLAY) return;
+
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (surface_ != EGL_NO_SURFACE) eglDestroySurface(display_, surface_);
+  if (context_ != EGL_NO_CONTEXT) eglDestroyContext(display_, context_);
+  eglTerminate(display_);
+}
+
+void EGLOffscreenContext::makeCurrent() {
+  eglMakeCurrent(display_, surface_, surface_, context_);
+}
@@ -0,0 +1,36 @@
+#ifndef SRC_OPENGL_EGLOFFSCREENCONTEXT_H_
+#define SRC_OPENGL_EGLOFFSCREENCONTEXT_H_
+
+#include <EGL/egl.h>
+#include <stdint.h>
+
+/** \brief headless OpenGL core profile context without any window system.
+ *
+ *  Uses the EGL surfaceless platform if available and falls back to the default display
+ *  with a small pbuffer surface otherwise. Together with Mesa's software rasterizer (llvmpipe),
+ *  this enables running the complete pipeline on machines without display and without GPU.
+ *
+ *  The context is made current in the constructor and GLEW is initialized, i.e., afterwards
+ *  all glow objects can be created.
+ *
+ *  \author behley
+ */
+class EGLOffscreenContext {
+ public:
+  /** \brief create context with given OpenGL core profile version; throws std::runtime_error on failure. **/
+  EGLOffscreenContext(int32_t major_version = __GL_VERSION / 100, int32_t minor_version = (__GL_VERSION % 100) / 10);
+  ~EGLOffscreenContext();
+
+  EGLOffscreenContext(const EGLOffscreenContext&) = delete;
+  EGLOffscreenContext& operator=(const EGLOffscreenContext&) = delete;
+
+  /** \brief make context current for the calling thread. **/
+  void makeCurrent();
+
+ protected:
+  EGLDisplay display_{EGL_NO_DISPLAY};
+  EGLContext context_{EGL_NO_CONTEXT};
+  EGLSurface surface_{EGL_NO_SURFACE};
+};
+
+#endif /* SRC_OPENGL_EGLOFFSCREENCONTEXT_H_ */
@@ -1,10 +1,10 @@
 #include "Stopwatch.h"
-#include <cassert>
+#include <stdexcept>
 
 namespace rv
 {
 
-std::vector<std::chrono::system_clock::time_point> Stopwatch::stimes =
+thread_local std::vector<std::chrono::system_clock::time_point> Stopwatch::stimes =
     std::vector<std::chrono::system_clock::time_point>();
 
 void Stopwatch::tic()
@@ -18,7 +18,7 @@ void Stopwatch::tic()
  **/
 double Stopwatch::toc()
 {
-  assert(stimes.begin() != stimes.end());
+  if (stimes.empty()) throw std::runtime_error("Stopwatch: toc() without tic().");
 
   std::chrono::system_clock::time_point endtime = std::chrono::high_resolution_clock::now();
   std::chrono::system_clock::time_point starttime = stimes.back();
@@ -36,11 +36,12 @@ class Stopwatch {
   static void tic();
   /** \brief stops the last timer started and outputs \a msg **/
   static double toc();
-  /** \brief number of active stopwatches. **/
+  /** \brief number of active stopwatches of the calling thread. **/
   static size_t active() { return stimes.size(); }
 
  protected:
-  static std::vector<std::chrono::system_clock::time_point> stimes;
+  // every thread has its own timers, i.e., timings of background threads do not interfere.
+  static thread_local std::vector<std::chrono::system_clock::time_point> stimes;
 };
 }
 
@@ -0,0 +1,179 @@
+#include "Tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace rv {
+
+std::atomic<bool> Tracer::enabled_(false);
+std::mutex Tracer::mutex_;
+std::vector<std::shared_ptr<Tracer::Buffer>> Tracer::buffers_;
+
+static const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+/** \brief string as JSON string literal. **/
+static std::string quote(const std::string& str) {
+  std::string result = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (uint8_t(c) < 0x20) {
+      char code[7];
+      std::snprintf(code, sizeof(code), "\\u%04x", uint32_t(c));
+      result += code;
+    } else {
+      result += c;
+    }
+  }
+
+  return result + "\"";
+}
+
+void Tracer::begin(const char* name) {
+  Buffer& buf = buffer();
+  std::lock_guard<std::mutex> lock(buf.mutex);
+
+  Span span;
+  span.name = name;
+  span.start = now();
+  span.end = -1;
+
+  buf.open.push_back(buf.spans.size());
+  buf.spans.push_back(span);
+}
+
+void Tracer::end() {
+  int64_t t = now();
+
+  Buffer& buf = buffer();
+  std::lock_guard<std::mutex> lock(buf.mutex);
+  if (buf.open.empty()) return;  // cleared in between.
+
+  buf.spans[buf.open.back()].end = t;
+  buf.open.pop_back();
+}
+
+void Tracer::setThreadName(const std::string& name) {
+  Handle& h = handle();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (h.buffer != nullptr && h.buffer->name == name) return;
+
+  std::shared_ptr<Buffer> buf = acquire(name);
+  if (h.buffer != nullptr) {
+    // spans recorded before naming the thread are moved.
+    std::lock_guard<std::mutex> old_lock(h.buffer->mutex);
+    std::lock_guard<std::mutex> buf_lock(buf->mutex);
+    for (uint32_t idx : h.buffer->open) buf->open.push_back(idx + buf->spans.size());
+    buf->spans.insert(buf->spans.end(), h.buffer->spans.begin(), h.buffer->spans.end());
+    h.buffer->spans.clear();
+    h.buffer->open.clear();
+    h.buffer->threads -= 1;
+  }
+
+  h.buffer = buf;
+}
+
+uint64_t Tracer::size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  uint64_t count = 0;
+  for (auto& buf : buffers_) {
+    std::lock_guard<std::mutex> buf_lock(buf->mutex);
+    count += buf->spans.size();
+  }
+
+  return count;
+}
+
+void Tracer::write(const std::string& filename) {
+  std::ofstream out(filename.c_str());
+  if (!out.is_open()) throw std::runtime_error("Tracer: unable to open " + filename + ".");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // complete events ("X") with timestamps and durations in microseconds.
+  out << "{\"traceEvents\": [";
+  out << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (auto& buf : buffers_) {
+    std::lock_guard<std::mutex> buf_lock(buf->mutex);
+
+    // buffers without finished spans, e.g., of finished threads after clear(), are omitted completely.
+    bool finished = std::any_of(buf->spans.begin(), buf->spans.end(), [](const Span& s) { return s.end >= 0; });
+    if (!finished) continue;
+
+    if (!buf->name.empty()) {
+      out << (first ? "\n" : ",\n");
+      out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buf->tid
+          << ", \"args\": {\"name\": " << quote(buf->name) << "}}";
+      first = false;
+    }
+
+    for (const Span& span : buf->spans) {
+      if (span.end < 0) continue;  // still running.
+      out << (first ? "\n" : ",\n");
+      out << "{\"name\": " << quote(span.name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buf->tid
+          << ", \"ts\": " << 1e-3 * span.start << ", \"dur\": " << 1e-3 * (span.end - span.start) << "}";
+      first = false;
+    }
+  }
+  out << "\n]}" << std::endl;
+}
+
+void Tracer::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& buf : buffers_) {
+    std::lock_guard<std::mutex> buf_lock(buf->mutex);
+    buf->spans.clear();
+    buf->open.clear();
+  }
+}
+
+Tracer::Handle::~Handle() {
+  if (buffer == nullptr) return;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer->threads -= 1;
+}
+
+Tracer::Buffer& Tracer::buffer() {
+  Handle& h = handle();
+  if (h.buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    h.buffer = acquire("");
+  }
+
+  return *h.buffer;
+}
+
+Tracer::Handle& Tracer::handle() {
+  static thread_local Handle h;
+  return h;
+}
+
+std::shared_ptr<Tracer::Buffer> Tracer::acquire(const std::string& name) {
+  for (auto& buf : buffers_) {
+    if (buf->threads == 0 && buf->name == name) {
+      buf->threads += 1;
+      return buf;
+    }
+  }
+
+  std::shared_ptr<Buffer> buf = std::make_shared<Buffer>();
+  buf->tid = buffers_.size() + 1;
+  buf->name = name;
+  buf->threads = 1;
+  buffers_.push_back(buf);
+
+  return buf;
+}
+
+int64_t Tracer::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+}
@@ -0,0 +1,106 @@
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rv {
+
+/** \brief recording of nested time spans of all threads, which can be written as Chrome trace.
+ *
+ *  Spans are recorded with ScopedTrace, i.e., the span ends with the scope:
+ *
+ *    void SurfelMapping::updatePose() {
+ *      ScopedTrace trace("updatePose");
+ *      ...
+ *    }
+ *
+ *  Every thread records into its own buffer, i.e., threads never wait for each other, and mismatched spans cannot
+ *  corrupt spans of other threads. The buffers outlive the threads, such that spans of finished background threads
+ *  are written as well. The buffer of a finished thread is reused by the next thread with the same name; thus,
+ *  a logical worker, which is started with std::async for every task, has a single buffer and row in the trace.
+ *  The written JSON can be opened with chrome://tracing or https://ui.perfetto.dev.
+ *
+ *  Without setEnabled(true), nothing is recorded.
+ *
+ *  \author behley
+ */
+class Tracer {
+ public:
+  static void setEnabled(bool enabled) { enabled_ = enabled; }
+  static bool enabled() { return enabled_; }
+
+  /** \brief start span with given name, which must stay valid until the trace is written, e.g., a literal. **/
+  static void begin(const char* name);
+
+  /** \brief end the last started span of the calling thread. **/
+  static void end();
+
+  /** \brief name of the calling thread in the trace; continues the buffer of a finished thread with this name. **/
+  static void setThreadName(const std::string& name);
+
+  /** \brief number of recorded spans of all threads. **/
+  static uint64_t size();
+
+  /** \brief write all finished spans in Chrome's trace event format; threads without finished spans are omitted. **/
+  static void write(const std::string& filename);
+
+  /** \brief remove all recorded spans. **/
+  static void clear();
+
+ protected:
+  struct Span {
+    const char* name;
+    int64_t start, end;  // nanoseconds since the start of the program; end < 0 while running.
+  };
+
+  struct Buffer {
+    std::mutex mutex;  // only contended while writing or clearing.
+    uint32_t tid;
+    std::string name;
+    std::vector<Span> spans;
+    std::vector<uint32_t> open;  // indexes of running spans.
+    uint32_t threads{0};         // threads currently recording into the buffer; guarded by mutex_.
+  };
+
+  /** \brief buffer of the calling thread, which is released when the thread exits. **/
+  struct Handle {
+    ~Handle();
+    std::shared_ptr<Buffer> buffer;
+  };
+
+  static Buffer& buffer();
+  static Handle& handle();
+  /** \brief unused buffer with given name or a new buffer; needs lock of mutex_. **/
+  static std::shared_ptr<Buffer> acquire(const std::string& name);
+  static int64_t now();
+
+  static std::atomic<bool> enabled_;
+  static std::mutex mutex_;
+  static std::vector<std::shared_ptr<Buffer>> buffers_;
+};
+
+/** \brief span from construction to destruction; only recorded if the Tracer was enabled at construction. **/
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(const char* name) : active_(Tracer::enabled()) {
+    if (active_) Tracer::begin(name);
+  }
+
+  ~ScopedTrace() {
+    if (active_) Tracer::end();
+  }
+
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  bool active_;
+};
+}
+
+#endif /* TRACER_H_ */
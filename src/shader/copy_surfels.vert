@@ -18,6 +18,11 @@ out SURFEL
 uniform vec2 submap_center;
 uniform float submap_extent;
 
+// compaction: remove surfels with lower confidence, which were not updated since compaction_timestamp.
+uniform bool compact;
+uniform float compaction_confidence;
+uniform int compaction_timestamp;
+
 uniform samplerBuffer poseBuffer;
 
 mat4 get_pose(int t)
@@ -32,7 +37,9 @@ void main()
   mat4 surfelPose = get_pose(int(surfel_color_weight_count.z));
   vec4 position = surfelPose * vec4(position_radius.xyz, 1.0);
 
-  if(in_timestamp < 0 || abs(position.x - submap_center.x) > submap_extent || abs(position.y - submap_center.y) > submap_extent)
+  bool unstable = compact && normal_confidence.w < compaction_confidence && in_timestamp < compaction_timestamp;
+
+  if(in_timestamp < 0 || unstable || abs(position.x - submap_center.x) > submap_extent || abs(position.y - submap_center.y) > submap_extent)
   {
     vs_out.valid = false;
   }
@@ -0,0 +1,191 @@
+// headless end-to-end benchmark on simulated scans with known trajectory, which needs no dataset.
+#include <core/SurfelMapping.h>
+#include <rv/PrimitiveParameters.h>
+#include <rv/Stopwatch.h>
+
+#include <algorithm>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "io/SimulationReader.h"
+#include "opengl/EGLOffscreenContext.h"
+#include "util/trajectory_utils.h"
+
+using namespace rv;
+
+namespace {
+
+// absolute slack of the accuracy checks, i.e., very accurate baselines do not fail due to noise.
+const double ERROR_SLACK = 0.01;
+
+/** \brief write the result of the current run as baseline in the format of the parameter files; the frame time is
+ *  omitted if negative, i.e., the baseline is machine-independent. **/
+void writeBaseline(const std::string& filename, const SimulationReader& reader, uint32_t numColumns,
+                   double frameTime, const Trajectory::Errors& errors) {
+  std::ofstream out(filename.c_str());
+  if (!out.is_open()) throw std::runtime_error("Unable to open baseline file " + filename + ".");
+
+  out << "<config>" << std::endl;
+  if (frameTime >= 0.0)
+    out << "  <!-- baseline of simbench; the frame time depends on the machine. -->" << std::endl;
+  else
+    out << "  <!-- accuracy baseline of simbench without frame time, i.e., machine-independent. -->" << std::endl;
+  out << "  <param name=\"simulation_beams\" type=\"integer\">" << reader.numBeams() << "</param>" << std::endl;
+  out << "  <param name=\"simulation_columns\" type=\"integer\">" << numColumns << "</param>" << std::endl;
+  out << "  <param name=\"simulation_scans\" type=\"integer\">" << reader.count() << "</param>" << std::endl;
+  if (frameTime >= 0.0)
+    out << "  <param name=\"frame-time\" type=\"float\">" << frameTime << "</param> <!-- mean in s. -->" << std::endl;
+  out << "  <param name=\"ate\" type=\"float\">" << errors.ate << "</param> <!-- m. -->" << std::endl;
+  out << "  <param name=\"rpe-translation\" type=\"float\">" << errors.rpe_translation << "</param> <!-- m. -->"
+      << std::endl;
+  out << "  <param name=\"rpe-rotation\" type=\"float\">" << errors.rpe_rotation << "</param> <!-- deg. -->"
+      << std::endl;
+  out << "</config>" << std::endl;
+}
+
+/** \brief compare value with baseline; true, if the value exceeds the limit. **/
+bool regressed(const std::string& name, double value, double baseline, double limit) {
+  bool failed = (value > limit);
+  std::cout << std::setw(30) << std::left << name << std::right << std::setw(14) << value << std::setw(14)
+            << baseline << std::setw(14) << limit << std::setw(8) << (failed ? "FAIL" : "ok") << std::endl;
+
+  return failed;
+}
+}
+
+int main(int argc, char** argv) {
+  setlocale(LC_NUMERIC, "C");
+
+  if (argc < 3) {
+    std::cerr << "Missing parameters: ./simbench [parameter] [baseline file] [<record|record-accuracy>]"
+              << std::endl;
+    std::cerr << "  Compares the run with the baseline and fails on regressions; with record, the baseline is written."
+              << std::endl;
+    std::cerr << "  With record-accuracy, the frame time is omitted, i.e., only the accuracy is checked later."
+              << std::endl;
+    return 1;
+  }
+
+  const std::string baselineFile = argv[2];
+  const std::string mode = (argc > 3) ? argv[3] : "";
+  const bool record = (mode == "record" || mode == "record-accuracy");
+
+  EGLOffscreenContext ctx;  // needs to be generated before any OpenGL object is created.
+
+  ParameterList params;
+  parseXmlFile(argv[1], params);
+
+  // length of the sequence and resolution of the sensor must match the baseline.
+  ParameterList baseline;
+  if (!record) {
+    parseXmlFile(baselineFile, baseline);
+    for (const char* name : {"simulation_beams", "simulation_columns", "simulation_scans"}) {
+      if (params.hasParam(name) && int32_t(params[name]) != int32_t(baseline[name])) {
+        std::cerr << "Error: " << name << " differs from the baseline." << std::endl;
+        return 1;
+      }
+      params.insert(IntegerParameter(name, int32_t(baseline[name])));
+    }
+  }
+
+  uint32_t numColumns = 4 * 360;
+  if (params.hasParam("simulation_columns")) numColumns = params["simulation_columns"];
+
+  SimulationReader reader("");
+  reader.setParameters(params);
+
+  // the range image of the pipeline must cover the simulated sensor.
+  params.insert(IntegerParameter("data_height", reader.numBeams()));
+  params.insert(FloatParameter("data_fov_up", reader.fovUp()));
+  params.insert(FloatParameter("data_fov_down", reader.fovDown()));
+
+  SurfelMapping fusion(params);
+  Metrics& metrics = fusion.metrics();
+  Metrics::Handle frameTime = metrics.histogram("frame-time");
+  if (params.hasParam("metrics-log")) metrics.open(std::string(params["metrics-log"]));
+
+  std::cout << "Simulating " << reader.count() << " scans with " << reader.numBeams() << " beams and " << numColumns
+            << " columns." << std::endl;
+
+  // only the processing is timed, the ray casting of the scans is excluded.
+  Laserscan scan, next;
+  const uint32_t N = reader.count();
+  bool hasScan = reader.read(scan);
+  while (hasScan) {
+    bool hasNext = (fusion.timestamp() + 1 < N) && reader.read(next);
+
+    Stopwatch::tic();
+    if (hasNext)
+      fusion.processScan(scan, next);
+    else
+      fusion.processScan(scan);
+    metrics.record(frameTime, Stopwatch::toc());
+    metrics.commit(fusion.timestamp() - 1);
+
+    if (fusion.timestamp() % 100 == 0) std::cout << "Processed " << fusion.timestamp() << "/" << N << std::endl;
+
+    std::swap(scan, next);
+    hasScan = hasNext;
+  }
+  metrics.close();
+
+  std::vector<Eigen::Matrix4d> gt;
+  for (const Eigen::Matrix4f& pose : reader.getTrajectory()) gt.push_back(pose.cast<double>());
+  Trajectory::Errors errors = Trajectory::evaluate(gt, fusion.getOptimizedPoses());
+
+  // stage report.
+  std::cout << std::setw(30) << std::left << "stage [ms/frame]" << std::right << std::setw(14) << "mean"
+            << std::setw(14) << "p50" << std::setw(14) << "p95" << std::setw(14) << "max" << std::endl;
+  for (Metrics::Handle h = 0; h < metrics.size(); ++h) {
+    Metrics::Summary summary = metrics.summary(h);
+    if (metrics.type(h) != Metrics::Type::HISTOGRAM || summary.count == 0) continue;
+    std::cout << std::setw(30) << std::left << metrics.name(h) << std::right << std::setw(14) << 1000.0 * summary.mean
+              << std::setw(14) << 1000.0 * summary.p50 << std::setw(14) << 1000.0 * summary.p95 << std::setw(14)
+              << 1000.0 * summary.max << std::endl;
+  }
+
+  const double meanFrameTime = metrics.summary(frameTime).mean;
+  std::cout << "ATE: " << errors.ate << " m (max " << errors.ate_max << " m), RPE: " << errors.rpe_translation
+            << " m, " << errors.rpe_rotation << " deg, " << 1.0 / meanFrameTime << " frames/s." << std::endl;
+
+  if (record) {
+    writeBaseline(baselineFile, reader, numColumns, (mode == "record") ? meanFrameTime : -1.0, errors);
+    std::cout << "Wrote baseline to " << baselineFile << "." << std::endl;
+    return 0;
+  }
+
+  // relative tolerances with respect to the baseline.
+  float timeTolerance = 0.2f, errorTolerance = 0.1f;
+  if (params.hasParam("baseline-time-tolerance")) timeTolerance = params["baseline-time-tolerance"];
+  if (params.hasParam("baseline-error-tolerance")) errorTolerance = params["baseline-error-tolerance"];
+
+  double baseAte = float(baseline["ate"]);
+  double baseRpeT = float(baseline["rpe-translation"]), baseRpeR = float(baseline["rpe-rotation"]);
+
+  std::cout << std::setw(30) << std::left << "regression check" << std::right << std::setw(14) << "value"
+            << std::setw(14) << "baseline" << std::setw(14) << "limit" << std::endl;
+  bool failed = false;
+  // the frame time is only comparable to baselines recorded on the same machine.
+  if (baseline.hasParam("frame-time")) {
+    double baseTime = float(baseline["frame-time"]);
+    failed |= regressed("frame-time", meanFrameTime, baseTime, (1.0 + timeTolerance) * baseTime);
+  } else {
+    std::cout << std::setw(30) << std::left << "frame-time" << std::right << std::setw(14) << meanFrameTime
+              << std::setw(14) << "-" << std::setw(14) << "-" << std::setw(8) << "skip" << std::endl;
+  }
+  failed |= regressed("ate", errors.ate, baseAte, (1.0 + errorTolerance) * baseAte + ERROR_SLACK);
+  failed |= regressed("rpe-translation", errors.rpe_translation, baseRpeT,
+                      (1.0 + errorTolerance) * baseRpeT + ERROR_SLACK);
+  failed |= regressed("rpe-rotation", errors.rpe_rotation, baseRpeR, (1.0 + errorTolerance) * baseRpeR + ERROR_SLACK);
+
+  if (failed) {
+    std::cout << "Regression with respect to " << baselineFile << "." << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef SRC_UTIL_BINARYBUFFER_H_
+#define SRC_UTIL_BINARYBUFFER_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/** \brief append trivially copyable values in native (little endian) byte order to a byte buffer.
+ *
+ *  The complete content is usually written with a single call, which avoids any formatting of streams.
+ *
+ *  \author behley
+ */
+class BinaryWriter {
+ public:
+  template <class T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written.");
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+  }
+
+  template <class T>
+  void write(const T* values, size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written.");
+    const char* bytes = reinterpret_cast<const char*>(values);
+    buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+  }
+
+  /** \brief write size followed by the elements. **/
+  template <class T, class A>
+  void write(const std::vector<T, A>& values) {
+    write<uint64_t>(values.size());
+    write(values.data(), values.size());
+  }
+
+  std::vector<char> buffer;
+};
+
+/** \brief read values written by BinaryWriter; throws std::runtime_error if the buffer is too short. **/
+class BinaryReader {
+ public:
+  BinaryReader(const std::vector<char>& buffer) : buffer_(buffer) {}
+
+  template <class T>
+  T read() {
+    T value;
+    read(&value, 1);
+
+    return value;
+  }
+
+  template <class T>
+  void read(T* values, size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read.");
+    if (count > (buffer_.size() - offset_) / sizeof(T)) throw std::runtime_error("BinaryReader: unexpected end.");
+
+    std::memcpy(values, buffer_.data() + offset_, count * sizeof(T));
+    offset_ += count * sizeof(T);
+  }
+
+  template <class T, class A>
+  void read(std::vector<T, A>& values) {
+    uint64_t size = read<uint64_t>();
+    if (size > (buffer_.size() - offset_) / sizeof(T)) throw std::runtime_error("BinaryReader: unexpected end.");
+
+    values.resize(size);
+    read(values.data(), size);
+  }
+
+  /** \brief read an element count written as uint64_t; throws if the remaining bytes cannot hold as many elements,
+   *  which occupy at least elementSize bytes each.
+   **/
+  uint64_t readCount(size_t elementSize) {
+    uint64_t count = read<uint64_t>();
+    if (count > remaining() / elementSize) throw std::runtime_error("BinaryReader: unexpected end.");
+
+    return count;
+  }
+
+  /** \brief number of bytes not yet read. **/
+  size_t remaining() const { return buffer_.size() - offset_; }
+
+  /** \brief true, if all bytes were read. **/
+  bool atEnd() const { return offset_ == buffer_.size(); }
+
+ protected:
+  const std::vector<char>& buffer_;
+  size_t offset_{0};
+};
+
+#endif /* SRC_UTIL_BINARYBUFFER_H_ */
@@ -0,0 +1,49 @@
+#include "trajectory_utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Trajectory {
+
+Errors evaluate(const std::vector<Eigen::Matrix4d>& poses_gt, const std::vector<Eigen::Matrix4d>& poses_result) {
+  Errors errors;
+
+  const uint32_t N = std::min(poses_gt.size(), poses_result.size());
+  if (N == 0) return errors;
+
+  const Eigen::Matrix4d gt0_inv = poses_gt[0].inverse();
+  const Eigen::Matrix4d result0_inv = poses_result[0].inverse();
+
+  double sum_ate = 0.0, sum_rpe_t = 0.0, sum_rpe_r = 0.0;
+  Eigen::Matrix4d last_gt, last_result;
+  for (uint32_t i = 0; i < N; ++i) {
+    Eigen::Matrix4d gt = gt0_inv * poses_gt[i];
+    Eigen::Matrix4d result = result0_inv * poses_result[i];
+
+    double error = (gt.topRightCorner<3, 1>() - result.topRightCorner<3, 1>()).norm();
+    sum_ate += error * error;
+    errors.ate_max = std::max(errors.ate_max, error);
+
+    if (i > 0) {
+      Eigen::Matrix4d delta = (last_gt.inverse() * gt).inverse() * (last_result.inverse() * result);
+      double t = delta.topRightCorner<3, 1>().norm();
+      double d = std::max(-1.0, std::min(1.0, 0.5 * (delta.topLeftCorner<3, 3>().trace() - 1.0)));
+      double r = std::acos(d) * 180.0 / M_PI;
+
+      sum_rpe_t += t * t;
+      sum_rpe_r += r * r;
+    }
+
+    last_gt = gt;
+    last_result = result;
+  }
+
+  errors.ate = std::sqrt(sum_ate / N);
+  if (N > 1) {
+    errors.rpe_translation = std::sqrt(sum_rpe_t / (N - 1));
+    errors.rpe_rotation = std::sqrt(sum_rpe_r / (N - 1));
+  }
+
+  return errors;
+}
+}
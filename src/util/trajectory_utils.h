@@ -0,0 +1,27 @@
+#ifndef INCLUDE_UTIL_TRAJECTORY_UTILS_H_
+#define INCLUDE_UTIL_TRAJECTORY_UTILS_H_
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+/** \brief accuracy of an estimated trajectory with respect to the groundtruth trajectory.
+ *
+ *  Both trajectories are expressed relative to their first pose, i.e., no alignment is estimated. This corresponds
+ *  to an odometry that starts at the first pose of the groundtruth.
+ *
+ *  \author behley
+ **/
+namespace Trajectory {
+
+struct Errors {
+  double ate{0.0};              // absolute trajectory error, i.e., RMSE of the translation in m.
+  double ate_max{0.0};          // maximum translational error in m.
+  double rpe_translation{0.0};  // relative pose error, i.e., RMSE of the translation of consecutive poses in m.
+  double rpe_rotation{0.0};     // RMSE of the rotation of consecutive poses in degrees.
+};
+
+/** \brief evaluate the common prefix of both trajectories. **/
+Errors evaluate(const std::vector<Eigen::Matrix4d>& poses_gt, const std::vector<Eigen::Matrix4d>& poses_result);
+}
+
+#endif /* INCLUDE_UTIL_TRAJECTORY_UTILS_H_ */
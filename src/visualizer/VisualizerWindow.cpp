@@ -7,6 +7,7 @@
 #include <QtWidgets/QFileDialog>
 #include "core/lie_algebra.h"
 #include "io/KITTIReader.h"
+#include "io/PrefetchingReader.h"
 #include "io/SimulationReader.h"
 #include "opengl/ObjReader.h"
 
@@ -393,7 +394,7 @@ void VisualizerWindow::openFile(const QString& filename) {
 
     if (extension == ".bin") {
       delete reader_;
-      reader_ = new KITTIReader(filename.toStdString(), 50);
+      reader_ = new PrefetchingReader(std::make_shared<KITTIReader>(filename.toStdString(), 50));
 
       scanFrequency = 10.0f;   // in Hz.
       timer_.setInterval(10);  // 1./10. second = 100 msecs.
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <core/CpuPreprocessing.h>
+#include <rv/PrimitiveParameters.h>
+
+#include <cmath>
+#include <random>
+
+using namespace rv;
+using namespace glow;
+
+namespace {
+
+const uint32_t width = 360, height = 32;
+
+ParameterList getParams(int32_t threads) {
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 3.0f));
+  params.insert(FloatParameter("data_fov_down", -25.0f));
+  params.insert(FloatParameter("min_depth", 1.0f));
+  params.insert(FloatParameter("max_depth", 100.0f));
+  params.insert(IntegerParameter("preprocessing_threads", threads));
+
+  return params;
+}
+
+/** \brief point at the center of pixel (col, row) on the plane x = 10. **/
+Point3f wallPoint(uint32_t col, uint32_t row) {
+  float yaw = -(2.0f * (col + 0.5f) / width - 1.0f) * M_PI;
+  float pitch = ((1.0f - (row + 0.5f) / height) * 28.0f - 3.0f) * M_PI / 180.0f;
+  float x = std::cos(pitch) * std::cos(yaw), y = std::cos(pitch) * std::sin(yaw), z = -std::sin(pitch);
+
+  return Point3f(10.0f, 10.0f * y / x, 10.0f * z / x);
+}
+
+TEST(CpuPreprocessingTest, testNearestPoint) {
+  CpuPreprocessing preprocessor(getParams(4));
+
+  // all points in front of the sensor fall into pixel (180, 28).
+  std::vector<Point3f> points;
+  points.push_back(Point3f(20.0f, 0.0f, 0.0f));
+  points.push_back(Point3f(10.0f, 0.0f, 0.0f));
+  points.push_back(Point3f(15.0f, 0.0f, 0.0f));
+  points.push_back(Point3f(200.0f, 0.0f, 0.0f));  // too far.
+  points.push_back(Point3f(0.5f, 0.0f, 0.0f));    // too near.
+
+  std::vector<vec4> vertex_map, normal_map;
+  preprocessor.process(points, vertex_map, normal_map);
+
+  ASSERT_EQ(width * height, vertex_map.size());
+  ASSERT_EQ(width * height, normal_map.size());
+
+  uint32_t num_valid = 0;
+  for (uint32_t i = 0; i < vertex_map.size(); ++i) {
+    if (vertex_map[i].w > 0.5f) num_valid += 1;
+    ASSERT_EQ(0.0f, normal_map[i].w);  // single point: no neighbors.
+  }
+  ASSERT_EQ(1, num_valid);
+
+  const vec4& v = vertex_map[28 * width + 180];
+  ASSERT_EQ(10.0f, v.x);
+  ASSERT_EQ(0.0f, v.y);
+  ASSERT_EQ(0.0f, v.z);
+  ASSERT_EQ(1.0f, v.w);
+}
+
+TEST(CpuPreprocessingTest, testAverage) {
+  ParameterList params = getParams(2);
+  params.insert(BooleanParameter("avg_vertexmap", true));
+  CpuPreprocessing preprocessor(params);
+
+  std::vector<Point3f> points;
+  points.push_back(Point3f(10.0f, 0.0f, 0.0f));
+  points.push_back(Point3f(20.0f, 0.0f, 0.0f));
+
+  std::vector<vec4> vertex_map, normal_map;
+  preprocessor.process(points, vertex_map, normal_map);
+
+  const vec4& v = vertex_map[28 * width + 180];
+  ASSERT_FLOAT_EQ(15.0f, v.x);
+  ASSERT_EQ(1.0f, v.w);
+}
+
+TEST(CpuPreprocessingTest, testPlane) {
+  std::vector<Point3f> points;
+  for (uint32_t row = 10; row < 20; ++row) {
+    for (uint32_t col = 170; col < 190; ++col) {
+      points.push_back(wallPoint(col, row));
+    }
+  }
+
+  std::vector<vec4> vertex_map, normal_map;
+  CpuPreprocessing preprocessor(getParams(3));
+  preprocessor.process(points, vertex_map, normal_map);
+
+  for (uint32_t row = 10; row < 20; ++row) {
+    for (uint32_t col = 170; col < 190; ++col) {
+      const vec4& v = vertex_map[row * width + col];
+      ASSERT_EQ(1.0f, v.w) << "(" << col << ", " << row << ")";
+      ASSERT_NEAR(10.0f, v.x, 1e-5);
+
+      // normals need right and upper neighbor, and additionally left or lower neighbor.
+      const vec4& n = normal_map[row * width + col];
+      if (row < 19 && col < 189 && (row > 10 || col > 170)) {
+        ASSERT_EQ(1.0f, n.w) << "(" << col << ", " << row << ")";
+        ASSERT_NEAR(-1.0f, n.x, 1e-4);
+        ASSERT_NEAR(0.0f, n.y, 1e-3);
+        ASSERT_NEAR(0.0f, n.z, 1e-3);
+      } else {
+        ASSERT_EQ(0.0f, n.w) << "(" << col << ", " << row << ")";
+      }
+    }
+  }
+
+  // results must not depend on the number of threads.
+  std::vector<vec4> vertex_map1, normal_map1;
+  CpuPreprocessing preprocessor1(getParams(1));
+  preprocessor1.process(points, vertex_map1, normal_map1);
+
+  for (uint32_t i = 0; i < width * height; ++i) {
+    ASSERT_EQ(vertex_map1[i].x, vertex_map[i].x);
+    ASSERT_EQ(vertex_map1[i].w, vertex_map[i].w);
+    ASSERT_EQ(normal_map1[i].x, normal_map[i].x);
+    ASSERT_EQ(normal_map1[i].w, normal_map[i].w);
+  }
+}
+
+TEST(CpuPreprocessingTest, testSimd) {
+  if (!CpuPreprocessing::simdSupported()) return;
+
+  // points in all directions, including points outside the field of view and the depth range.
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> coordinate(-60.0f, 60.0f), height_offset(-8.0f, 3.0f);
+  std::vector<Point3f> points;
+  for (uint32_t i = 0; i < 20005; ++i) {
+    points.push_back(Point3f(coordinate(rng), coordinate(rng), height_offset(rng)));
+  }
+  points.push_back(Point3f(0.0f, 0.0f, 0.0f));
+  points.push_back(Point3f(-10.0f, 0.0f, 0.0f));  // yaw = pi.
+  points.push_back(Point3f(-10.0f, -0.0f, 0.0f));
+
+  ParameterList params = getParams(2);
+  std::vector<vec4> vertex_simd, normal_simd;
+  params.insert(BooleanParameter("preprocessing_simd", true));
+  CpuPreprocessing(params).process(points, vertex_simd, normal_simd);
+
+  std::vector<vec4> vertex_scalar, normal_scalar;
+  params.insert(BooleanParameter("preprocessing_simd", false));
+  CpuPreprocessing(params).process(points, vertex_scalar, normal_scalar);
+
+  // the approximation of atan2 might move points at pixel borders to the neighboring pixel.
+  uint32_t num_equal = 0, num_valid = 0;
+  for (uint32_t i = 0; i < width * height; ++i) {
+    if (vertex_scalar[i].w > 0.5f) num_valid += 1;
+    if (vertex_scalar[i].x == vertex_simd[i].x && vertex_scalar[i].y == vertex_simd[i].y &&
+        vertex_scalar[i].w == vertex_simd[i].w) {
+      num_equal += 1;
+    }
+  }
+
+  ASSERT_GT(num_valid, width * height / 2);
+  EXPECT_GE(num_equal, 0.999 * width * height);
+}
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "io/KITTIReader.h"
+#include "io/MappedScan.h"
+
+#include <algorithm>
+
+using namespace rv;
+
+namespace {
+
+TEST(MappedScanTest, testKITTIReader) {
+  KITTIReader reader("./scan0.bin");
+  KITTIReader mapped_reader("./scan0.bin");
+  ASSERT_EQ(2, reader.count());
+
+  Laserscan scan;
+  MappedScan mapped;
+  uint32_t last_size = 0;
+  for (uint32_t i = 0; i < reader.count(); ++i) {
+    ASSERT_TRUE(reader.read(scan));
+    ASSERT_TRUE(mapped_reader.read(mapped));
+
+    ASSERT_GT(scan.size(), 0);
+    ASSERT_EQ(scan.size(), mapped.size());
+    last_size = scan.size();
+
+    float max_remission = 0.0f;
+    for (uint32_t j = 0; j < mapped.size(); ++j) max_remission = std::max(max_remission, mapped.data()[4 * j + 3]);
+
+    for (uint32_t j = 0; j < mapped.size(); ++j) {
+      ASSERT_EQ(scan.point(j).x(), mapped.points()[j].x());
+      ASSERT_EQ(scan.point(j).y(), mapped.points()[j].y());
+      ASSERT_EQ(scan.point(j).z(), mapped.points()[j].z());
+      ASSERT_FLOAT_EQ(scan.remission(j), mapped.data()[4 * j + 3] / max_remission);
+    }
+  }
+
+  ASSERT_FALSE(reader.read(scan));
+  ASSERT_FALSE(mapped_reader.read(mapped));
+
+  mapped_reader.seek(1);
+  ASSERT_TRUE(mapped_reader.read(mapped));
+  ASSERT_EQ(last_size, mapped.size());
+}
+
+TEST(MappedScanTest, testMapping) {
+  MappedScan scan;
+  ASSERT_FALSE(scan.map("./does_not_exist.bin"));
+  ASSERT_TRUE(scan.empty());
+
+  ASSERT_TRUE(scan.map("./scan0.bin", false));
+  uint32_t size = scan.size();
+  ASSERT_GT(size, 0);
+
+  MappedScan other(std::move(scan));
+  ASSERT_TRUE(scan.empty());
+  ASSERT_EQ(size, other.size());
+
+  other.unmap();
+  ASSERT_TRUE(other.empty());
+  ASSERT_EQ(nullptr, other.data());
+}
+}
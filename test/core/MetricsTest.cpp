@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/Metrics.h"
+
+namespace {
+
+std::vector<std::string> readLines(const std::string& filename) {
+  std::ifstream in(filename.c_str());
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) lines.push_back(line);
+
+  return lines;
+}
+
+TEST(MetricsTest, testRegistry) {
+  Metrics metrics;
+  Metrics::Handle scans = metrics.counter("scans");
+  Metrics::Handle ratio = metrics.gauge("ratio");
+
+  EXPECT_EQ(scans, metrics.counter("scans"));
+  EXPECT_NE(scans, ratio);
+  EXPECT_THROW(metrics.histogram("scans"), std::runtime_error);
+  EXPECT_THROW(metrics.record(ratio, 1.0), std::runtime_error);
+
+  std::unordered_map<std::string, float> values;
+  metrics.values(values);
+  EXPECT_TRUE(values.empty());  // nothing updated yet.
+
+  for (uint32_t i = 0; i < 10; ++i) metrics.add(scans);
+  metrics.set(ratio, 0.25);
+  metrics.set(ratio, 0.5);
+
+  metrics.values(values);
+  ASSERT_EQ(2, values.size());
+  EXPECT_FLOAT_EQ(10.0f, values["scans"]);
+  EXPECT_FLOAT_EQ(0.5f, values["ratio"]);
+
+  metrics.clear();
+  values.clear();
+  metrics.values(values);
+  EXPECT_TRUE(values.empty());
+  EXPECT_EQ(2, metrics.size());
+}
+
+TEST(MetricsTest, testHistogram) {
+  Metrics metrics;
+  Metrics::Handle h = metrics.histogram("icp-time");
+
+  // latencies with a heavy tail.
+  std::mt19937 rng(1234);
+  std::lognormal_distribution<double> dist(std::log(0.02), 0.5);
+  std::vector<double> samples;
+  for (uint32_t i = 0; i < 4500; ++i) {
+    samples.push_back(dist(rng));
+    metrics.record(h, samples.back());
+  }
+  EXPECT_DOUBLE_EQ(samples.back(), metrics.value(h));
+  std::sort(samples.begin(), samples.end());
+
+  Metrics::Summary summary = metrics.summary(h);
+  EXPECT_EQ(samples.size(), summary.count);
+  EXPECT_DOUBLE_EQ(samples.front(), summary.min);
+  EXPECT_DOUBLE_EQ(samples.back(), summary.max);
+
+  const double tolerance = Metrics::BUCKET_GROWTH - 1.0;
+  auto exact = [&samples](double p) { return samples[std::ceil(p * samples.size()) - 1]; };
+  EXPECT_NEAR(exact(0.50), summary.p50, tolerance * exact(0.50));
+  EXPECT_NEAR(exact(0.95), summary.p95, tolerance * exact(0.95));
+  EXPECT_NEAR(exact(0.99), summary.p99, tolerance * exact(0.99));
+  EXPECT_LE(summary.p50, summary.p95);
+  EXPECT_LE(summary.p95, summary.p99);
+  EXPECT_LE(summary.p99, summary.max);
+
+  // a single sample is reported exactly.
+  Metrics::Handle single = metrics.histogram("single");
+  metrics.record(single, 0.123);
+  EXPECT_DOUBLE_EQ(0.123, metrics.summary(single).p50);
+  EXPECT_DOUBLE_EQ(0.123, metrics.summary(single).p99);
+}
+
+TEST(MetricsTest, testLog) {
+  const std::string jsonFile = "/tmp/suma_metrics_test.jsonl";
+  const std::string csvFile = "/tmp/suma_metrics_test.csv";
+
+  for (const std::string& filename : {jsonFile, csvFile}) {
+    Metrics metrics;
+    Metrics::Handle time = metrics.histogram("icp-time");
+    Metrics::Handle ratio = metrics.gauge("ratio");
+    metrics.open(filename);
+
+    for (uint32_t frame = 0; frame < 100; ++frame) {
+      metrics.record(time, 0.5 * frame);
+      if (frame % 2 == 0) metrics.set(ratio, frame);
+      metrics.commit(frame);
+    }
+    metrics.close();
+
+    std::vector<std::string> lines = readLines(filename);
+    if (filename == csvFile) {
+      ASSERT_EQ(101, lines.size());
+      EXPECT_EQ("frame,icp-time,ratio", lines[0]);
+      EXPECT_EQ("0,0,0", lines[1]);
+      EXPECT_EQ("1,0.5,", lines[2]);  // ratio not updated.
+      EXPECT_EQ("99,49.5,", lines[100]);
+    } else {
+      ASSERT_EQ(100, lines.size());
+      EXPECT_EQ("{\"frame\": 0, \"icp-time\": 0, \"ratio\": 0}", lines[0]);
+      EXPECT_EQ("{\"frame\": 1, \"icp-time\": 0.5}", lines[1]);
+      EXPECT_EQ("{\"frame\": 98, \"icp-time\": 49, \"ratio\": 98}", lines[98]);
+    }
+
+    std::remove(filename.c_str());
+  }
+}
+}
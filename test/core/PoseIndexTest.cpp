@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include "core/PoseIndex.h"
+
+#include <random>
+
+namespace {
+
+/** \brief brute force search over all nodes like the former linear scan. **/
+int32_t closestBruteForce(const std::vector<Eigen::Vector3d>& positions, const Eigen::Vector3d& query, float radius,
+                          int32_t max_id) {
+  int32_t closest_idx = -1;
+  double min_distance = radius;
+  for (int32_t j = max_id; j >= 0; --j) {
+    double distance = (positions[j] - query).norm();
+    if (distance < min_distance) {
+      closest_idx = j;
+      min_distance = distance;
+    }
+  }
+
+  return closest_idx;
+}
+
+std::vector<Eigen::Vector3d> randomTrajectory(uint32_t num_poses, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::normal_distribution<double> step(0.0, 1.0);
+
+  std::vector<Eigen::Vector3d> positions;
+  Eigen::Vector3d position = Eigen::Vector3d::Zero();
+  for (uint32_t i = 0; i < num_poses; ++i) {
+    position += Eigen::Vector3d(3.0 * step(gen), 3.0 * step(gen), 0.1 * step(gen));
+    positions.push_back(position);
+  }
+
+  return positions;
+}
+
+TEST(PoseIndexTest, testClosest) {
+  std::vector<Eigen::Vector3d> positions = randomTrajectory(5000, 42);
+
+  PoseIndex index(20.0f);
+  for (uint32_t i = 0; i < positions.size(); ++i) index.set(i, positions[i]);
+
+  ASSERT_EQ(positions.size(), index.size());
+
+  for (uint32_t i = 100; i < positions.size(); i += 37) {
+    int32_t max_id = i - 100;
+    auto filter = [max_id](int32_t j) { return j <= max_id; };
+
+    ASSERT_EQ(closestBruteForce(positions, positions[i], 20.0f, max_id), index.closest(positions[i], 20.0f, filter));
+    // query radius larger than the cell size.
+    ASSERT_EQ(closestBruteForce(positions, positions[i], 50.0f, max_id), index.closest(positions[i], 50.0f, filter));
+  }
+
+  ASSERT_EQ(-1, index.closest(Eigen::Vector3d(1e5, 1e5, 0), 20.0f));
+}
+
+TEST(PoseIndexTest, testRadiusSearch) {
+  std::vector<Eigen::Vector3d> positions = randomTrajectory(2000, 7);
+
+  PoseIndex index(10.0f);
+  for (uint32_t i = 0; i < positions.size(); ++i) index.set(i, positions[i]);
+
+  std::vector<int32_t> indexes;
+  for (uint32_t i = 0; i < positions.size(); i += 13) {
+    index.radiusSearch(positions[i], 15.0f, indexes, [](int32_t j) { return j % 2 == 0; });
+
+    std::vector<int32_t> expected;
+    for (uint32_t j = 0; j < positions.size(); j += 2) {
+      if ((positions[j] - positions[i]).norm() <= 15.0) expected.push_back(j);
+    }
+
+    ASSERT_EQ(expected, indexes);
+  }
+}
+
+TEST(PoseIndexTest, testUpdate) {
+  std::vector<Eigen::Vector3d> positions = randomTrajectory(1000, 3);
+
+  PoseIndex index(20.0f);
+  for (uint32_t i = 0; i < positions.size(); ++i) index.set(i, positions[i]);
+
+  // move nodes individually.
+  for (uint32_t i = 0; i < positions.size(); i += 3) {
+    positions[i] += Eigen::Vector3d(25.0, -5.0, 0.0);
+    index.set(i, positions[i]);
+  }
+
+  for (uint32_t i = 0; i < positions.size(); i += 11) {
+    ASSERT_EQ(closestBruteForce(positions, positions[i] + Eigen::Vector3d(1, 1, 0), 20.0f, positions.size() - 1),
+              index.closest(positions[i] + Eigen::Vector3d(1, 1, 0), 20.0f));
+  }
+
+  // rebuild from transformed poses, e.g., after pose graph optimization.
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.block<3, 3>(0, 0) = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T.block<3, 1>(0, 3) = Eigen::Vector3d(100, -40, 2);
+
+  std::vector<Eigen::Matrix4d> poses(positions.size(), Eigen::Matrix4d::Identity());
+  for (uint32_t i = 0; i < positions.size(); ++i) {
+    positions[i] = T.block<3, 3>(0, 0) * positions[i] + T.block<3, 1>(0, 3);
+    poses[i].block<3, 1>(0, 3) = positions[i];
+  }
+
+  index.rebuild(poses);
+  ASSERT_EQ(positions.size(), index.size());
+
+  for (uint32_t i = 0; i < positions.size(); i += 11) {
+    ASSERT_TRUE(index.position(i).isApprox(positions[i]));
+    ASSERT_EQ(closestBruteForce(positions, positions[i], 20.0f, positions.size() - 1),
+              index.closest(positions[i], 20.0f));
+  }
+
+  // changing the cell size must not change the results.
+  index.setCellSize(5.0f);
+  for (uint32_t i = 0; i < positions.size(); i += 11) {
+    ASSERT_EQ(closestBruteForce(positions, positions[i], 20.0f, positions.size() - 1),
+              index.closest(positions[i], 20.0f));
+  }
+}
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "core/PoseTable.h"
+
+namespace {
+
+Eigen::Matrix4f trajectoryPose(uint32_t i, float offset = 0.0f) {
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  float angle = 0.001f * i;
+  pose.block<3, 3>(0, 0) = Eigen::AngleAxisf(angle, Eigen::Vector3f::UnitZ()).toRotationMatrix();
+  pose(0, 3) = 100.0f * std::cos(angle) + offset;
+  pose(1, 3) = 100.0f * std::sin(angle);
+
+  return pose;
+}
+
+uint32_t numPoses(const std::vector<PoseTable::Range>& ranges) {
+  uint32_t count = 0;
+  for (const auto& range : ranges) count += range.second - range.first;
+  return count;
+}
+
+TEST(PoseTableTest, testGrowing) {
+  const uint32_t num_poses = 50000;
+
+  PoseTable table(10000);
+  EXPECT_TRUE(table.resized());
+  table.clean();
+
+  uint32_t num_resized = 0;
+  for (uint32_t i = 0; i < num_poses; ++i) {
+    table.set(i, trajectoryPose(i));
+    if (table.resized()) {
+      num_resized += 1;
+    } else {
+      // only the new pose must be uploaded.
+      std::vector<PoseTable::Range> ranges = table.dirtyRanges();
+      ASSERT_EQ(1, ranges.size());
+      ASSERT_EQ(i, ranges[0].first);
+      ASSERT_EQ(i + 1, ranges[0].second);
+    }
+    table.clean();
+  }
+
+  EXPECT_EQ(3, num_resized);  // 20000, 40000, 80000.
+  EXPECT_EQ(80000, table.capacity());
+  for (uint32_t i = 0; i < num_poses; ++i) ASSERT_TRUE(table[i] == trajectoryPose(i));
+  for (uint32_t i = num_poses; i < table.capacity(); ++i) ASSERT_TRUE(table[i] == Eigen::Matrix4f::Identity());
+}
+
+TEST(PoseTableTest, testDeltaUpdates) {
+  const uint32_t num_poses = 50000;
+
+  std::vector<Eigen::Matrix4f> poses;
+  PoseTable table;
+  for (uint32_t i = 0; i < num_poses; ++i) {
+    poses.push_back(trajectoryPose(i));
+    table.set(i, poses.back());
+  }
+  table.clean();
+
+  // unchanged poses are not uploaded.
+  table.update(poses);
+  EXPECT_TRUE(table.dirtyRanges().empty());
+  EXPECT_FALSE(table.resized());
+
+  // loop closure correcting the end of the trajectory.
+  for (uint32_t i = 45000; i < num_poses; ++i) poses[i] = trajectoryPose(i, 0.5f);
+  table.update(poses);
+  std::vector<PoseTable::Range> ranges = table.dirtyRanges();
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(45000, ranges[0].first);
+  EXPECT_EQ(num_poses, ranges[0].second);
+  table.clean();
+
+  // scattered corrections: close ranges are merged, distant ranges not.
+  poses[100] = poses[105] = trajectoryPose(0, 1.0f);
+  poses[20000] = trajectoryPose(1, 1.0f);
+  poses[30000 + PoseTable::MERGE_GAP - 5] = trajectoryPose(2, 1.0f);
+  poses[30000] = trajectoryPose(3, 1.0f);
+  table.update(poses);
+  ranges = table.dirtyRanges();
+  ASSERT_EQ(3, ranges.size());
+  EXPECT_EQ(PoseTable::Range(100, 106), ranges[0]);
+  EXPECT_EQ(PoseTable::Range(20000, 20001), ranges[1]);
+  EXPECT_EQ(PoseTable::Range(30000, 30000 + PoseTable::MERGE_GAP - 4), ranges[2]);
+  EXPECT_LT(numPoses(ranges), 100);
+  table.clean();
+
+  for (uint32_t i = 0; i < num_poses; ++i) ASSERT_TRUE(table[i] == poses[i]);
+
+  // more poses than capacity require a complete upload.
+  poses.resize(table.capacity() + 1, Eigen::Matrix4f::Identity());
+  table.update(poses);
+  EXPECT_TRUE(table.resized());
+  EXPECT_GE(table.capacity(), poses.size());
+}
+}
@@ -3,6 +3,9 @@
 #include <gtest/gtest.h>
 #include <gtsam/geometry/Pose3.h>
 
+#include <fstream>
+#include <iterator>
+
 namespace {
 
 Eigen::Matrix4d pose(float yaw, float pitch, float roll, float x, float y, float z) {
@@ -99,4 +102,178 @@ TEST(PosegraphTest, testOptimize) {
   ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 2, 0, result.at<gtsam::Pose3>(11));
   ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 0, 0, result.at<gtsam::Pose3>(12));
 }
+
+TEST(PosegraphTest, testIncremental) {
+  Posegraph p_gtsam;
+  p_gtsam.setIncremental(true);
+  ASSERT_TRUE(p_gtsam.isIncremental());
+
+  Posegraph::Matrix6d info_ = 10 * Posegraph::Matrix6d::Identity();
+
+  // first half of the square.
+  p_gtsam.setInitial(0, pose(0, 0, 0, 0, 0, 0));
+  p_gtsam.setInitial(1, pose(0, 0, 0, 2.1, 0.1, 0));
+  p_gtsam.setInitial(2, pose(0, 0, 0, 3.9, 0.1, 0));
+  p_gtsam.setInitial(3, pose(0, 0, M_PI_2, 6.1, -0.1, 0));
+  p_gtsam.setInitial(4, pose(0, 0, M_PI_2, 6.1, 2.1, 0));
+  p_gtsam.setInitial(5, pose(0, 0, M_PI_2, 6.1, 3.9, 0));
+  p_gtsam.setInitial(6, pose(0, 0, M_PI, 6.1, 6.1, 0));
+
+  p_gtsam.addEdge(0, 1, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(1, 2, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(2, 3, pose(0, 0, M_PI_2, 2., 0, 0), info_);
+  p_gtsam.addEdge(3, 4, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(4, 5, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(5, 6, pose(0, 0, M_PI_2, 2., 0, 0), info_);
+
+  Posegraph::Ptr first = p_gtsam.extractChanges();
+  ASSERT_TRUE(first->optimize(10));
+  ASSERT_EQ(7, first->size());
+  ASSERT_POSE_EQ(M_PI, 0, 0, 6, 6, 0, first->result().at<gtsam::Pose3>(6));
+
+  // second half with loop closure edges only passes the new factors to the solver.
+  p_gtsam.setInitial(7, pose(0, 0, M_PI, 4.0, 6.1, 0));
+  p_gtsam.setInitial(8, pose(0, 0, M_PI, 2.0, 6.1, 0));
+  p_gtsam.setInitial(9, pose(0, 0, 3 * M_PI_2, 0.0, 6.1, 0));
+  p_gtsam.setInitial(10, pose(0, 0, 3 * M_PI_2, 0.0, 3.95, 0));
+  p_gtsam.setInitial(11, pose(0, 0, 3 * M_PI_2, 0.0, 2.0, 0));
+  p_gtsam.setInitial(12, pose(0, 0, 3 * M_PI_2, 0.0, 0.0, 0));
+
+  p_gtsam.addEdge(6, 7, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(7, 8, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(8, 9, pose(0, 0, M_PI_2, 2., 0, 0), info_);
+  p_gtsam.addEdge(9, 10, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(10, 11, pose(0, 0, 0, 2., 0, 0), info_);
+  p_gtsam.addEdge(11, 12, pose(0, 0, 0, 2., 0, 0), info_);
+
+  p_gtsam.addEdge(11, 0, pose(0, 0, M_PI_2, 2., 0, 0), info_);
+  p_gtsam.addEdge(12, 0, pose(0, 0, M_PI_2, 0, 0, 0), info_);
+  p_gtsam.addEdge(11, 1, pose(0, 0, M_PI_2, 2., 2, 0), info_);
+  p_gtsam.addEdge(12, 1, pose(0, 0, M_PI_2, 0, 2, 0), info_);
+
+  Posegraph::Ptr second = p_gtsam.extractChanges();
+  ASSERT_EQ(12, second->graph().size());  // only new factors.
+  ASSERT_TRUE(second->optimize(10));
+
+  // estimates of all nodes are available.
+  const std::vector<Eigen::Matrix4d> poses = second->poses();
+  ASSERT_EQ(13, poses.size());
+
+  const gtsam::Values& result = second->result();
+
+  ASSERT_POSE_EQ(0, 0, 0, 0, 0, 0, result.at<gtsam::Pose3>(0));
+
+  ASSERT_POSE_EQ(0, 0, 0, 2, 0, 0, result.at<gtsam::Pose3>(1));
+  ASSERT_POSE_EQ(0, 0, 0, 4, 0, 0, result.at<gtsam::Pose3>(2));
+  ASSERT_POSE_EQ(M_PI_2, 0, 0, 6, 0, 0, result.at<gtsam::Pose3>(3));
+
+  ASSERT_POSE_EQ(M_PI_2, 0, 0, 6, 2, 0, result.at<gtsam::Pose3>(4));
+  ASSERT_POSE_EQ(M_PI_2, 0, 0, 6, 4, 0, result.at<gtsam::Pose3>(5));
+  ASSERT_POSE_EQ(M_PI, 0, 0, 6, 6, 0, result.at<gtsam::Pose3>(6));
+
+  ASSERT_POSE_EQ(M_PI, 0, 0, 4, 6, 0, result.at<gtsam::Pose3>(7));
+  ASSERT_POSE_EQ(M_PI, 0, 0, 2, 6, 0, result.at<gtsam::Pose3>(8));
+  ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 6, 0, result.at<gtsam::Pose3>(9));
+
+  ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 4, 0, result.at<gtsam::Pose3>(10));
+  ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 2, 0, result.at<gtsam::Pose3>(11));
+  ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 0, 0, result.at<gtsam::Pose3>(12));
+
+  // complete graph still available for the error.
+  ASSERT_EQ(17, p_gtsam.graph().size());
+}
+
+/** \brief square with some loop closure edges, see testOptimize. **/
+void buildSquare(Posegraph& graph) {
+  Posegraph::Matrix6d info = 10 * Posegraph::Matrix6d::Identity();
+  info(0, 3) = info(3, 0) = 0.5;  // some correlation between rotation and translation.
+
+  const float yaws[] = {0,    0,    0,    M_PI_2,     M_PI_2,     M_PI_2,    M_PI,
+                        M_PI, M_PI, 3 * M_PI_2, 3 * M_PI_2, 3 * M_PI_2, 3 * M_PI_2};
+  const float xs[] = {0, 2.1, 3.9, 6.1, 6.1, 6.1, 6.1, 4.0, 2.0, 0.0, 0.0, 0.0, 0.0};
+  const float ys[] = {0, 0.1, 0.1, -0.1, 2.1, 3.9, 6.1, 6.1, 6.1, 6.1, 3.95, 2.0, 0.0};
+
+  for (int32_t i = 0; i < 13; ++i) graph.setInitial(i, pose(yaws[i], 0, 0, xs[i], ys[i], 0));
+
+  for (int32_t i = 0; i < 12; ++i) {
+    bool corner = (i == 2 || i == 5 || i == 8);
+    graph.addEdge(i, i + 1, pose(0, 0, corner ? M_PI_2 : 0, 2., 0, 0), info);
+  }
+
+  graph.addEdge(11, 0, pose(0, 0, M_PI_2, 2., 0, 0), info);
+  graph.addEdge(12, 0, pose(0, 0, M_PI_2, 0, 0, 0), info);
+  graph.addEdge(11, 1, pose(0, 0, M_PI_2, 2., 2, 0), info);
+  graph.addEdge(12, 1, pose(0, 0, M_PI_2, 0, 2, 0), info);
+}
+
+void comparePosegraphs(const Posegraph& expected, const Posegraph& given, double tolerance) {
+  ASSERT_EQ(expected.size(), given.size());
+  ASSERT_EQ(expected.graph().size(), given.graph().size());
+  ASSERT_EQ(expected.getEdges().size(), given.getEdges().size());
+
+  std::vector<Eigen::Matrix4d> expected_poses = expected.poses();
+  std::vector<Eigen::Matrix4d> given_poses = given.poses();
+  for (uint32_t i = 0; i < expected_poses.size(); ++i) {
+    ASSERT_TRUE(expected_poses[i].isApprox(given_poses[i], tolerance)) << "Pose " << i << " differs.";
+  }
+
+  for (uint32_t i = 0; i < expected.getEdges().size(); ++i) {
+    const Posegraph::Edge& a = expected.getEdges()[i];
+    const Posegraph::Edge& b = given.getEdges()[i];
+
+    ASSERT_EQ(a.from, b.from);
+    ASSERT_EQ(a.to, b.to);
+    ASSERT_TRUE(a.measurement.isApprox(b.measurement, tolerance));
+    ASSERT_TRUE(a.information.isApprox(b.information, tolerance));
+  }
+
+  ASSERT_NEAR(expected.error(), given.error(), tolerance);
+}
+
+TEST(PosegraphTest, testSaveLoad) {
+  Posegraph graph;
+  buildSquare(graph);
+  graph.optimize(10);
+
+  // binary format is exact.
+  graph.save("posegraph_test.bin");
+  Posegraph binary;
+  binary.load("posegraph_test.bin");
+  comparePosegraphs(graph, binary, 1e-12);
+
+  for (uint32_t i = 0; i < 13; ++i) {
+    ASSERT_TRUE(graph.initial().at<gtsam::Pose3>(i).equals(binary.initial().at<gtsam::Pose3>(i), 1e-12));
+  }
+
+  // streamed file has the same content as the serialized buffer.
+  std::vector<char> buffer;
+  graph.serialize(buffer);
+  std::ifstream file("posegraph_test.bin", std::ios::binary);
+  std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ASSERT_EQ(buffer, content);
+
+  // g2o stores the result as vertices.
+  graph.save("posegraph_test.g2o");
+  Posegraph g2o;
+  g2o.load("posegraph_test.g2o");
+  comparePosegraphs(graph, g2o, 1e-9);
+
+  // loaded graph can be optimized further.
+  ASSERT_TRUE(binary.optimize(10));
+  ASSERT_POSE_EQ(3 * M_PI_2, 0, 0, 0, 0, 0, binary.result().at<gtsam::Pose3>(12));
+
+  // TORO export.
+  graph.save("posegraph_test.graph");
+  std::ifstream toro("posegraph_test.graph");
+  std::string line;
+  uint32_t vertices = 0, edges = 0;
+  while (std::getline(toro, line)) {
+    if (line.find("VERTEX3 ") == 0) vertices += 1;
+    if (line.find("EDGE3 ") == 0) edges += 1;
+  }
+  ASSERT_EQ(13, vertices);
+  ASSERT_EQ(16, edges);
+
+  ASSERT_THROW(binary.load("posegraph_test.graph"), std::runtime_error);
+}
 }
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include "io/PrefetchingReader.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace rv;
+
+namespace {
+
+/** \brief reader generating scans with a single point, where x encodes the scan index. **/
+class CountingReader : public LaserscanReader {
+ public:
+  CountingReader(uint32_t count) : count_(count) {}
+
+  void reset() override { current_ = 0; }
+
+  bool read(Laserscan& scan) override {
+    if (current_ >= count_) return false;
+
+    std::this_thread::sleep_for(std::chrono::microseconds(100));  // simulate disk access.
+    scan.clear();
+    scan.points().push_back(Point3f(current_, 0, 0));
+    current_ += 1;
+
+    return true;
+  }
+
+  bool isSeekable() const override { return true; }
+  void seek(uint32_t scan) override { current_ = scan; }
+  uint32_t count() const override { return count_; }
+
+ protected:
+  uint32_t count_;
+  uint32_t current_{0};
+};
+
+TEST(PrefetchingReaderTest, testSequentialRead) {
+  PrefetchingReader reader(std::make_shared<CountingReader>(100), 5);
+
+  ASSERT_EQ(100, reader.count());
+  ASSERT_TRUE(reader.isSeekable());
+
+  Laserscan scan;
+  for (uint32_t i = 0; i < 100; ++i) {
+    ASSERT_TRUE(reader.read(scan));
+    ASSERT_EQ(1, scan.size());
+    ASSERT_EQ(i, scan.point(0).x());
+  }
+
+  ASSERT_FALSE(reader.read(scan));
+  ASSERT_FALSE(reader.read(scan));
+}
+
+/** \brief reader failing after the given number of scans. **/
+class FailingReader : public CountingReader {
+ public:
+  FailingReader(uint32_t count, uint32_t failure) : CountingReader(count), failure_(failure) {}
+
+  bool read(Laserscan& scan) override {
+    if (current_ == failure_) throw std::runtime_error("FailingReader: corrupted scan.");
+    return CountingReader::read(scan);
+  }
+
+ protected:
+  uint32_t failure_;
+};
+
+TEST(PrefetchingReaderTest, testPrefetching) {
+  PrefetchingReader reader(std::make_shared<CountingReader>(100), 5);
+
+  // worker must fill the buffer without any read; the deadline only guards against a hanging worker.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (reader.available() < 5 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(5, reader.available());
+
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(0, scan.point(0).x());
+}
+
+TEST(PrefetchingReaderTest, testSeekAndReset) {
+  PrefetchingReader reader(std::make_shared<CountingReader>(100), 5);
+
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(1, scan.point(0).x());
+
+  // prefetched scans must be discarded.
+  reader.seek(42);
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(42, scan.point(0).x());
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(43, scan.point(0).x());
+
+  reader.seek(10);
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(10, scan.point(0).x());
+
+  reader.reset();
+  for (uint32_t i = 0; i < 100; ++i) {
+    ASSERT_TRUE(reader.read(scan));
+    ASSERT_EQ(i, scan.point(0).x());
+  }
+  ASSERT_FALSE(reader.read(scan));
+
+  // reset after all scans were read.
+  reader.reset();
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(0, scan.point(0).x());
+}
+
+TEST(PrefetchingReaderTest, testException) {
+  PrefetchingReader reader(std::make_shared<FailingReader>(100, 3), 5);
+
+  // scans before the failure are returned, afterwards the exception of the worker.
+  Laserscan scan;
+  for (uint32_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(reader.read(scan));
+    ASSERT_EQ(i, scan.point(0).x());
+  }
+  ASSERT_THROW(reader.read(scan), std::runtime_error);
+
+  // seeking behind the failure restarts the worker.
+  reader.seek(4);
+  ASSERT_TRUE(reader.read(scan));
+  ASSERT_EQ(4, scan.point(0).x());
+}
+}
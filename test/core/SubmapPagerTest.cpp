@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include "core/SubmapPager.h"
+#include "core/SurfelPacking.h"
+
+#include <random>
+
+namespace {
+
+std::vector<Surfel> randomSurfels(uint32_t num_surfels, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> uniform(-50.0f, 50.0f);
+
+  std::vector<Surfel> surfels(num_surfels);
+  for (uint32_t k = 0; k < num_surfels; ++k) {
+    Surfel& s = surfels[k];
+    s.x = uniform(gen);
+    s.y = uniform(gen);
+    s.z = 0.01f * uniform(gen);
+    s.radius = 0.2f;
+    s.nx = s.ny = 0.0f;
+    s.nz = 1.0f;
+    s.confidence = 10.0f;
+    s.timestamp = seed;
+    s.color = 0.5f;
+    s.weight = 1.0f;
+    s.count = seed;
+  }
+
+  return surfels;
+}
+
+bool equal(const std::vector<Surfel>& a, const std::vector<Surfel>& b) {
+  if (a.size() != b.size()) return false;
+  for (uint32_t k = 0; k < a.size(); ++k) {
+    if (a[k].x != b[k].x || a[k].y != b[k].y || a[k].z != b[k].z || a[k].timestamp != b[k].timestamp ||
+        a[k].count != b[k].count)
+      return false;
+  }
+
+  return true;
+}
+
+TEST(SubmapPagerTest, testUnlimited) {
+  SubmapPager pager;
+
+  std::vector<Surfel> surfels = randomSurfels(100, 1);
+  std::vector<Surfel> copy = surfels;
+  pager.put(SubmapPager::Index(0, 1), copy);
+  EXPECT_TRUE(copy.empty());
+
+  EXPECT_TRUE(pager.contains(SubmapPager::Index(0, 1)));
+  EXPECT_FALSE(pager.contains(SubmapPager::Index(1, 0)));
+
+  std::vector<Surfel> result;
+  EXPECT_TRUE(pager.get(SubmapPager::Index(0, 1), result));
+  EXPECT_TRUE(equal(surfels, result));
+  EXPECT_FALSE(pager.get(SubmapPager::Index(1, 0), result));
+
+  EXPECT_EQ(1, pager.statistics().hits);
+  EXPECT_EQ(0, pager.statistics().spilledSubmaps);
+  EXPECT_EQ(100 * sizeof(Surfel), pager.statistics().residentBytes);
+}
+
+TEST(SubmapPagerTest, testSpilling) {
+  const uint32_t num_submaps = 20;
+  const uint32_t num_surfels = 1000;
+
+  SubmapPager pager;
+  pager.setBudget(3 * num_surfels * sizeof(Surfel));  // only three submaps fit into memory.
+
+  std::vector<std::vector<Surfel>> submaps;
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    submaps.push_back(randomSurfels(num_surfels, i));
+    std::vector<Surfel> copy = submaps.back();
+    pager.put(SubmapPager::Index(i, -int32_t(i)), copy);
+
+    EXPECT_LE(pager.statistics().residentBytes, 3 * num_surfels * sizeof(Surfel));
+  }
+
+  EXPECT_EQ(num_submaps, pager.size());
+  EXPECT_EQ(num_submaps - 3, pager.statistics().spilledSubmaps);
+  EXPECT_GT(pager.statistics().spilledBytes, 0);
+  // byte planes of similar values should compress.
+  EXPECT_LT(pager.statistics().spilledBytes, (num_submaps - 3) * num_surfels * sizeof(Surfel));
+
+  // peek does not change anything.
+  std::vector<Surfel> result;
+  EXPECT_TRUE(pager.peek(SubmapPager::Index(0, 0), result));
+  EXPECT_TRUE(equal(submaps[0], result));
+  EXPECT_EQ(0, pager.statistics().misses);
+
+  // most recent submaps are in memory.
+  result.clear();
+  EXPECT_TRUE(pager.get(SubmapPager::Index(num_submaps - 1, -int32_t(num_submaps - 1)), result));
+  EXPECT_TRUE(equal(submaps.back(), result));
+  EXPECT_EQ(1, pager.statistics().hits);
+
+  // oldest submaps were spilled.
+  result.clear();
+  EXPECT_TRUE(pager.get(SubmapPager::Index(0, 0), result));
+  EXPECT_TRUE(equal(submaps[0], result));
+  EXPECT_EQ(1, pager.statistics().misses);
+
+  pager.prefetch(SubmapPager::Index(1, -1));
+  result.clear();
+  EXPECT_TRUE(pager.get(SubmapPager::Index(1, -1), result));
+  EXPECT_TRUE(equal(submaps[1], result));
+  EXPECT_EQ(1, pager.statistics().prefetchHits);
+  EXPECT_EQ(1, pager.statistics().misses);
+
+  // all submaps are still retrievable, also after re-spilling of unchanged submaps.
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    result.clear();
+    EXPECT_TRUE(pager.get(SubmapPager::Index(i, -int32_t(i)), result));
+    EXPECT_TRUE(equal(submaps[i], result));
+  }
+
+  // replaced content is returned.
+  std::vector<Surfel> replacement = randomSurfels(10, 100);
+  std::vector<Surfel> copy = replacement;
+  pager.put(SubmapPager::Index(0, 0), copy);
+  for (uint32_t i = 1; i < num_submaps; ++i) {
+    result.clear();
+    pager.get(SubmapPager::Index(i, -int32_t(i)), result);
+  }
+  result.clear();
+  EXPECT_TRUE(pager.get(SubmapPager::Index(0, 0), result));
+  EXPECT_TRUE(equal(replacement, result));
+
+  pager.clear();
+  EXPECT_EQ(0, pager.size());
+  EXPECT_EQ(0, pager.statistics().residentBytes);
+}
+
+TEST(SubmapPagerTest, testCompact) {
+  const uint32_t num_submaps = 10;
+  const uint32_t num_surfels = 1000;
+
+  SubmapPager pager;
+  pager.setCompact(true);
+  pager.setBudget(3 * num_surfels * SurfelPacking::PACKED_SIZE);
+
+  std::vector<std::vector<Surfel>> submaps;
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    submaps.push_back(randomSurfels(num_surfels, i));
+    std::vector<Surfel> copy = submaps.back();
+    pager.put(SubmapPager::Index(i, 0), copy);
+    EXPECT_TRUE(copy.empty());
+  }
+
+  EXPECT_GT(pager.statistics().spilledSubmaps, 0);
+  EXPECT_LT(pager.statistics().residentBytes, 4 * num_surfels * SurfelPacking::PACKED_SIZE);
+
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    std::vector<Surfel> result;
+    ASSERT_TRUE(pager.get(SubmapPager::Index(i, 0), result));
+    ASSERT_EQ(num_surfels, result.size());
+    for (uint32_t k = 0; k < num_surfels; ++k) {
+      ASSERT_NEAR(submaps[i][k].x, result[k].x, 2e-3);
+      ASSERT_NEAR(submaps[i][k].y, result[k].y, 2e-3);
+      ASSERT_NEAR(submaps[i][k].z, result[k].z, 2e-3);
+      ASSERT_EQ(submaps[i][k].timestamp, result[k].timestamp);
+      ASSERT_EQ(submaps[i][k].count, result[k].count);
+    }
+  }
+}
+
+TEST(SubmapPagerTest, testSnapshot) {
+  const uint32_t num_submaps = 10;
+  const uint32_t num_surfels = 1000;
+
+  SubmapPager pager;
+  pager.setBudget(3 * num_surfels * sizeof(Surfel));
+
+  std::vector<std::vector<Surfel>> submaps;
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    submaps.push_back(randomSurfels(num_surfels, i));
+    std::vector<Surfel> copy = submaps.back();
+    pager.put(SubmapPager::Index(i, 0), copy);
+  }
+
+  // spilled submaps are copied in compressed form.
+  std::vector<SubmapPager::Snapshot> snapshots(num_submaps);
+  uint32_t num_spilled = 0;
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    ASSERT_TRUE(pager.snapshot(SubmapPager::Index(i, 0), snapshots[i]));
+    if (snapshots[i].spilled) {
+      num_spilled += 1;
+      EXPECT_TRUE(snapshots[i].surfels.empty());
+      EXPECT_LT(snapshots[i].bytes.size(), num_surfels * sizeof(Surfel));
+    }
+
+    std::vector<Surfel> decoded;
+    SubmapPager::decode(snapshots[i], decoded);
+    ASSERT_TRUE(equal(submaps[i], decoded));
+  }
+  EXPECT_EQ(num_submaps - 3, num_spilled);
+  EXPECT_EQ(0, pager.statistics().misses);
+
+  SubmapPager restored;
+  restored.setBudget(3 * num_surfels * sizeof(Surfel));
+  for (const SubmapPager::Snapshot& snapshot : snapshots) restored.restore(snapshot);
+  EXPECT_EQ(num_submaps, restored.size());
+  EXPECT_LE(restored.statistics().residentBytes, 3 * num_surfels * sizeof(Surfel));
+
+  for (uint32_t i = 0; i < num_submaps; ++i) {
+    std::vector<Surfel> result;
+    ASSERT_TRUE(restored.get(SubmapPager::Index(i, 0), result));
+    ASSERT_TRUE(equal(submaps[i], result));
+  }
+}
+
+TEST(SubmapPagerTest, testFileCompaction) {
+  const uint32_t num_surfels = 1000;
+
+  SubmapPager pager;
+  pager.setBudget(num_surfels * sizeof(Surfel));  // only the most recently used submap stays in memory.
+  pager.setMinCompactionSize(0);
+
+  // every change of a submap leaves its previous content as dead bytes in the spill file.
+  std::vector<std::vector<Surfel>> submaps(2);
+  for (uint32_t round = 0; round < 10; ++round) {
+    for (uint32_t i = 0; i < 2; ++i) {
+      submaps[i] = randomSurfels(num_surfels, 10 * round + i);
+      std::vector<Surfel> copy = submaps[i];
+      pager.put(SubmapPager::Index(i, 0), copy);
+    }
+  }
+
+  EXPECT_GT(pager.statistics().compactions, 0);
+  for (uint32_t i = 0; i < 2; ++i) {
+    std::vector<Surfel> result;
+    ASSERT_TRUE(pager.get(SubmapPager::Index(i, 0), result));
+    ASSERT_TRUE(equal(submaps[i], result));
+  }
+}
+}
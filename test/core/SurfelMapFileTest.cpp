@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include "core/SurfelMapFile.h"
+
+#include <fstream>
+#include <random>
+
+namespace {
+
+SurfelMapFile::Tile randomTile(int32_t i, int32_t j, uint32_t num_surfels, std::mt19937& gen) {
+  std::uniform_real_distribution<float> uniform(-10.0f, 10.0f);
+
+  SurfelMapFile::Tile tile;
+  tile.index = SurfelMapFile::TileIndex(i, j);
+  for (uint32_t k = 0; k < num_surfels; ++k) {
+    Surfel s;
+    s.x = uniform(gen);
+    s.y = uniform(gen);
+    s.z = uniform(gen);
+    s.radius = 0.1f;
+    s.nx = s.ny = 0.0f;
+    s.nz = 1.0f;
+    s.confidence = uniform(gen);
+    s.timestamp = k;
+    s.color = s.weight = 1.0f;
+    s.count = k % 3;
+    tile.surfels.push_back(s);
+  }
+
+  return tile;
+}
+
+TEST(SurfelMapFileTest, testWriteOpen) {
+  std::mt19937 gen(42);
+
+  std::vector<Eigen::Matrix4f> poses;
+  for (uint32_t k = 0; k < 3; ++k) poses.push_back(Eigen::Matrix4f::Random());
+
+  std::vector<SurfelMapFile::Tile> tiles;
+  tiles.push_back(randomTile(0, 0, 1000, gen));
+  tiles.push_back(randomTile(-3, 2, 1, gen));
+  tiles.push_back(randomTile(5, -7, 2500, gen));
+  tiles.push_back(randomTile(1, 1, 0, gen));
+
+  SurfelMapFile::write("test_map.bin", 50.0f, poses, tiles);
+
+  SurfelMapFile file;
+  file.open("test_map.bin");
+  ASSERT_TRUE(file.isOpen());
+  EXPECT_EQ(50.0f, file.submapExtent());
+  ASSERT_EQ(poses.size(), file.poses().size());
+  for (uint32_t k = 0; k < poses.size(); ++k) EXPECT_TRUE(poses[k] == file.poses()[k]);
+  EXPECT_EQ(tiles.size(), file.tiles().size());
+
+  EXPECT_FALSE(file.isCompact());
+
+  for (const auto& tile : tiles) {
+    ASSERT_TRUE(file.contains(tile.index.first, tile.index.second));
+    ASSERT_EQ(tile.surfels.size(), file.count(tile.index.first, tile.index.second));
+
+    std::vector<Surfel> surfels;
+    ASSERT_TRUE(file.read(tile.index.first, tile.index.second, surfels));
+    ASSERT_EQ(tile.surfels.size(), surfels.size());
+
+    for (uint32_t k = 0; k < surfels.size(); ++k) {
+      ASSERT_EQ(tile.surfels[k].x, surfels[k].x);
+      ASSERT_EQ(tile.surfels[k].confidence, surfels[k].confidence);
+      ASSERT_EQ(tile.surfels[k].timestamp, surfels[k].timestamp);
+      ASSERT_EQ(tile.surfels[k].count, surfels[k].count);
+    }
+  }
+
+  std::vector<Surfel> surfels;
+  EXPECT_FALSE(file.contains(2, 2));
+  EXPECT_FALSE(file.read(2, 2, surfels));
+  EXPECT_TRUE(surfels.empty());
+  EXPECT_EQ(0, file.count(2, 2));
+
+  file.close();
+  EXPECT_FALSE(file.isOpen());
+}
+
+TEST(SurfelMapFileTest, testOverwriteOpen) {
+  std::mt19937 gen(7);
+
+  std::vector<Eigen::Matrix4f> poses(1, Eigen::Matrix4f::Identity());
+  std::vector<SurfelMapFile::Tile> tiles;
+  tiles.push_back(randomTile(0, 0, 100, gen));
+  tiles.push_back(randomTile(20, 20, 500, gen));
+  SurfelMapFile::write("test_overwrite_map.bin", 10.0f, poses, tiles);
+
+  SurfelMapFile file;
+  file.open("test_overwrite_map.bin");
+
+  // saving a loaded map replaces the file, which must not change the open file.
+  std::vector<SurfelMapFile::Tile> other;
+  other.push_back(randomTile(1, 1, 10, gen));
+  SurfelMapFile::write("test_overwrite_map.bin", 10.0f, poses, other);
+
+  std::vector<Surfel> surfels;
+  ASSERT_TRUE(file.read(20, 20, surfels));
+  ASSERT_EQ(500, surfels.size());
+  for (uint32_t k = 0; k < surfels.size(); ++k) ASSERT_EQ(tiles[1].surfels[k].x, surfels[k].x);
+
+  SurfelMapFile replaced;
+  replaced.open("test_overwrite_map.bin");
+  EXPECT_FALSE(replaced.contains(20, 20));
+  EXPECT_EQ(10, replaced.count(1, 1));
+}
+
+TEST(SurfelMapFileTest, testCompact) {
+  std::mt19937 gen(7);
+
+  std::vector<Eigen::Matrix4f> poses(2, Eigen::Matrix4f::Identity());
+  std::vector<SurfelMapFile::Tile> tiles;
+  tiles.push_back(randomTile(0, 0, 5000, gen));
+  tiles.push_back(randomTile(2, -1, 10, gen));
+
+  SurfelMapFile::write("test_raw_map.bin", 50.0f, poses, tiles);
+  SurfelMapFile::write("test_compact_map.bin", 50.0f, poses, tiles, true);
+
+  std::ifstream raw("test_raw_map.bin", std::ios::binary | std::ios::ate);
+  std::ifstream compact("test_compact_map.bin", std::ios::binary | std::ios::ate);
+  EXPECT_LT(2 * compact.tellg(), raw.tellg());
+
+  SurfelMapFile file;
+  file.open("test_compact_map.bin");
+  EXPECT_TRUE(file.isCompact());
+
+  for (const auto& tile : tiles) {
+    EXPECT_EQ(tile.surfels.size(), file.count(tile.index.first, tile.index.second));
+
+    std::vector<Surfel> surfels;
+    ASSERT_TRUE(file.read(tile.index.first, tile.index.second, surfels));
+    ASSERT_EQ(tile.surfels.size(), surfels.size());
+
+    for (uint32_t k = 0; k < surfels.size(); ++k) {
+      ASSERT_NEAR(tile.surfels[k].x, surfels[k].x, 1e-3);
+      ASSERT_NEAR(tile.surfels[k].y, surfels[k].y, 1e-3);
+      ASSERT_NEAR(tile.surfels[k].z, surfels[k].z, 1e-3);
+      ASSERT_EQ(tile.surfels[k].timestamp, surfels[k].timestamp);
+      ASSERT_EQ(tile.surfels[k].count, surfels[k].count);
+    }
+  }
+}
+
+TEST(SurfelMapFileTest, testInvalidFile) {
+  {
+    std::ofstream out("test_invalid_map.bin", std::ios::binary);
+    out << "no surfel map at all.";
+  }
+
+  SurfelMapFile file;
+  EXPECT_THROW(file.open("test_invalid_map.bin"), std::runtime_error);
+  EXPECT_FALSE(file.isOpen());
+  EXPECT_THROW(file.open("non_existing_map.bin"), std::runtime_error);
+
+  // truncated index.
+  std::vector<SurfelMapFile::Tile> tiles;
+  std::mt19937 gen(1);
+  tiles.push_back(randomTile(0, 0, 100, gen));
+  SurfelMapFile::write("test_truncated_map.bin", 50.0f, std::vector<Eigen::Matrix4f>(), tiles);
+  {
+    std::ifstream in("test_truncated_map.bin", std::ios::binary);
+    std::vector<char> bytes(30);
+    in.read(bytes.data(), bytes.size());
+    std::ofstream out("test_truncated_map.bin", std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+  }
+  EXPECT_THROW(file.open("test_truncated_map.bin"), std::runtime_error);
+}
+}
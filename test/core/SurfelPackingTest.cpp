@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "core/SurfelPacking.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace {
+
+std::vector<Surfel> randomSurfels(uint32_t num_surfels, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> position(-80.0f, 80.0f);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.01f, 2.0f);
+  std::uniform_real_distribution<float> confidence(-10.0f, 200.0f);
+  std::uniform_int_distribution<int32_t> timestamp(0, 5000);
+
+  std::vector<Surfel> surfels(num_surfels);
+  for (Surfel& s : surfels) {
+    s.x = position(gen);
+    s.y = position(gen);
+    s.z = 0.05f * position(gen);
+    s.radius = radius(gen);
+
+    float nx = normal(gen), ny = normal(gen), nz = normal(gen);
+    float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+    s.nx = nx / length;
+    s.ny = ny / length;
+    s.nz = nz / length;
+
+    s.confidence = confidence(gen);
+    s.count = timestamp(gen);
+    s.timestamp = s.count + timestamp(gen);
+    s.color = SurfelPacking::COLOR;
+    s.weight = radius(gen);
+  }
+
+  return surfels;
+}
+
+void checkBounds(const std::vector<Surfel>& surfels, const std::vector<Surfel>& decoded) {
+  ASSERT_EQ(surfels.size(), decoded.size());
+
+  // bounding box of a single chunk.
+  float extent[3] = {160.0f, 160.0f, 8.0f};
+  for (uint32_t k = 0; k < surfels.size(); ++k) {
+    const Surfel& a = surfels[k];
+    const Surfel& b = decoded[k];
+
+    ASSERT_LE(std::abs(a.x - b.x), 0.5f * extent[0] / 65535.0f + 1e-5f);
+    ASSERT_LE(std::abs(a.y - b.y), 0.5f * extent[1] / 65535.0f + 1e-5f);
+    ASSERT_LE(std::abs(a.z - b.z), 0.5f * extent[2] / 65535.0f + 1e-5f);
+
+    // acos is too imprecise for small angles.
+    double cx = double(a.ny) * b.nz - double(a.nz) * b.ny;
+    double cy = double(a.nz) * b.nx - double(a.nx) * b.nz;
+    double cz = double(a.nx) * b.ny - double(a.ny) * b.nx;
+    double dot = double(a.nx) * b.nx + double(a.ny) * b.ny + double(a.nz) * b.nz;
+    ASSERT_LE(std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot), SurfelPacking::MAX_NORMAL_ERROR);
+
+    ASSERT_LE(std::abs(a.radius - b.radius), std::abs(a.radius) / 2048.0f);
+    ASSERT_LE(std::abs(a.confidence - b.confidence), std::abs(a.confidence) / 2048.0f);
+    ASSERT_LE(std::abs(a.weight - b.weight), std::abs(a.weight) / 2048.0f);
+
+    ASSERT_EQ(a.timestamp, b.timestamp);
+    ASSERT_EQ(a.count, b.count);
+    ASSERT_EQ(a.color, b.color);
+  }
+}
+
+TEST(SurfelPackingTest, testRoundTrip) {
+  std::vector<Surfel> surfels = randomSurfels(3 * SurfelPacking::CHUNK_SIZE + 17, 42);
+
+  std::vector<char> packed;
+  SurfelPacking::pack(surfels.data(), surfels.size(), packed, false);
+  EXPECT_LT(packed.size(), surfels.size() * 21);
+  EXPECT_EQ(surfels.size(), SurfelPacking::count(packed.data(), packed.size()));
+
+  std::vector<Surfel> decoded;
+  SurfelPacking::unpack(packed.data(), packed.size(), decoded, false);
+  checkBounds(surfels, decoded);
+
+  // truncated data.
+  std::vector<Surfel> invalid;
+  EXPECT_THROW(SurfelPacking::unpack(packed.data(), packed.size() - 1, invalid), std::runtime_error);
+}
+
+TEST(SurfelPackingTest, testTimestampRange) {
+  std::vector<Surfel> surfels = randomSurfels(100, 1);
+  surfels[50].timestamp = 200000;  // more than 16 bit away from the other timestamps.
+  surfels[70].count = 100000;
+
+  std::vector<char> packed;
+  SurfelPacking::pack(surfels.data(), surfels.size(), packed);
+
+  std::vector<Surfel> decoded;
+  SurfelPacking::unpack(packed.data(), packed.size(), decoded);
+  ASSERT_EQ(surfels.size(), decoded.size());
+  for (uint32_t k = 0; k < surfels.size(); ++k) {
+    ASSERT_EQ(surfels[k].timestamp, decoded[k].timestamp);
+    ASSERT_EQ(surfels[k].count, decoded[k].count);
+  }
+}
+
+TEST(SurfelPackingTest, testSimd) {
+  if (!SurfelPacking::simdSupported()) return;
+
+  std::vector<Surfel> surfels = randomSurfels(2 * SurfelPacking::CHUNK_SIZE + 5, 7);
+  surfels[3].radius = 1e-6f;  // subnormal half.
+  surfels[4].confidence = 1e6f;  // overflow.
+
+  std::vector<char> scalar, simd;
+  SurfelPacking::pack(surfels.data(), surfels.size(), scalar, false);
+  SurfelPacking::pack(surfels.data(), surfels.size(), simd, true);
+  ASSERT_EQ(scalar.size(), simd.size());
+  EXPECT_EQ(0, std::memcmp(scalar.data(), simd.data(), scalar.size()));
+
+  std::vector<Surfel> decoded_scalar, decoded_simd;
+  SurfelPacking::unpack(scalar.data(), scalar.size(), decoded_scalar, false);
+  SurfelPacking::unpack(scalar.data(), scalar.size(), decoded_simd, true);
+  ASSERT_EQ(decoded_scalar.size(), decoded_simd.size());
+  EXPECT_EQ(0, std::memcmp(decoded_scalar.data(), decoded_simd.data(), decoded_scalar.size() * sizeof(Surfel)));
+}
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <rv/Stopwatch.h>
+#include <rv/Tracer.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rv;
+
+namespace {
+
+uint32_t countOccurrences(const std::string& text, const std::string& pattern) {
+  uint32_t count = 0;
+  for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) count += 1;
+  return count;
+}
+
+TEST(TracerTest, testDisabled) {
+  Tracer::clear();
+  Tracer::setEnabled(false);
+  {
+    ScopedTrace trace("ignored");
+  }
+  EXPECT_EQ(0, Tracer::size());
+}
+
+TEST(TracerTest, testThreads) {
+  const std::string filename = "/tmp/suma_tracer_test.json";
+
+  Tracer::clear();
+  Tracer::setEnabled(true);
+  Tracer::setThreadName("main");
+
+  std::thread worker([]() {
+    Tracer::setThreadName("worker");
+    for (uint32_t i = 0; i < 100; ++i) {
+      ScopedTrace outer("optimize");
+      ScopedTrace inner("iteration");
+    }
+  });
+
+  for (uint32_t i = 0; i < 100; ++i) {
+    ScopedTrace outer("processScan");
+    {
+      ScopedTrace inner("updatePose");
+    }
+    ScopedTrace inner("updateMap");
+  }
+  worker.join();
+
+  // spans of the finished thread are still available.
+  EXPECT_EQ(500, Tracer::size());
+
+  Tracer::write(filename);
+  Tracer::setEnabled(false);
+
+  std::ifstream in(filename.c_str());
+  std::stringstream json;
+  json << in.rdbuf();
+  std::string text = json.str();
+
+  EXPECT_EQ(0, text.find("{\"traceEvents\": ["));
+  EXPECT_EQ(100, countOccurrences(text, "\"name\": \"processScan\", \"ph\": \"X\""));
+  EXPECT_EQ(100, countOccurrences(text, "\"name\": \"iteration\", \"ph\": \"X\""));
+  EXPECT_EQ(2, countOccurrences(text, "\"ph\": \"M\""));
+  EXPECT_EQ(1, countOccurrences(text, "\"args\": {\"name\": \"worker\"}"));
+  EXPECT_EQ(text.size() - 3, text.rfind("]}\n"));
+
+  std::remove(filename.c_str());
+  Tracer::clear();
+  EXPECT_EQ(0, Tracer::size());
+}
+
+TEST(TracerTest, testWorkerThreads) {
+  const std::string filename = "/tmp/suma_tracer_test.json";
+
+  Tracer::clear();
+  Tracer::setEnabled(true);
+
+  // a worker started for every task, e.g., with std::async, continues the buffer of its finished predecessor.
+  for (uint32_t i = 0; i < 10; ++i) {
+    std::thread worker([]() {
+      ScopedTrace unnamed("unnamed");
+      Tracer::setThreadName("optimizer \"async\"");
+      ScopedTrace trace("optimize\\all");
+    });
+    worker.join();
+  }
+  EXPECT_EQ(20, Tracer::size());
+
+  Tracer::write(filename);
+  Tracer::setEnabled(false);
+
+  std::ifstream in(filename.c_str());
+  std::stringstream json;
+  json << in.rdbuf();
+  std::string text = json.str();
+
+  // names are escaped.
+  EXPECT_EQ(1, countOccurrences(text, "\"args\": {\"name\": \"optimizer \\\"async\\\"\"}"));
+  EXPECT_EQ(10, countOccurrences(text, "\"name\": \"optimize\\\\all\", \"ph\": \"X\""));
+  EXPECT_EQ(10, countOccurrences(text, "\"name\": \"unnamed\", \"ph\": \"X\""));
+
+  std::remove(filename.c_str());
+  Tracer::clear();
+}
+
+TEST(TracerTest, testStopwatchThreads) {
+  // timers of other threads must not interfere.
+  Stopwatch::tic();
+  std::thread worker([]() {
+    EXPECT_EQ(0, Stopwatch::active());
+    Stopwatch::tic();
+    Stopwatch::toc();
+    EXPECT_THROW(Stopwatch::toc(), std::runtime_error);
+  });
+  worker.join();
+
+  EXPECT_EQ(1, Stopwatch::active());
+  EXPECT_GE(Stopwatch::toc(), 0.0);
+}
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <util/trajectory_utils.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+Eigen::Matrix4d pose(double yaw, double x, double y) {
+  Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+  T.topLeftCorner<3, 3>() = Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  T(0, 3) = x;
+  T(1, 3) = y;
+
+  return T;
+}
+
+TEST(TrajectoryTest, testIdentical) {
+  std::vector<Eigen::Matrix4d> gt, result;
+  for (uint32_t i = 0; i < 10; ++i) {
+    gt.push_back(pose(0.1 * i, i, 0.5 * i));
+    // same trajectory, but starting at the origin.
+    result.push_back(gt[0].inverse() * gt.back());
+  }
+
+  Trajectory::Errors errors = Trajectory::evaluate(gt, result);
+  EXPECT_NEAR(0.0, errors.ate, 1e-9);
+  EXPECT_NEAR(0.0, errors.ate_max, 1e-9);
+  EXPECT_NEAR(0.0, errors.rpe_translation, 1e-9);
+  EXPECT_NEAR(0.0, errors.rpe_rotation, 1e-6);
+}
+
+TEST(TrajectoryTest, testDrift) {
+  std::vector<Eigen::Matrix4d> gt, result;
+  for (uint32_t i = 0; i < 11; ++i) {
+    gt.push_back(pose(0.0, i, 0.0));
+    // every step is 0.1 m too long.
+    result.push_back(pose(0.0, 1.1 * i, 0.0));
+  }
+
+  Trajectory::Errors errors = Trajectory::evaluate(gt, result);
+
+  double sum = 0.0;
+  for (uint32_t i = 0; i < 11; ++i) sum += (0.1 * i) * (0.1 * i);
+  EXPECT_NEAR(std::sqrt(sum / 11), errors.ate, 1e-9);
+  EXPECT_NEAR(1.0, errors.ate_max, 1e-9);
+  EXPECT_NEAR(0.1, errors.rpe_translation, 1e-9);
+  EXPECT_NEAR(0.0, errors.rpe_rotation, 1e-6);
+
+  // only the common prefix is evaluated.
+  result.resize(6);
+  EXPECT_NEAR(0.5, Trajectory::evaluate(gt, result).ate_max, 1e-9);
+}
+
+TEST(TrajectoryTest, testRotation) {
+  std::vector<Eigen::Matrix4d> gt, result;
+  gt.push_back(pose(0.0, 0.0, 0.0));
+  gt.push_back(pose(0.0, 1.0, 0.0));
+  result.push_back(pose(0.0, 0.0, 0.0));
+  result.push_back(pose(M_PI / 180.0, 1.0, 0.0));
+
+  Trajectory::Errors errors = Trajectory::evaluate(gt, result);
+  EXPECT_NEAR(0.0, errors.ate, 1e-9);
+  EXPECT_NEAR(0.0, errors.rpe_translation, 1e-9);
+  EXPECT_NEAR(1.0, errors.rpe_rotation, 1e-6);
+}
+}
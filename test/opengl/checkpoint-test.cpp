@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <core/SurfelMapping.h>
+#include <rv/PrimitiveParameters.h>
+#include "io/KITTIReader.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+
+using namespace rv;
+
+namespace {
+
+std::vector<Surfel> downloadSurfels(SurfelMapping& fusion) {
+  std::vector<Surfel> surfels;
+  glow::GlBuffer<Surfel> buffer = fusion.getMap()->getModelSurfels();
+  if (buffer.size() > 0) buffer.get(surfels);
+
+  return surfels;
+}
+
+TEST(CheckpointTest, testRestore) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) scans.push_back(scan);
+  ASSERT_EQ(2, scans.size());
+
+  SurfelMapping fusion(params);
+  fusion.processScan(scans[0]);
+  fusion.checkpoint("./checkpoint-test.bin");
+  fusion.waitCheckpoints();
+
+  SurfelMapping restored(params);
+  restored.restore("./checkpoint-test.bin");
+
+  ASSERT_EQ(fusion.timestamp(), restored.timestamp());
+  ASSERT_TRUE(fusion.getCurrentPose().isApprox(restored.getCurrentPose()));
+  ASSERT_TRUE(fusion.getLastPose().isApprox(restored.getLastPose()));
+
+  ASSERT_EQ(fusion.getPosegraph()->size(), restored.getPosegraph()->size());
+  for (int32_t i = 0; i < fusion.getPosegraph()->size(); ++i) {
+    ASSERT_TRUE(fusion.getPosegraph()->pose(i).isApprox(restored.getPosegraph()->pose(i))) << "pose " << i;
+  }
+
+  std::vector<Surfel> expected = downloadSurfels(fusion), surfels = downloadSurfels(restored);
+  ASSERT_GT(expected.size(), 0);
+  ASSERT_EQ(expected.size(), surfels.size());
+  ASSERT_EQ(0, std::memcmp(expected.data(), surfels.data(), expected.size() * sizeof(Surfel)));
+
+  // the restored state continues exactly like the original state.
+  fusion.processScan(scans[1]);
+  restored.processScan(scans[1]);
+
+  ASSERT_EQ(fusion.timestamp(), restored.timestamp());
+  ASSERT_TRUE(fusion.getCurrentPose().isApprox(restored.getCurrentPose(), 1e-6));
+
+  std::vector<Eigen::Matrix4d> poses = fusion.getOptimizedPoses(), restored_poses = restored.getOptimizedPoses();
+  ASSERT_EQ(poses.size(), restored_poses.size());
+  for (uint32_t i = 0; i < poses.size(); ++i) ASSERT_TRUE(poses[i].isApprox(restored_poses[i], 1e-6)) << "pose " << i;
+
+  ASSERT_EQ(fusion.getMap()->size(), restored.getMap()->size());
+}
+
+TEST(CheckpointTest, testInvalid) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+
+  KITTIReader reader("./scan0.bin");
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+
+  SurfelMapping fusion(params);
+  fusion.processScan(scan);
+  fusion.checkpoint("./checkpoint-test.bin");
+  fusion.waitCheckpoints();
+
+  std::ifstream in("./checkpoint-test.bin", std::ios::binary);
+  std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+
+  // magic, version, and state; afterwards the map state with timestamp, origin, surfels, and the number of poses.
+  uint64_t state_size = 0, num_surfels = 0;
+  std::memcpy(&state_size, content.data() + 2 * sizeof(uint32_t), sizeof(uint64_t));
+  uint64_t offset = 2 * sizeof(uint32_t) + sizeof(uint64_t) + state_size + 3 * sizeof(uint32_t);
+  std::memcpy(&num_surfels, content.data() + offset, sizeof(uint64_t));
+  offset += sizeof(uint64_t) + num_surfels * sizeof(Surfel);
+  ASSERT_LT(offset + sizeof(uint64_t), content.size());
+
+  // a count larger than the remaining file is rejected before any memory is allocated.
+  uint64_t num_poses = std::numeric_limits<uint64_t>::max() / 64;
+  std::memcpy(content.data() + offset, &num_poses, sizeof(uint64_t));
+  std::ofstream out("./checkpoint-invalid.bin", std::ios::binary);
+  out.write(content.data(), content.size());
+  out.close();
+
+  SurfelMapping restored(params);
+  ASSERT_THROW(restored.restore("./checkpoint-invalid.bin"), std::runtime_error);
+  ASSERT_EQ(0, restored.timestamp());
+}
+}
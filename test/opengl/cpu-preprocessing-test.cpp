@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <core/CpuPreprocessing.h>
+#include <core/Preprocessing.h>
+#include <glow/glutil.h>
+#include "io/KITTIReader.h"
+#include <rv/ParameterList.h>
+#include <rv/PrimitiveParameters.h>
+
+using namespace rv;
+using namespace glow;
+
+namespace {
+
+/** \brief CPU and OpenGL preprocessing should produce (almost) the same vertex map and normal map.
+ *
+ *  Only points projected exactly onto a pixel border might end in different pixels due to different
+ *  implementations of the trigonometric functions.
+ **/
+TEST(CpuPreprocessingTest, compareOpenGL) {
+  uint32_t width = 900;
+  uint32_t height = 64;
+
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 3.0f));
+  params.insert(FloatParameter("data_fov_down", -25.0f));
+  params.insert(FloatParameter("max_depth", 75.0f));
+  params.insert(FloatParameter("min_depth", 2.0f));
+
+  KITTIReader reader("./scan0.bin");
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+
+  GlBuffer<rv::Point3f> pts{BufferTarget::ARRAY_BUFFER, BufferUsage::DYNAMIC_READ};
+  pts.assign(scan.points());
+
+  Preprocessing preprocessor(params);
+  Frame frame(width, height);
+  ASSERT_NO_THROW(preprocessor.process(pts, frame));
+
+  std::vector<vec4> gl_vertices(width * height), gl_normals(width * height);
+  frame.vertex_map.download(gl_vertices);
+  frame.normal_map.download(gl_normals);
+
+  CpuPreprocessing cpu(params);
+  std::vector<vec4> vertices, normals;
+  cpu.process(scan.points(), vertices, normals);
+
+  uint32_t num_valid = 0, num_vertices_equal = 0, num_normals_equal = 0;
+  for (uint32_t i = 0; i < width * height; ++i) {
+    if (gl_vertices[i].w < 0.5f) continue;
+    num_valid += 1;
+
+    const vec4& v = vertices[i];
+    const vec4& w = gl_vertices[i];
+    if (v.w > 0.5f && std::abs(v.x - w.x) < 1e-4 && std::abs(v.y - w.y) < 1e-4 && std::abs(v.z - w.z) < 1e-4)
+      num_vertices_equal += 1;
+
+    const vec4& n = normals[i];
+    const vec4& m = gl_normals[i];
+    if (n.w == m.w && (m.w < 0.5f || n.x * m.x + n.y * m.y + n.z * m.z > 0.999f)) num_normals_equal += 1;
+  }
+
+  ASSERT_GT(num_valid, 0.5 * width * height);
+  ASSERT_GT(num_vertices_equal, 0.99 * num_valid);
+  ASSERT_GT(num_normals_equal, 0.97 * num_valid);
+
+  // the uploaded maps of the cpu backend must equal the host-side maps.
+  params.insert(StringParameter("preprocessing_backend", "cpu"));
+  Preprocessing cpu_preprocessor(params);
+  ASSERT_EQ(Preprocessing::Backend::CPU, cpu_preprocessor.backend());
+
+  Frame cpu_frame(width, height);
+  ASSERT_NO_THROW(cpu_preprocessor.process(scan.points(), cpu_frame));
+  ASSERT_EQ(vertices.size(), cpu_frame.vertex_data.size());
+  ASSERT_EQ(scan.points().size(), cpu_frame.points.size());
+
+  std::vector<vec4> uploaded(width * height);
+  cpu_frame.vertex_map.download(uploaded);
+  for (uint32_t i = 0; i < width * height; ++i) {
+    ASSERT_EQ(vertices[i].x, uploaded[i].x);
+    ASSERT_EQ(vertices[i].w, uploaded[i].w);
+  }
+}
+}
@@ -0,0 +1,110 @@
+#include <glow/glbase.h>
+#include <glow/glutil.h>
+#include <gtest/gtest.h>
+
+#include <glow/GlBuffer.h>
+#include <glow/GlFramebuffer.h>
+#include <glow/GlProgram.h>
+#include <glow/GlVertexArray.h>
+#include <glow/ScopedBinder.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "core/GpuTimer.h"
+
+using namespace glow;
+
+namespace {
+
+void draw(GpuTimer::Pass pass) {
+  uint32_t width = 32, height = 32;
+
+  GlProgram program;
+  program.attach(GlShader::fromCache(ShaderType::VERTEX_SHADER, "shader/pix2ndc.vert"));
+  program.attach(GlShader::fromCache(ShaderType::FRAGMENT_SHADER, "shader/pix2ndc.frag"));
+  program.link();
+
+  program.setUniform(GlUniform<int32_t>("width", width));
+  program.setUniform(GlUniform<int32_t>("height", height));
+
+  GlFramebuffer fbo(width, height, FramebufferTarget::DRAW);
+  GlTexture tex_output{width, height, TextureFormat::RGBA_FLOAT};
+  GlRenderbuffer rbo(width, height, RenderbufferFormat::DEPTH_STENCIL);
+  fbo.attach(FramebufferAttachment::COLOR0, tex_output);
+  fbo.attach(FramebufferAttachment::DEPTH_STENCIL, rbo);
+
+  std::vector<vec2> pixels(1, vec2(1, 1));
+  GlBuffer<vec2> buffer{BufferTarget::ARRAY_BUFFER, BufferUsage::STATIC_DRAW};
+  buffer.assign(pixels);
+
+  GlVertexArray vao;
+  vao.setVertexAttribute(0, buffer, 2, AttributeType::FLOAT, false, 2 * sizeof(GL_FLOAT), nullptr);
+  vao.enableVertexAttribute(0);
+
+  ScopedBinder<GlFramebuffer> fbo_bind(fbo);
+  ScopedBinder<GlProgram> program_bind(program);
+  ScopedBinder<GlVertexArray> vao_bind(vao);
+
+  glViewport(0, 0, width, height);
+
+  GpuTimer::begin(pass);
+  glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+  glDrawArrays(GL_POINTS, 0, buffer.size());
+  GpuTimer::end(pass);
+
+  CheckGlError();
+}
+
+/** \brief finish frames until the results of a new frame are harvested. **/
+bool harvest() {
+  int32_t frame = GpuTimer::frame();
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  do {
+    glFinish();  // results of all finished frames are available.
+    GpuTimer::nextFrame();
+  } while (GpuTimer::frame() == frame && std::chrono::steady_clock::now() < deadline);
+
+  return GpuTimer::frame() > frame;
+}
+
+TEST(GpuTimerTest, testTime) {
+  GpuTimer::setEnabled(true);
+
+  draw(GpuTimer::VERTEX_MAP);
+  ASSERT_TRUE(harvest());
+
+  EXPECT_EQ(0, GpuTimer::frame());
+  EXPECT_GE(GpuTimer::time(GpuTimer::VERTEX_MAP), 0.0);
+  EXPECT_LT(GpuTimer::time(GpuTimer::NORMAL_MAP), 0.0);  // not executed.
+
+  GpuTimer::setEnabled(false);
+  EXPECT_EQ(-1, GpuTimer::frame());
+}
+
+TEST(GpuTimerTest, testException) {
+  GpuTimer::setEnabled(true);
+
+  // the scope ends the pass during stack unwinding.
+  try {
+    GpuTimer::Scope timer(GpuTimer::RENDER);
+    throw std::runtime_error("failure");
+  } catch (const std::runtime_error&) {
+  }
+  EXPECT_FALSE(GpuTimer::running(GpuTimer::RENDER));
+  EXPECT_NO_THROW(draw(GpuTimer::RENDER));
+
+  // a pass without end() is discarded at the end of the frame.
+  GpuTimer::begin(GpuTimer::NORMAL_MAP);
+  EXPECT_THROW(GpuTimer::begin(GpuTimer::NORMAL_MAP), std::runtime_error);
+  ASSERT_TRUE(harvest());
+  EXPECT_FALSE(GpuTimer::running(GpuTimer::NORMAL_MAP));
+  EXPECT_GE(GpuTimer::time(GpuTimer::RENDER), 0.0);
+  EXPECT_LT(GpuTimer::time(GpuTimer::NORMAL_MAP), 0.0);
+
+  EXPECT_NO_THROW(draw(GpuTimer::NORMAL_MAP));
+
+  GpuTimer::setEnabled(false);
+}
+}
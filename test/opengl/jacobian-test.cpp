@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <core/CpuFrame2Model.h>
 #include <core/Frame2Model.h>
 #include <core/Preprocessing.h>
 #include <rv/PrimitiveParameters.h>
@@ -47,6 +48,7 @@ TEST(JacobianTest, testjacobian) {
   params.insert(FloatParameter("icp-max-angle", 50.0f));
   params.insert(FloatParameter("icp-max-distance", 2.0f));
   params.insert(FloatParameter("cutoff_threshold", 100.0f));
+  params.insert(StringParameter("icp-reduction", "blending"));  // gold values depend on the order of summation.
 
   KITTIReader reader("./scan0.bin");
   std::vector<Laserscan> scans;
@@ -100,3 +102,324 @@ TEST(JacobianTest, testjacobian) {
   ASSERT_EQ(valid, objective.valid());
   ASSERT_EQ(invalid, objective.invalid());
 }
+
+TEST(JacobianTest, testCpuJacobian) {
+  uint32_t width = 720;
+  uint32_t height = 64;
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 2.5));
+  params.insert(FloatParameter("data_fov_down", -24.8));
+  params.insert(FloatParameter("min_depth", 0.5f));
+  params.insert(FloatParameter("max_depth", 100.0f));
+  params.insert(FloatParameter("icp-max-angle", 50.0f));
+  params.insert(FloatParameter("icp-max-distance", 2.0f));
+  params.insert(FloatParameter("cutoff_threshold", 100.0f));
+  params.insert(StringParameter("weighting", "huber"));
+  params.insert(FloatParameter("factor", 0.5f));
+  params.insert(BooleanParameter("bilinear_sampling", true));
+
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) {
+    scans.push_back(scan);
+  }
+
+  ASSERT_EQ(2, scans.size());
+
+  glow::GlBuffer<rv::Point3f> pts{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+
+  Preprocessing preprocessor(params);
+
+  std::shared_ptr<Frame> frame1 = std::make_shared<Frame>(width, height);
+  std::shared_ptr<Frame> frame2 = std::make_shared<Frame>(width, height);
+
+  pts.assign(scans[0].points());
+  preprocessor.process(pts, *frame1);
+
+  pts.assign(scans[1].points());
+  preprocessor.process(pts, *frame2);
+
+  Eigen::Matrix4d pose = SE3::exp((Eigen::VectorXd(6) << 0.1, -0.05, 0.0, 0.001, 0.002, -0.01).finished());
+
+  Frame2Model gpu_objective(params);
+  gpu_objective.setData(frame1, frame2);
+  gpu_objective.initialize(pose);
+
+  CpuFrame2Model cpu_objective(params);
+  cpu_objective.setData(frame1, frame2);
+  cpu_objective.initialize(pose);
+
+  Eigen::MatrixXd JtJ_gpu(6, 6), JtJ_cpu(6, 6);
+  Eigen::MatrixXd Jtf_gpu(6, 1), Jtf_cpu(6, 1);
+  double F_gpu = gpu_objective.jacobianProducts(JtJ_gpu, Jtf_gpu);
+  double F_cpu = cpu_objective.jacobianProducts(JtJ_cpu, Jtf_cpu);
+
+  // few associations might differ due to different implementations of the trigonometric functions.
+  for (uint32_t i = 0; i < 6; ++i) {
+    for (uint32_t j = 0; j < 6; ++j) {
+      double tol = 0.01 * std::sqrt(std::abs(JtJ_gpu(i, i) * JtJ_gpu(j, j)));
+      ASSERT_NEAR(JtJ_gpu(i, j), JtJ_cpu(i, j), tol) << "Mismatch at (" << i << ", " << j << ")";
+    }
+    double tol = 0.01 * std::sqrt(std::abs(JtJ_gpu(i, i) * F_gpu));
+    ASSERT_NEAR(Jtf_gpu(i), Jtf_cpu(i), tol) << "Mismatch at " << i;
+  }
+  ASSERT_NEAR(F_gpu, F_cpu, 0.01 * F_gpu);
+
+  ASSERT_NEAR(gpu_objective.inlier(), cpu_objective.inlier(), 0.001 * gpu_objective.inlier());
+  ASSERT_NEAR(gpu_objective.outlier(), cpu_objective.outlier(), 0.01 * gpu_objective.outlier());
+  ASSERT_NEAR(gpu_objective.valid(), cpu_objective.valid(), 0.001 * gpu_objective.valid());
+  ASSERT_NEAR(gpu_objective.invalid(), cpu_objective.invalid(), 0.001 * gpu_objective.invalid());
+  ASSERT_NEAR(gpu_objective.inlier_residual(), cpu_objective.inlier_residual(), 0.01 * F_gpu);
+}
+
+TEST(JacobianTest, testComputeReduction) {
+  uint32_t width = 720;
+  uint32_t height = 64;
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 2.5));
+  params.insert(FloatParameter("data_fov_down", -24.8));
+  params.insert(FloatParameter("min_depth", 0.5f));
+  params.insert(FloatParameter("max_depth", 100.0f));
+  params.insert(FloatParameter("icp-max-angle", 50.0f));
+  params.insert(FloatParameter("icp-max-distance", 2.0f));
+  params.insert(FloatParameter("cutoff_threshold", 100.0f));
+  params.insert(StringParameter("weighting", "huber"));
+  params.insert(FloatParameter("factor", 0.5f));
+
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) {
+    scans.push_back(scan);
+  }
+
+  ASSERT_EQ(2, scans.size());
+
+  glow::GlBuffer<rv::Point3f> pts{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+
+  Preprocessing preprocessor(params);
+
+  std::shared_ptr<Frame> frame1 = std::make_shared<Frame>(width, height);
+  std::shared_ptr<Frame> frame2 = std::make_shared<Frame>(width, height);
+
+  pts.assign(scans[0].points());
+  preprocessor.process(pts, *frame1);
+
+  pts.assign(scans[1].points());
+  preprocessor.process(pts, *frame2);
+
+  Eigen::Matrix4d pose = SE3::exp((Eigen::VectorXd(6) << 0.1, -0.05, 0.0, 0.001, 0.002, -0.01).finished());
+
+  params.insert(StringParameter("icp-reduction", "blending"));
+  Frame2Model blend_objective(params);
+  blend_objective.setData(frame1, frame2);
+  blend_objective.initialize(pose);
+
+  params.insert(StringParameter("icp-reduction", "compute"));
+  Frame2Model compute_objective(params);
+  compute_objective.setData(frame1, frame2);
+  compute_objective.initialize(pose);
+
+  Eigen::MatrixXd JtJ_blend(6, 6), JtJ_compute(6, 6);
+  Eigen::MatrixXd Jtf_blend(6, 1), Jtf_compute(6, 1);
+  double F_blend = blend_objective.jacobianProducts(JtJ_blend, Jtf_blend);
+  double F_compute = compute_objective.jacobianProducts(JtJ_compute, Jtf_compute);
+
+  // only the order of summation differs.
+  for (uint32_t i = 0; i < 6; ++i) {
+    for (uint32_t j = 0; j < 6; ++j) {
+      double tol = 1e-4 * std::sqrt(std::abs(JtJ_blend(i, i) * JtJ_blend(j, j)));
+      ASSERT_NEAR(JtJ_blend(i, j), JtJ_compute(i, j), tol) << "Mismatch at (" << i << ", " << j << ")";
+    }
+    double tol = 1e-4 * std::sqrt(std::abs(JtJ_blend(i, i) * F_blend));
+    ASSERT_NEAR(Jtf_blend(i), Jtf_compute(i), tol) << "Mismatch at " << i;
+  }
+  ASSERT_NEAR(F_blend, F_compute, 1e-4 * F_blend);
+
+  // counts are exactly representable.
+  ASSERT_EQ(blend_objective.inlier(), compute_objective.inlier());
+  ASSERT_EQ(blend_objective.outlier(), compute_objective.outlier());
+  ASSERT_EQ(blend_objective.valid(), compute_objective.valid());
+  ASSERT_EQ(blend_objective.invalid(), compute_objective.invalid());
+}
+
+TEST(JacobianTest, testPyramidLevels) {
+  uint32_t width = 720;
+  uint32_t height = 64;
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 2.5));
+  params.insert(FloatParameter("data_fov_down", -24.8));
+  params.insert(FloatParameter("min_depth", 0.5f));
+  params.insert(FloatParameter("max_depth", 100.0f));
+  params.insert(FloatParameter("icp-max-angle", 50.0f));
+  params.insert(FloatParameter("icp-max-distance", 2.0f));
+  params.insert(FloatParameter("cutoff_threshold", 100.0f));
+  params.insert(StringParameter("weighting", "huber"));
+  params.insert(FloatParameter("factor", 0.5f));
+  params.insert(IntegerParameter("pyramid-levels", 3));
+
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) {
+    scans.push_back(scan);
+  }
+
+  ASSERT_EQ(2, scans.size());
+
+  glow::GlBuffer<rv::Point3f> pts{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+
+  Preprocessing preprocessor(params);
+
+  std::shared_ptr<Frame> frame1 = std::make_shared<Frame>(width, height);
+  std::shared_ptr<Frame> frame2 = std::make_shared<Frame>(width, height);
+
+  pts.assign(scans[0].points());
+  preprocessor.process(pts, *frame1);
+
+  pts.assign(scans[1].points());
+  preprocessor.process(pts, *frame2);
+
+  std::vector<std::string> reductions{"blending", "compute"};
+  for (const std::string& reduction : reductions) {
+    params.insert(StringParameter("icp-reduction", reduction));
+    Frame2Model gpu_objective(params);
+    CpuFrame2Model cpu_objective(params);
+
+    ASSERT_EQ(2, gpu_objective.getMaxLevel());
+    ASSERT_EQ(2, cpu_objective.getMaxLevel());
+
+    gpu_objective.setData(frame1, frame2);
+    gpu_objective.initialize(Eigen::Matrix4d::Identity());
+    cpu_objective.setData(frame1, frame2);
+    cpu_objective.initialize(Eigen::Matrix4d::Identity());
+
+    Eigen::MatrixXd JtJ(6, 6), Jtf(6, 1);
+    std::vector<uint32_t> gpu_counts, cpu_counts;
+    for (uint32_t lvl = 0; lvl < 3; ++lvl) {
+      gpu_objective.setLevel(lvl);
+      cpu_objective.setLevel(lvl);
+      gpu_objective.jacobianProducts(JtJ, Jtf);
+      cpu_objective.jacobianProducts(JtJ, Jtf);
+
+      gpu_counts.push_back(gpu_objective.valid() + gpu_objective.invalid());
+      cpu_counts.push_back(cpu_objective.valid() + cpu_objective.invalid());
+      ASSERT_NEAR(gpu_objective.valid(), cpu_objective.valid(), 0.001 * gpu_objective.valid()) << reduction;
+    }
+
+    // every level halves the number of evaluated pixels.
+    ASSERT_EQ(width * height / 4, gpu_counts[0]) << reduction;
+    ASSERT_EQ(width * height / 2, gpu_counts[1]) << reduction;
+    ASSERT_EQ(width * height, gpu_counts[2]) << reduction;
+    ASSERT_EQ(gpu_counts, cpu_counts) << reduction;
+  }
+}
+
+TEST(JacobianTest, testBatchedHypotheses) {
+  uint32_t width = 720;
+  uint32_t height = 64;
+  ParameterList params;
+  params.insert(IntegerParameter("data_width", width));
+  params.insert(IntegerParameter("data_height", height));
+  params.insert(FloatParameter("data_fov_up", 2.5));
+  params.insert(FloatParameter("data_fov_down", -24.8));
+  params.insert(FloatParameter("min_depth", 0.5f));
+  params.insert(FloatParameter("max_depth", 100.0f));
+  params.insert(FloatParameter("icp-max-angle", 50.0f));
+  params.insert(FloatParameter("icp-max-distance", 2.0f));
+  params.insert(FloatParameter("cutoff_threshold", 100.0f));
+  params.insert(StringParameter("weighting", "huber"));
+  params.insert(FloatParameter("factor", 0.5f));
+  params.insert(StringParameter("icp-reduction", "compute"));
+
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) {
+    scans.push_back(scan);
+  }
+
+  ASSERT_EQ(2, scans.size());
+
+  glow::GlBuffer<rv::Point3f> pts{glow::BufferTarget::ARRAY_BUFFER, glow::BufferUsage::DYNAMIC_READ};
+
+  Preprocessing preprocessor(params);
+
+  std::shared_ptr<Frame> frame1 = std::make_shared<Frame>(width, height);
+  std::shared_ptr<Frame> frame2 = std::make_shared<Frame>(width, height);
+
+  pts.assign(scans[0].points());
+  preprocessor.process(pts, *frame1);
+
+  pts.assign(scans[1].points());
+  preprocessor.process(pts, *frame2);
+
+  // more hypotheses than a single dispatch can handle.
+  std::vector<Eigen::Matrix4d> poses;
+  for (uint32_t i = 0; i < Frame2Model::MAX_HYPOTHESES + 4; ++i) {
+    double s = 0.1 * i;
+    poses.push_back(SE3::exp((Eigen::VectorXd(6) << 0.1 * s, -0.05, 0.02 * s, 0.001, 0.002 * s, -0.01).finished()));
+  }
+
+  Frame2Model gpu_objective(params);
+  gpu_objective.setData(frame1, frame2);
+
+  CpuFrame2Model cpu_objective(params);
+  cpu_objective.setData(frame1, frame2);
+
+  std::vector<Objective*> objectives{&gpu_objective, &cpu_objective};
+
+  for (Objective* objective : objectives) {
+    objective->initialize(Eigen::Matrix4d::Identity());
+
+    std::vector<Objective::Evaluation> results;
+    objective->jacobianProducts(poses, results);
+    ASSERT_EQ(poses.size(), results.size());
+
+    // batched evaluation must neither change the pose nor the counters.
+    ASSERT_TRUE(objective->pose().isIdentity());
+
+    Eigen::MatrixXd JtJ(6, 6), Jtf(6, 1);
+    for (uint32_t i = 0; i < poses.size(); ++i) {
+      objective->initialize(poses[i]);
+      double F = objective->jacobianProducts(JtJ, Jtf);
+
+      // same order of summation for every hypothesis.
+      ASSERT_NEAR(F, results[i].F, 1e-6 * F) << "Mismatch of hypothesis " << i;
+      for (uint32_t j = 0; j < 6; ++j) {
+        for (uint32_t k = 0; k < 6; ++k) {
+          double tol = 1e-6 * std::sqrt(std::abs(JtJ(j, j) * JtJ(k, k)));
+          ASSERT_NEAR(JtJ(j, k), results[i].JtJ(j, k), tol) << "Mismatch of hypothesis " << i;
+        }
+        ASSERT_NEAR(Jtf(j), results[i].Jtf(j), 1e-6 * std::sqrt(std::abs(JtJ(j, j) * F)));
+      }
+
+      ASSERT_EQ(objective->inlier(), results[i].inlier);
+      ASSERT_EQ(objective->outlier(), results[i].outlier);
+      ASSERT_EQ(objective->invalid(), results[i].invalid);
+    }
+
+    // batched optimization of a single hypothesis follows the sequential optimization.
+    LieGaussNewton gn;
+    ParameterList gn_params;
+    gn_params.insert(IntegerParameter("max iterations", 10));
+    gn.setParameters(gn_params);
+
+    gn.minimize(*objective, poses[1]);
+    Eigen::Matrix4d expected = gn.pose();
+
+    std::vector<LieGaussNewton::Hypothesis> hypotheses;
+    gn.minimize(*objective, std::vector<Eigen::Matrix4d>{poses[1]}, hypotheses);
+
+    ASSERT_EQ(1, hypotheses.size());
+    ASSERT_FALSE(hypotheses[0].pruned);
+    ASSERT_TRUE(expected.isApprox(hypotheses[0].pose, 1e-5));
+  }
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <core/SurfelMapping.h>
+#include <rv/PrimitiveParameters.h>
+#include "io/KITTIReader.h"
+
+#include <string>
+#include <vector>
+
+using namespace rv;
+
+namespace {
+
+std::vector<Eigen::Matrix4d> process(const std::vector<Laserscan>& scans, bool pipelined,
+                                     const std::string& backend) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+  params.insert(BooleanParameter("pipelined", pipelined));
+  params.insert(StringParameter("preprocessing_backend", backend));
+
+  SurfelMapping fusion(params);
+  for (uint32_t i = 0; i < scans.size(); ++i) {
+    if (i + 1 < scans.size())
+      fusion.processScan(scans[i], scans[i + 1]);
+    else
+      fusion.processScan(scans[i]);
+  }
+
+  return fusion.getOptimizedPoses();
+}
+
+TEST(PipelinedTest, testSamePoses) {
+  KITTIReader reader("./scan0.bin");
+  std::vector<Laserscan> scans;
+  Laserscan scan;
+  while (reader.read(scan)) scans.push_back(scan);
+  ASSERT_EQ(2, scans.size());
+
+  // several pipelined steps; the scans are repeated, since the test data only has two scans.
+  scans.push_back(scans[0]);
+  scans.push_back(scans[1]);
+
+  for (const std::string backend : {"opengl", "cpu"}) {
+    std::vector<Eigen::Matrix4d> expected = process(scans, false, backend);
+    std::vector<Eigen::Matrix4d> poses = process(scans, true, backend);
+
+    ASSERT_EQ(scans.size(), expected.size()) << backend;
+    ASSERT_EQ(expected.size(), poses.size()) << backend;
+    for (uint32_t i = 0; i < poses.size(); ++i) {
+      EXPECT_TRUE(poses[i].isApprox(expected[i], 1e-6)) << backend << ", pose " << i;
+    }
+  }
+}
+}
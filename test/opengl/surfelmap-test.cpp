@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+
+#include <core/Preprocessing.h>
+#include <core/SurfelMap.h>
+#include <core/SurfelMapFile.h>
+#include <rv/PrimitiveParameters.h>
+#include "io/KITTIReader.h"
+
+#include <set>
+#include <tuple>
+
+using namespace rv;
+
+namespace {
+
+// surfels on a grid with 1000 columns; at the height of the sensor, they are never visible and thus never updated.
+SurfelMapFile::Tile tile(int32_t i, int32_t j, uint32_t num_surfels, float extent, float confidence = 1.0f) {
+  SurfelMapFile::Tile tile;
+  tile.index = SurfelMapFile::TileIndex(i, j);
+  for (uint32_t k = 0; k < num_surfels; ++k) {
+    Surfel s;
+    s.x = 2.0f * extent * i + 0.01f * (k % 1000);
+    s.y = 2.0f * extent * j + 0.01f * (k / 1000);
+    s.z = 0.0f;
+    s.radius = 0.1f;
+    s.nx = s.ny = 0.0f;
+    s.nz = 1.0f;
+    s.confidence = confidence;
+    s.timestamp = 0;
+    s.color = s.weight = 1.0f;
+    s.count = 0;  // first pose.
+    tile.surfels.push_back(s);
+  }
+
+  return tile;
+}
+
+// all attributes except the color, which the update overwrites for visualization.
+typedef std::tuple<float, float, float, float, float, float, float, float, int32_t, float, float> SurfelKey;
+
+SurfelKey key(const Surfel& s) {
+  return SurfelKey(s.x, s.y, s.z, s.radius, s.nx, s.ny, s.nz, s.confidence, s.timestamp, s.weight, s.count);
+}
+
+std::set<SurfelKey> downloadSurfels(SurfelMap& map) {
+  std::vector<Surfel> surfels;
+  glow::GlBuffer<Surfel> buffer = map.getModelSurfels();
+  if (buffer.size() > 0) buffer.get(surfels);
+
+  std::set<SurfelKey> keys;
+  for (const Surfel& s : surfels) keys.insert(key(s));
+
+  return keys;
+}
+
+/** \brief number of surfels of the tile, which are contained in surfels. **/
+uint32_t count(const std::set<SurfelKey>& surfels, const SurfelMapFile::Tile& tile) {
+  uint32_t n = 0;
+  for (const Surfel& s : tile.surfels) n += surfels.count(key(s));
+
+  return n;
+}
+
+TEST(SurfelMapTest, testSaveLoadedMap) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+  const float extent = params["submap-extent"];
+
+  // tile (20, 20) is far outside of the active area around the origin.
+  std::vector<Eigen::Matrix4f> poses(1, Eigen::Matrix4f::Identity());
+  std::vector<SurfelMapFile::Tile> tiles;
+  tiles.push_back(tile(0, 0, 100, extent));
+  tiles.push_back(tile(20, 20, 500, extent));
+  SurfelMapFile::write("./surfelmap-test.bin", extent, poses, tiles);
+
+  SurfelMap map(params);
+  map.load("./surfelmap-test.bin");
+  ASSERT_EQ(100, map.size());
+
+  // the loaded file is replaced, but its tiles must be still available.
+  map.save("./surfelmap-test.bin");
+  map.save("./surfelmap-test2.bin");
+
+  SurfelMapFile file;
+  file.open("./surfelmap-test2.bin");
+  EXPECT_EQ(100, file.count(0, 0));
+  EXPECT_EQ(500, file.count(20, 20));
+
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  pose(0, 3) = pose(1, 3) = 40.0f * extent;
+  map.localize(pose);
+  ASSERT_EQ(500, map.size());
+}
+
+TEST(SurfelMapTest, testLocalize) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+  const float extent = params["submap-extent"];
+  const int32_t dim = params["submap-dimension"];
+
+  std::vector<Eigen::Matrix4f> poses(1, Eigen::Matrix4f::Identity());
+  std::vector<SurfelMapFile::Tile> tiles;
+  tiles.push_back(tile(0, 0, 100, extent));
+  tiles.push_back(tile(-dim, 0, 20, extent));
+  tiles.push_back(tile(-dim, -dim, 5, extent));
+  tiles.push_back(tile(dim + 1, 0, 50, extent));
+  tiles.push_back(tile(dim + 1, dim + 1, 10, extent));
+  SurfelMapFile::write("./surfelmap-test.bin", extent, poses, tiles);
+
+  SurfelMap map(params);
+  map.load("./surfelmap-test.bin");
+  map.setLocalization(true);
+  ASSERT_EQ(125, map.size());
+
+  // single steps only exchange the leaving and entering rows and columns.
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  pose(0, 3) = 2.0f * extent;
+  map.localize(pose);
+  EXPECT_EQ(150, map.size());
+
+  pose(1, 3) = 2.0f * extent;
+  map.localize(pose);
+  EXPECT_EQ(160, map.size());
+
+  // diagonal step back: the corner submap must be appended once.
+  pose(0, 3) = pose(1, 3) = 0.0f;
+  map.localize(pose);
+  EXPECT_EQ(125, map.size());
+
+  // jump uploads the complete active area.
+  pose(0, 3) = pose(1, 3) = 2.0f * (dim + 1) * extent;
+  map.localize(pose);
+  EXPECT_EQ(10, map.size());
+}
+
+TEST(SurfelMapTest, testGrowth) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+  const float extent = params["submap-extent"];
+  const int32_t dim = params["submap-dimension"];
+
+  // all buffers including the extraction buffer start smaller than a single submap; every scan is compacted.
+  params.insert(IntegerParameter("surfel-capacity", 64));
+  params.insert(IntegerParameter("surfel-compaction-interval", 1));
+  params.insert(FloatParameter("surfel-compaction-confidence", 0.5f));
+  params.insert(IntegerParameter("surfel-compaction-age", 0));
+
+  std::vector<Eigen::Matrix4f> poses(1, Eigen::Matrix4f::Identity());
+  SurfelMapFile::Tile stable = tile(0, -dim, 100, extent);
+  SurfelMapFile::Tile leaving = tile(-dim, 0, 100, extent);
+  SurfelMapFile::Tile unstable = tile(0, dim, 100, extent, 0.1f);
+  SurfelMapFile::Tile entering = tile(dim + 1, 0, 100000, extent);
+  std::vector<SurfelMapFile::Tile> tiles{stable, leaving, unstable, entering};
+  SurfelMapFile::write("./surfelmap-test.bin", extent, poses, tiles);
+
+  // upload of the active area exceeds the initial capacity.
+  SurfelMap map(params);
+  map.load("./surfelmap-test.bin");
+  ASSERT_EQ(300, map.size());
+
+  std::set<SurfelKey> surfels = downloadSurfels(map);
+  EXPECT_EQ(100, count(surfels, stable));
+  EXPECT_EQ(100, count(surfels, leaving));
+  EXPECT_EQ(100, count(surfels, unstable));
+
+  KITTIReader reader("./scan0.bin");
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+
+  uint32_t width = params["data_width"], height = params["data_height"];
+  Frame frame(width, height);
+  Preprocessing preprocessor(params);
+  preprocessor.process(&scan.points()[0], scan.points().size(), frame);
+
+  // the update moves the active area: the leaving submap is extracted into a buffer that is too small, and the
+  // entering submap is appended to the copied surfels, which exceeds the capacity again.
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  pose(0, 3) = 2.0f * extent;
+  map.update(pose, frame);
+
+  surfels = downloadSurfels(map);
+  EXPECT_EQ(100, count(surfels, stable));
+  EXPECT_EQ(0, count(surfels, unstable));  // removed by the compaction.
+  EXPECT_EQ(100000, count(surfels, entering));
+  EXPECT_GT(map.size(), 100200);  // with the leaving submap, which is discarded by the next update, and the scan.
+
+  map.update(pose, frame);
+  surfels = downloadSurfels(map);
+  EXPECT_EQ(100, count(surfels, stable));
+  EXPECT_EQ(0, count(surfels, leaving));
+  EXPECT_EQ(100000, count(surfels, entering));
+
+  // the extracted submap is complete.
+  map.save("./surfelmap-test2.bin");
+  SurfelMapFile file;
+  file.open("./surfelmap-test2.bin");
+  ASSERT_EQ(100, file.count(-dim, 0));
+
+  std::vector<Surfel> extracted;
+  file.read(-dim, 0, extracted);
+  std::set<SurfelKey> extracted_keys;
+  for (const Surfel& s : extracted) extracted_keys.insert(key(s));
+  EXPECT_EQ(100, count(extracted_keys, leaving));
+}
+
+TEST(SurfelMapTest, testRenderCache) {
+  ParameterList params;
+  parseXmlFile("./default.xml", params);
+  const float extent = params["submap-extent"];
+  uint32_t width = params["data_width"], height = params["data_height"];
+
+  std::vector<Eigen::Matrix4f> poses(1, Eigen::Matrix4f::Identity());
+  std::vector<SurfelMapFile::Tile> tiles{tile(0, 0, 100, extent)};
+  SurfelMapFile::write("./surfelmap-test.bin", extent, poses, tiles);
+
+  SurfelMap map(params);
+  map.load("./surfelmap-test.bin");
+  Frame frame(width, height);
+
+  // counts the hits and misses of a single rendering.
+  SurfelMap::RenderStatistics last = map.renderStatistics();
+  auto render = [&](const Eigen::Matrix4f& pose, float confidence_threshold) {
+    map.render(pose, frame, confidence_threshold);
+    SurfelMap::RenderStatistics stats = map.renderStatistics();
+    bool hit = (stats.hits == last.hits + 1 && stats.misses == last.misses);
+    bool miss = (stats.hits == last.hits && stats.misses == last.misses + 1);
+    last = stats;
+    EXPECT_TRUE(hit || miss);
+
+    return hit;
+  };
+
+  Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+  EXPECT_FALSE(render(pose, 0.0f));
+  EXPECT_TRUE(render(pose, 0.0f));
+
+  pose(0, 3) = 1.0f;
+  EXPECT_FALSE(render(pose, 0.0f));
+  EXPECT_TRUE(render(pose, 0.0f));
+
+  EXPECT_FALSE(render(pose, 1.0f));
+  EXPECT_TRUE(render(pose, 1.0f));
+
+  // every modification of the map invalidates the rendering.
+  map.updatePoses(poses);
+  EXPECT_FALSE(render(pose, 1.0f));
+  EXPECT_TRUE(render(pose, 1.0f));
+
+  map.setParameters(params);
+  EXPECT_FALSE(render(pose, 1.0f));
+  EXPECT_TRUE(render(pose, 1.0f));
+
+  KITTIReader reader("./scan0.bin");
+  Laserscan scan;
+  ASSERT_TRUE(reader.read(scan));
+  Frame data(width, height);
+  Preprocessing preprocessor(params);
+  preprocessor.process(&scan.points()[0], scan.points().size(), data);
+
+  map.update(pose, data);
+  EXPECT_FALSE(render(pose, 1.0f));
+  EXPECT_TRUE(render(pose, 1.0f));
+}
+}